@@ -3481,6 +3481,94 @@ static void test_delete_key_value(void)
     RegCloseKey(subkey);
 }
 
+static void test_many_keys(void)
+{
+    unsigned int i, count = 500;
+    char name[32], buffer[32];
+    HKEY hkey, subkey;
+    DWORD size, value;
+    LONG res;
+
+    res = RegCreateKeyExA( hkey_main, "many", 0, NULL, 0, KEY_ALL_ACCESS, NULL, &hkey, NULL );
+    ok(res == ERROR_SUCCESS, "RegCreateKeyExA failed: %d\n", res);
+
+    /* create enough keys and values to use the hash index, in scattered order,
+     * so that most of them are inserted in the middle */
+    for (i = 0; i < count; i++)
+    {
+        value = (i * 7919) % count;
+        sprintf( name, "key%07u", value );
+        res = RegCreateKeyExA( hkey, name, 0, NULL, 0, KEY_ALL_ACCESS, NULL, &subkey, NULL );
+        ok(res == ERROR_SUCCESS, "RegCreateKeyExA %s failed: %d\n", name, res);
+        if (res) break;
+        res = RegSetValueExA( subkey, "value", 0, REG_DWORD, (const BYTE *)&value, sizeof(value) );
+        ok(res == ERROR_SUCCESS, "RegSetValueExA failed: %d\n", res);
+        RegCloseKey( subkey );
+        sprintf( name, "value%07u", value );
+        res = RegSetValueExA( hkey, name, 0, REG_DWORD, (const BYTE *)&value, sizeof(value) );
+        ok(res == ERROR_SUCCESS, "RegSetValueExA %s failed: %d\n", name, res);
+    }
+
+    /* lookups must ignore case */
+    for (i = 0; i < count; i++)
+    {
+        sprintf( name, "KEY%07u", i );
+        res = RegOpenKeyExA( hkey, name, 0, KEY_READ, &subkey );
+        ok(res == ERROR_SUCCESS, "RegOpenKeyExA %s failed: %d\n", name, res);
+        if (res) break;
+        size = sizeof(value);
+        res = RegQueryValueExA( subkey, "VALUE", NULL, NULL, (BYTE *)&value, &size );
+        ok(res == ERROR_SUCCESS, "RegQueryValueExA failed: %d\n", res);
+        ok(value == i, "got %u, expected %u\n", value, i);
+        RegCloseKey( subkey );
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        sprintf( name, "Value%07u", i );
+        size = sizeof(value);
+        res = RegQueryValueExA( hkey, name, NULL, NULL, (BYTE *)&value, &size );
+        ok(res == ERROR_SUCCESS, "RegQueryValueExA %s failed: %d\n", name, res);
+        if (res) break;
+        ok(value == i, "got %u, expected %u\n", value, i);
+    }
+
+    /* enumeration returns the keys sorted by name, whatever the creation order */
+    for (i = 0; i < count; i += count / 100)
+    {
+        sprintf( name, "key%07u", i );
+        res = RegEnumKeyA( hkey, i, buffer, sizeof(buffer) );
+        ok(res == ERROR_SUCCESS, "RegEnumKeyA %u failed: %d\n", i, res);
+        ok(!strcmp( buffer, name ), "got %s, expected %s\n", buffer, name);
+    }
+
+    /* delete every other key and value, the remaining ones must still be found */
+    for (i = 0; i < count; i += 2)
+    {
+        sprintf( name, "key%07u", i );
+        res = RegDeleteKeyA( hkey, name );
+        ok(res == ERROR_SUCCESS, "RegDeleteKeyA %s failed: %d\n", name, res);
+        sprintf( name, "value%07u", i );
+        res = RegDeleteValueA( hkey, name );
+        ok(res == ERROR_SUCCESS, "RegDeleteValueA %s failed: %d\n", name, res);
+    }
+    for (i = 0; i < count; i++)
+    {
+        sprintf( name, "key%07u", i );
+        res = RegOpenKeyExA( hkey, name, 0, KEY_READ, &subkey );
+        if (i % 2) ok(res == ERROR_SUCCESS, "RegOpenKeyExA %s failed: %d\n", name, res);
+        else ok(res == ERROR_FILE_NOT_FOUND, "RegOpenKeyExA %s returned %d\n", name, res);
+        if (!res) RegCloseKey( subkey );
+        sprintf( name, "value%07u", i );
+        res = RegQueryValueExA( hkey, name, NULL, NULL, NULL, NULL );
+        if (i % 2) ok(res == ERROR_SUCCESS, "RegQueryValueExA %s failed: %d\n", name, res);
+        else ok(res == ERROR_FILE_NOT_FOUND, "RegQueryValueExA %s returned %d\n", name, res);
+    }
+
+    delete_key( hkey );
+    RegCloseKey( hkey );
+}
+
 static void test_RegOpenCurrentUser(void)
 {
     HKEY key;
@@ -3785,6 +3873,7 @@ START_TEST(registry)
     test_deleted_key();
     test_delete_value();
     test_delete_key_value();
+    test_many_keys();
     test_RegOpenCurrentUser();
     test_RegNotifyChangeKeyValue();
     test_RegQueryValueExPerformanceData();
@@ -1,16 +1,16 @@
 @ stdcall CallbackMayRunLong(ptr) kernel32.CallbackMayRunLong
-@ stub CancelThreadpoolIo
+@ stdcall CancelThreadpoolIo(ptr) kernel32.CancelThreadpoolIo
 @ stdcall ChangeTimerQueueTimer(ptr ptr long long) kernel32.ChangeTimerQueueTimer
 @ stdcall CloseThreadpool(ptr) kernel32.CloseThreadpool
 @ stdcall CloseThreadpoolCleanupGroup(ptr) kernel32.CloseThreadpoolCleanupGroup
 @ stdcall CloseThreadpoolCleanupGroupMembers(ptr long ptr) kernel32.CloseThreadpoolCleanupGroupMembers
-@ stub CloseThreadpoolIo
+@ stdcall CloseThreadpoolIo(ptr) kernel32.CloseThreadpoolIo
 @ stdcall CloseThreadpoolTimer(ptr) kernel32.CloseThreadpoolTimer
 @ stdcall CloseThreadpoolWait(ptr) kernel32.CloseThreadpoolWait
 @ stdcall CloseThreadpoolWork(ptr) kernel32.CloseThreadpoolWork
 @ stdcall CreateThreadpool(ptr) kernel32.CreateThreadpool
 @ stdcall CreateThreadpoolCleanupGroup() kernel32.CreateThreadpoolCleanupGroup
-@ stub CreateThreadpoolIo
+@ stdcall CreateThreadpoolIo(ptr ptr ptr ptr) kernel32.CreateThreadpoolIo
 @ stdcall CreateThreadpoolTimer(ptr ptr ptr) kernel32.CreateThreadpoolTimer
 @ stdcall CreateThreadpoolWait(ptr ptr ptr) kernel32.CreateThreadpoolWait
 @ stdcall CreateThreadpoolWork(ptr ptr ptr) kernel32.CreateThreadpoolWork
@@ -32,11 +32,11 @@
 @ stdcall SetThreadpoolThreadMinimum(ptr long) kernel32.SetThreadpoolThreadMinimum
 @ stdcall SetThreadpoolTimer(ptr ptr long long) kernel32.SetThreadpoolTimer
 @ stdcall SetThreadpoolWait(ptr long ptr) kernel32.SetThreadpoolWait
-@ stub StartThreadpoolIo
+@ stdcall StartThreadpoolIo(ptr) kernel32.StartThreadpoolIo
 @ stdcall SubmitThreadpoolWork(ptr) kernel32.SubmitThreadpoolWork
 @ stdcall TrySubmitThreadpoolCallback(ptr ptr ptr) kernel32.TrySubmitThreadpoolCallback
 @ stdcall UnregisterWaitEx(long long) kernel32.UnregisterWaitEx
-@ stub WaitForThreadpoolIoCallbacks
+@ stdcall WaitForThreadpoolIoCallbacks(ptr long) kernel32.WaitForThreadpoolIoCallbacks
 @ stdcall WaitForThreadpoolTimerCallbacks(ptr long) kernel32.WaitForThreadpoolTimerCallbacks
 @ stdcall WaitForThreadpoolWaitCallbacks(ptr long) kernel32.WaitForThreadpoolWaitCallbacks
 @ stdcall WaitForThreadpoolWorkCallbacks(ptr long) kernel32.WaitForThreadpoolWorkCallbacks
@@ -72,9 +72,24 @@ enum deferred_cmd
     DEFERRED_CLEARDEPTHSTENCILVIEW,     /* clear_depth_info */
 };
 
-struct deferred_call
+/* Deferred calls are packed back to back into chunks, so that recording a
+ * call usually doesn't need a heap allocation, and contexts recording on
+ * different threads don't contend on the heap lock. Chunks start small and
+ * double in size, so that short command lists stay small. */
+#define DEFERRED_CHUNK_MIN_SIZE 0x400
+#define DEFERRED_CHUNK_MAX_SIZE 0x10000
+
+struct deferred_chunk
 {
     struct list entry;
+    SIZE_T size;
+    SIZE_T used;
+    BYTE data[1];
+};
+
+struct deferred_call
+{
+    SIZE_T size;
     enum deferred_cmd cmd;
     union
     {
@@ -203,6 +218,7 @@ struct deferred_call
             UINT map_flags;
             void *buffer;
             UINT size;
+            struct deferred_call *previous;
         } map_info;
         struct
         {
@@ -245,22 +261,72 @@ struct d3d11_deferred_context
     LONG refcount;
 
     struct list commands;
+    struct deferred_call *last_map;
 
     struct wined3d_private_store private_store;
 };
 
 static struct deferred_call *add_deferred_call(struct d3d11_deferred_context *context, size_t extra_size)
 {
+    SIZE_T size = (sizeof(struct deferred_call) + extra_size + 7) & ~(SIZE_T)7;
+    struct deferred_chunk *chunk = NULL;
     struct deferred_call *call;
+    struct list *tail;
 
-    if (!(call = HeapAlloc(GetProcessHeap(), 0, sizeof(*call) + extra_size)))
-        return NULL;
+    if ((tail = list_tail(&context->commands)))
+        chunk = LIST_ENTRY(tail, struct deferred_chunk, entry);
+
+    if (!chunk || chunk->size - chunk->used < size)
+    {
+        SIZE_T chunk_size = chunk ? min(chunk->size * 2, DEFERRED_CHUNK_MAX_SIZE) : DEFERRED_CHUNK_MIN_SIZE;
+
+        chunk_size = max(chunk_size, size);
 
+        if (!(chunk = HeapAlloc(GetProcessHeap(), 0, FIELD_OFFSET(struct deferred_chunk, data[chunk_size]))))
+            return NULL;
+        chunk->size = chunk_size;
+        chunk->used = 0;
+        list_add_tail(&context->commands, &chunk->entry);
+    }
+
+    call = (struct deferred_call *)&chunk->data[chunk->used];
+    chunk->used += size;
+
+    call->size = size;
     call->cmd = 0xdeadbeef;
-    list_add_tail(&context->commands, &call->entry);
     return call;
 }
 
+/* Returns the call following "call", or the first call if "call" is NULL. */
+static struct deferred_call *next_deferred_call(const struct list *commands,
+        struct deferred_chunk **chunk, const struct deferred_call *call)
+{
+    struct list *entry;
+    SIZE_T offset;
+
+    if (call)
+    {
+        offset = (const BYTE *)call - (*chunk)->data + call->size;
+    }
+    else
+    {
+        if (!(entry = list_head(commands)))
+            return NULL;
+        *chunk = LIST_ENTRY(entry, struct deferred_chunk, entry);
+        offset = 0;
+    }
+
+    while (offset >= (*chunk)->used)
+    {
+        if (!(entry = list_next(commands, &(*chunk)->entry)))
+            return NULL;
+        *chunk = LIST_ENTRY(entry, struct deferred_chunk, entry);
+        offset = 0;
+    }
+
+    return (struct deferred_call *)&(*chunk)->data[offset];
+}
+
 /* for DEFERRED_DSSETSHADERRESOURCES and DEFERRED_PSSETSHADERRESOURCES */
 static void add_deferred_set_shader_resources(struct d3d11_deferred_context *context, enum deferred_cmd cmd,
         UINT start_slot, UINT view_count, ID3D11ShaderResourceView *const *views)
@@ -327,10 +393,11 @@ static void add_deferred_set_constant_buffers(struct d3d11_deferred_context *con
 
 static void free_deferred_calls(struct list *commands)
 {
-    struct deferred_call *call, *call2;
+    struct deferred_chunk *chunk = NULL, *chunk2;
+    struct deferred_call *call = NULL;
     int i;
 
-    LIST_FOR_EACH_ENTRY_SAFE(call, call2, commands, struct deferred_call, entry)
+    while ((call = next_deferred_call(commands, &chunk, call)))
     {
         switch (call->cmd)
         {
@@ -501,17 +568,21 @@ static void free_deferred_calls(struct list *commands)
                 break;
             }
         }
+    }
 
-        list_remove(&call->entry);
-        HeapFree(GetProcessHeap(), 0, call);
+    LIST_FOR_EACH_ENTRY_SAFE(chunk, chunk2, commands, struct deferred_chunk, entry)
+    {
+        list_remove(&chunk->entry);
+        HeapFree(GetProcessHeap(), 0, chunk);
     }
 }
 
 static void exec_deferred_calls(ID3D11DeviceContext *iface, struct list *commands)
 {
-    struct deferred_call *call;
+    struct deferred_chunk *chunk = NULL;
+    struct deferred_call *call = NULL;
 
-    LIST_FOR_EACH_ENTRY(call, commands, struct deferred_call, entry)
+    while ((call = next_deferred_call(commands, &chunk, call)))
     {
         switch (call->cmd)
         {
@@ -863,6 +934,84 @@ static inline struct d3d_device *device_from_immediate_ID3D11DeviceContext(ID3D1
     return CONTAINING_RECORD(context, struct d3d_device, immediate_context);
 }
 
+static void d3d11_set_shader_resource_views(struct d3d_device *device, enum wined3d_shader_type type,
+        UINT start_slot, UINT view_count, ID3D11ShaderResourceView *const *views)
+{
+    struct wined3d_shader_resource_view *wined3d_views[D3D11_COMMONSHADER_INPUT_RESOURCE_SLOT_COUNT];
+    unsigned int i;
+
+    if (start_slot >= ARRAY_SIZE(wined3d_views))
+    {
+        WARN("Invalid start slot %u.\n", start_slot);
+        return;
+    }
+    if (view_count > ARRAY_SIZE(wined3d_views) - start_slot)
+    {
+        WARN("Invalid view count %u, clamping.\n", view_count);
+        view_count = ARRAY_SIZE(wined3d_views) - start_slot;
+    }
+
+    for (i = 0; i < view_count; ++i)
+    {
+        struct d3d_shader_resource_view *view = unsafe_impl_from_ID3D11ShaderResourceView(views[i]);
+
+        wined3d_views[i] = view ? view->wined3d_view : NULL;
+    }
+    wined3d_device_set_shader_resource_views(device->wined3d_device, type, start_slot, view_count, wined3d_views);
+}
+
+static void d3d11_set_samplers(struct d3d_device *device, enum wined3d_shader_type type,
+        UINT start_slot, UINT sampler_count, ID3D11SamplerState *const *samplers)
+{
+    struct wined3d_sampler *wined3d_samplers[D3D11_COMMONSHADER_SAMPLER_SLOT_COUNT];
+    unsigned int i;
+
+    if (start_slot >= ARRAY_SIZE(wined3d_samplers))
+    {
+        WARN("Invalid start slot %u.\n", start_slot);
+        return;
+    }
+    if (sampler_count > ARRAY_SIZE(wined3d_samplers) - start_slot)
+    {
+        WARN("Invalid sampler count %u, clamping.\n", sampler_count);
+        sampler_count = ARRAY_SIZE(wined3d_samplers) - start_slot;
+    }
+
+    for (i = 0; i < sampler_count; ++i)
+    {
+        struct d3d_sampler_state *sampler = unsafe_impl_from_ID3D11SamplerState(samplers[i]);
+
+        wined3d_samplers[i] = sampler ? sampler->wined3d_sampler : NULL;
+    }
+    wined3d_device_set_samplers(device->wined3d_device, type, start_slot, sampler_count, wined3d_samplers);
+}
+
+static void d3d11_set_constant_buffers(struct d3d_device *device, enum wined3d_shader_type type,
+        UINT start_slot, UINT buffer_count, ID3D11Buffer *const *buffers)
+{
+    struct wined3d_buffer *wined3d_buffers[D3D11_COMMONSHADER_CONSTANT_BUFFER_API_SLOT_COUNT];
+    unsigned int i;
+
+    if (start_slot >= ARRAY_SIZE(wined3d_buffers))
+    {
+        WARN("Invalid start slot %u.\n", start_slot);
+        return;
+    }
+    if (buffer_count > ARRAY_SIZE(wined3d_buffers) - start_slot)
+    {
+        WARN("Invalid buffer count %u, clamping.\n", buffer_count);
+        buffer_count = ARRAY_SIZE(wined3d_buffers) - start_slot;
+    }
+
+    for (i = 0; i < buffer_count; ++i)
+    {
+        struct d3d_buffer *buffer = unsafe_impl_from_ID3D11Buffer(buffers[i]);
+
+        wined3d_buffers[i] = buffer ? buffer->wined3d_buffer : NULL;
+    }
+    wined3d_device_set_constant_buffers(device->wined3d_device, type, start_slot, buffer_count, wined3d_buffers);
+}
+
 static HRESULT STDMETHODCALLTYPE d3d11_immediate_context_QueryInterface(ID3D11DeviceContext *iface,
         REFIID riid, void **out)
 {
@@ -958,19 +1107,12 @@ static void STDMETHODCALLTYPE d3d11_immediate_context_VSSetConstantBuffers(ID3D1
         UINT start_slot, UINT buffer_count, ID3D11Buffer *const *buffers)
 {
     struct d3d_device *device = device_from_immediate_ID3D11DeviceContext(iface);
-    unsigned int i;
 
     TRACE("iface %p, start_slot %u, buffer_count %u, buffers %p.\n",
             iface, start_slot, buffer_count, buffers);
 
     wined3d_mutex_lock();
-    for (i = 0; i < buffer_count; ++i)
-    {
-        struct d3d_buffer *buffer = unsafe_impl_from_ID3D11Buffer(buffers[i]);
-
-        wined3d_device_set_vs_cb(device->wined3d_device, start_slot + i,
-                buffer ? buffer->wined3d_buffer : NULL);
-    }
+    d3d11_set_constant_buffers(device, WINED3D_SHADER_TYPE_VERTEX, start_slot, buffer_count, buffers);
     wined3d_mutex_unlock();
 }
 
@@ -978,19 +1120,12 @@ static void STDMETHODCALLTYPE d3d11_immediate_context_PSSetShaderResources(ID3D1
         UINT start_slot, UINT view_count, ID3D11ShaderResourceView *const *views)
 {
     struct d3d_device *device = device_from_immediate_ID3D11DeviceContext(iface);
-    unsigned int i;
 
     TRACE("iface %p, start_slot %u, view_count %u, views %p.\n",
             iface, start_slot, view_count, views);
 
     wined3d_mutex_lock();
-    for (i = 0; i < view_count; ++i)
-    {
-        struct d3d_shader_resource_view *view = unsafe_impl_from_ID3D11ShaderResourceView(views[i]);
-
-        wined3d_device_set_ps_resource_view(device->wined3d_device, start_slot + i,
-                view ? view->wined3d_view : NULL);
-    }
+    d3d11_set_shader_resource_views(device, WINED3D_SHADER_TYPE_PIXEL, start_slot, view_count, views);
     wined3d_mutex_unlock();
 }
 
@@ -1015,19 +1150,12 @@ static void STDMETHODCALLTYPE d3d11_immediate_context_PSSetSamplers(ID3D11Device
         UINT start_slot, UINT sampler_count, ID3D11SamplerState *const *samplers)
 {
     struct d3d_device *device = device_from_immediate_ID3D11DeviceContext(iface);
-    unsigned int i;
 
     TRACE("iface %p, start_slot %u, sampler_count %u, samplers %p.\n",
             iface, start_slot, sampler_count, samplers);
 
     wined3d_mutex_lock();
-    for (i = 0; i < sampler_count; ++i)
-    {
-        struct d3d_sampler_state *sampler = unsafe_impl_from_ID3D11SamplerState(samplers[i]);
-
-        wined3d_device_set_ps_sampler(device->wined3d_device, start_slot + i,
-                sampler ? sampler->wined3d_sampler : NULL);
-    }
+    d3d11_set_samplers(device, WINED3D_SHADER_TYPE_PIXEL, start_slot, sampler_count, samplers);
     wined3d_mutex_unlock();
 }
 
@@ -1120,19 +1248,12 @@ static void STDMETHODCALLTYPE d3d11_immediate_context_PSSetConstantBuffers(ID3D1
         UINT start_slot, UINT buffer_count, ID3D11Buffer *const *buffers)
 {
     struct d3d_device *device = device_from_immediate_ID3D11DeviceContext(iface);
-    unsigned int i;
 
     TRACE("iface %p, start_slot %u, buffer_count %u, buffers %p.\n",
             iface, start_slot, buffer_count, buffers);
 
     wined3d_mutex_lock();
-    for (i = 0; i < buffer_count; ++i)
-    {
-        struct d3d_buffer *buffer = unsafe_impl_from_ID3D11Buffer(buffers[i]);
-
-        wined3d_device_set_ps_cb(device->wined3d_device, start_slot + i,
-                buffer ? buffer->wined3d_buffer : NULL);
-    }
+    d3d11_set_constant_buffers(device, WINED3D_SHADER_TYPE_PIXEL, start_slot, buffer_count, buffers);
     wined3d_mutex_unlock();
 }
 
@@ -1223,19 +1344,12 @@ static void STDMETHODCALLTYPE d3d11_immediate_context_GSSetConstantBuffers(ID3D1
         UINT start_slot, UINT buffer_count, ID3D11Buffer *const *buffers)
 {
     struct d3d_device *device = device_from_immediate_ID3D11DeviceContext(iface);
-    unsigned int i;
 
     TRACE("iface %p, start_slot %u, buffer_count %u, buffers %p.\n",
             iface, start_slot, buffer_count, buffers);
 
     wined3d_mutex_lock();
-    for (i = 0; i < buffer_count; ++i)
-    {
-        struct d3d_buffer *buffer = unsafe_impl_from_ID3D11Buffer(buffers[i]);
-
-        wined3d_device_set_gs_cb(device->wined3d_device, start_slot + i,
-                buffer ? buffer->wined3d_buffer : NULL);
-    }
+    d3d11_set_constant_buffers(device, WINED3D_SHADER_TYPE_GEOMETRY, start_slot, buffer_count, buffers);
     wined3d_mutex_unlock();
 }
 
@@ -1276,18 +1390,11 @@ static void STDMETHODCALLTYPE d3d11_immediate_context_VSSetShaderResources(ID3D1
         UINT start_slot, UINT view_count, ID3D11ShaderResourceView *const *views)
 {
     struct d3d_device *device = device_from_immediate_ID3D11DeviceContext(iface);
-    unsigned int i;
 
     TRACE("iface %p, start_slot %u, view_count %u, views %p.\n", iface, start_slot, view_count, views);
 
     wined3d_mutex_lock();
-    for (i = 0; i < view_count; ++i)
-    {
-        struct d3d_shader_resource_view *view = unsafe_impl_from_ID3D11ShaderResourceView(views[i]);
-
-        wined3d_device_set_vs_resource_view(device->wined3d_device, start_slot + i,
-                view ? view->wined3d_view : NULL);
-    }
+    d3d11_set_shader_resource_views(device, WINED3D_SHADER_TYPE_VERTEX, start_slot, view_count, views);
     wined3d_mutex_unlock();
 }
 
@@ -1295,19 +1402,12 @@ static void STDMETHODCALLTYPE d3d11_immediate_context_VSSetSamplers(ID3D11Device
         UINT start_slot, UINT sampler_count, ID3D11SamplerState *const *samplers)
 {
     struct d3d_device *device = device_from_immediate_ID3D11DeviceContext(iface);
-    unsigned int i;
 
     TRACE("iface %p, start_slot %u, sampler_count %u, samplers %p.\n",
             iface, start_slot, sampler_count, samplers);
 
     wined3d_mutex_lock();
-    for (i = 0; i < sampler_count; ++i)
-    {
-        struct d3d_sampler_state *sampler = unsafe_impl_from_ID3D11SamplerState(samplers[i]);
-
-        wined3d_device_set_vs_sampler(device->wined3d_device, start_slot + i,
-                sampler ? sampler->wined3d_sampler : NULL);
-    }
+    d3d11_set_samplers(device, WINED3D_SHADER_TYPE_VERTEX, start_slot, sampler_count, samplers);
     wined3d_mutex_unlock();
 }
 
@@ -1390,18 +1490,11 @@ static void STDMETHODCALLTYPE d3d11_immediate_context_GSSetShaderResources(ID3D1
         UINT start_slot, UINT view_count, ID3D11ShaderResourceView *const *views)
 {
     struct d3d_device *device = device_from_immediate_ID3D11DeviceContext(iface);
-    unsigned int i;
 
     TRACE("iface %p, start_slot %u, view_count %u, views %p.\n", iface, start_slot, view_count, views);
 
     wined3d_mutex_lock();
-    for (i = 0; i < view_count; ++i)
-    {
-        struct d3d_shader_resource_view *view = unsafe_impl_from_ID3D11ShaderResourceView(views[i]);
-
-        wined3d_device_set_gs_resource_view(device->wined3d_device, start_slot + i,
-                view ? view->wined3d_view : NULL);
-    }
+    d3d11_set_shader_resource_views(device, WINED3D_SHADER_TYPE_GEOMETRY, start_slot, view_count, views);
     wined3d_mutex_unlock();
 }
 
@@ -1409,19 +1502,12 @@ static void STDMETHODCALLTYPE d3d11_immediate_context_GSSetSamplers(ID3D11Device
         UINT start_slot, UINT sampler_count, ID3D11SamplerState *const *samplers)
 {
     struct d3d_device *device = device_from_immediate_ID3D11DeviceContext(iface);
-    unsigned int i;
 
     TRACE("iface %p, start_slot %u, sampler_count %u, samplers %p.\n",
             iface, start_slot, sampler_count, samplers);
 
     wined3d_mutex_lock();
-    for (i = 0; i < sampler_count; ++i)
-    {
-        struct d3d_sampler_state *sampler = unsafe_impl_from_ID3D11SamplerState(samplers[i]);
-
-        wined3d_device_set_gs_sampler(device->wined3d_device, start_slot + i,
-                sampler ? sampler->wined3d_sampler : NULL);
-    }
+    d3d11_set_samplers(device, WINED3D_SHADER_TYPE_GEOMETRY, start_slot, sampler_count, samplers);
     wined3d_mutex_unlock();
 }
 
@@ -1980,19 +2066,12 @@ static void STDMETHODCALLTYPE d3d11_immediate_context_HSSetShaderResources(ID3D1
         UINT start_slot, UINT view_count, ID3D11ShaderResourceView *const *views)
 {
     struct d3d_device *device = device_from_immediate_ID3D11DeviceContext(iface);
-    unsigned int i;
 
     TRACE("iface %p, start_slot %u, view_count %u, views %p.\n",
             iface, start_slot, view_count, views);
 
     wined3d_mutex_lock();
-    for (i = 0; i < view_count; ++i)
-    {
-        struct d3d_shader_resource_view *view = unsafe_impl_from_ID3D11ShaderResourceView(views[i]);
-
-        wined3d_device_set_hs_resource_view(device->wined3d_device, start_slot + i,
-                view ? view->wined3d_view : NULL);
-    }
+    d3d11_set_shader_resource_views(device, WINED3D_SHADER_TYPE_HULL, start_slot, view_count, views);
     wined3d_mutex_unlock();
 }
 
@@ -2017,19 +2096,12 @@ static void STDMETHODCALLTYPE d3d11_immediate_context_HSSetSamplers(ID3D11Device
         UINT start_slot, UINT sampler_count, ID3D11SamplerState *const *samplers)
 {
     struct d3d_device *device = device_from_immediate_ID3D11DeviceContext(iface);
-    unsigned int i;
 
     TRACE("iface %p, start_slot %u, sampler_count %u, samplers %p.\n",
             iface, start_slot, sampler_count, samplers);
 
     wined3d_mutex_lock();
-    for (i = 0; i < sampler_count; ++i)
-    {
-        struct d3d_sampler_state *sampler = unsafe_impl_from_ID3D11SamplerState(samplers[i]);
-
-        wined3d_device_set_hs_sampler(device->wined3d_device, start_slot + i,
-                sampler ? sampler->wined3d_sampler : NULL);
-    }
+    d3d11_set_samplers(device, WINED3D_SHADER_TYPE_HULL, start_slot, sampler_count, samplers);
     wined3d_mutex_unlock();
 }
 
@@ -2037,19 +2109,12 @@ static void STDMETHODCALLTYPE d3d11_immediate_context_HSSetConstantBuffers(ID3D1
         UINT start_slot, UINT buffer_count, ID3D11Buffer *const *buffers)
 {
     struct d3d_device *device = device_from_immediate_ID3D11DeviceContext(iface);
-    unsigned int i;
 
     TRACE("iface %p, start_slot %u, buffer_count %u, buffers %p.\n",
             iface, start_slot, buffer_count, buffers);
 
     wined3d_mutex_lock();
-    for (i = 0; i < buffer_count; ++i)
-    {
-        struct d3d_buffer *buffer = unsafe_impl_from_ID3D11Buffer(buffers[i]);
-
-        wined3d_device_set_hs_cb(device->wined3d_device, start_slot + i,
-                buffer ? buffer->wined3d_buffer : NULL);
-    }
+    d3d11_set_constant_buffers(device, WINED3D_SHADER_TYPE_HULL, start_slot, buffer_count, buffers);
     wined3d_mutex_unlock();
 }
 
@@ -2057,19 +2122,12 @@ static void STDMETHODCALLTYPE d3d11_immediate_context_DSSetShaderResources(ID3D1
         UINT start_slot, UINT view_count, ID3D11ShaderResourceView *const *views)
 {
     struct d3d_device *device = device_from_immediate_ID3D11DeviceContext(iface);
-    unsigned int i;
 
     TRACE("iface %p, start_slot %u, view_count %u, views %p.\n",
             iface, start_slot, view_count, views);
 
     wined3d_mutex_lock();
-    for (i = 0; i < view_count; ++i)
-    {
-        struct d3d_shader_resource_view *view = unsafe_impl_from_ID3D11ShaderResourceView(views[i]);
-
-        wined3d_device_set_ds_resource_view(device->wined3d_device, start_slot + i,
-                view ? view->wined3d_view : NULL);
-    }
+    d3d11_set_shader_resource_views(device, WINED3D_SHADER_TYPE_DOMAIN, start_slot, view_count, views);
     wined3d_mutex_unlock();
 }
 
@@ -2094,19 +2152,12 @@ static void STDMETHODCALLTYPE d3d11_immediate_context_DSSetSamplers(ID3D11Device
         UINT start_slot, UINT sampler_count, ID3D11SamplerState *const *samplers)
 {
     struct d3d_device *device = device_from_immediate_ID3D11DeviceContext(iface);
-    unsigned int i;
 
     TRACE("iface %p, start_slot %u, sampler_count %u, samplers %p.\n",
             iface, start_slot, sampler_count, samplers);
 
     wined3d_mutex_lock();
-    for (i = 0; i < sampler_count; ++i)
-    {
-        struct d3d_sampler_state *sampler = unsafe_impl_from_ID3D11SamplerState(samplers[i]);
-
-        wined3d_device_set_ds_sampler(device->wined3d_device, start_slot + i,
-                sampler ? sampler->wined3d_sampler : NULL);
-    }
+    d3d11_set_samplers(device, WINED3D_SHADER_TYPE_DOMAIN, start_slot, sampler_count, samplers);
     wined3d_mutex_unlock();
 }
 
@@ -2114,19 +2165,12 @@ static void STDMETHODCALLTYPE d3d11_immediate_context_DSSetConstantBuffers(ID3D1
         UINT start_slot, UINT buffer_count, ID3D11Buffer *const *buffers)
 {
     struct d3d_device *device = device_from_immediate_ID3D11DeviceContext(iface);
-    unsigned int i;
 
     TRACE("iface %p, start_slot %u, buffer_count %u, buffers %p.\n",
             iface, start_slot, buffer_count, buffers);
 
     wined3d_mutex_lock();
-    for (i = 0; i < buffer_count; ++i)
-    {
-        struct d3d_buffer *buffer = unsafe_impl_from_ID3D11Buffer(buffers[i]);
-
-        wined3d_device_set_ds_cb(device->wined3d_device, start_slot + i,
-                buffer ? buffer->wined3d_buffer : NULL);
-    }
+    d3d11_set_constant_buffers(device, WINED3D_SHADER_TYPE_DOMAIN, start_slot, buffer_count, buffers);
     wined3d_mutex_unlock();
 }
 
@@ -2134,19 +2178,12 @@ static void STDMETHODCALLTYPE d3d11_immediate_context_CSSetShaderResources(ID3D1
         UINT start_slot, UINT view_count, ID3D11ShaderResourceView *const *views)
 {
     struct d3d_device *device = device_from_immediate_ID3D11DeviceContext(iface);
-    unsigned int i;
 
     TRACE("iface %p, start_slot %u, view_count %u, views %p.\n",
             iface, start_slot, view_count, views);
 
     wined3d_mutex_lock();
-    for (i = 0; i < view_count; ++i)
-    {
-        struct d3d_shader_resource_view *view = unsafe_impl_from_ID3D11ShaderResourceView(views[i]);
-
-        wined3d_device_set_cs_resource_view(device->wined3d_device, start_slot + i,
-                view ? view->wined3d_view : NULL);
-    }
+    d3d11_set_shader_resource_views(device, WINED3D_SHADER_TYPE_COMPUTE, start_slot, view_count, views);
     wined3d_mutex_unlock();
 }
 
@@ -2196,19 +2233,12 @@ static void STDMETHODCALLTYPE d3d11_immediate_context_CSSetSamplers(ID3D11Device
         UINT start_slot, UINT sampler_count, ID3D11SamplerState *const *samplers)
 {
     struct d3d_device *device = device_from_immediate_ID3D11DeviceContext(iface);
-    unsigned int i;
 
     TRACE("iface %p, start_slot %u, sampler_count %u, samplers %p.\n",
             iface, start_slot, sampler_count, samplers);
 
     wined3d_mutex_lock();
-    for (i = 0; i < sampler_count; ++i)
-    {
-        struct d3d_sampler_state *sampler = unsafe_impl_from_ID3D11SamplerState(samplers[i]);
-
-        wined3d_device_set_cs_sampler(device->wined3d_device, start_slot + i,
-                sampler ? sampler->wined3d_sampler : NULL);
-    }
+    d3d11_set_samplers(device, WINED3D_SHADER_TYPE_COMPUTE, start_slot, sampler_count, samplers);
     wined3d_mutex_unlock();
 }
 
@@ -2216,19 +2246,12 @@ static void STDMETHODCALLTYPE d3d11_immediate_context_CSSetConstantBuffers(ID3D1
         UINT start_slot, UINT buffer_count, ID3D11Buffer *const *buffers)
 {
     struct d3d_device *device = device_from_immediate_ID3D11DeviceContext(iface);
-    unsigned int i;
 
     TRACE("iface %p, start_slot %u, buffer_count %u, buffers %p.\n",
             iface, start_slot, buffer_count, buffers);
 
     wined3d_mutex_lock();
-    for (i = 0; i < buffer_count; ++i)
-    {
-        struct d3d_buffer *buffer = unsafe_impl_from_ID3D11Buffer(buffers[i]);
-
-        wined3d_device_set_cs_cb(device->wined3d_device, start_slot + i,
-                buffer ? buffer->wined3d_buffer : NULL);
-    }
+    d3d11_set_constant_buffers(device, WINED3D_SHADER_TYPE_COMPUTE, start_slot, buffer_count, buffers);
     wined3d_mutex_unlock();
 }
 
@@ -3705,9 +3728,8 @@ static HRESULT STDMETHODCALLTYPE d3d11_deferred_context_Map(ID3D11DeviceContext
 
     if (map_type != D3D11_MAP_WRITE_DISCARD)
     {
-        LIST_FOR_EACH_ENTRY_REV(call, &context->commands, struct deferred_call, entry)
+        for (call = context->last_map; call; call = call->map_info.previous)
         {
-            if (call->cmd != DEFERRED_MAP) continue;
             if (call->map_info.resource != resource) continue;
             if (call->map_info.subresource_idx != subresource_idx) continue;
             previous = call;
@@ -3730,7 +3752,8 @@ static HRESULT STDMETHODCALLTYPE d3d11_deferred_context_Map(ID3D11DeviceContext
     if (FAILED(hr))
         return hr;
 
-    if (!(call = add_deferred_call(context, map_info.size)))
+    /* Mapped memory is expected to be 16-byte aligned. */
+    if (!(call = add_deferred_call(context, map_info.size + 15)))
         return E_OUTOFMEMORY;
 
     call->cmd = DEFERRED_MAP;
@@ -3739,8 +3762,10 @@ static HRESULT STDMETHODCALLTYPE d3d11_deferred_context_Map(ID3D11DeviceContext
     call->map_info.subresource_idx = subresource_idx;
     call->map_info.map_type = map_type;
     call->map_info.map_flags = map_flags;
-    call->map_info.buffer = (void *)(call + 1);
+    call->map_info.buffer = (void *)(((ULONG_PTR)(call + 1) + 15) & ~(ULONG_PTR)15);
     call->map_info.size = map_info.size;
+    call->map_info.previous = context->last_map;
+    context->last_map = call;
 
     if (previous)
         memcpy(call->map_info.buffer, previous->map_info.buffer, map_info.size);
@@ -4698,6 +4723,8 @@ static HRESULT STDMETHODCALLTYPE d3d11_deferred_context_FinishCommandList(ID3D11
 {
     struct d3d11_deferred_context *context = impl_from_deferred_ID3D11DeviceContext(iface);
     struct d3d11_command_list *object;
+    struct deferred_chunk *chunk;
+    struct list *tail;
 
     TRACE("iface %p, restore %#x, command_list %p.\n", iface, restore, command_list);
 
@@ -4707,12 +4734,23 @@ static HRESULT STDMETHODCALLTYPE d3d11_deferred_context_FinishCommandList(ID3D11
     if (!(object = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(*object))))
         return E_OUTOFMEMORY;
 
+    /* Give back the unused end of the last chunk. The calls must not move,
+     * maps point into them. */
+    if ((tail = list_tail(&context->commands)))
+    {
+        chunk = LIST_ENTRY(tail, struct deferred_chunk, entry);
+        if (chunk->used < chunk->size && HeapReAlloc(GetProcessHeap(), HEAP_REALLOC_IN_PLACE_ONLY,
+                chunk, FIELD_OFFSET(struct deferred_chunk, data[chunk->used])))
+            chunk->size = chunk->used;
+    }
+
     object->ID3D11CommandList_iface.lpVtbl = &d3d11_command_list_vtbl;
     object->device = context->device;
     object->refcount = 1;
 
     list_init(&object->commands);
     list_move_tail(&object->commands, &context->commands);
+    context->last_map = NULL;
 
     ID3D11Device_AddRef(context->device);
     wined3d_private_store_init(&object->private_store);
@@ -5948,6 +5986,84 @@ static ULONG STDMETHODCALLTYPE d3d_device_inner_Release(IUnknown *iface)
     return refcount;
 }
 
+static void d3d10_set_shader_resource_views(struct d3d_device *device, enum wined3d_shader_type type,
+        UINT start_slot, UINT view_count, ID3D10ShaderResourceView *const *views)
+{
+    struct wined3d_shader_resource_view *wined3d_views[D3D10_COMMONSHADER_INPUT_RESOURCE_SLOT_COUNT];
+    unsigned int i;
+
+    if (start_slot >= ARRAY_SIZE(wined3d_views))
+    {
+        WARN("Invalid start slot %u.\n", start_slot);
+        return;
+    }
+    if (view_count > ARRAY_SIZE(wined3d_views) - start_slot)
+    {
+        WARN("Invalid view count %u, clamping.\n", view_count);
+        view_count = ARRAY_SIZE(wined3d_views) - start_slot;
+    }
+
+    for (i = 0; i < view_count; ++i)
+    {
+        struct d3d_shader_resource_view *view = unsafe_impl_from_ID3D10ShaderResourceView(views[i]);
+
+        wined3d_views[i] = view ? view->wined3d_view : NULL;
+    }
+    wined3d_device_set_shader_resource_views(device->wined3d_device, type, start_slot, view_count, wined3d_views);
+}
+
+static void d3d10_set_samplers(struct d3d_device *device, enum wined3d_shader_type type,
+        UINT start_slot, UINT sampler_count, ID3D10SamplerState *const *samplers)
+{
+    struct wined3d_sampler *wined3d_samplers[D3D10_COMMONSHADER_SAMPLER_SLOT_COUNT];
+    unsigned int i;
+
+    if (start_slot >= ARRAY_SIZE(wined3d_samplers))
+    {
+        WARN("Invalid start slot %u.\n", start_slot);
+        return;
+    }
+    if (sampler_count > ARRAY_SIZE(wined3d_samplers) - start_slot)
+    {
+        WARN("Invalid sampler count %u, clamping.\n", sampler_count);
+        sampler_count = ARRAY_SIZE(wined3d_samplers) - start_slot;
+    }
+
+    for (i = 0; i < sampler_count; ++i)
+    {
+        struct d3d_sampler_state *sampler = unsafe_impl_from_ID3D10SamplerState(samplers[i]);
+
+        wined3d_samplers[i] = sampler ? sampler->wined3d_sampler : NULL;
+    }
+    wined3d_device_set_samplers(device->wined3d_device, type, start_slot, sampler_count, wined3d_samplers);
+}
+
+static void d3d10_set_constant_buffers(struct d3d_device *device, enum wined3d_shader_type type,
+        UINT start_slot, UINT buffer_count, ID3D10Buffer *const *buffers)
+{
+    struct wined3d_buffer *wined3d_buffers[D3D10_COMMONSHADER_CONSTANT_BUFFER_API_SLOT_COUNT];
+    unsigned int i;
+
+    if (start_slot >= ARRAY_SIZE(wined3d_buffers))
+    {
+        WARN("Invalid start slot %u.\n", start_slot);
+        return;
+    }
+    if (buffer_count > ARRAY_SIZE(wined3d_buffers) - start_slot)
+    {
+        WARN("Invalid buffer count %u, clamping.\n", buffer_count);
+        buffer_count = ARRAY_SIZE(wined3d_buffers) - start_slot;
+    }
+
+    for (i = 0; i < buffer_count; ++i)
+    {
+        struct d3d_buffer *buffer = unsafe_impl_from_ID3D10Buffer(buffers[i]);
+
+        wined3d_buffers[i] = buffer ? buffer->wined3d_buffer : NULL;
+    }
+    wined3d_device_set_constant_buffers(device->wined3d_device, type, start_slot, buffer_count, wined3d_buffers);
+}
+
 /* IUnknown methods */
 
 static HRESULT STDMETHODCALLTYPE d3d10_device_QueryInterface(ID3D10Device1 *iface, REFIID riid,
@@ -5975,19 +6091,12 @@ static void STDMETHODCALLTYPE d3d10_device_VSSetConstantBuffers(ID3D10Device1 *i
         UINT start_slot, UINT buffer_count, ID3D10Buffer *const *buffers)
 {
     struct d3d_device *device = impl_from_ID3D10Device(iface);
-    unsigned int i;
 
     TRACE("iface %p, start_slot %u, buffer_count %u, buffers %p.\n",
             iface, start_slot, buffer_count, buffers);
 
     wined3d_mutex_lock();
-    for (i = 0; i < buffer_count; ++i)
-    {
-        struct d3d_buffer *buffer = unsafe_impl_from_ID3D10Buffer(buffers[i]);
-
-        wined3d_device_set_vs_cb(device->wined3d_device, start_slot + i,
-                buffer ? buffer->wined3d_buffer : NULL);
-    }
+    d3d10_set_constant_buffers(device, WINED3D_SHADER_TYPE_VERTEX, start_slot, buffer_count, buffers);
     wined3d_mutex_unlock();
 }
 
@@ -5995,19 +6104,12 @@ static void STDMETHODCALLTYPE d3d10_device_PSSetShaderResources(ID3D10Device1 *i
         UINT start_slot, UINT view_count, ID3D10ShaderResourceView *const *views)
 {
     struct d3d_device *device = impl_from_ID3D10Device(iface);
-    unsigned int i;
 
     TRACE("iface %p, start_slot %u, view_count %u, views %p.\n",
             iface, start_slot, view_count, views);
 
     wined3d_mutex_lock();
-    for (i = 0; i < view_count; ++i)
-    {
-        struct d3d_shader_resource_view *view = unsafe_impl_from_ID3D10ShaderResourceView(views[i]);
-
-        wined3d_device_set_ps_resource_view(device->wined3d_device, start_slot + i,
-                view ? view->wined3d_view : NULL);
-    }
+    d3d10_set_shader_resource_views(device, WINED3D_SHADER_TYPE_PIXEL, start_slot, view_count, views);
     wined3d_mutex_unlock();
 }
 
@@ -6028,19 +6130,12 @@ static void STDMETHODCALLTYPE d3d10_device_PSSetSamplers(ID3D10Device1 *iface,
         UINT start_slot, UINT sampler_count, ID3D10SamplerState *const *samplers)
 {
     struct d3d_device *device = impl_from_ID3D10Device(iface);
-    unsigned int i;
 
     TRACE("iface %p, start_slot %u, sampler_count %u, samplers %p.\n",
             iface, start_slot, sampler_count, samplers);
 
     wined3d_mutex_lock();
-    for (i = 0; i < sampler_count; ++i)
-    {
-        struct d3d_sampler_state *sampler = unsafe_impl_from_ID3D10SamplerState(samplers[i]);
-
-        wined3d_device_set_ps_sampler(device->wined3d_device, start_slot + i,
-                sampler ? sampler->wined3d_sampler : NULL);
-    }
+    d3d10_set_samplers(device, WINED3D_SHADER_TYPE_PIXEL, start_slot, sampler_count, samplers);
     wined3d_mutex_unlock();
 }
 
@@ -6088,19 +6183,12 @@ static void STDMETHODCALLTYPE d3d10_device_PSSetConstantBuffers(ID3D10Device1 *i
         UINT start_slot, UINT buffer_count, ID3D10Buffer *const *buffers)
 {
     struct d3d_device *device = impl_from_ID3D10Device(iface);
-    unsigned int i;
 
     TRACE("iface %p, start_slot %u, buffer_count %u, buffers %p.\n",
             iface, start_slot, buffer_count, buffers);
 
     wined3d_mutex_lock();
-    for (i = 0; i < buffer_count; ++i)
-    {
-        struct d3d_buffer *buffer = unsafe_impl_from_ID3D10Buffer(buffers[i]);
-
-        wined3d_device_set_ps_cb(device->wined3d_device, start_slot + i,
-                buffer ? buffer->wined3d_buffer : NULL);
-    }
+    d3d10_set_constant_buffers(device, WINED3D_SHADER_TYPE_PIXEL, start_slot, buffer_count, buffers);
     wined3d_mutex_unlock();
 }
 
@@ -6192,19 +6280,12 @@ static void STDMETHODCALLTYPE d3d10_device_GSSetConstantBuffers(ID3D10Device1 *i
         UINT start_slot, UINT buffer_count, ID3D10Buffer *const *buffers)
 {
     struct d3d_device *device = impl_from_ID3D10Device(iface);
-    unsigned int i;
 
     TRACE("iface %p, start_slot %u, buffer_count %u, buffers %p.\n",
             iface, start_slot, buffer_count, buffers);
 
     wined3d_mutex_lock();
-    for (i = 0; i < buffer_count; ++i)
-    {
-        struct d3d_buffer *buffer = unsafe_impl_from_ID3D10Buffer(buffers[i]);
-
-        wined3d_device_set_gs_cb(device->wined3d_device, start_slot + i,
-                buffer ? buffer->wined3d_buffer : NULL);
-    }
+    d3d10_set_constant_buffers(device, WINED3D_SHADER_TYPE_GEOMETRY, start_slot, buffer_count, buffers);
     wined3d_mutex_unlock();
 }
 
@@ -6236,19 +6317,12 @@ static void STDMETHODCALLTYPE d3d10_device_VSSetShaderResources(ID3D10Device1 *i
         UINT start_slot, UINT view_count, ID3D10ShaderResourceView *const *views)
 {
     struct d3d_device *device = impl_from_ID3D10Device(iface);
-    unsigned int i;
 
     TRACE("iface %p, start_slot %u, view_count %u, views %p.\n",
             iface, start_slot, view_count, views);
 
     wined3d_mutex_lock();
-    for (i = 0; i < view_count; ++i)
-    {
-        struct d3d_shader_resource_view *view = unsafe_impl_from_ID3D10ShaderResourceView(views[i]);
-
-        wined3d_device_set_vs_resource_view(device->wined3d_device, start_slot + i,
-                view ? view->wined3d_view : NULL);
-    }
+    d3d10_set_shader_resource_views(device, WINED3D_SHADER_TYPE_VERTEX, start_slot, view_count, views);
     wined3d_mutex_unlock();
 }
 
@@ -6256,19 +6330,12 @@ static void STDMETHODCALLTYPE d3d10_device_VSSetSamplers(ID3D10Device1 *iface,
         UINT start_slot, UINT sampler_count, ID3D10SamplerState *const *samplers)
 {
     struct d3d_device *device = impl_from_ID3D10Device(iface);
-    unsigned int i;
 
     TRACE("iface %p, start_slot %u, sampler_count %u, samplers %p.\n",
             iface, start_slot, sampler_count, samplers);
 
     wined3d_mutex_lock();
-    for (i = 0; i < sampler_count; ++i)
-    {
-        struct d3d_sampler_state *sampler = unsafe_impl_from_ID3D10SamplerState(samplers[i]);
-
-        wined3d_device_set_vs_sampler(device->wined3d_device, start_slot + i,
-                sampler ? sampler->wined3d_sampler : NULL);
-    }
+    d3d10_set_samplers(device, WINED3D_SHADER_TYPE_VERTEX, start_slot, sampler_count, samplers);
     wined3d_mutex_unlock();
 }
 
@@ -6289,19 +6356,12 @@ static void STDMETHODCALLTYPE d3d10_device_GSSetShaderResources(ID3D10Device1 *i
         UINT start_slot, UINT view_count, ID3D10ShaderResourceView *const *views)
 {
     struct d3d_device *device = impl_from_ID3D10Device(iface);
-    unsigned int i;
 
     TRACE("iface %p, start_slot %u, view_count %u, views %p.\n",
             iface, start_slot, view_count, views);
 
     wined3d_mutex_lock();
-    for (i = 0; i < view_count; ++i)
-    {
-        struct d3d_shader_resource_view *view = unsafe_impl_from_ID3D10ShaderResourceView(views[i]);
-
-        wined3d_device_set_gs_resource_view(device->wined3d_device, start_slot + i,
-                view ? view->wined3d_view : NULL);
-    }
+    d3d10_set_shader_resource_views(device, WINED3D_SHADER_TYPE_GEOMETRY, start_slot, view_count, views);
     wined3d_mutex_unlock();
 }
 
@@ -6309,19 +6369,12 @@ static void STDMETHODCALLTYPE d3d10_device_GSSetSamplers(ID3D10Device1 *iface,
         UINT start_slot, UINT sampler_count, ID3D10SamplerState *const *samplers)
 {
     struct d3d_device *device = impl_from_ID3D10Device(iface);
-    unsigned int i;
 
     TRACE("iface %p, start_slot %u, sampler_count %u, samplers %p.\n",
             iface, start_slot, sampler_count, samplers);
 
     wined3d_mutex_lock();
-    for (i = 0; i < sampler_count; ++i)
-    {
-        struct d3d_sampler_state *sampler = unsafe_impl_from_ID3D10SamplerState(samplers[i]);
-
-        wined3d_device_set_gs_sampler(device->wined3d_device, start_slot + i,
-                sampler ? sampler->wined3d_sampler : NULL);
-    }
+    d3d10_set_samplers(device, WINED3D_SHADER_TYPE_GEOMETRY, start_slot, sampler_count, samplers);
     wined3d_mutex_unlock();
 }
 
@@ -10707,6 +10707,282 @@ static void test_copy_subresource_region(void)
     release_test_context(&test_context);
 }
 
+static void test_dynamic_buffer_discard(void)
+{
+    static const unsigned int chunk_size = 256, chunk_count = 64;
+    D3D11_MAPPED_SUBRESOURCE map_desc, map_desc2;
+    ID3D11Buffer *buffer, *buffer2, *dst_buffer;
+    D3D11_BUFFER_DESC buffer_desc;
+    ID3D11DeviceContext *context;
+    struct resource_readback rb;
+    ID3D11Device *device;
+    unsigned int i, j;
+    DWORD value;
+    ULONG refcount;
+    HRESULT hr;
+
+    if (!(device = create_device(NULL)))
+    {
+        skip("Failed to create device.\n");
+        return;
+    }
+
+    ID3D11Device_GetImmediateContext(device, &context);
+
+    buffer_desc.ByteWidth = chunk_size;
+    buffer_desc.Usage = D3D11_USAGE_DYNAMIC;
+    buffer_desc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+    buffer_desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+    buffer_desc.MiscFlags = 0;
+    buffer_desc.StructureByteStride = 0;
+    hr = ID3D11Device_CreateBuffer(device, &buffer_desc, NULL, &buffer);
+    ok(SUCCEEDED(hr), "Failed to create buffer, hr %#x.\n", hr);
+    hr = ID3D11Device_CreateBuffer(device, &buffer_desc, NULL, &buffer2);
+    ok(SUCCEEDED(hr), "Failed to create buffer, hr %#x.\n", hr);
+
+    dst_buffer = create_buffer(device, D3D11_BIND_VERTEX_BUFFER, chunk_size * chunk_count, NULL);
+
+    /* Every discarded version of the buffer must be seen by the commands
+     * recorded between its unmap and the next map. */
+    for (i = 0; i < chunk_count; ++i)
+    {
+        hr = ID3D11DeviceContext_Map(context, (ID3D11Resource *)buffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &map_desc);
+        ok(SUCCEEDED(hr), "Failed to map buffer, hr %#x.\n", hr);
+        if (FAILED(hr))
+            break;
+        for (j = 0; j < chunk_size / sizeof(DWORD); ++j)
+            ((DWORD *)map_desc.pData)[j] = i << 16 | j;
+        ID3D11DeviceContext_Unmap(context, (ID3D11Resource *)buffer, 0);
+
+        ID3D11DeviceContext_CopySubresourceRegion(context, (ID3D11Resource *)dst_buffer, 0,
+                i * chunk_size, 0, 0, (ID3D11Resource *)buffer, 0, NULL);
+    }
+
+    get_buffer_readback(dst_buffer, &rb);
+    for (i = 0; i < chunk_count; ++i)
+    {
+        for (j = 0; j < chunk_size / sizeof(DWORD); ++j)
+        {
+            value = get_readback_color(&rb, i * chunk_size / sizeof(DWORD) + j, 0);
+            if (value != (i << 16 | j))
+                break;
+        }
+        ok(j == chunk_size / sizeof(DWORD), "Chunk %u: got unexpected value %#x at %u.\n", i, value, j);
+    }
+    release_resource_readback(&rb);
+
+    /* A buffer that stays mapped keeps its contents while other buffers
+     * are mapped and unmapped, enough times to reuse all discarded memory. */
+    hr = ID3D11DeviceContext_Map(context, (ID3D11Resource *)buffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &map_desc);
+    ok(SUCCEEDED(hr), "Failed to map buffer, hr %#x.\n", hr);
+    for (j = 0; j < chunk_size / sizeof(DWORD); ++j)
+        ((DWORD *)map_desc.pData)[j] = 0xdead0000 | j;
+    for (i = 0; i < 100000; ++i)
+    {
+        hr = ID3D11DeviceContext_Map(context, (ID3D11Resource *)buffer2, 0,
+                D3D11_MAP_WRITE_DISCARD, 0, &map_desc2);
+        if (FAILED(hr))
+            break;
+        *(DWORD *)map_desc2.pData = i;
+        ID3D11DeviceContext_Unmap(context, (ID3D11Resource *)buffer2, 0);
+    }
+    ok(SUCCEEDED(hr), "Failed to map buffer, hr %#x.\n", hr);
+    for (j = 0; j < chunk_size / sizeof(DWORD); ++j)
+    {
+        if (((DWORD *)map_desc.pData)[j] != (0xdead0000 | j))
+            break;
+    }
+    ok(j == chunk_size / sizeof(DWORD), "Got unexpected value %#x at %u.\n", ((DWORD *)map_desc.pData)[j], j);
+    ID3D11DeviceContext_Unmap(context, (ID3D11Resource *)buffer, 0);
+
+    ID3D11DeviceContext_CopySubresourceRegion(context, (ID3D11Resource *)dst_buffer, 0,
+            0, 0, 0, (ID3D11Resource *)buffer, 0, NULL);
+    get_buffer_readback(dst_buffer, &rb);
+    for (j = 0; j < chunk_size / sizeof(DWORD); ++j)
+    {
+        value = get_readback_color(&rb, j, 0);
+        if (value != (0xdead0000 | j))
+            break;
+    }
+    ok(j == chunk_size / sizeof(DWORD), "Got unexpected value %#x at %u.\n", value, j);
+    release_resource_readback(&rb);
+
+    ID3D11Buffer_Release(dst_buffer);
+    ID3D11Buffer_Release(buffer2);
+    ID3D11Buffer_Release(buffer);
+    ID3D11DeviceContext_Release(context);
+    refcount = ID3D11Device_Release(device);
+    ok(!refcount, "Device has %u references left.\n", refcount);
+}
+
+struct deferred_record_thread_data
+{
+    ID3D11DeviceContext *context;
+    ID3D11Buffer *buffer;
+    unsigned int index;
+    unsigned int buffer_size;
+    unsigned int map_count;
+    ID3D11CommandList *command_list;
+};
+
+static DWORD WINAPI deferred_record_thread(void *arg)
+{
+    struct deferred_record_thread_data *data = arg;
+    D3D11_MAPPED_SUBRESOURCE map_desc;
+    unsigned int i, j;
+    HRESULT hr;
+
+    for (i = 0; i < data->map_count; ++i)
+    {
+        hr = ID3D11DeviceContext_Map(data->context, (ID3D11Resource *)data->buffer, 0,
+                D3D11_MAP_WRITE_DISCARD, 0, &map_desc);
+        ok(SUCCEEDED(hr), "Thread %u: Failed to map buffer, hr %#x.\n", data->index, hr);
+        if (FAILED(hr))
+            break;
+        for (j = 0; j < data->buffer_size / sizeof(DWORD); ++j)
+            ((DWORD *)map_desc.pData)[j] = data->index << 24 | i << 12 | j;
+        ID3D11DeviceContext_Unmap(data->context, (ID3D11Resource *)data->buffer, 0);
+
+        ID3D11DeviceContext_IASetPrimitiveTopology(data->context, D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+        ID3D11DeviceContext_VSSetConstantBuffers(data->context, 0, 1, &data->buffer);
+        ID3D11DeviceContext_Draw(data->context, 3, 0);
+    }
+
+    hr = ID3D11DeviceContext_FinishCommandList(data->context, FALSE, &data->command_list);
+    ok(SUCCEEDED(hr), "Failed to finish command list, hr %#x.\n", hr);
+
+    return 0;
+}
+
+static void test_deferred_context(void)
+{
+    static const unsigned int buffer_size = 1024, max_thread_count = 8;
+    struct deferred_record_thread_data data[8];
+    ID3D11DeviceContext *context, *deferred;
+    D3D11_MAPPED_SUBRESOURCE map_desc;
+    ID3D11CommandList *command_list;
+    D3D11_BUFFER_DESC buffer_desc;
+    struct resource_readback rb;
+    ID3D11Buffer *buffer;
+    ID3D11Device *device;
+    HANDLE threads[8];
+    unsigned int i, j;
+    DWORD value;
+    ULONG refcount;
+    HRESULT hr;
+
+    if (!(device = create_device(NULL)))
+    {
+        skip("Failed to create device.\n");
+        return;
+    }
+
+    hr = ID3D11Device_CreateDeferredContext(device, 0, &deferred);
+    if (FAILED(hr))
+    {
+        skip("Failed to create deferred context, hr %#x.\n", hr);
+        ID3D11Device_Release(device);
+        return;
+    }
+
+    ID3D11Device_GetImmediateContext(device, &context);
+
+    buffer_desc.ByteWidth = buffer_size;
+    buffer_desc.Usage = D3D11_USAGE_DYNAMIC;
+    buffer_desc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+    buffer_desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+    buffer_desc.MiscFlags = 0;
+    buffer_desc.StructureByteStride = 0;
+    hr = ID3D11Device_CreateBuffer(device, &buffer_desc, NULL, &buffer);
+    ok(SUCCEEDED(hr), "Failed to create buffer, hr %#x.\n", hr);
+
+    /* A NO_OVERWRITE map sees the data written by the previous map. */
+    hr = ID3D11DeviceContext_Map(deferred, (ID3D11Resource *)buffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &map_desc);
+    ok(SUCCEEDED(hr), "Failed to map buffer, hr %#x.\n", hr);
+    ok(!((ULONG_PTR)map_desc.pData & 15), "Got unaligned pointer %p.\n", map_desc.pData);
+    for (i = 0; i < buffer_size / sizeof(DWORD); ++i)
+        ((DWORD *)map_desc.pData)[i] = 0xdead0000 | i;
+    ID3D11DeviceContext_Unmap(deferred, (ID3D11Resource *)buffer, 0);
+
+    hr = ID3D11DeviceContext_Map(deferred, (ID3D11Resource *)buffer, 0, D3D11_MAP_WRITE_NO_OVERWRITE, 0, &map_desc);
+    ok(SUCCEEDED(hr), "Failed to map buffer, hr %#x.\n", hr);
+    ok(!((ULONG_PTR)map_desc.pData & 15), "Got unaligned pointer %p.\n", map_desc.pData);
+    for (i = 0; i < buffer_size / sizeof(DWORD); ++i)
+    {
+        value = ((DWORD *)map_desc.pData)[i];
+        if (value != (0xdead0000 | i))
+            break;
+    }
+    ok(i == buffer_size / sizeof(DWORD), "Got unexpected value %#x at %u.\n", value, i);
+    for (i = buffer_size / sizeof(DWORD) / 2; i < buffer_size / sizeof(DWORD); ++i)
+        ((DWORD *)map_desc.pData)[i] = 0xbeef0000 | i;
+    ID3D11DeviceContext_Unmap(deferred, (ID3D11Resource *)buffer, 0);
+
+    hr = ID3D11DeviceContext_FinishCommandList(deferred, FALSE, &command_list);
+    ok(SUCCEEDED(hr), "Failed to finish command list, hr %#x.\n", hr);
+    ID3D11DeviceContext_ExecuteCommandList(context, command_list, FALSE);
+    ID3D11CommandList_Release(command_list);
+
+    get_buffer_readback(buffer, &rb);
+    for (i = 0; i < buffer_size / sizeof(DWORD); ++i)
+    {
+        value = get_readback_color(&rb, i, 0);
+        if (value != ((i < buffer_size / sizeof(DWORD) / 2 ? 0xdead0000 : 0xbeef0000) | i))
+            break;
+    }
+    ok(i == buffer_size / sizeof(DWORD), "Got unexpected value %#x at %u.\n", value, i);
+    release_resource_readback(&rb);
+
+    ID3D11DeviceContext_Release(deferred);
+
+    /* Command lists recorded on several threads at the same time are
+     * replayed completely, including calls in later chunks. */
+    for (i = 0; i < max_thread_count; ++i)
+    {
+        hr = ID3D11Device_CreateDeferredContext(device, 0, &data[i].context);
+        ok(SUCCEEDED(hr), "Failed to create deferred context, hr %#x.\n", hr);
+        hr = ID3D11Device_CreateBuffer(device, &buffer_desc, NULL, &data[i].buffer);
+        ok(SUCCEEDED(hr), "Failed to create buffer, hr %#x.\n", hr);
+        data[i].index = i;
+        data[i].buffer_size = buffer_size;
+        data[i].map_count = 200;
+        data[i].command_list = NULL;
+        threads[i] = CreateThread(NULL, 0, deferred_record_thread, &data[i], 0, NULL);
+    }
+    WaitForMultipleObjects(max_thread_count, threads, TRUE, INFINITE);
+
+    for (i = 0; i < max_thread_count; ++i)
+    {
+        CloseHandle(threads[i]);
+        ok(!!data[i].command_list, "Thread %u: Got NULL command list.\n", i);
+        if (!data[i].command_list)
+            continue;
+        ID3D11DeviceContext_ExecuteCommandList(context, data[i].command_list, FALSE);
+        ID3D11CommandList_Release(data[i].command_list);
+    }
+
+    for (i = 0; i < max_thread_count; ++i)
+    {
+        get_buffer_readback(data[i].buffer, &rb);
+        for (j = 0; j < buffer_size / sizeof(DWORD); ++j)
+        {
+            value = get_readback_color(&rb, j, 0);
+            if (value != (i << 24 | (data[i].map_count - 1) << 12 | j))
+                break;
+        }
+        ok(j == buffer_size / sizeof(DWORD), "Thread %u: Got unexpected value %#x at %u.\n", i, value, j);
+        release_resource_readback(&rb);
+
+        ID3D11Buffer_Release(data[i].buffer);
+        ID3D11DeviceContext_Release(data[i].context);
+    }
+
+    ID3D11Buffer_Release(buffer);
+    ID3D11DeviceContext_Release(context);
+    refcount = ID3D11Device_Release(device);
+    ok(!refcount, "Device has %u references left.\n", refcount);
+}
+
 static void test_resource_map(void)
 {
     D3D11_MAPPED_SUBRESOURCE mapped_subresource;
@@ -21438,6 +21714,8 @@ START_TEST(d3d11)
     test_update_subresource();
     test_copy_subresource_region();
     test_resource_map();
+    test_dynamic_buffer_discard();
+    test_deferred_context();
     test_check_multisample_quality_levels();
     run_for_each_feature_level(test_swapchain_formats);
     test_swapchain_views();
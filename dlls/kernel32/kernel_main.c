@@ -207,7 +207,7 @@ ULONGLONG WINAPI DECLSPEC_HOTPATCH GetTickCount64(void)
  */
 DWORD WINAPI DECLSPEC_HOTPATCH GetTickCount(void)
 {
-    return GetTickCount64();
+    return NtGetTickCount();
 }
 
 /******************************************************************************
@@ -4916,6 +4916,126 @@ static void test_GetFileAttributesExW(void)
     ok(GetLastError() == ERROR_FILE_NOT_FOUND, "Expected error ERROR_FILE_NOT_FOUND, got %u\n", GetLastError());
 }
 
+#define QUEUE_TEST_BLOCK_SIZE 4096
+#define QUEUE_TEST_BLOCKS     64
+#define QUEUE_TEST_MAX_DEPTH  16
+
+static BOOL start_queue_io( HANDLE file, OVERLAPPED *ovl, char *buffer, DWORD block, BOOL write )
+{
+    DWORD *data = (DWORD *)buffer, i, bytes;
+    BOOL ret;
+
+    S(U(*ovl)).Offset = block * QUEUE_TEST_BLOCK_SIZE;
+    S(U(*ovl)).OffsetHigh = 0;
+    if (write)
+    {
+        for (i = 0; i < QUEUE_TEST_BLOCK_SIZE / sizeof(DWORD); i++) data[i] = block * QUEUE_TEST_BLOCK_SIZE + i;
+        ret = WriteFile( file, buffer, QUEUE_TEST_BLOCK_SIZE, &bytes, ovl );
+    }
+    else
+    {
+        data[0] = data[QUEUE_TEST_BLOCK_SIZE / sizeof(DWORD) - 1] = 0xdeadbeef;
+        ret = ReadFile( file, buffer, QUEUE_TEST_BLOCK_SIZE, &bytes, ovl );
+    }
+    return ret || GetLastError() == ERROR_IO_PENDING;
+}
+
+/* run QUEUE_TEST_BLOCKS overlapped I/Os keeping depth of them in flight */
+static BOOL run_queue_io( HANDLE file, OVERLAPPED *ovl, char *buffers, DWORD depth, BOOL write )
+{
+    DWORD next, done, slot = 0, bytes, block, last;
+    DWORD *data;
+    BOOL ret;
+
+    for (next = 0; next < depth && next < QUEUE_TEST_BLOCKS; next++)
+    {
+        ret = start_queue_io( file, &ovl[next], buffers + next * QUEUE_TEST_BLOCK_SIZE, next, write );
+        ok( ret, "failed to start I/O on block %u, error %u\n", next, GetLastError() );
+        if (!ret) return FALSE;
+    }
+
+    /* the oldest I/O in flight is always in the next slot */
+    for (done = 0; done < QUEUE_TEST_BLOCKS; done++)
+    {
+        data = (DWORD *)(buffers + slot * QUEUE_TEST_BLOCK_SIZE);
+        block = S(U(ovl[slot])).Offset / QUEUE_TEST_BLOCK_SIZE;
+        last = QUEUE_TEST_BLOCK_SIZE / sizeof(DWORD) - 1;
+
+        ret = GetOverlappedResult( file, &ovl[slot], &bytes, TRUE );
+        ok( ret, "block %u: GetOverlappedResult failed, error %u\n", block, GetLastError() );
+        ok( bytes == QUEUE_TEST_BLOCK_SIZE, "block %u: got %u bytes\n", block, bytes );
+        if (!write)
+            ok( data[0] == block * QUEUE_TEST_BLOCK_SIZE && data[last] == block * QUEUE_TEST_BLOCK_SIZE + last,
+                "block %u: got data %#x %#x\n", block, data[0], data[last] );
+        if (!ret || bytes != QUEUE_TEST_BLOCK_SIZE) return FALSE;
+
+        if (next < QUEUE_TEST_BLOCKS)
+        {
+            ret = start_queue_io( file, &ovl[slot], (char *)data, next, write );
+            ok( ret, "failed to start I/O on block %u, error %u\n", next, GetLastError() );
+            if (!ret) return FALSE;
+            next++;
+        }
+        if (++slot == depth) slot = 0;
+    }
+    return TRUE;
+}
+
+static void test_overlapped_queue_depth(void)
+{
+    char temp_path[MAX_PATH], name[MAX_PATH], *buffers;
+    OVERLAPPED *ovl, *ovl2;
+    DWORD depth, ret, bytes;
+    ULONG_PTR key;
+    HANDLE file, port;
+
+    GetTempPathA( MAX_PATH, temp_path );
+    GetTempFileNameA( temp_path, "qdt", 0, name );
+    file = CreateFileA( name, GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+                        FILE_FLAG_OVERLAPPED | FILE_FLAG_DELETE_ON_CLOSE, NULL );
+    ok( file != INVALID_HANDLE_VALUE, "CreateFile failed, error %u\n", GetLastError() );
+    if (file == INVALID_HANDLE_VALUE) return;
+
+    buffers = VirtualAlloc( NULL, QUEUE_TEST_MAX_DEPTH * QUEUE_TEST_BLOCK_SIZE, MEM_COMMIT, PAGE_READWRITE );
+    ovl = HeapAlloc( GetProcessHeap(), HEAP_ZERO_MEMORY, QUEUE_TEST_MAX_DEPTH * sizeof(*ovl) );
+    for (depth = 0; depth < QUEUE_TEST_MAX_DEPTH; depth++)
+        ovl[depth].hEvent = CreateEventA( NULL, TRUE, FALSE, NULL );
+
+    run_queue_io( file, ovl, buffers, QUEUE_TEST_MAX_DEPTH, TRUE );
+    ret = FlushFileBuffers( file );
+    ok( ret, "FlushFileBuffers failed, error %u\n", GetLastError() );
+
+    for (depth = 1; depth <= QUEUE_TEST_MAX_DEPTH; depth *= 4)
+        run_queue_io( file, ovl, buffers, depth, FALSE );
+
+    for (depth = 0; depth < QUEUE_TEST_MAX_DEPTH; depth++) CloseHandle( ovl[depth].hEvent );
+    CloseHandle( file );
+
+    /* the completion is still posted when the file is closed while the I/O is in flight */
+    file = CreateFileA( name, GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+                        FILE_FLAG_OVERLAPPED | FILE_FLAG_DELETE_ON_CLOSE, NULL );
+    ok( file != INVALID_HANDLE_VALUE, "CreateFile failed, error %u\n", GetLastError() );
+    port = CreateIoCompletionPort( file, NULL, 0xbeef, 0 );
+    ok( port != NULL, "CreateIoCompletionPort failed, error %u\n", GetLastError() );
+    memset( ovl, 0, sizeof(*ovl) );
+    ovl->hEvent = CreateEventA( NULL, TRUE, FALSE, NULL );
+    ret = start_queue_io( file, ovl, buffers, 0, TRUE );
+    ok( ret, "failed to start I/O, error %u\n", GetLastError() );
+    CloseHandle( file );
+    ret = WaitForSingleObject( ovl->hEvent, 10000 );
+    ok( ret == WAIT_OBJECT_0, "wait failed: %u\n", ret );
+    ret = GetQueuedCompletionStatus( port, &bytes, &key, &ovl2, 10000 );
+    ok( ret, "GetQueuedCompletionStatus failed, error %u\n", GetLastError() );
+    ok( key == 0xbeef, "got key %#lx\n", key );
+    ok( ovl2 == ovl, "got overlapped %p, expected %p\n", ovl2, ovl );
+    ok( bytes == QUEUE_TEST_BLOCK_SIZE, "got %u bytes\n", bytes );
+    CloseHandle( ovl->hEvent );
+    CloseHandle( port );
+
+    HeapFree( GetProcessHeap(), 0, ovl );
+    VirtualFree( buffers, 0, MEM_RELEASE );
+}
+
 START_TEST(file)
 {
     char temp_path[MAX_PATH];
@@ -4984,4 +5104,5 @@ START_TEST(file)
     test_GetFinalPathNameByHandleW();
     test_SetFileInformationByHandle();
     test_GetFileAttributesExW();
+    test_overlapped_queue_depth();
 }
@@ -1467,6 +1467,124 @@ nt4_is_broken:
     }
 }
 
+static void test_forwarded_exports(void)
+{
+    static const struct
+    {
+        const char *dll;
+        const char *func;
+    } tests[] =
+    {
+        { "api-ms-win-core-synch-l1-1-0.dll", "EnterCriticalSection" },
+        { "api-ms-win-core-errorhandling-l1-1-0.dll", "GetLastError" },
+        { "api-ms-win-core-processthreads-l1-1-0.dll", "GetCurrentProcessId" },
+        { "api-ms-win-core-heap-l1-1-0.dll", "HeapAlloc" },
+        { "api-ms-win-core-handle-l1-1-0.dll", "CloseHandle" },
+    };
+    HMODULE kernel32 = GetModuleHandleA( "kernel32.dll" );
+    HMODULE mods[sizeof(tests) / sizeof(tests[0])];
+    unsigned int i, j;
+    FARPROC proc, expect;
+
+    for (i = 0; i < sizeof(tests) / sizeof(tests[0]); i++)
+    {
+        mods[i] = LoadLibraryA( tests[i].dll );
+        if (!mods[i])
+        {
+            win_skip( "%s not available\n", tests[i].dll );
+            continue;
+        }
+        expect = GetProcAddress( kernel32, tests[i].func );
+        ok( expect != NULL, "%s not found in kernel32\n", tests[i].func );
+
+        /* resolving the same forward twice must give the same result */
+        for (j = 0; j < 2; j++)
+        {
+            proc = GetProcAddress( mods[i], tests[i].func );
+            ok( proc == expect, "%u: %s!%s got %p, expected %p\n",
+                j, tests[i].dll, tests[i].func, proc, expect );
+        }
+    }
+
+    /* unloading and reloading must not return stale addresses */
+    for (i = 0; i < sizeof(tests) / sizeof(tests[0]); i++)
+    {
+        if (!mods[i]) continue;
+        FreeLibrary( mods[i] );
+        mods[i] = LoadLibraryA( tests[i].dll );
+        ok( mods[i] != NULL, "failed to reload %s, error %u\n", tests[i].dll, GetLastError() );
+        if (!mods[i]) continue;
+        proc = GetProcAddress( mods[i], tests[i].func );
+        expect = GetProcAddress( kernel32, tests[i].func );
+        ok( proc == expect, "%s!%s got %p, expected %p after reload\n",
+            tests[i].dll, tests[i].func, proc, expect );
+        FreeLibrary( mods[i] );
+    }
+}
+
+static const char * const proc_names[] =
+{
+    "CreateFileA", "GetLastError", "SetLastError", "Sleep", "WaitForSingleObject",
+    "VirtualAlloc", "LoadLibraryA", "GetProcAddress", "HeapFree", "lstrlenA",
+    "GetTickCount", "CloseHandle", "NoSuchFunctionForTesting",
+};
+
+struct proc_address_params
+{
+    HMODULE module;
+    FARPROC expect[sizeof(proc_names) / sizeof(proc_names[0])];
+    unsigned int loops;
+    LONG errors;
+};
+
+static DWORD WINAPI proc_address_thread( void *arg )
+{
+    struct proc_address_params *params = arg;
+    unsigned int i, j;
+
+    for (i = 0; i < params->loops; i++)
+    {
+        j = i % (sizeof(proc_names) / sizeof(proc_names[0]));
+        if (GetProcAddress( params->module, proc_names[j] ) != params->expect[j])
+            InterlockedIncrement( &params->errors );
+    }
+    return 0;
+}
+
+static void test_GetProcAddress_threads(void)
+{
+    struct proc_address_params params;
+    HANDLE threads[4];
+    unsigned int i;
+
+    params.module = GetModuleHandleA( "kernel32.dll" );
+    params.loops = 10000;
+    params.errors = 0;
+    for (i = 0; i < sizeof(proc_names) / sizeof(proc_names[0]); i++)
+    {
+        params.expect[i] = GetProcAddress( params.module, proc_names[i] );
+        /* a second lookup must return the same address */
+        ok( GetProcAddress( params.module, proc_names[i] ) == params.expect[i],
+            "%s: got different address\n", proc_names[i] );
+    }
+    ok( params.expect[0] != NULL, "CreateFileA not found\n" );
+    ok( !params.expect[i - 1], "%s found\n", proc_names[i - 1] );
+
+    /* concurrent lookups, which don't take the loader lock */
+    for (i = 0; i < sizeof(threads) / sizeof(threads[0]); i++)
+    {
+        threads[i] = CreateThread( NULL, 0, proc_address_thread, &params, 0, NULL );
+        ok( threads[i] != NULL, "CreateThread failed, error %u\n", GetLastError() );
+    }
+    for (i = 0; i < sizeof(threads) / sizeof(threads[0]); i++)
+    {
+        if (!threads[i]) continue;
+        WaitForSingleObject( threads[i], INFINITE );
+        CloseHandle( threads[i] );
+    }
+    ok( !params.errors, "got %d wrong addresses\n", params.errors );
+}
+
 static void test_import_resolution(void)
 {
     char temp_path[MAX_PATH];
@@ -3269,6 +3387,8 @@ START_TEST(loader)
     test_ImportDescriptors();
     test_section_access();
     test_import_resolution();
+    test_forwarded_exports();
+    test_GetProcAddress_threads();
     test_ExitProcess();
     test_InMemoryOrderModuleList();
     test_HashLinks();
@@ -2641,6 +2641,138 @@ static void test_apc_deadlock(void)
     CloseHandle(pi.hProcess);
 }
 
+struct mixed_wait_info
+{
+    HANDLE object;
+    BOOL alertable;
+    BOOL mutex;
+    LONG *acquired;
+    LONG *inside;
+    BOOL *stop;
+};
+
+static DWORD WINAPI mixed_wait_thread(void *param)
+{
+    struct mixed_wait_info *info = param;
+    DWORD result;
+    BOOL ret;
+    int i;
+
+    if (info->mutex)
+    {
+        for (i = 0; i < 500; i++)
+        {
+            result = WaitForSingleObjectEx(info->object, 5000, info->alertable);
+            ok(result == WAIT_OBJECT_0, "expected WAIT_OBJECT_0, got %u\n", result);
+            if (result != WAIT_OBJECT_0) break;
+            ok(InterlockedIncrement(info->inside) == 1, "mutex is owned by another thread\n");
+            InterlockedDecrement(info->inside);
+            ret = ReleaseMutex(info->object);
+            ok(ret, "ReleaseMutex failed with %u\n", GetLastError());
+        }
+        return 0;
+    }
+
+    while (!*(volatile BOOL *)info->stop)
+    {
+        result = WaitForSingleObjectEx(info->object, 10, info->alertable);
+        ok(result == WAIT_OBJECT_0 || result == WAIT_TIMEOUT, "got %u\n", result);
+        if (result == WAIT_OBJECT_0) InterlockedIncrement(info->acquired);
+    }
+    return 0;
+}
+
+static void run_mixed_wait_threads(HANDLE object, BOOL mutex, LONG *acquired, BOOL *stop, HANDLE *threads)
+{
+    static struct mixed_wait_info info[4];
+    static LONG inside;
+    int i;
+
+    for (i = 0; i < 4; i++)
+    {
+        info[i].object = object;
+        info[i].alertable = i & 1;
+        info[i].mutex = mutex;
+        info[i].acquired = acquired;
+        info[i].inside = &inside;
+        info[i].stop = stop;
+        threads[i] = CreateThread(NULL, 0, mixed_wait_thread, &info[i], 0, NULL);
+        ok(threads[i] != NULL, "CreateThread failed with %u\n", GetLastError());
+    }
+}
+
+static void wait_mixed_wait_threads(HANDLE *threads)
+{
+    DWORD result;
+    int i;
+
+    result = WaitForMultipleObjects(4, threads, TRUE, 30000);
+    ok(result == WAIT_OBJECT_0, "expected WAIT_OBJECT_0, got %u\n", result);
+    for (i = 0; i < 4; i++) CloseHandle(threads[i]);
+}
+
+/* alertable waits are handled by the server while the other ones may be
+ * handled on the client side, the object must never be acquired twice */
+static void test_mixed_waits(void)
+{
+    HANDLE threads[4], object;
+    LONG acquired = 0;
+    BOOL stop = FALSE;
+    DWORD start, result;
+    LONG prev;
+    BOOL ret;
+    int i;
+
+    object = CreateSemaphoreW(NULL, 0, 1000, NULL);
+    ok(object != NULL, "CreateSemaphore failed with %u\n", GetLastError());
+    run_mixed_wait_threads(object, FALSE, &acquired, &stop, threads);
+    for (i = 0; i < 1000; i++)
+    {
+        ret = ReleaseSemaphore(object, 1, NULL);
+        ok(ret, "ReleaseSemaphore failed with %u\n", GetLastError());
+        if (!(i % 16)) Sleep(0);
+    }
+    start = GetTickCount();
+    while (acquired < 1000 && GetTickCount() - start < 10000) Sleep(1);
+    stop = TRUE;
+    wait_mixed_wait_threads(threads);
+    ok(acquired == 1000, "expected 1000 acquisitions, got %d\n", acquired);
+    ret = ReleaseSemaphore(object, 1, &prev);
+    ok(ret, "ReleaseSemaphore failed with %u\n", GetLastError());
+    ok(prev == 0, "expected previous count 0, got %d\n", prev);
+    CloseHandle(object);
+
+    acquired = 0;
+    stop = FALSE;
+    object = CreateEventW(NULL, FALSE, FALSE, NULL);
+    ok(object != NULL, "CreateEvent failed with %u\n", GetLastError());
+    run_mixed_wait_threads(object, FALSE, &acquired, &stop, threads);
+    for (i = 0; i < 200; i++)
+    {
+        ret = SetEvent(object);
+        ok(ret, "SetEvent failed with %u\n", GetLastError());
+        start = GetTickCount();
+        while (acquired <= i && GetTickCount() - start < 5000) Sleep(0);
+        ok(acquired == i + 1, "expected %d acquisitions, got %d\n", i + 1, acquired);
+    }
+    stop = TRUE;
+    wait_mixed_wait_threads(threads);
+    ok(acquired == 200, "expected 200 acquisitions, got %d\n", acquired);
+    result = WaitForSingleObject(object, 0);
+    ok(result == WAIT_TIMEOUT, "expected WAIT_TIMEOUT, got %u\n", result);
+    CloseHandle(object);
+
+    object = CreateMutexW(NULL, FALSE, NULL);
+    ok(object != NULL, "CreateMutex failed with %u\n", GetLastError());
+    run_mixed_wait_threads(object, TRUE, &acquired, &stop, threads);
+    wait_mixed_wait_threads(threads);
+    result = WaitForSingleObject(object, 0);
+    ok(result == WAIT_OBJECT_0, "expected WAIT_OBJECT_0, got %u\n", result);
+    ret = ReleaseMutex(object);
+    ok(ret, "ReleaseMutex failed with %u\n", GetLastError());
+    CloseHandle(object);
+}
+
 START_TEST(sync)
 {
     char **argv;
@@ -2708,4 +2840,5 @@ START_TEST(sync)
     test_srwlock_example();
     test_alertable_wait();
     test_apc_deadlock();
+    test_mixed_waits();
 }
@@ -1045,6 +1045,37 @@ PTP_TIMER WINAPI CreateThreadpoolTimer( PTP_TIMER_CALLBACK callback, PVOID userd
     return timer;
 }
 
+static void CALLBACK tp_io_callback( TP_CALLBACK_INSTANCE *instance, void *userdata, void *cvalue,
+                                    IO_STATUS_BLOCK *iosb, TP_IO *io )
+{
+    PTP_WIN32_IO_CALLBACK callback = *(void **)io;
+
+    callback( instance, userdata, cvalue, RtlNtStatusToDosError( iosb->Status ), iosb->Information, io );
+}
+
+/***********************************************************************
+ *              CreateThreadpoolIo (KERNEL32.@)
+ */
+PTP_IO WINAPI CreateThreadpoolIo( HANDLE handle, PTP_WIN32_IO_CALLBACK callback, PVOID userdata,
+                                  TP_CALLBACK_ENVIRON *environment )
+{
+    TP_IO *io;
+    NTSTATUS status;
+
+    TRACE( "%p, %p, %p, %p\n", handle, callback, userdata, environment );
+
+    status = TpAllocIoCompletion( &io, handle, tp_io_callback, userdata, environment );
+    if (status)
+    {
+        SetLastError( RtlNtStatusToDosError(status) );
+        return NULL;
+    }
+
+    /* ntdll leaves room for the win32 callback at the start of the object */
+    *(void **)io = callback;
+    return io;
+}
+
 /***********************************************************************
  *              CreateThreadpoolWait (KERNEL32.@)
  */
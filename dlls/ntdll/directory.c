@@ -91,6 +91,9 @@
 #ifdef HAVE_SYS_STATFS_H
 #include <sys/statfs.h>
 #endif
+#ifdef HAVE_SYS_INOTIFY_H
+#include <sys/inotify.h>
+#endif
 #include <time.h>
 #ifdef HAVE_UNISTD_H
 # include <unistd.h>
@@ -199,6 +202,28 @@ static const unsigned int dir_data_names_initial_size  = 64;
 static struct dir_data **dir_data_cache;
 static unsigned int dir_data_cache_size;
 
+/* cache of directory contents indexed by case-folded name, for case-insensitive lookups */
+struct name_cache
+{
+    struct list             entry;       /* entry in the LRU list */
+    struct file_identity    id;          /* directory file identity */
+    ULONGLONG               mtime;       /* directory modification time in nanoseconds */
+    int                     watch;       /* inotify watch descriptor, -1 if none */
+    struct dir_data        *data;        /* directory file names */
+    unsigned int            deleted;     /* number of deleted entries in the names */
+    unsigned int            index_size;  /* size of the hash tables, a power of 2 */
+    unsigned int           *long_index;  /* hash table of long names, name index + 1 */
+    unsigned int           *short_index; /* hash table of short names, name index + 1 */
+};
+
+#define MAX_NAME_CACHE_DIRS 32
+
+static struct list name_cache_list = LIST_INIT( name_cache_list );
+static unsigned int name_cache_count;
+#ifdef HAVE_SYS_INOTIFY_H
+static int name_cache_inotify = -2;  /* inotify fd for the cached directories, -2 if not initialized yet */
+#endif
+
 static BOOL show_dot_files;
 static RTL_RUN_ONCE init_once = RTL_RUN_ONCE_INIT;
 
@@ -2019,6 +2044,369 @@ NTSTATUS WINAPI NtQueryDirectoryFile( HANDLE handle, HANDLE event,
 }
 
 
+/* hash a file name the way memicmpW compares it */
+static unsigned int hash_name_nocase( const WCHAR *name, unsigned int len )
+{
+    unsigned int hash = 2166136261u;
+
+    while (len--) hash = (hash ^ tolowerW( *name++ )) * 16777619;
+    return hash;
+}
+
+/* insert a name into one of the name cache hash tables */
+static void add_name_cache_index( struct name_cache *cache, unsigned int *index,
+                                  const WCHAR *name, unsigned int idx )
+{
+    unsigned int i = hash_name_nocase( name, strlenW( name ) ) & (cache->index_size - 1);
+
+    while (index[i]) i = (i + 1) & (cache->index_size - 1);
+    index[i] = idx + 1;
+}
+
+/* find a name in one of the name cache hash tables, starting after the given position */
+static int find_name_cache_index( const struct name_cache *cache, const unsigned int *index,
+                                  const WCHAR *name, unsigned int length, BOOL short_names, int *pos )
+{
+    unsigned int i = (*pos == -1) ? hash_name_nocase( name, length ) & (cache->index_size - 1)
+                                  : (*pos + 1) & (cache->index_size - 1);
+
+    for ( ; index[i]; i = (i + 1) & (cache->index_size - 1))
+    {
+        const struct dir_data_names *names = &cache->data->names[index[i] - 1];
+        const WCHAR *str = short_names ? names->short_name : names->long_name;
+
+        if (!names->unix_name) continue;  /* deleted entry */
+        if (strlenW( str ) != length || memicmpW( str, name, length )) continue;
+        *pos = i;
+        return index[i] - 1;
+    }
+    return -1;
+}
+
+/* look up a name in the cache, returning the Unix name */
+static const char *lookup_name_cache( const struct name_cache *cache, const WCHAR *name,
+                                      unsigned int length, BOOL short_names )
+{
+    int pos = -1, idx;
+
+    if ((idx = find_name_cache_index( cache, cache->long_index, name, length, FALSE, &pos )) != -1)
+        return cache->data->names[idx].unix_name;
+    pos = -1;
+    if (short_names &&
+        (idx = find_name_cache_index( cache, cache->short_index, name, length, TRUE, &pos )) != -1)
+        return cache->data->names[idx].unix_name;
+    return NULL;
+}
+
+/* (re)allocate the hash tables for the current number of names */
+static BOOL build_name_cache_index( struct name_cache *cache, unsigned int size )
+{
+    unsigned int i, *long_index, *short_index;
+
+    long_index = RtlAllocateHeap( GetProcessHeap(), HEAP_ZERO_MEMORY, size * sizeof(*long_index) );
+    short_index = RtlAllocateHeap( GetProcessHeap(), HEAP_ZERO_MEMORY, size * sizeof(*short_index) );
+    if (!long_index || !short_index)
+    {
+        RtlFreeHeap( GetProcessHeap(), 0, long_index );
+        RtlFreeHeap( GetProcessHeap(), 0, short_index );
+        return FALSE;
+    }
+    RtlFreeHeap( GetProcessHeap(), 0, cache->long_index );
+    RtlFreeHeap( GetProcessHeap(), 0, cache->short_index );
+    cache->long_index  = long_index;
+    cache->short_index = short_index;
+    cache->index_size  = size;
+
+    for (i = 0; i < cache->data->count; i++)
+    {
+        if (!cache->data->names[i].unix_name) continue;
+        add_name_cache_index( cache, long_index, cache->data->names[i].long_name, i );
+        if (cache->data->names[i].short_name[0])
+            add_name_cache_index( cache, short_index, cache->data->names[i].short_name, i );
+    }
+    return TRUE;
+}
+
+/* add a directory entry to the name cache */
+static BOOL add_name_cache_entry( struct name_cache *cache, const char *unix_name )
+{
+    static const WCHAR empty[1];
+    WCHAR long_nameW[MAX_DIR_ENTRY_LEN + 1], short_nameW[13];
+    const struct dir_data_names *names;
+    UNICODE_STRING str;
+    BOOLEAN spaces;
+    int len, pos = -1, idx;
+
+    len = ntdll_umbstowcs( 0, unix_name, strlen(unix_name), long_nameW, MAX_DIR_ENTRY_LEN );
+    if (len < 0) return TRUE;
+    long_nameW[len] = 0;
+
+    /* we may already know about it if it was created while the directory was being read */
+    while ((idx = find_name_cache_index( cache, cache->long_index, long_nameW, len, FALSE, &pos )) != -1)
+        if (!strcmp( cache->data->names[idx].unix_name, unix_name )) return TRUE;
+
+    str.Buffer = long_nameW;
+    str.Length = len * sizeof(WCHAR);
+    str.MaximumLength = sizeof(long_nameW);
+    if (!RtlIsNameLegalDOS8Dot3( &str, NULL, &spaces ) || spaces)
+    {
+        len = hash_short_file_name( &str, short_nameW );
+        short_nameW[len] = 0;
+    }
+    else short_nameW[0] = 0;
+
+    if (!add_dir_data_names( cache->data, long_nameW, short_nameW[0] ? short_nameW : empty, unix_name ))
+        return FALSE;
+    if (cache->data->count * 2 > cache->index_size)
+        return build_name_cache_index( cache, cache->index_size * 2 );
+
+    names = &cache->data->names[cache->data->count - 1];
+    add_name_cache_index( cache, cache->long_index, names->long_name, cache->data->count - 1 );
+    if (names->short_name[0])
+        add_name_cache_index( cache, cache->short_index, names->short_name, cache->data->count - 1 );
+    return TRUE;
+}
+
+/* drop the deleted entries from the names and rebuild the hash tables */
+static BOOL compact_name_cache( struct name_cache *cache )
+{
+    struct dir_data *data, *old_data = cache->data;
+    unsigned int i, size = 16;
+
+    if (!(data = RtlAllocateHeap( GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(*data) ))) return FALSE;
+    for (i = 0; i < old_data->count; i++)
+    {
+        if (!old_data->names[i].unix_name) continue;
+        if (!add_dir_data_names( data, old_data->names[i].long_name, old_data->names[i].short_name,
+                                 old_data->names[i].unix_name ))
+        {
+            free_dir_data( data );
+            return FALSE;
+        }
+    }
+    cache->data = data;
+    cache->deleted = 0;
+    free_dir_data( old_data );
+
+    while (data->count * 2 > size) size *= 2;
+    return build_name_cache_index( cache, size );
+}
+
+/* remove a directory entry from the name cache */
+static BOOL remove_name_cache_entry( struct name_cache *cache, const char *unix_name )
+{
+    WCHAR long_nameW[MAX_DIR_ENTRY_LEN + 1];
+    int len, pos = -1, idx;
+
+    len = ntdll_umbstowcs( 0, unix_name, strlen(unix_name), long_nameW, MAX_DIR_ENTRY_LEN );
+    if (len < 0) return TRUE;
+
+    /* entries stay in the hash tables, they are skipped until the next rebuild */
+    while ((idx = find_name_cache_index( cache, cache->long_index, long_nameW, len, FALSE, &pos )) != -1)
+    {
+        if (strcmp( cache->data->names[idx].unix_name, unix_name )) continue;
+        cache->data->names[idx].unix_name = NULL;
+        cache->deleted++;
+    }
+
+    /* don't let deleted names pile up in directories that keep changing */
+    if (cache->deleted > 16 && cache->deleted * 2 > cache->data->count)
+        return compact_name_cache( cache );
+    return TRUE;
+}
+
+static void free_name_cache( struct name_cache *cache )
+{
+#ifdef HAVE_SYS_INOTIFY_H
+    if (cache->watch != -1) inotify_rm_watch( name_cache_inotify, cache->watch );
+#endif
+    list_remove( &cache->entry );
+    name_cache_count--;
+    free_dir_data( cache->data );
+    RtlFreeHeap( GetProcessHeap(), 0, cache->long_index );
+    RtlFreeHeap( GetProcessHeap(), 0, cache->short_index );
+    RtlFreeHeap( GetProcessHeap(), 0, cache );
+}
+
+/* check if a directory is on a network or FUSE file system, where changes made elsewhere
+ * are neither reported by inotify nor reliably reflected in the directory mtime */
+static BOOL is_remote_dir( const char *unix_name )
+{
+#ifdef __linux__
+    struct statfs stfs;
+
+    if (statfs( unix_name, &stfs ) == -1) return TRUE;
+    switch ((unsigned int)stfs.f_type)
+    {
+    case 0x6969:      /* NFS_SUPER_MAGIC */
+    case 0x517b:      /* SMB_SUPER_MAGIC */
+    case 0xfe534d42:  /* SMB2_MAGIC_NUMBER */
+    case 0xff534d42:  /* CIFS_MAGIC_NUMBER */
+    case 0x65735546:  /* FUSE_SUPER_MAGIC */
+    case 0x01021997:  /* V9FS_MAGIC */
+    case 0x73757245:  /* CODA_SUPER_MAGIC */
+    case 0x5346414f:  /* AFS_SUPER_MAGIC */
+    case 0x6b414653:  /* AFS_FS_MAGIC */
+    case 0x00c36400:  /* CEPH_SUPER_MAGIC */
+        return TRUE;
+    }
+    return FALSE;
+#elif (defined(__APPLE__) || defined(__FreeBSD__) || defined(__FreeBSD_kernel__)) && defined(MNT_LOCAL)
+    struct statfs stfs;
+
+    if (statfs( unix_name, &stfs ) == -1) return TRUE;
+    return !(stfs.f_flags & MNT_LOCAL);
+#else
+    return FALSE;
+#endif
+}
+
+/* read the directory contents and build the hash tables */
+static struct name_cache *create_name_cache( const char *unix_name, const struct stat *st, ULONGLONG mtime )
+{
+    struct name_cache *cache;
+    struct dirent *de;
+    DIR *dir;
+
+    if (is_remote_dir( unix_name )) return NULL;
+
+    if (!(cache = RtlAllocateHeap( GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(*cache) ))) return NULL;
+    if (!(cache->data = RtlAllocateHeap( GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(*cache->data) )))
+    {
+        RtlFreeHeap( GetProcessHeap(), 0, cache );
+        return NULL;
+    }
+    list_add_head( &name_cache_list, &cache->entry );
+    name_cache_count++;
+    cache->id.dev = st->st_dev;
+    cache->id.ino = st->st_ino;
+    cache->mtime  = mtime;
+    cache->watch  = -1;
+
+#ifdef HAVE_SYS_INOTIFY_H
+    /* start watching before reading, so that we don't miss any change */
+    if (name_cache_inotify != -1)
+        cache->watch = inotify_add_watch( name_cache_inotify, unix_name, IN_CREATE | IN_DELETE |
+                                          IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF );
+#endif
+    /* without notifications, changes made within the timestamp granularity of our scan
+     * would go unnoticed, so don't cache directories that are being modified */
+    if (cache->watch == -1 && st->st_mtime >= time( NULL ) - 1) goto failed;
+
+    if (!build_name_cache_index( cache, 16 )) goto failed;
+    if (!(dir = opendir( unix_name ))) goto failed;
+    while ((de = readdir( dir )))
+    {
+        if (!add_name_cache_entry( cache, de->d_name ))
+        {
+            closedir( dir );
+            goto failed;
+        }
+    }
+    closedir( dir );
+
+    if (name_cache_count > MAX_NAME_CACHE_DIRS)
+        free_name_cache( LIST_ENTRY( list_tail( &name_cache_list ), struct name_cache, entry ));
+    return cache;
+
+failed:
+    free_name_cache( cache );
+    return NULL;
+}
+
+#ifdef HAVE_SYS_INOTIFY_H
+/* apply the pending directory change notifications to the name caches */
+static void read_name_cache_events(void)
+{
+    union
+    {
+        struct inotify_event event;
+        char data[4096];
+    } buffer;
+    struct inotify_event *event;
+    struct name_cache *cache, *next;
+    ssize_t size, pos;
+
+    while ((size = read( name_cache_inotify, &buffer, sizeof(buffer) )) > 0)
+    {
+        for (pos = 0; pos < size; pos += sizeof(*event) + event->len)
+        {
+            event = (struct inotify_event *)(buffer.data + pos);
+            if (event->mask & IN_Q_OVERFLOW)
+            {
+                /* we lost track of the changes, start over */
+                LIST_FOR_EACH_ENTRY_SAFE( cache, next, &name_cache_list, struct name_cache, entry )
+                    free_name_cache( cache );
+                continue;
+            }
+            LIST_FOR_EACH_ENTRY( cache, &name_cache_list, struct name_cache, entry )
+            {
+                if (cache->watch != event->wd) continue;
+                if (event->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED))
+                    free_name_cache( cache );
+                else if (event->mask & (IN_CREATE | IN_MOVED_TO))
+                {
+                    if (!add_name_cache_entry( cache, event->name )) free_name_cache( cache );
+                }
+                else if (event->mask & (IN_DELETE | IN_MOVED_FROM))
+                {
+                    if (!remove_name_cache_entry( cache, event->name )) free_name_cache( cache );
+                }
+                break;
+            }
+        }
+    }
+}
+#endif
+
+/***********************************************************************
+ *           get_name_cache
+ *
+ * Get the name cache for a directory, (re)building it if the directory
+ * has changed since it was cached. Must be called with dir_section held.
+ */
+static struct name_cache *get_name_cache( const char *unix_name )
+{
+    struct name_cache *cache;
+    struct stat st;
+    ULONGLONG mtime;
+
+#ifdef HAVE_SYS_INOTIFY_H
+    if (name_cache_inotify == -2)
+    {
+        if ((name_cache_inotify = inotify_init()) != -1)
+        {
+            fcntl( name_cache_inotify, F_SETFD, FD_CLOEXEC );
+            fcntl( name_cache_inotify, F_SETFL, O_NONBLOCK );
+        }
+    }
+    if (name_cache_inotify != -1) read_name_cache_events();
+#endif
+
+    if (stat( unix_name, &st ) == -1) return NULL;
+    mtime = (ULONGLONG)st.st_mtime * 1000000000;
+#ifdef HAVE_STRUCT_STAT_ST_MTIM
+    mtime += st.st_mtim.tv_nsec;
+#elif defined(HAVE_STRUCT_STAT_ST_MTIMESPEC)
+    mtime += st.st_mtimespec.tv_nsec;
+#endif
+
+    LIST_FOR_EACH_ENTRY( cache, &name_cache_list, struct name_cache, entry )
+    {
+        if (cache->id.dev != st.st_dev || cache->id.ino != st.st_ino) continue;
+        if (cache->watch == -1 && cache->mtime != mtime)
+        {
+            free_name_cache( cache );
+            break;
+        }
+        list_remove( &cache->entry );
+        list_add_head( &name_cache_list, &cache->entry );
+        return cache;
+    }
+    return create_name_cache( unix_name, &st, mtime );
+}
+
+
 /***********************************************************************
  *           find_file_in_dir
  *
@@ -2032,6 +2420,7 @@ static NTSTATUS find_file_in_dir( char *unix_name, int pos, const WCHAR *name, i
     WCHAR buffer[MAX_DIR_ENTRY_LEN];
     UNICODE_STRING str;
     BOOLEAN spaces, is_name_8_dot_3;
+    struct name_cache *cache;
     DIR *dir;
     struct dirent *de;
     struct stat st;
@@ -2129,6 +2518,22 @@ static NTSTATUS find_file_in_dir( char *unix_name, int pos, const WCHAR *name, i
     }
 #endif /* VFAT_IOCTL_READDIR_BOTH */
 
+    RtlEnterCriticalSection( &dir_section );
+    if ((cache = get_name_cache( unix_name )))
+    {
+        const char *found = lookup_name_cache( cache, name, length, is_name_8_dot_3 );
+
+        if (found)
+        {
+            unix_name[pos - 1] = '/';
+            strcpy( unix_name + pos, found );
+        }
+        RtlLeaveCriticalSection( &dir_section );
+        if (found) goto success;
+        goto not_found;
+    }
+    RtlLeaveCriticalSection( &dir_section );
+
     if (!(dir = opendir( unix_name )))
     {
         if (errno == ENOENT) return STATUS_OBJECT_PATH_NOT_FOUND;
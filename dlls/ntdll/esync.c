@@ -0,0 +1,626 @@
+/*
+ * eventfd-based synchronization objects
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+/*
+ * Events, semaphores and mutexes created by a server running with WINEESYNC
+ * set are backed by an eventfd (see server/esync.c). This file implements the
+ * client side: the eventfd of each handle is fetched once and cached, after
+ * which signaling and non-alertable waits are done with read/write/poll on
+ * the eventfds, without any server round-trip. Anything that can't be
+ * handled here (alertable waits, other object types) returns
+ * STATUS_NOT_IMPLEMENTED and the caller falls back to the server.
+ */
+
+#include "config.h"
+#include "wine/port.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef HAVE_POLL_H
+#include <poll.h>
+#endif
+#ifdef HAVE_SYS_POLL_H
+# include <sys/poll.h>
+#endif
+#ifdef HAVE_SYS_MMAN_H
+# include <sys/mman.h>
+#endif
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+
+#include "ntstatus.h"
+#define WIN32_NO_STATUS
+#include "windef.h"
+#include "winternl.h"
+#include "wine/library.h"
+#include "wine/server.h"
+#include "wine/debug.h"
+#include "ntdll_misc.h"
+
+WINE_DEFAULT_DEBUG_CHANNEL(esync);
+
+static RTL_CRITICAL_SECTION esync_section;
+static RTL_CRITICAL_SECTION_DEBUG critsect_debug =
+{
+    0, 0, &esync_section,
+    { &critsect_debug.ProcessLocksList, &critsect_debug.ProcessLocksList },
+      0, 0, { (DWORD_PTR)(__FILE__ ": esync_section") }
+};
+static RTL_CRITICAL_SECTION esync_section = { &critsect_debug, -1, 0, 0, 0, 0 };
+
+static int esync_enabled = -1;
+static esync_shm_t *esync_shm;
+
+struct esync_object
+{
+    int          type;      /* enum esync_type, ESYNC_NONE if not an esync object, -1 if unset */
+    int          fd;        /* eventfd */
+    unsigned int shm_idx;   /* index of the shared state */
+    unsigned int access;    /* handle access rights */
+};
+
+#define ESYNC_CACHE_BLOCK_SIZE  (65536 / sizeof(struct esync_object))
+#define ESYNC_CACHE_ENTRIES     128
+
+static struct esync_object *esync_cache[ESYNC_CACHE_ENTRIES];
+
+static inline unsigned int handle_to_index( HANDLE handle, unsigned int *entry )
+{
+    unsigned int idx = (wine_server_obj_handle(handle) >> 2) - 1;
+    *entry = idx / ESYNC_CACHE_BLOCK_SIZE;
+    return idx % ESYNC_CACHE_BLOCK_SIZE;
+}
+
+
+/***********************************************************************
+ *           do_esync
+ *
+ * Check whether esync is in use, mapping the shared state block on first use.
+ */
+int do_esync(void)
+{
+    SIZE_T size = ESYNC_SHM_SLOTS * sizeof(esync_shm_t);
+    const char *str;
+    void *mem = NULL;
+    sigset_t sigset;
+    int fd;
+
+    if (esync_enabled != -1) return esync_enabled;
+
+    server_enter_uninterrupted_section( &esync_section, &sigset );
+    if (esync_enabled == -1)
+    {
+        str = getenv( "WINEESYNC" );
+        if (str && atoi( str ) && !server_get_esync_fd( 0, NULL, NULL, NULL, &fd ))
+        {
+            if (virtual_map_shared_memory( fd, &mem, 0, &size, PAGE_READWRITE ))
+                ERR( "failed to map esync shared memory\n" );
+            close( fd );
+        }
+        else if (str && atoi( str ))
+            ERR( "WINEESYNC is set but the server doesn't support it\n" );
+        esync_shm = mem;
+        esync_enabled = (mem != NULL);
+        if (esync_enabled) TRACE( "using eventfd synchronization\n" );
+    }
+    server_leave_uninterrupted_section( &esync_section, &sigset );
+    return esync_enabled;
+}
+
+
+/***********************************************************************
+ *           get_cached_object
+ */
+static inline struct esync_object *get_cached_object( HANDLE handle )
+{
+    unsigned int entry, idx = handle_to_index( handle, &entry );
+
+    if (entry >= ESYNC_CACHE_ENTRIES || !esync_cache[entry]) return NULL;
+    if (esync_cache[entry][idx].type == -1) return NULL;
+    return &esync_cache[entry][idx];
+}
+
+
+/***********************************************************************
+ *           add_object_to_cache
+ *
+ * Caller must hold esync_section.
+ */
+static struct esync_object *add_object_to_cache( HANDLE handle, int type, int fd,
+                                                 unsigned int shm_idx, unsigned int access )
+{
+    unsigned int entry, idx = handle_to_index( handle, &entry );
+    struct esync_object *obj;
+
+    if (entry >= ESYNC_CACHE_ENTRIES)
+    {
+        FIXME( "too many allocated handles, not caching %p\n", handle );
+        return NULL;
+    }
+
+    if (!esync_cache[entry])
+    {
+        unsigned int i;
+        void *ptr = wine_anon_mmap( NULL, ESYNC_CACHE_BLOCK_SIZE * sizeof(struct esync_object),
+                                    PROT_READ | PROT_WRITE, 0 );
+        if (ptr == MAP_FAILED) return NULL;
+        obj = ptr;
+        for (i = 0; i < ESYNC_CACHE_BLOCK_SIZE; i++) obj[i].type = -1;
+        esync_cache[entry] = ptr;
+    }
+
+    obj = &esync_cache[entry][idx];
+    obj->fd      = fd;
+    obj->shm_idx = shm_idx;
+    obj->access  = access;
+    /* publish the entry once it is complete */
+    interlocked_xchg( &obj->type, type );
+    return obj;
+}
+
+
+/***********************************************************************
+ *           get_object
+ *
+ * Retrieve the esync state of a handle, asking the server on the first use.
+ */
+static NTSTATUS get_object( HANDLE handle, struct esync_object **ret )
+{
+    struct esync_object *obj;
+    enum esync_type type;
+    unsigned int shm_idx, access;
+    sigset_t sigset;
+    NTSTATUS status = STATUS_SUCCESS;
+    int fd;
+
+    *ret = NULL;
+    if ((INT_PTR)handle < 0) return STATUS_NOT_IMPLEMENTED;  /* pseudo-handles */
+
+    if (!(obj = get_cached_object( handle )))
+    {
+        server_enter_uninterrupted_section( &esync_section, &sigset );
+        if (!(obj = get_cached_object( handle )))
+        {
+            status = server_get_esync_fd( handle, &type, &shm_idx, &access, &fd );
+            if (!status)
+            {
+                if (!(obj = add_object_to_cache( handle, type, fd, shm_idx, access )))
+                    close( fd );
+            }
+            else if (status == STATUS_NOT_IMPLEMENTED)
+                obj = add_object_to_cache( handle, ESYNC_NONE, -1, 0, 0 );
+        }
+        server_leave_uninterrupted_section( &esync_section, &sigset );
+        if (!obj) return status ? status : STATUS_NOT_IMPLEMENTED;
+    }
+
+    if (obj->type == ESYNC_NONE) return STATUS_NOT_IMPLEMENTED;
+    *ret = obj;
+    return STATUS_SUCCESS;
+}
+
+
+/***********************************************************************
+ *           esync_close
+ *
+ * Forget the cached state of a handle that is being closed.
+ */
+void esync_close( HANDLE handle )
+{
+    unsigned int entry, idx = handle_to_index( handle, &entry );
+    struct esync_object *obj;
+
+    if (esync_enabled != 1) return;
+    if (entry >= ESYNC_CACHE_ENTRIES || !esync_cache[entry]) return;
+
+    obj = &esync_cache[entry][idx];
+    if (interlocked_xchg( &obj->type, -1 ) == -1) return;
+    if (obj->fd != -1) close( obj->fd );
+    obj->fd = -1;
+}
+
+
+static inline esync_shm_t *get_shm( struct esync_object *obj )
+{
+    return &esync_shm[obj->shm_idx];
+}
+
+static int fd_signaled( int fd )
+{
+    struct pollfd pfd;
+
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    return poll( &pfd, 1, 0 ) == 1 && (pfd.revents & POLLIN);
+}
+
+static int fd_grab( int fd )
+{
+    ULONGLONG value;
+    return read( fd, &value, sizeof(value) ) == sizeof(value);
+}
+
+static void fd_post( int fd, ULONG count )
+{
+    ULONGLONG value = count;
+    if (write( fd, &value, sizeof(value) ) == -1)
+        ERR( "write to eventfd %d failed: %s\n", fd, strerror( errno ));
+}
+
+/* wait for the eventfd post matching a count unit that has already been taken;
+ * releasers bump the count before posting, so this only waits while a release
+ * is in flight, but give up if the releaser never gets to post */
+static int fd_grab_pending( int fd )
+{
+    struct pollfd pfd;
+    int i;
+
+    for (i = 0; i < 100; i++)
+    {
+        if (fd_grab( fd )) return 1;
+        pfd.fd = fd;
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+        poll( &pfd, 1, 1 );
+    }
+    return 0;
+}
+
+/* let the server know about the new state if one of its threads waits on the object;
+ * the eventfd has already been posted, a waiter added later will see it when polling */
+static void wake_server( HANDLE handle, struct esync_object *obj )
+{
+    if (!interlocked_cmpxchg( &get_shm( obj )->waiters, 0, 0 )) return;
+
+    SERVER_START_REQ( esync_wake )
+    {
+        req->handle = wine_server_obj_handle( handle );
+        wine_server_call( req );
+    }
+    SERVER_END_REQ;
+}
+
+
+/***********************************************************************
+ *           esync_set_event
+ */
+NTSTATUS esync_set_event( HANDLE handle )
+{
+    struct esync_object *obj;
+    NTSTATUS ret;
+
+    if ((ret = get_object( handle, &obj ))) return ret;
+    if (obj->type != ESYNC_AUTO_EVENT && obj->type != ESYNC_MANUAL_EVENT) return STATUS_OBJECT_TYPE_MISMATCH;
+    if (!(obj->access & EVENT_MODIFY_STATE)) return STATUS_ACCESS_DENIED;
+
+    fd_post( obj->fd, 1 );
+    wake_server( handle, obj );
+    return STATUS_SUCCESS;
+}
+
+
+/***********************************************************************
+ *           esync_reset_event
+ */
+NTSTATUS esync_reset_event( HANDLE handle )
+{
+    struct esync_object *obj;
+    NTSTATUS ret;
+
+    if ((ret = get_object( handle, &obj ))) return ret;
+    if (obj->type != ESYNC_AUTO_EVENT && obj->type != ESYNC_MANUAL_EVENT) return STATUS_OBJECT_TYPE_MISMATCH;
+    if (!(obj->access & EVENT_MODIFY_STATE)) return STATUS_ACCESS_DENIED;
+
+    fd_grab( obj->fd );
+    return STATUS_SUCCESS;
+}
+
+
+/***********************************************************************
+ *           esync_release_semaphore
+ */
+NTSTATUS esync_release_semaphore( HANDLE handle, ULONG count, ULONG *prev )
+{
+    struct esync_object *obj;
+    esync_shm_t *shm;
+    unsigned int current, new;
+    NTSTATUS ret;
+
+    if ((ret = get_object( handle, &obj ))) return ret;
+    if (obj->type != ESYNC_SEMAPHORE) return STATUS_OBJECT_TYPE_MISMATCH;
+    if (!(obj->access & SEMAPHORE_MODIFY_STATE)) return STATUS_ACCESS_DENIED;
+
+    shm = get_shm( obj );
+    do
+    {
+        current = shm->count;
+        new = current + count;
+        if (new < current || new > shm->max) return STATUS_SEMAPHORE_LIMIT_EXCEEDED;
+    } while (interlocked_cmpxchg( (int *)&shm->count, new, current ) != current);
+
+    if (prev) *prev = current;
+    fd_post( obj->fd, count );
+    wake_server( handle, obj );
+    return STATUS_SUCCESS;
+}
+
+
+/***********************************************************************
+ *           esync_release_mutex
+ */
+NTSTATUS esync_release_mutex( HANDLE handle, LONG *prev )
+{
+    struct esync_object *obj;
+    esync_shm_t *shm;
+    NTSTATUS ret;
+
+    if ((ret = get_object( handle, &obj ))) return ret;
+    if (obj->type != ESYNC_MUTEX) return STATUS_OBJECT_TYPE_MISMATCH;
+
+    /* only the owner thread touches the count, no need for atomic operations */
+    shm = get_shm( obj );
+    if (shm->tid != GetCurrentThreadId()) return STATUS_MUTANT_NOT_OWNED;
+
+    if (prev) *prev = 1 - shm->count;
+    if (!--shm->count)
+    {
+        shm->tid = 0;
+        fd_post( obj->fd, 1 );
+        wake_server( handle, obj );
+    }
+    return STATUS_SUCCESS;
+}
+
+
+/* check whether an object could be acquired without consuming it */
+static int object_signaled( struct esync_object *obj )
+{
+    if (obj->type == ESYNC_MUTEX && get_shm( obj )->tid == GetCurrentThreadId()) return 1;
+    return fd_signaled( obj->fd );
+}
+
+/* try to acquire an object for the current thread */
+static int grab_object( struct esync_object *obj, BOOL *abandoned )
+{
+    esync_shm_t *shm = get_shm( obj );
+
+    switch (obj->type)
+    {
+    case ESYNC_MANUAL_EVENT:
+        return fd_signaled( obj->fd );
+    case ESYNC_AUTO_EVENT:
+        return fd_grab( obj->fd );
+    case ESYNC_SEMAPHORE:
+    {
+        unsigned int current;
+
+        /* take the count first so that it never includes a unit that is
+         * already gone from the eventfd, or releases could fail spuriously */
+        do
+        {
+            if (!(current = shm->count)) return 0;
+        } while (interlocked_cmpxchg( (int *)&shm->count, current - 1, current ) != current);
+
+        if (fd_grab_pending( obj->fd )) return 1;
+        interlocked_xchg_add( (int *)&shm->count, 1 );
+        return 0;
+    }
+    case ESYNC_MUTEX:
+        if (shm->tid == GetCurrentThreadId())
+        {
+            shm->count++;
+            return 1;
+        }
+        if (!fd_grab( obj->fd )) return 0;
+        shm->tid = GetCurrentThreadId();
+        shm->count = 1;
+        if (shm->abandoned)
+        {
+            shm->abandoned = 0;
+            *abandoned = TRUE;
+        }
+        return 1;
+    }
+    return 0;
+}
+
+/* give back an object taken by grab_object when a wait-all can't be completed */
+static void ungrab_object( HANDLE handle, struct esync_object *obj, BOOL abandoned )
+{
+    esync_shm_t *shm = get_shm( obj );
+
+    switch (obj->type)
+    {
+    case ESYNC_MANUAL_EVENT:
+        return;
+    case ESYNC_AUTO_EVENT:
+        fd_post( obj->fd, 1 );
+        break;
+    case ESYNC_SEMAPHORE:
+        interlocked_xchg_add( (int *)&shm->count, 1 );
+        fd_post( obj->fd, 1 );
+        break;
+    case ESYNC_MUTEX:
+        if (--shm->count) return;
+        shm->tid = 0;
+        shm->abandoned = abandoned;
+        fd_post( obj->fd, 1 );
+        break;
+    }
+    wake_server( handle, obj );
+}
+
+/* convert an NT timeout to an absolute end time, TIMEOUT_INFINITE if none */
+static timeout_t get_end_time( const LARGE_INTEGER *timeout )
+{
+    LARGE_INTEGER now;
+
+    if (!timeout || timeout->QuadPart == TIMEOUT_INFINITE) return TIMEOUT_INFINITE;
+    if (timeout->QuadPart >= 0) return timeout->QuadPart;
+    NtQuerySystemTime( &now );
+    return now.QuadPart - timeout->QuadPart;
+}
+
+/* poll the given fds until one is signaled or the end time is reached */
+static NTSTATUS do_poll( struct pollfd *fds, nfds_t count, timeout_t end )
+{
+    LARGE_INTEGER now;
+    int ret, ms = -1;
+    nfds_t i;
+
+    for (;;)
+    {
+        if (end != TIMEOUT_INFINITE)
+        {
+            NtQuerySystemTime( &now );
+            if (now.QuadPart >= end) ms = 0;
+            else ms = (end - now.QuadPart + 9999) / 10000;
+        }
+        if ((ret = poll( fds, count, ms )) > 0)
+        {
+            /* the handle was closed while we were waiting on it */
+            for (i = 0; i < count; i++) if (fds[i].revents & POLLNVAL) return STATUS_INVALID_HANDLE;
+            return STATUS_SUCCESS;
+        }
+        if (!ret) return ms ? STATUS_SUCCESS : STATUS_TIMEOUT;  /* rounding, check again */
+        if (errno != EINTR) return STATUS_INVALID_HANDLE;
+    }
+}
+
+
+/***********************************************************************
+ *           esync_wait_objects
+ */
+NTSTATUS esync_wait_objects( DWORD count, const HANDLE *handles, BOOLEAN wait_any,
+                             BOOLEAN alertable, const LARGE_INTEGER *timeout )
+{
+    struct esync_object *objs[MAXIMUM_WAIT_OBJECTS];
+    struct pollfd fds[MAXIMUM_WAIT_OBJECTS];
+    BOOL abandoned[MAXIMUM_WAIT_OBJECTS];
+    timeout_t end;
+    NTSTATUS ret;
+    DWORD i, j;
+    nfds_t nfds;
+
+    /* user APCs can only be delivered by the server */
+    if (alertable) return STATUS_NOT_IMPLEMENTED;
+
+    for (i = 0; i < count; i++)
+    {
+        if ((ret = get_object( handles[i], &objs[i] ))) return STATUS_NOT_IMPLEMENTED;
+        if (!(objs[i]->access & SYNCHRONIZE)) return STATUS_NOT_IMPLEMENTED;
+        /* the server knows how to handle the same object twice in a wait-all */
+        if (!wait_any)
+            for (j = 0; j < i; j++)
+                if (objs[j]->shm_idx == objs[i]->shm_idx) return STATUS_NOT_IMPLEMENTED;
+    }
+
+    end = get_end_time( timeout );
+    TRACE( "waiting for %s of %u handles, end %s\n", wait_any ? "any" : "all", count,
+           wine_dbgstr_longlong( end ));
+
+    for (;;)
+    {
+        if (wait_any)
+        {
+            for (i = 0; i < count; i++)
+            {
+                abandoned[i] = FALSE;
+                if (!grab_object( objs[i], &abandoned[i] )) continue;
+                return abandoned[i] ? STATUS_ABANDONED_WAIT_0 + i : STATUS_WAIT_0 + i;
+            }
+            for (i = 0; i < count; i++)
+            {
+                fds[i].fd = objs[i]->fd;
+                fds[i].events = POLLIN;
+                fds[i].revents = 0;
+            }
+            nfds = count;
+        }
+        else
+        {
+            /* only try to take the objects once they all appear signaled, and
+             * then only wait on the ones that aren't */
+            for (i = nfds = 0; i < count; i++)
+            {
+                if (object_signaled( objs[i] )) continue;
+                fds[nfds].fd = objs[i]->fd;
+                fds[nfds].events = POLLIN;
+                fds[nfds].revents = 0;
+                nfds++;
+            }
+            if (!nfds)
+            {
+                BOOL any_abandoned = FALSE;
+
+                for (i = 0; i < count; i++)
+                {
+                    abandoned[i] = FALSE;
+                    if (!grab_object( objs[i], &abandoned[i] )) break;
+                    any_abandoned |= abandoned[i];
+                }
+                if (i == count) return any_abandoned ? STATUS_ABANDONED_WAIT_0 : STATUS_WAIT_0;
+                /* someone else got there first, put back what we took and start over */
+                while (i--) ungrab_object( handles[i], objs[i], abandoned[i] );
+                continue;
+            }
+        }
+
+        if ((ret = do_poll( fds, nfds, end ))) return ret;
+    }
+}
+
+
+/***********************************************************************
+ *           esync_signal_and_wait
+ */
+NTSTATUS esync_signal_and_wait( HANDLE signal, HANDLE wait, BOOLEAN alertable,
+                                const LARGE_INTEGER *timeout )
+{
+    struct esync_object *obj, *wait_obj;
+    NTSTATUS ret;
+
+    if (alertable) return STATUS_NOT_IMPLEMENTED;
+    if ((ret = get_object( signal, &obj ))) return ret;
+    if ((ret = get_object( wait, &wait_obj ))) return ret;
+    if (!(wait_obj->access & SYNCHRONIZE)) return STATUS_NOT_IMPLEMENTED;
+
+    switch (obj->type)
+    {
+    case ESYNC_AUTO_EVENT:
+    case ESYNC_MANUAL_EVENT:
+        ret = esync_set_event( signal );
+        break;
+    case ESYNC_SEMAPHORE:
+        ret = esync_release_semaphore( signal, 1, NULL );
+        break;
+    case ESYNC_MUTEX:
+        ret = esync_release_mutex( signal, NULL );
+        break;
+    default:
+        return STATUS_NOT_IMPLEMENTED;
+    }
+    if (ret) return ret;
+
+    return esync_wait_objects( 1, &wait, TRUE, FALSE, timeout );
+}
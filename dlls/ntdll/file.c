@@ -964,7 +964,14 @@ NTSTATUS WINAPI NtReadFile(HANDLE hFile, HANDLE hEvent,
 
         if (offset && offset->QuadPart != FILE_USE_FILE_POINTER_POSITION)
         {
-            /* async I/O doesn't make sense on regular files */
+            if (async_read)
+            {
+                status = uring_read_write( FALSE, hFile, unix_handle, hEvent, apc, apc_user, io_status,
+                                           buffer, length, offset->QuadPart, cvalue );
+                if (status == STATUS_PENDING) goto err;
+            }
+
+            /* no kernel async I/O, do it synchronously */
             while ((result = pread( unix_handle, buffer, length, offset->QuadPart )) == -1)
             {
                 if (errno == EFAULT)
@@ -1385,7 +1392,14 @@ NTSTATUS WINAPI NtWriteFile(HANDLE hFile, HANDLE hEvent,
                 goto done;
             }
 
-            /* async I/O doesn't make sense on regular files */
+            if (async_write && offset->QuadPart >= 0)
+            {
+                status = uring_read_write( TRUE, hFile, unix_handle, hEvent, apc, apc_user, io_status,
+                                           (void *)buffer, length, off, cvalue );
+                if (status == STATUS_PENDING) goto err;
+            }
+
+            /* no kernel async I/O, do it synchronously */
             while ((result = pwrite( unix_handle, buffer, length, off )) == -1)
             {
                 if (errno != EINTR)
@@ -3159,6 +3173,24 @@ NTSTATUS WINAPI NtSetInformationFile(HANDLE handle, PIO_STATUS_BLOCK io,
             io->u.Status = STATUS_INVALID_PARAMETER_3;
         break;
 
+    case FileReplaceCompletionInformation:
+        if (len >= sizeof(FILE_COMPLETION_INFORMATION))
+        {
+            FILE_COMPLETION_INFORMATION *info = ptr;
+
+            SERVER_START_REQ( set_completion_info )
+            {
+                req->handle   = wine_server_obj_handle( handle );
+                req->chandle  = wine_server_obj_handle( info->CompletionPort );
+                req->ckey     = info->CompletionKey;
+                req->replace  = 1;
+                io->u.Status  = wine_server_call( req );
+            }
+            SERVER_END_REQ;
+        } else
+            io->u.Status = STATUS_INFO_LENGTH_MISMATCH;
+        break;
+
     case FileIoCompletionNotificationInformation:
         if (len >= sizeof(FILE_IO_COMPLETION_NOTIFICATION_INFORMATION))
         {
@@ -3894,21 +3926,40 @@ NTSTATUS WINAPI NtFlushBuffersFile( HANDLE hFile, IO_STATUS_BLOCK* IoStatusBlock
     {
         ret = COMM_FlushBuffersFile( fd );
     }
+    else if (!ret && type == FD_TYPE_FILE && (ret = uring_flush( fd )) != STATUS_NOT_SUPPORTED)
+    {
+        IoStatusBlock->u.Status = ret;
+        IoStatusBlock->Information = 0;
+    }
     else if (ret != STATUS_ACCESS_DENIED)
     {
+        struct async_irp *async;
+        IO_STATUS_BLOCK io;
+
+        if (!(async = (struct async_irp *)alloc_fileio( sizeof(*async), irp_completion, hFile )))
+        {
+            if (needs_close) close( fd );
+            return STATUS_NO_MEMORY;
+        }
+        async->event  = NULL;
+        async->buffer = NULL;
+        async->size   = 0;
+
         SERVER_START_REQ( flush )
         {
-            req->async = server_async( hFile, NULL, NULL, NULL, NULL, IoStatusBlock );
+            req->async = server_async( hFile, &async->io, NULL, NULL, NULL, &io );
             ret = wine_server_call( req );
             hEvent = wine_server_ptr_handle( reply->event );
         }
         SERVER_END_REQ;
 
+        if (ret != STATUS_PENDING) release_fileio( &async->io );
+
         if (hEvent)
         {
             NtWaitForSingleObject( hEvent, FALSE, NULL );
             NtClose( hEvent );
-            ret = STATUS_SUCCESS;
+            ret = io.u.Status;
         }
     }
 
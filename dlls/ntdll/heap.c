@@ -148,6 +148,68 @@ typedef struct tagSUBHEAP
 
 #define SUBHEAP_MAGIC    ((DWORD)('S' | ('U'<<8) | ('B'<<16) | ('H'<<24)))
 
+/* Low fragmentation heap front end
+ *
+ * Once enabled with HeapCompatibilityInformation, small blocks are served
+ * from 64k slabs holding blocks of a single size class instead of the
+ * arenas. Free blocks are kept in lock-free lists, one per size class and
+ * affinity slot (picked from the thread id) to spread contention, so the
+ * heap lock is only taken to carve more blocks out of a slab.
+ */
+
+typedef struct
+{
+    DWORD  size;                    /* Size of user data */
+    DWORD  magic;                   /* Magic number */
+} ARENA_LFH;
+
+C_ASSERT( sizeof(ARENA_LFH) == sizeof(ARENA_INUSE) );
+
+#define LFH_SLAB_SIZE        0x10000  /* size and alignment of a slab */
+#define LFH_MAX_BLOCK_SIZE   0x4000   /* larger blocks are allocated from the arenas */
+#define LFH_NB_CLASSES       64
+#define LFH_AFFINITY_SLOTS   8
+#define LFH_GROW_SIZE        0x1000   /* amount of blocks to carve out of a slab at once */
+#define LFH_HEADER_SIZE      ALIGNMENT
+#define LFH_REGION_SHIFT     28       /* slabs are tracked per 256Mb region */
+#define LFH_REGION_SLABS     (1 << (LFH_REGION_SHIFT - 16))
+#define LFH_NB_REGIONS       64
+
+#define LFH_BLOCK_MAGIC  ((DWORD)('L' | ('F'<<8) | ('H'<<16) | ('B'<<24)))
+#define LFH_FREE_MAGIC   ((DWORD)('L' | ('F'<<8) | ('H'<<16) | ('F'<<24)))
+#define LFH_SLAB_MAGIC   ((DWORD)('L' | ('F'<<8) | ('H'<<16) | ('S'<<24)))
+
+struct lfh_slab
+{
+    DWORD               magic;      /* Magic number */
+    DWORD               class;      /* Size class of the blocks */
+    struct tagHEAP     *heap;       /* Heap owning the slab */
+    struct list         entry;      /* Entry in the heap slab list */
+    char               *next;       /* First block not carved yet */
+};
+
+/* bitmap of the slabs of a region, used to validate block pointers
+ * without touching memory that may not be mapped */
+struct lfh_region
+{
+    ULONG_PTR           index;      /* (address >> LFH_REGION_SHIFT) + 1, 0 if unused */
+    ULONG               bits[LFH_REGION_SLABS / 32];
+};
+
+typedef union
+{
+    SLIST_HEADER        list;
+    char                pad[64];    /* keep the slots in separate cache lines */
+} LFH_SLOT;
+
+struct lfh
+{
+    LFH_SLOT            slots[LFH_NB_CLASSES][LFH_AFFINITY_SLOTS];  /* Free blocks */
+    struct lfh_slab    *current[LFH_NB_CLASSES];  /* Slabs being carved, protected by the heap lock */
+    struct list         slabs;      /* All the slabs */
+    struct lfh_region   regions[LFH_NB_REGIONS];  /* Slab addresses, updated under the heap lock */
+};
+
 typedef struct tagHEAP
 {
     DWORD_PTR        unknown1[2];
@@ -164,6 +226,7 @@ typedef struct tagHEAP
     ARENA_INUSE    **pending_free;  /* Ring buffer for pending free requests */
     RTL_CRITICAL_SECTION critSection; /* Critical section for serialization */
     FREE_LIST_ENTRY *freeList;      /* Free lists */
+    struct lfh      *lfh;           /* Low fragmentation front end, if enabled */
 } HEAP;
 
 #define HEAP_MAGIC       ((DWORD)('H' | ('E'<<8) | ('A'<<16) | ('P'<<24)))
@@ -869,6 +932,382 @@ static BOOL validate_large_arena( HEAP *heap, const ARENA_LARGE *arena, BOOL qui
 }
 
 
+/***********************************************************************
+ *           lfh_get_class
+ *
+ * Size classes are 16 bytes apart up to 256 bytes, then there are 8 of
+ * them for each power of two. Returns -1 for blocks too large for the LFH.
+ */
+static inline int lfh_get_class( SIZE_T size )
+{
+    unsigned int bit;
+
+    if (size <= 0x100) return size ? (size - 1) / 16 : 0;
+    if (size > LFH_MAX_BLOCK_SIZE) return -1;
+
+    size--;
+    for (bit = 8; size >> (bit + 1); bit++) ;
+    return 16 + (bit - 8) * 8 + ((size >> (bit - 3)) & 7);
+}
+
+static inline SIZE_T lfh_get_class_size( unsigned int class )
+{
+    if (class < 16) return (class + 1) * 16;
+    class -= 16;
+    return (SIZE_T)(9 + class % 8) << (class / 8 + 5);
+}
+
+static inline SLIST_HEADER *lfh_get_list( struct lfh *lfh, unsigned int class )
+{
+    ULONG tid = HandleToULong( NtCurrentTeb()->ClientId.UniqueThread );
+    return &lfh->slots[class][(tid >> 2) % LFH_AFFINITY_SLOTS].list;
+}
+
+
+static inline char *lfh_get_first_block( const struct lfh_slab *slab )
+{
+    return (char *)slab + ((sizeof(*slab) + ALIGNMENT - 1) & ~(ALIGNMENT - 1));
+}
+
+/***********************************************************************
+ *           lfh_find_region
+ *
+ * Find the region entry of an address, allocating it if requested.
+ * Lookups don't need the heap lock, allocations do.
+ */
+static struct lfh_region *lfh_find_region( struct lfh *lfh, const void *addr, BOOL create )
+{
+    ULONG_PTR index = ((ULONG_PTR)addr >> LFH_REGION_SHIFT) + 1, current;
+    struct lfh_region *region;
+    unsigned int i;
+
+    for (i = 0; i < LFH_NB_REGIONS; i++)
+    {
+        region = &lfh->regions[(index + i) % LFH_NB_REGIONS];
+        current = *(volatile ULONG_PTR *)&region->index;
+        if (current == index) return region;
+        if (current) continue;
+        if (!create) return NULL;
+        region->index = index;
+        return region;
+    }
+    return NULL;
+}
+
+
+/***********************************************************************
+ *           lfh_get_block
+ *
+ * Return the LFH arena of a block, or NULL if it doesn't belong to the LFH.
+ * Nothing is read from the block before it is known to be inside a slab.
+ */
+static ARENA_LFH *lfh_get_block( const HEAP *heap, const void *ptr )
+{
+    const struct lfh_slab *slab;
+    const struct lfh_region *region;
+    const char *block;
+    unsigned int idx;
+    SIZE_T stride;
+
+    if (!heap->lfh || (ULONG_PTR)ptr % ALIGNMENT) return NULL;
+    slab = (const struct lfh_slab *)((ULONG_PTR)ptr & ~(ULONG_PTR)(LFH_SLAB_SIZE - 1));
+    if (!(region = lfh_find_region( heap->lfh, slab, FALSE ))) return NULL;
+    idx = ((ULONG_PTR)slab / LFH_SLAB_SIZE) % LFH_REGION_SLABS;
+    if (!(region->bits[idx / 32] & (1u << (idx % 32)))) return NULL;
+
+    /* the pointer must be the start of a block carved out of the slab */
+    block = (const char *)ptr - LFH_HEADER_SIZE;
+    stride = LFH_HEADER_SIZE + lfh_get_class_size( slab->class );
+    if (block < lfh_get_first_block( slab )) return NULL;
+    if ((block - lfh_get_first_block( slab )) % stride) return NULL;
+    if (block + stride > *(char * volatile *)&slab->next) return NULL;
+    return (ARENA_LFH *)ptr - 1;
+}
+
+static inline const struct lfh_slab *lfh_get_slab( const ARENA_LFH *arena )
+{
+    return (const struct lfh_slab *)((ULONG_PTR)arena & ~(ULONG_PTR)(LFH_SLAB_SIZE - 1));
+}
+
+
+/***********************************************************************
+ *           lfh_create_slab
+ *
+ * Caller must hold the heap lock.
+ */
+static struct lfh_slab *lfh_create_slab( HEAP *heap, unsigned int class )
+{
+    struct lfh_region *region;
+    struct lfh_slab *slab;
+    SIZE_T size = LFH_SLAB_SIZE;
+    void *addr = NULL;
+    unsigned int idx;
+
+    if (NtAllocateVirtualMemory( NtCurrentProcess(), &addr, 5, &size, MEM_COMMIT,
+                                 get_protection_type( heap->flags ) ))
+    {
+        WARN( "Could not allocate slab for heap %p\n", heap );
+        return NULL;
+    }
+    if ((ULONG_PTR)addr & (LFH_SLAB_SIZE - 1))
+    {
+        ERR( "slab %p is not aligned\n", addr );
+        size = 0;
+        NtFreeVirtualMemory( NtCurrentProcess(), &addr, &size, MEM_RELEASE );
+        return NULL;
+    }
+    if (!(region = lfh_find_region( heap->lfh, addr, TRUE )))
+    {
+        WARN( "no free region for slab %p in heap %p\n", addr, heap );
+        size = 0;
+        NtFreeVirtualMemory( NtCurrentProcess(), &addr, &size, MEM_RELEASE );
+        return NULL;
+    }
+
+    slab = addr;
+    slab->magic = LFH_SLAB_MAGIC;
+    slab->class = class;
+    slab->heap  = heap;
+    slab->next  = lfh_get_first_block( slab );
+    list_add_tail( &heap->lfh->slabs, &slab->entry );
+    idx = ((ULONG_PTR)slab / LFH_SLAB_SIZE) % LFH_REGION_SLABS;
+    interlocked_xchg( (int *)&region->bits[idx / 32], region->bits[idx / 32] | (1u << (idx % 32)) );
+    return slab;
+}
+
+
+/***********************************************************************
+ *           lfh_grow
+ *
+ * Carve a batch of blocks out of a slab, return the first one and put
+ * the others in the free list of the calling thread.
+ */
+static ARENA_LFH *lfh_grow( HEAP *heap, unsigned int class )
+{
+    struct lfh *lfh = heap->lfh;
+    SLIST_HEADER *list = lfh_get_list( lfh, class );
+    SIZE_T stride = LFH_HEADER_SIZE + lfh_get_class_size( class );
+    SLIST_ENTRY *entry, *first = NULL, *last = NULL;
+    struct lfh_slab *slab;
+    ARENA_LFH *arena, *ret = NULL;
+    char *ptr, *end;
+    ULONG count = 0;
+
+    RtlEnterCriticalSection( &heap->critSection );
+
+    /* another thread may have filled the list while we were waiting */
+    if ((entry = RtlInterlockedPopEntrySList( list )))
+    {
+        ret = (ARENA_LFH *)entry - 1;
+        goto done;
+    }
+
+    slab = lfh->current[class];
+    if (!slab || slab->next + stride > (char *)slab + LFH_SLAB_SIZE)
+    {
+        if (!(slab = lfh_create_slab( heap, class ))) goto done;
+        lfh->current[class] = slab;
+    }
+
+    end = min( slab->next + max( stride, LFH_GROW_SIZE ), (char *)slab + LFH_SLAB_SIZE );
+    for (ptr = slab->next; ptr + stride <= end; ptr += stride)
+    {
+        arena = (ARENA_LFH *)(ptr + LFH_HEADER_SIZE) - 1;
+        arena->size  = 0;
+        arena->magic = LFH_FREE_MAGIC;
+        if (!ret)
+        {
+            ret = arena;
+            continue;
+        }
+        entry = (SLIST_ENTRY *)(arena + 1);
+        entry->Next = NULL;
+        if (last) last->Next = entry;
+        else first = entry;
+        last = entry;
+        count++;
+    }
+    slab->next = ptr;
+    if (count) RtlInterlockedPushListSListEx( list, first, last, count );
+
+done:
+    RtlLeaveCriticalSection( &heap->critSection );
+    return ret;
+}
+
+
+/***********************************************************************
+ *           lfh_alloc
+ */
+static void *lfh_alloc( HEAP *heap, DWORD flags, SIZE_T size )
+{
+    struct lfh *lfh = heap->lfh;
+    SLIST_HEADER *list;
+    SLIST_ENTRY *entry;
+    ARENA_LFH *arena;
+    unsigned int i;
+    int class;
+
+    if ((class = lfh_get_class( size )) == -1) return NULL;
+
+    list = lfh_get_list( lfh, class );
+    if ((entry = RtlInterlockedPopEntrySList( list ))) arena = (ARENA_LFH *)entry - 1;
+    else
+    {
+        /* use up the blocks freed by threads of other slots before growing */
+        for (i = 0, entry = NULL; i < LFH_AFFINITY_SLOTS && !entry; i++)
+            entry = RtlInterlockedPopEntrySList( &lfh->slots[class][i].list );
+        if (entry) arena = (ARENA_LFH *)entry - 1;
+        else if (!(arena = lfh_grow( heap, class ))) return NULL;
+    }
+
+    arena->size  = size;
+    arena->magic = LFH_BLOCK_MAGIC;
+    notify_alloc( arena + 1, size, flags & HEAP_ZERO_MEMORY );
+    initialize_block( arena + 1, size, 0, flags );
+    return arena + 1;
+}
+
+
+/***********************************************************************
+ *           lfh_free
+ */
+static BOOL lfh_free( HEAP *heap, ARENA_LFH *arena )
+{
+    const struct lfh_slab *slab = lfh_get_slab( arena );
+
+    if (interlocked_cmpxchg( (int *)&arena->magic, LFH_FREE_MAGIC, LFH_BLOCK_MAGIC ) != LFH_BLOCK_MAGIC)
+    {
+        WARN( "Heap %p: block %p used after free\n", heap, arena + 1 );
+        return FALSE;
+    }
+    RtlInterlockedPushEntrySList( lfh_get_list( heap->lfh, slab->class ), (SLIST_ENTRY *)(arena + 1) );
+    return TRUE;
+}
+
+
+/***********************************************************************
+ *           lfh_realloc
+ */
+static void *lfh_realloc( HEAP *heap, DWORD flags, ARENA_LFH *arena, SIZE_T size )
+{
+    SIZE_T old_size = arena->size;
+    void *ret;
+
+    if (size <= lfh_get_class_size( lfh_get_slab( arena )->class ))
+    {
+        notify_realloc( arena + 1, old_size, size );
+        if (size > old_size)
+            initialize_block( (char *)(arena + 1) + old_size, size - old_size, 0, flags );
+        arena->size = size;
+        return arena + 1;
+    }
+    if (flags & HEAP_REALLOC_IN_PLACE_ONLY) return NULL;
+
+    if (!(ret = RtlAllocateHeap( heap, flags & (HEAP_NO_SERIALIZE | HEAP_ZERO_MEMORY), size )))
+        return NULL;
+    memcpy( ret, arena + 1, old_size );
+    notify_free( arena + 1 );
+    lfh_free( heap, arena );
+    return ret;
+}
+
+
+/***********************************************************************
+ *           lfh_walk
+ *
+ * Return the first carved block at or after ptr, moving on to the next
+ * slabs if needed. Start from the first slab if slab is NULL.
+ * Caller must hold the heap lock.
+ */
+static ARENA_LFH *lfh_walk( const HEAP *heap, const struct lfh_slab *slab, char *ptr )
+{
+    struct list *next;
+
+    if (!heap->lfh) return NULL;
+    if (!slab)
+    {
+        if (!(next = list_head( &heap->lfh->slabs ))) return NULL;
+        slab = LIST_ENTRY( next, struct lfh_slab, entry );
+        ptr = NULL;
+    }
+
+    for (;;)
+    {
+        SIZE_T stride = LFH_HEADER_SIZE + lfh_get_class_size( slab->class );
+
+        if (!ptr) ptr = lfh_get_first_block( slab ) + LFH_HEADER_SIZE;
+        if (ptr - LFH_HEADER_SIZE + stride <= slab->next) return (ARENA_LFH *)ptr - 1;
+        if (!(next = list_next( &heap->lfh->slabs, &slab->entry ))) return NULL;
+        slab = LIST_ENTRY( next, struct lfh_slab, entry );
+        ptr = NULL;
+    }
+}
+
+
+/***********************************************************************
+ *           lfh_destroy
+ *
+ * Release all the slabs of a heap being destroyed.
+ */
+static void lfh_destroy( HEAP *heap )
+{
+    struct lfh_slab *slab, *next;
+    SIZE_T size;
+    void *addr;
+
+    if (!heap->lfh) return;
+
+    LIST_FOR_EACH_ENTRY_SAFE( slab, next, &heap->lfh->slabs, struct lfh_slab, entry )
+    {
+        size = 0;
+        addr = slab;
+        NtFreeVirtualMemory( NtCurrentProcess(), &addr, &size, MEM_RELEASE );
+    }
+    size = 0;
+    addr = heap->lfh;
+    NtFreeVirtualMemory( NtCurrentProcess(), &addr, &size, MEM_RELEASE );
+    heap->lfh = NULL;
+}
+
+
+/***********************************************************************
+ *           lfh_enable
+ */
+static NTSTATUS lfh_enable( HEAP *heap )
+{
+    struct lfh *lfh;
+    SIZE_T size = sizeof(*lfh);
+    NTSTATUS status = STATUS_SUCCESS;
+    void *addr = NULL;
+    unsigned int i, j;
+
+    /* the front end doesn't support heap debugging, and can't be shared */
+    if (!(heap->flags & HEAP_GROWABLE) ||
+        (heap->flags & (HEAP_NO_SERIALIZE | HEAP_SHARED | HEAP_VALIDATE | HEAP_PAGE_ALLOCS |
+                        HEAP_TAIL_CHECKING_ENABLED | HEAP_FREE_CHECKING_ENABLED)))
+        return STATUS_UNSUCCESSFUL;
+
+    RtlEnterCriticalSection( &heap->critSection );
+    if (!heap->lfh)
+    {
+        if (!(status = NtAllocateVirtualMemory( NtCurrentProcess(), &addr, 5, &size,
+                                                MEM_COMMIT, PAGE_READWRITE )))
+        {
+            lfh = addr;
+            for (i = 0; i < LFH_NB_CLASSES; i++)
+                for (j = 0; j < LFH_AFFINITY_SLOTS; j++)
+                    RtlInitializeSListHead( &lfh->slots[i][j].list );
+            list_init( &lfh->slabs );
+            interlocked_xchg_ptr( (void **)&heap->lfh, lfh );
+            TRACE( "enabled low fragmentation heap for %p\n", heap );
+        }
+    }
+    RtlLeaveCriticalSection( &heap->critSection );
+    return status;
+}
+
+
 /***********************************************************************
  *           HEAP_CreateSubHeap
  */
@@ -924,6 +1363,7 @@ static SUBHEAP *HEAP_CreateSubHeap( HEAP *heap, LPVOID address, DWORD flags,
         heap->flags         = flags;
         heap->magic         = HEAP_MAGIC;
         heap->grow_size     = max( HEAP_DEF_SIZE, totalSize );
+        heap->lfh           = NULL;
         list_init( &heap->subheap_list );
         list_init( &heap->large_list );
 
@@ -1385,8 +1825,19 @@ static BOOL HEAP_IsRealArena( HEAP *heapPtr,   /* [in] ptr to the heap */
     if (block)  /* only check this single memory block */
     {
         const ARENA_INUSE *arena = (const ARENA_INUSE *)block - 1;
+        const ARENA_LFH *lfh_arena;
 
-        if (!(subheap = HEAP_FindSubHeap( heapPtr, arena )) ||
+        if ((lfh_arena = lfh_get_block( heapPtr, block )))
+        {
+            if (!(ret = (lfh_arena->magic == LFH_BLOCK_MAGIC)))
+            {
+                if (quiet == NOISY)
+                    ERR("Heap %p: block %p used after free\n", heapPtr, block );
+                else if (WARN_ON(heap))
+                    WARN("Heap %p: block %p used after free\n", heapPtr, block );
+            }
+        }
+        else if (!(subheap = HEAP_FindSubHeap( heapPtr, arena )) ||
             ((const char *)arena < (char *)subheap->base + subheap->headerSize))
         {
             if (!(large_arena = find_large_block( heapPtr, block )))
@@ -1656,6 +2107,8 @@ HANDLE WINAPI RtlDestroyHeap( HANDLE heap )
     heapPtr->critSection.DebugInfo->Spare[0] = 0;
     RtlDeleteCriticalSection( &heapPtr->critSection );
 
+    lfh_destroy( heapPtr );
+
     LIST_FOR_EACH_ENTRY_SAFE( arena, arena_next, &heapPtr->large_list, ARENA_LARGE, entry )
     {
         list_remove( &arena->entry );
@@ -1724,6 +2177,16 @@ PVOID WINAPI RtlAllocateHeap( HANDLE heap, ULONG flags, SIZE_T size )
     }
     if (rounded_size < HEAP_MIN_DATA_SIZE) rounded_size = HEAP_MIN_DATA_SIZE;
 
+    if (heapPtr->lfh && size <= LFH_MAX_BLOCK_SIZE)
+    {
+        void *ret = lfh_alloc( heapPtr, flags, size );
+        if (ret)
+        {
+            TRACE("(%p,%08x,%08lx): returning %p\n", heap, flags, size, ret );
+            return ret;
+        }
+    }
+
     if (!(flags & HEAP_NO_SERIALIZE)) RtlEnterCriticalSection( &heapPtr->critSection );
 
     if (rounded_size >= HEAP_MIN_LARGE_BLOCK_SIZE && (flags & HEAP_GROWABLE))
@@ -1791,6 +2254,7 @@ PVOID WINAPI RtlAllocateHeap( HANDLE heap, ULONG flags, SIZE_T size )
 BOOLEAN WINAPI RtlFreeHeap( HANDLE heap, ULONG flags, PVOID ptr )
 {
     ARENA_INUSE *pInUse;
+    ARENA_LFH *lfh_arena;
     SUBHEAP *subheap;
     HEAP *heapPtr;
 
@@ -1807,6 +2271,20 @@ BOOLEAN WINAPI RtlFreeHeap( HANDLE heap, ULONG flags, PVOID ptr )
 
     flags &= HEAP_NO_SERIALIZE;
     flags |= heapPtr->flags;
+
+    if ((lfh_arena = lfh_get_block( heapPtr, ptr )))
+    {
+        notify_free( ptr );
+        if (lfh_free( heapPtr, lfh_arena ))
+        {
+            TRACE("(%p,%08x,%p): returning TRUE\n", heap, flags, ptr );
+            return TRUE;
+        }
+        RtlSetLastWin32ErrorAndNtStatusFromNtStatus( STATUS_INVALID_PARAMETER );
+        TRACE("(%p,%08x,%p): returning FALSE\n", heap, flags, ptr );
+        return FALSE;
+    }
+
     if (!(flags & HEAP_NO_SERIALIZE)) RtlEnterCriticalSection( &heapPtr->critSection );
 
     /* Inform valgrind we are trying to free memory, so it can throw up an error message */
@@ -1851,6 +2329,7 @@ error:
 PVOID WINAPI RtlReAllocateHeap( HANDLE heap, ULONG flags, PVOID ptr, SIZE_T size )
 {
     ARENA_INUSE *pArena;
+    ARENA_LFH *lfh_arena;
     HEAP *heapPtr;
     SUBHEAP *subheap;
     SIZE_T oldBlockSize, oldActualSize, rounded_size;
@@ -1868,6 +2347,24 @@ PVOID WINAPI RtlReAllocateHeap( HANDLE heap, ULONG flags, PVOID ptr, SIZE_T size
     flags &= HEAP_GENERATE_EXCEPTIONS | HEAP_NO_SERIALIZE | HEAP_ZERO_MEMORY |
              HEAP_REALLOC_IN_PLACE_ONLY;
     flags |= heapPtr->flags;
+
+    if ((lfh_arena = lfh_get_block( heapPtr, ptr )))
+    {
+        if (lfh_arena->magic != LFH_BLOCK_MAGIC)
+        {
+            WARN( "Heap %p: block %p used after free\n", heapPtr, ptr );
+            RtlSetLastWin32ErrorAndNtStatusFromNtStatus( STATUS_INVALID_PARAMETER );
+            ret = NULL;
+        }
+        else if (!(ret = lfh_realloc( heapPtr, flags, lfh_arena, size )))
+        {
+            if (flags & HEAP_GENERATE_EXCEPTIONS) RtlRaiseStatus( STATUS_NO_MEMORY );
+            RtlSetLastWin32ErrorAndNtStatusFromNtStatus( STATUS_NO_MEMORY );
+        }
+        TRACE("(%p,%08x,%p,%08lx): returning %p\n", heap, flags, ptr, size, ret );
+        return ret;
+    }
+
     if (!(flags & HEAP_NO_SERIALIZE)) RtlEnterCriticalSection( &heapPtr->critSection );
 
     rounded_size = ROUND_SIZE(size) + HEAP_TAIL_EXTRA_SIZE(flags);
@@ -2067,6 +2564,7 @@ SIZE_T WINAPI RtlSizeHeap( HANDLE heap, ULONG flags, const void *ptr )
 {
     SIZE_T ret;
     const ARENA_INUSE *pArena;
+    const ARENA_LFH *lfh_arena;
     SUBHEAP *subheap;
     HEAP *heapPtr = HEAP_GetPtr( heap );
 
@@ -2077,6 +2575,19 @@ SIZE_T WINAPI RtlSizeHeap( HANDLE heap, ULONG flags, const void *ptr )
     }
     flags &= HEAP_NO_SERIALIZE;
     flags |= heapPtr->flags;
+
+    if ((lfh_arena = lfh_get_block( heapPtr, ptr )))
+    {
+        if (lfh_arena->magic == LFH_BLOCK_MAGIC) ret = lfh_arena->size;
+        else
+        {
+            RtlSetLastWin32ErrorAndNtStatusFromNtStatus( STATUS_INVALID_PARAMETER );
+            ret = ~0UL;
+        }
+        TRACE("(%p,%08x,%p): returning %08lx\n", heap, flags, ptr, ret );
+        return ret;
+    }
+
     if (!(flags & HEAP_NO_SERIALIZE)) RtlEnterCriticalSection( &heapPtr->critSection );
 
     pArena = (const ARENA_INUSE *)ptr - 1;
@@ -2135,6 +2646,7 @@ NTSTATUS WINAPI RtlWalkHeap( HANDLE heap, PVOID entry_ptr )
     LPPROCESS_HEAP_ENTRY entry = entry_ptr; /* FIXME */
     HEAP *heapPtr = HEAP_GetPtr(heap);
     SUBHEAP *sub, *currentheap = NULL;
+    ARENA_LFH *lfh_arena;
     NTSTATUS ret;
     char *ptr;
     int region_index = 0;
@@ -2153,6 +2665,20 @@ NTSTATUS WINAPI RtlWalkHeap( HANDLE heap, PVOID entry_ptr )
         currentheap = &heapPtr->subheap;
         ptr = (char*)currentheap->base + currentheap->headerSize;
     }
+    else if ((lfh_arena = lfh_get_block( heapPtr, entry->lpData )))
+    {
+        /* the low fragmentation heap blocks come after all the subheaps */
+        const struct lfh_slab *slab = lfh_get_slab( lfh_arena );
+
+        ptr = (char *)(lfh_arena + 1) + lfh_get_class_size( slab->class ) + LFH_HEADER_SIZE;
+        if (!(lfh_arena = lfh_walk( heapPtr, slab, ptr )))
+        {
+            TRACE("end reached.\n");
+            ret = STATUS_NO_MORE_ENTRIES;
+            goto HW_end;
+        }
+        goto lfh_entry;
+    }
     else
     {
         ptr = entry->lpData;
@@ -2190,6 +2716,7 @@ NTSTATUS WINAPI RtlWalkHeap( HANDLE heap, PVOID entry_ptr )
         if (ptr > (char *)currentheap->base + currentheap->size - 1)
         {   /* proceed with next subheap */
             struct list *next = list_next( &heapPtr->subheap_list, &currentheap->entry );
+            if (!next && (lfh_arena = lfh_walk( heapPtr, NULL, NULL ))) goto lfh_entry;
             if (!next)
             {  /* successfully finished */
                 TRACE("end reached.\n");
@@ -2244,6 +2771,24 @@ NTSTATUS WINAPI RtlWalkHeap( HANDLE heap, PVOID entry_ptr )
     }
     ret = STATUS_SUCCESS;
     if (TRACE_ON(heap)) HEAP_DumpEntry(entry);
+    goto HW_end;
+
+lfh_entry:
+    entry->lpData = lfh_arena + 1;
+    entry->cbOverhead = LFH_HEADER_SIZE;
+    entry->iRegionIndex = 0;
+    if (lfh_arena->magic == LFH_BLOCK_MAGIC)
+    {
+        entry->cbData = lfh_arena->size;
+        entry->wFlags = PROCESS_HEAP_ENTRY_BUSY;
+    }
+    else
+    {
+        entry->cbData = lfh_get_class_size( lfh_get_slab( lfh_arena )->class );
+        entry->wFlags = 0;
+    }
+    ret = STATUS_SUCCESS;
+    if (TRACE_ON(heap)) HEAP_DumpEntry(entry);
 
 HW_end:
     if (!(heapPtr->flags & HEAP_NO_SERIALIZE)) RtlLeaveCriticalSection( &heapPtr->critSection );
@@ -2287,6 +2832,8 @@ ULONG WINAPI RtlGetProcessHeaps( ULONG count, HANDLE *heaps )
 NTSTATUS WINAPI RtlQueryHeapInformation( HANDLE heap, HEAP_INFORMATION_CLASS info_class,
                                          PVOID info, SIZE_T size_in, PSIZE_T size_out)
 {
+    HEAP *heapPtr;
+
     switch (info_class)
     {
     case HeapCompatibilityInformation:
@@ -2295,7 +2842,8 @@ NTSTATUS WINAPI RtlQueryHeapInformation( HANDLE heap, HEAP_INFORMATION_CLASS inf
         if (size_in < sizeof(ULONG))
             return STATUS_BUFFER_TOO_SMALL;
 
-        *(ULONG *)info = 0; /* standard heap */
+        if (!(heapPtr = HEAP_GetPtr( heap ))) return STATUS_INVALID_HANDLE;
+        *(ULONG *)info = heapPtr->lfh ? 2 /* low fragmentation heap */ : 0 /* standard heap */;
         return STATUS_SUCCESS;
 
     default:
@@ -2309,6 +2857,29 @@ NTSTATUS WINAPI RtlQueryHeapInformation( HANDLE heap, HEAP_INFORMATION_CLASS inf
  */
 NTSTATUS WINAPI RtlSetHeapInformation( HANDLE heap, HEAP_INFORMATION_CLASS info_class, PVOID info, SIZE_T size)
 {
-    FIXME("%p %d %p %ld stub\n", heap, info_class, info, size);
-    return STATUS_SUCCESS;
+    HEAP *heapPtr;
+
+    switch (info_class)
+    {
+    case HeapCompatibilityInformation:
+        if (size < sizeof(ULONG)) return STATUS_BUFFER_TOO_SMALL;
+        if (!(heapPtr = HEAP_GetPtr( heap ))) return STATUS_INVALID_HANDLE;
+
+        switch (*(ULONG *)info)
+        {
+        case 0:  /* standard heap, the front end can't be disabled again */
+            return heapPtr->lfh ? STATUS_UNSUCCESSFUL : STATUS_SUCCESS;
+        case 1:  /* look-aside lists */
+            FIXME("%p: look-aside lists not supported\n", heap);
+            return STATUS_SUCCESS;
+        case 2:  /* low fragmentation heap */
+            return lfh_enable( heapPtr );
+        default:
+            return STATUS_INVALID_PARAMETER;
+        }
+
+    default:
+        FIXME("%p %d %p %ld stub\n", heap, info_class, info, size);
+        return STATUS_SUCCESS;
+    }
 }
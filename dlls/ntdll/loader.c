@@ -137,6 +137,39 @@ static WINE_MODREF *cached_modref;
 static WINE_MODREF *current_modref;
 static WINE_MODREF *last_failed_modref;
 
+/* cache of resolved forwarded exports, keyed by the address of the forward
+ * string inside the exporting image; protected by the loader_section */
+struct forward_cache_entry
+{
+    const char *forward;
+    FARPROC     proc;
+};
+
+static struct forward_cache_entry *forward_cache;
+static unsigned int forward_cache_size;
+static unsigned int forward_cache_count;
+
+#define MIN_FORWARD_CACHE_SIZE 256
+
+/* per-module hash of export names, built the first time a named lookup
+ * misses its hint; the module map can be read under export_hash_lock alone,
+ * it is only modified with both that lock and the loader_section held */
+struct export_hash
+{
+    HMODULE                       module;
+    const IMAGE_EXPORT_DIRECTORY *exports;
+    DWORD                         exp_size;
+    unsigned int                  size;      /* power of two */
+    DWORD                         index[1];  /* name index + 1, 0 if free */
+};
+
+static struct export_hash **export_hash_map;
+static unsigned int export_hash_map_size;
+static unsigned int export_hash_map_count;
+static RTL_SRWLOCK export_hash_lock = RTL_SRWLOCK_INIT;
+
+#define MIN_EXPORT_HASH_MAP_SIZE 32
+
 static NTSTATUS load_dll( LPCWSTR load_path, LPCWSTR libname, LPCWSTR fakemodule,
                           DWORD flags, WINE_MODREF** pwm );
 static NTSTATUS process_attach( WINE_MODREF *wm, LPVOID lpReserved );
@@ -551,6 +584,91 @@ static WINE_MODREF *find_fullname_module( LPCWSTR name )
 }
 
 
+/*************************************************************************
+ *		forward_cache_hash
+ */
+static inline unsigned int forward_cache_hash( const char *forward )
+{
+    ULONG_PTR ptr = (ULONG_PTR)forward;
+    return (unsigned int)((ptr >> 2) ^ (ptr >> 13)) * 0x9e3779b1;
+}
+
+
+/*************************************************************************
+ *		forward_cache_get
+ *
+ * Look up a previously resolved forward.
+ * The loader_section must be locked while calling this function.
+ */
+static FARPROC forward_cache_get( const char *forward )
+{
+    unsigned int i;
+
+    if (!forward_cache_count) return NULL;
+    for (i = forward_cache_hash( forward ) & (forward_cache_size - 1);
+         forward_cache[i].forward;
+         i = (i + 1) & (forward_cache_size - 1))
+        if (forward_cache[i].forward == forward) return forward_cache[i].proc;
+    return NULL;
+}
+
+
+/*************************************************************************
+ *		forward_cache_put
+ *
+ * Remember the resolved address of a forward.
+ * The loader_section must be locked while calling this function.
+ */
+static void forward_cache_put( const char *forward, FARPROC proc )
+{
+    unsigned int i;
+
+    if ((forward_cache_count + 1) * 2 > forward_cache_size)
+    {
+        struct forward_cache_entry *new_cache, *old_cache = forward_cache;
+        unsigned int j, old_size = forward_cache_size;
+        unsigned int new_size = max( MIN_FORWARD_CACHE_SIZE, old_size * 2 );
+
+        if (!(new_cache = RtlAllocateHeap( GetProcessHeap(), HEAP_ZERO_MEMORY,
+                                           new_size * sizeof(*new_cache) )))
+            return;
+        forward_cache = new_cache;
+        forward_cache_size = new_size;
+        for (j = 0; j < old_size; j++)
+        {
+            if (!old_cache[j].forward) continue;
+            for (i = forward_cache_hash( old_cache[j].forward ) & (new_size - 1);
+                 new_cache[i].forward;
+                 i = (i + 1) & (new_size - 1)) /* nothing */;
+            new_cache[i] = old_cache[j];
+        }
+        RtlFreeHeap( GetProcessHeap(), 0, old_cache );
+    }
+
+    for (i = forward_cache_hash( forward ) & (forward_cache_size - 1);
+         forward_cache[i].forward;
+         i = (i + 1) & (forward_cache_size - 1))
+        if (forward_cache[i].forward == forward) return;
+    forward_cache[i].forward = forward;
+    forward_cache[i].proc = proc;
+    forward_cache_count++;
+}
+
+
+/*************************************************************************
+ *		forward_cache_clear
+ *
+ * Forget all resolved forwards, called when a module is unloaded.
+ * The loader_section must be locked while calling this function.
+ */
+static void forward_cache_clear(void)
+{
+    if (!forward_cache_count) return;
+    memset( forward_cache, 0, forward_cache_size * sizeof(*forward_cache) );
+    forward_cache_count = 0;
+}
+
+
 /*************************************************************************
  *		find_forwarded_export
  *
@@ -565,6 +683,10 @@ static FARPROC find_forwarded_export( HMODULE module, const char *forward, LPCWS
     WCHAR mod_name[32];
     const char *end = strrchr(forward, '.');
     FARPROC proc = NULL;
+    /* relay and snoop thunks depend on the importing module */
+    BOOL use_cache = !TRACE_ON(relay) && !TRACE_ON(snoop);
+
+    if (use_cache && (proc = forward_cache_get( forward ))) return proc;
 
     if (!end) return NULL;
     if ((end - forward) * sizeof(WCHAR) >= sizeof(mod_name)) return NULL;
@@ -626,6 +748,7 @@ static FARPROC find_forwarded_export( HMODULE module, const char *forward, LPCWS
             forward, debugstr_w(get_modref(module)->ldr.FullDllName.Buffer),
             debugstr_w(get_modref(module)->ldr.BaseDllName.Buffer) );
     }
+    else if (use_cache) forward_cache_put( forward, proc );
     return proc;
 }
 
@@ -671,6 +794,172 @@ static FARPROC find_ordinal_export( HMODULE module, const IMAGE_EXPORT_DIRECTORY
 }
 
 
+/*************************************************************************
+ *		hash_export_name
+ */
+static inline unsigned int hash_export_name( const char *name )
+{
+    unsigned int hash = 2166136261u;
+    while (*name) hash = (hash ^ (unsigned char)*name++) * 16777619;
+    return hash;
+}
+
+
+/*************************************************************************
+ *		hash_module
+ */
+static inline unsigned int hash_module( HMODULE module )
+{
+    return (unsigned int)((ULONG_PTR)module >> 16) * 0x9e3779b1;
+}
+
+
+/*************************************************************************
+ *		get_export_hash
+ *
+ * Find the export hash of a module.
+ * Either the loader_section or the export_hash_lock must be held.
+ */
+static struct export_hash *get_export_hash( HMODULE module )
+{
+    unsigned int i;
+
+    if (!export_hash_map_count) return NULL;
+    for (i = hash_module( module ) & (export_hash_map_size - 1);
+         export_hash_map[i];
+         i = (i + 1) & (export_hash_map_size - 1))
+        if (export_hash_map[i]->module == module) return export_hash_map[i];
+    return NULL;
+}
+
+
+/*************************************************************************
+ *		lookup_export_hash
+ *
+ * Find the index of a name in the export names table, or -1.
+ */
+static int lookup_export_hash( const struct export_hash *hash, const char *name )
+{
+    const DWORD *names = get_rva( hash->module, hash->exports->AddressOfNames );
+    unsigned int i;
+
+    for (i = hash_export_name( name ) & (hash->size - 1);
+         hash->index[i];
+         i = (i + 1) & (hash->size - 1))
+    {
+        if (!strcmp( get_rva( hash->module, names[hash->index[i] - 1] ), name ))
+            return hash->index[i] - 1;
+    }
+    return -1;
+}
+
+
+/*************************************************************************
+ *		create_export_hash
+ *
+ * Build the export hash of a module and add it to the module map.
+ * The loader_section must be locked while calling this function.
+ */
+static struct export_hash *create_export_hash( HMODULE module, const IMAGE_EXPORT_DIRECTORY *exports,
+                                               DWORD exp_size )
+{
+    const DWORD *names = get_rva( module, exports->AddressOfNames );
+    struct export_hash *hash, **new_map = NULL;
+    unsigned int i, j, size, new_map_size = 0;
+
+    for (size = 16; size < exports->NumberOfNames * 2; size *= 2) /* nothing */;
+    if (!(hash = RtlAllocateHeap( GetProcessHeap(), HEAP_ZERO_MEMORY,
+                                  FIELD_OFFSET( struct export_hash, index[size] ))))
+        return NULL;
+    hash->module   = module;
+    hash->exports  = exports;
+    hash->exp_size = exp_size;
+    hash->size     = size;
+    for (j = 0; j < exports->NumberOfNames; j++)
+    {
+        for (i = hash_export_name( get_rva( module, names[j] )) & (size - 1);
+             hash->index[i];
+             i = (i + 1) & (size - 1)) /* nothing */;
+        hash->index[i] = j + 1;
+    }
+
+    if ((export_hash_map_count + 1) * 2 > export_hash_map_size)
+    {
+        new_map_size = max( MIN_EXPORT_HASH_MAP_SIZE, export_hash_map_size * 2 );
+        if (!(new_map = RtlAllocateHeap( GetProcessHeap(), HEAP_ZERO_MEMORY,
+                                         new_map_size * sizeof(*new_map) )))
+        {
+            RtlFreeHeap( GetProcessHeap(), 0, hash );
+            return NULL;
+        }
+    }
+
+    RtlAcquireSRWLockExclusive( &export_hash_lock );
+    if (new_map)
+    {
+        for (j = 0; j < export_hash_map_size; j++)
+        {
+            if (!export_hash_map[j]) continue;
+            for (i = hash_module( export_hash_map[j]->module ) & (new_map_size - 1);
+                 new_map[i];
+                 i = (i + 1) & (new_map_size - 1)) /* nothing */;
+            new_map[i] = export_hash_map[j];
+        }
+        RtlFreeHeap( GetProcessHeap(), 0, export_hash_map );
+        export_hash_map = new_map;
+        export_hash_map_size = new_map_size;
+    }
+    for (i = hash_module( module ) & (export_hash_map_size - 1);
+         export_hash_map[i];
+         i = (i + 1) & (export_hash_map_size - 1)) /* nothing */;
+    export_hash_map[i] = hash;
+    export_hash_map_count++;
+    RtlReleaseSRWLockExclusive( &export_hash_lock );
+    return hash;
+}
+
+
+/*************************************************************************
+ *		free_export_hash
+ *
+ * Remove a module from the export hash map before it is unloaded.
+ * The loader_section must be locked while calling this function.
+ */
+static void free_export_hash( HMODULE module )
+{
+    struct export_hash *hash = NULL;
+    unsigned int i, j, k, mask = export_hash_map_size - 1;
+
+    if (!export_hash_map_count) return;
+
+    RtlAcquireSRWLockExclusive( &export_hash_lock );
+    for (i = hash_module( module ) & mask; export_hash_map[i]; i = (i + 1) & mask)
+    {
+        if (export_hash_map[i]->module != module) continue;
+        hash = export_hash_map[i];
+        break;
+    }
+    if (hash)
+    {
+        /* backward shift deletion to keep the probe sequences intact */
+        export_hash_map[i] = NULL;
+        for (j = (i + 1) & mask; export_hash_map[j]; j = (j + 1) & mask)
+        {
+            k = hash_module( export_hash_map[j]->module ) & mask;
+            if ((j > i && (k <= i || k > j)) || (j < i && (k <= i && k > j)))
+            {
+                export_hash_map[i] = export_hash_map[j];
+                export_hash_map[j] = NULL;
+                i = j;
+            }
+        }
+        export_hash_map_count--;
+    }
+    RtlReleaseSRWLockExclusive( &export_hash_lock );
+    RtlFreeHeap( GetProcessHeap(), 0, hash );
+}
+
+
 /*************************************************************************
  *		find_named_export
  *
@@ -682,6 +971,7 @@ static FARPROC find_named_export( HMODULE module, const IMAGE_EXPORT_DIRECTORY *
 {
     const WORD *ordinals = get_rva( module, exports->AddressOfNameOrdinals );
     const DWORD *names = get_rva( module, exports->AddressOfNames );
+    struct export_hash *hash;
     int min = 0, max = exports->NumberOfNames - 1;
 
     /* first check the hint */
@@ -692,7 +982,16 @@ static FARPROC find_named_export( HMODULE module, const IMAGE_EXPORT_DIRECTORY *
             return find_ordinal_export( module, exports, exp_size, ordinals[hint], load_path );
     }
 
-    /* then do a binary search */
+    /* then the export hash, if the module has enough exports to bother */
+    if (exports->NumberOfNames >= 64 &&
+        ((hash = get_export_hash( module )) || (hash = create_export_hash( module, exports, exp_size ))))
+    {
+        int pos = lookup_export_hash( hash, name );
+        if (pos == -1) return NULL;
+        return find_ordinal_export( module, exports, exp_size, ordinals[pos], load_path );
+    }
+
+    /* otherwise do a binary search */
     while (min <= max)
     {
         int res, pos = (min + max) / 2;
@@ -1757,6 +2056,50 @@ static BOOL is_hidden_export( void *proc )
 }
 
 
+/******************************************************************
+ *		find_hashed_export
+ *
+ * Lookup of an export that doesn't need the loader_section, for modules
+ * that already have an export hash. Forwards and relay or snoop thunks
+ * are left to the full lookup.
+ */
+static BOOL find_hashed_export( HMODULE module, const ANSI_STRING *name, ULONG ord, void **address )
+{
+    const struct export_hash *hash;
+    BOOL ret = FALSE;
+
+    if (TRACE_ON(relay) || TRACE_ON(snoop)) return FALSE;
+
+    RtlAcquireSRWLockShared( &export_hash_lock );
+    if ((hash = get_export_hash( module )))
+    {
+        const IMAGE_EXPORT_DIRECTORY *exports = hash->exports;
+        const DWORD *functions = get_rva( module, exports->AddressOfFunctions );
+        DWORD ordinal = ord - exports->Base;
+        const char *proc;
+
+        if (name)
+        {
+            const WORD *ordinals = get_rva( module, exports->AddressOfNameOrdinals );
+            int pos = lookup_export_hash( hash, name->Buffer );
+            ordinal = pos == -1 ? exports->NumberOfFunctions : ordinals[pos];
+        }
+        if (ordinal < exports->NumberOfFunctions && functions[ordinal])
+        {
+            proc = get_rva( module, functions[ordinal] );
+            if ((proc < (const char *)exports || proc >= (const char *)exports + hash->exp_size) &&
+                !is_hidden_export( (void *)proc ))
+            {
+                *address = (void *)proc;
+                ret = TRUE;
+            }
+        }
+    }
+    RtlReleaseSRWLockShared( &export_hash_lock );
+    return ret;
+}
+
+
 /******************************************************************
  *		LdrGetProcedureAddress  (NTDLL.@)
  */
@@ -1767,6 +2110,8 @@ NTSTATUS WINAPI LdrGetProcedureAddress(HMODULE module, const ANSI_STRING *name,
     DWORD exp_size;
     NTSTATUS ret = STATUS_PROCEDURE_NOT_FOUND;
 
+    if (find_hashed_export( module, name, ord, address )) return STATUS_SUCCESS;
+
     RtlEnterCriticalSection( &loader_section );
 
     /* check if the module itself is invalid to return the proper error */
@@ -3276,6 +3621,8 @@ static void free_modref( WINE_MODREF *wm )
     if (wm->ldr.InInitializationOrderModuleList.Flink)
         RemoveEntryList(&wm->ldr.InInitializationOrderModuleList);
 
+    free_export_hash( wm->ldr.BaseAddress );
+
     TRACE(" unloading %s\n", debugstr_w(wm->ldr.FullDllName.Buffer));
     if (!TRACE_ON(module))
         TRACE_(loaddll)("Unloaded module %s : %s\n",
@@ -3294,6 +3641,7 @@ static void free_modref( WINE_MODREF *wm )
     if (wm->ldr.Flags & LDR_WINE_INTERNAL) wine_dll_unload( wm->ldr.SectionHandle );
     NtUnmapViewOfSection( NtCurrentProcess(), wm->ldr.BaseAddress );
     if (cached_modref == wm) cached_modref = NULL;
+    forward_cache_clear();
     RtlFreeUnicodeString( &wm->ldr.FullDllName );
     RtlFreeHeap( GetProcessHeap(), 0, wm->deps );
     RtlFreeHeap( GetProcessHeap(), 0, wm );
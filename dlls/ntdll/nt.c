@@ -1296,6 +1296,29 @@ void fill_cpu_info(void)
           cached_sci.Architecture, cached_sci.Level, cached_sci.Revision, cached_sci.FeatureSet);
 }
 
+/******************************************************************
+ *		have_invariant_tsc
+ *
+ * Check whether the time stamp counter runs at a constant rate in all
+ * ACPI power states, so that it can be used as a clock.
+ */
+BOOL have_invariant_tsc(void)
+{
+#if defined(__i386__) || defined(__x86_64__)
+    unsigned int regs[4];
+
+    if (!have_cpuid()) return FALSE;
+    do_cpuid(0x00000001, regs);
+    if (!((regs[3] >> 4) & 1)) return FALSE;  /* no rdtsc */
+    do_cpuid(0x80000000, regs);
+    if (regs[0] < 0x80000007) return FALSE;
+    do_cpuid(0x80000007, regs);
+    return (regs[3] >> 8) & 1;
+#else
+    return FALSE;
+#endif
+}
+
 static BOOL grow_logical_proc_buf(SYSTEM_LOGICAL_PROCESSOR_INFORMATION **pdata,
         SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX **pdataex, DWORD *max_len)
 {
@@ -76,6 +76,7 @@ extern void actctx_init(void) DECLSPEC_HIDDEN;
 extern void virtual_init(void) DECLSPEC_HIDDEN;
 extern void virtual_init_threading(void) DECLSPEC_HIDDEN;
 extern void fill_cpu_info(void) DECLSPEC_HIDDEN;
+extern BOOL have_invariant_tsc(void) DECLSPEC_HIDDEN;
 
 /* heap routines */
 extern void *grow_virtual_heap( HANDLE handle, SIZE_T *size ) DECLSPEC_HIDDEN;
@@ -105,6 +106,20 @@ extern NTSTATUS alloc_object_attributes( const OBJECT_ATTRIBUTES *attr, struct o
                                          data_size_t *ret_len ) DECLSPEC_HIDDEN;
 extern NTSTATUS validate_open_object_attributes( const OBJECT_ATTRIBUTES *attr ) DECLSPEC_HIDDEN;
 extern void *server_get_shared_memory( HANDLE thread ) DECLSPEC_HIDDEN;
+extern NTSTATUS server_get_esync_fd( HANDLE handle, enum esync_type *type, unsigned int *shm_idx,
+                                     unsigned int *access, int *unix_fd ) DECLSPEC_HIDDEN;
+
+/* esync support */
+extern int do_esync(void) DECLSPEC_HIDDEN;
+extern void esync_close( HANDLE handle ) DECLSPEC_HIDDEN;
+extern NTSTATUS esync_set_event( HANDLE handle ) DECLSPEC_HIDDEN;
+extern NTSTATUS esync_reset_event( HANDLE handle ) DECLSPEC_HIDDEN;
+extern NTSTATUS esync_release_semaphore( HANDLE handle, ULONG count, ULONG *prev ) DECLSPEC_HIDDEN;
+extern NTSTATUS esync_release_mutex( HANDLE handle, LONG *prev ) DECLSPEC_HIDDEN;
+extern NTSTATUS esync_wait_objects( DWORD count, const HANDLE *handles, BOOLEAN wait_any,
+                                    BOOLEAN alertable, const LARGE_INTEGER *timeout ) DECLSPEC_HIDDEN;
+extern NTSTATUS esync_signal_and_wait( HANDLE signal, HANDLE wait, BOOLEAN alertable,
+                                       const LARGE_INTEGER *timeout ) DECLSPEC_HIDDEN;
 
 /* module handling */
 extern LIST_ENTRY tls_links DECLSPEC_HIDDEN;
@@ -152,6 +167,10 @@ extern NTSTATUS COMM_FlushBuffersFile( int fd ) DECLSPEC_HIDDEN;
 /* file I/O */
 struct stat;
 extern NTSTATUS FILE_GetNtStatus(void) DECLSPEC_HIDDEN;
+extern NTSTATUS uring_read_write( BOOL is_write, HANDLE handle, int unix_fd, HANDLE event,
+                                  PIO_APC_ROUTINE apc, void *apc_user, IO_STATUS_BLOCK *iosb,
+                                  void *buffer, ULONG length, ULONGLONG offset, ULONG_PTR cvalue ) DECLSPEC_HIDDEN;
+extern NTSTATUS uring_flush( int unix_fd ) DECLSPEC_HIDDEN;
 extern int get_file_info( const char *path, struct stat *st, ULONG *attr ) DECLSPEC_HIDDEN;
 extern NTSTATUS fill_file_info( const struct stat *st, ULONG attr, void *ptr,
                                 FILE_INFORMATION_CLASS class ) DECLSPEC_HIDDEN;
@@ -186,6 +205,18 @@ extern struct _KUSER_SHARED_DATA *user_shared_data_external DECLSPEC_HIDDEN;
 extern void create_user_shared_data_thread(void) DECLSPEC_HIDDEN;
 extern BYTE* CDECL __wine_user_shared_data(void);
 
+/* threadpool */
+extern void tp_worker_block_begin( const LARGE_INTEGER *timeout ) DECLSPEC_HIDDEN;
+extern void tp_worker_block_end( const LARGE_INTEGER *timeout ) DECLSPEC_HIDDEN;
+
+/* registry */
+extern void reg_cache_close_handle( HANDLE handle ) DECLSPEC_HIDDEN;
+
+/* handles */
+extern int deferred_close_count DECLSPEC_HIDDEN;
+extern void allow_deferred_close( HANDLE handle ) DECLSPEC_HIDDEN;
+extern void flush_deferred_close(void) DECLSPEC_HIDDEN;
+
 /* completion */
 extern NTSTATUS NTDLL_AddCompletion( HANDLE hFile, ULONG_PTR CompletionValue,
                                      NTSTATUS CompletionStatus, ULONG Information ) DECLSPEC_HIDDEN;
@@ -251,6 +282,8 @@ struct ntdll_thread_data
     void              *exit_frame;    /* 204 exit frame pointer */
 #endif
     void              *pthread_stack; /* 208/318 pthread stack */
+    request_shm_t     *request_shm;   /* 20c/350 shared memory block for server requests */
+    struct threadpool_worker *tp_worker; /* 210/358 threadpool worker running on this thread */
 };
 
 C_ASSERT( FIELD_OFFSET(TEB, SpareBytes1) + sizeof(struct ntdll_thread_data) <=
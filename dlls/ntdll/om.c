@@ -20,6 +20,7 @@
  */
 
 #include "config.h"
+#include "wine/port.h"
 
 #include <stdarg.h>
 #include <stdlib.h>
@@ -43,6 +44,127 @@
 
 WINE_DEFAULT_DEBUG_CHANNEL(ntdll);
 
+/*
+ * Deferred close of handles
+ *
+ * Closing a handle to an unnamed event or semaphore has no effect that is
+ * visible outside of the handle table, so such closes are queued and sent in
+ * a single close_handles request before the next server call made by any
+ * thread of the process. Handles are only queued if they are known to be
+ * such objects, which is recorded when they are created. The server keeps
+ * the value of such a handle reserved when another process closes it, so
+ * that it can't be reused for a different object while it is marked here.
+ */
+
+#define MAX_DEFERRED_HANDLES 65536  /* highest handle index tracked */
+#define MAX_DEFERRED_CLOSE   64     /* max. number of queued closes */
+
+static int deferred_close_enabled = -1;
+static int deferred_handles[MAX_DEFERRED_HANDLES / 32];
+
+/* queued closes, locked via deferred_close_section */
+static obj_handle_t deferred_close_queue[MAX_DEFERRED_CLOSE];
+static BOOL deferred_close_flushing;
+int deferred_close_count = 0;
+
+static RTL_CRITICAL_SECTION deferred_close_section;
+static RTL_CRITICAL_SECTION_DEBUG deferred_close_debug =
+{
+    0, 0, &deferred_close_section,
+    { &deferred_close_debug.ProcessLocksList, &deferred_close_debug.ProcessLocksList },
+      0, 0, { (DWORD_PTR)(__FILE__ ": deferred_close_section") }
+};
+static RTL_CRITICAL_SECTION deferred_close_section = { &deferred_close_debug, -1, 0, 0, 0, 0 };
+
+static int use_deferred_close(void)
+{
+    if (deferred_close_enabled == -1)
+    {
+        const char *str = getenv( "WINEDEFERCLOSE" );
+        deferred_close_enabled = str && atoi( str );
+    }
+    return deferred_close_enabled;
+}
+
+static inline unsigned int deferred_handle_index( HANDLE handle )
+{
+    return (ULONG_PTR)handle >> 2;
+}
+
+/* set or clear the deferrable flag of a handle, returns the previous state */
+static BOOL set_deferrable_handle( HANDLE handle, BOOL set )
+{
+    unsigned int idx = deferred_handle_index( handle );
+    int *word, old, mask;
+
+    if (idx >= MAX_DEFERRED_HANDLES) return FALSE;
+    word = &deferred_handles[idx / 32];
+    mask = 1 << (idx % 32);
+    do
+    {
+        old = *word;
+        if (!(old & mask) == !set) return set;
+    } while (interlocked_cmpxchg( word, set ? (old | mask) : (old & ~mask), old ) != old);
+    return !set;
+}
+
+/***********************************************************************
+ *           allow_deferred_close
+ *
+ * Mark a newly created handle to an unnamed event or semaphore.
+ */
+void allow_deferred_close( HANDLE handle )
+{
+    if (use_deferred_close()) set_deferrable_handle( handle, TRUE );
+}
+
+/***********************************************************************
+ *           flush_deferred_close
+ *
+ * Close the handles queued by all threads. Called before every server
+ * request, so other threads wait until the handles are really closed.
+ */
+void flush_deferred_close(void)
+{
+    sigset_t sigset;
+
+    server_enter_uninterrupted_section( &deferred_close_section, &sigset );
+    /* the close_handles request comes back here through wine_server_call */
+    if (deferred_close_count && !deferred_close_flushing)
+    {
+        deferred_close_flushing = TRUE;
+        SERVER_START_REQ( close_handles )
+        {
+            wine_server_add_data( req, deferred_close_queue, deferred_close_count * sizeof(deferred_close_queue[0]) );
+            wine_server_call( req );
+        }
+        SERVER_END_REQ;
+        deferred_close_count = 0;
+        deferred_close_flushing = FALSE;
+    }
+    server_leave_uninterrupted_section( &deferred_close_section, &sigset );
+}
+
+/* queue the close of a deferrable handle, returns FALSE if it must be closed now */
+static BOOL defer_close( HANDLE handle )
+{
+    sigset_t sigset;
+    int fd;
+
+    if (!set_deferrable_handle( handle, FALSE )) return FALSE;
+
+    fd = server_remove_fd_from_cache( handle );
+    if (fd != -1) close( fd );
+    esync_close( handle );
+    reg_cache_close_handle( handle );
+
+    server_enter_uninterrupted_section( &deferred_close_section, &sigset );
+    if (deferred_close_count == MAX_DEFERRED_CLOSE) flush_deferred_close();
+    deferred_close_queue[deferred_close_count++] = wine_server_obj_handle( handle );
+    server_leave_uninterrupted_section( &deferred_close_section, &sigset );
+    return TRUE;
+}
+
 #define ROUND_UP(value, alignment) (((value) + ((alignment) - 1)) & ~((alignment)-1))
 
 /*
@@ -296,6 +418,8 @@ NTSTATUS WINAPI NtSetInformationObject(IN HANDLE handle,
             OBJECT_DATA_INFORMATION* p = ptr;
 
             if (len < sizeof(*p)) return STATUS_INVALID_BUFFER_SIZE;
+            /* protected handles must fail to close */
+            if (p->ProtectFromClose) set_deferrable_handle( handle, FALSE );
 
             SERVER_START_REQ( set_handle_info )
             {
@@ -430,6 +554,9 @@ NTSTATUS WINAPI NtDuplicateObject( HANDLE source_process, HANDLE source,
             {
                 int fd = server_remove_fd_from_cache( source );
                 if (fd != -1) close( fd );
+                set_deferrable_handle( source, FALSE );
+                esync_close( source );
+                reg_cache_close_handle( source );
             }
         }
     }
@@ -448,7 +575,11 @@ static LONG WINAPI invalid_handle_exception_handler( EXCEPTION_POINTERS *eptr )
 NTSTATUS close_handle( HANDLE handle )
 {
     NTSTATUS ret;
-    int fd = server_remove_fd_from_cache( handle );
+    int fd;
+
+    if (defer_close( handle )) return STATUS_SUCCESS;
+
+    fd = server_remove_fd_from_cache( handle );
 
     SERVER_START_REQ( close_handle )
     {
@@ -457,6 +588,8 @@ NTSTATUS close_handle( HANDLE handle )
     }
     SERVER_END_REQ;
     if (fd != -1) close( fd );
+    esync_close( handle );
+    reg_cache_close_handle( handle );
 
     if (ret == STATUS_INVALID_HANDLE && NtCurrentTeb()->Peb->BeingDebugged)
     {
@@ -38,13 +38,195 @@
 #include "wine/library.h"
 #include "ntdll_misc.h"
 #include "wine/debug.h"
+#include "wine/list.h"
 #include "wine/unicode.h"
 
 WINE_DEFAULT_DEBUG_CHANNEL(reg);
+WINE_DECLARE_DEBUG_CHANNEL(regstats);
 
 /* maximum length of a value name in bytes (without terminating null) */
 #define MAX_VALUE_LENGTH (16383 * sizeof(WCHAR))
 
+/*
+ * Values read with NtQueryValueKey are cached in the process, keyed by key
+ * handle and value name. The server maintains a change counter for each key in
+ * the global shared memory block and returns it along with the value, so a
+ * cached value is used as long as the counter of its key hasn't changed.
+ * Entries are removed when their handle is closed; when another process
+ * closes the handle, the server bumps the counter instead, so the value can't
+ * be returned for a different key that gets the same handle value.
+ *
+ * Lookups only take the lock shared. Instead of moving hits to the front of
+ * the LRU list they set the "used" flag, and eviction gives used entries a
+ * second chance.
+ */
+
+#define VALUE_CACHE_BUCKETS  256    /* number of hash buckets, must be a power of 2 */
+#define VALUE_CACHE_ENTRIES  4096   /* max. number of cached values */
+#define VALUE_CACHE_MAX_DATA 4096   /* max. size of a cached value */
+
+struct value_cache_entry
+{
+    struct list   entry;        /* entry in hash bucket */
+    struct list   lru_entry;    /* entry in LRU list */
+    HANDLE        handle;       /* key handle */
+    unsigned int  seq_slot;     /* index of the key change counter */
+    unsigned int  seq;          /* key change counter when the value was read */
+    BOOL          used;         /* looked up since last considered for eviction */
+    int           type;         /* value type, -1 if the value doesn't exist */
+    DWORD         data_len;     /* length of the value data */
+    USHORT        name_len;     /* length of the value name */
+    WCHAR         name[1];      /* value name, followed by the data */
+};
+
+static struct list value_cache[VALUE_CACHE_BUCKETS];
+static struct list value_cache_lru = LIST_INIT( value_cache_lru );
+static RTL_SRWLOCK value_cache_lock = RTL_SRWLOCK_INIT;
+static LONG value_cache_count;
+static LONG value_cache_lookups, value_cache_hits, value_cache_stale, value_cache_evicted;
+
+static inline struct list *value_cache_bucket( HANDLE handle )
+{
+    struct list *bucket = &value_cache[((ULONG_PTR)handle >> 2) & (VALUE_CACHE_BUCKETS - 1)];
+    if (!bucket->next) list_init( bucket );
+    return bucket;
+}
+
+static inline const volatile unsigned int *get_registry_seq(void)
+{
+    shmglobal_t *shm = server_get_shared_memory( 0 );
+    return shm ? shm->registry_seq : NULL;
+}
+
+/* find a value in the cache, caller must hold value_cache_lock */
+static struct value_cache_entry *value_cache_find( HANDLE handle, const UNICODE_STRING *name )
+{
+    struct value_cache_entry *entry;
+
+    LIST_FOR_EACH_ENTRY( entry, value_cache_bucket( handle ), struct value_cache_entry, entry )
+    {
+        if (entry->handle == handle && entry->name_len == name->Length &&
+            !memicmpW( entry->name, name->Buffer, name->Length / sizeof(WCHAR) ))
+            return entry;
+    }
+    return NULL;
+}
+
+/* remove a value from the cache, caller must hold value_cache_lock */
+static void value_cache_remove( struct value_cache_entry *entry )
+{
+    list_remove( &entry->entry );
+    list_remove( &entry->lru_entry );
+    value_cache_count--;
+    RtlFreeHeap( GetProcessHeap(), 0, entry );
+}
+
+static void value_cache_dump_stats(void)
+{
+    TRACE_(regstats)( "%u lookups, %u hits (%u%%), %u stale, %u evicted, %d cached\n",
+                      value_cache_lookups, value_cache_hits,
+                      value_cache_lookups ? (ULONG)((ULONGLONG)value_cache_hits * 100 / value_cache_lookups) : 0,
+                      value_cache_stale, value_cache_evicted, value_cache_count );
+}
+
+/* retrieve a value from the cache; return FALSE if not cached or out of date */
+static BOOL value_cache_get( HANDLE handle, const UNICODE_STRING *name, void *data, DWORD size,
+                             int *type, DWORD *total )
+{
+    const volatile unsigned int *seq = get_registry_seq();
+    struct value_cache_entry *entry;
+    BOOL ret = FALSE;
+
+    if (!seq) return FALSE;
+
+    RtlAcquireSRWLockShared( &value_cache_lock );
+    if ((entry = value_cache_find( handle, name )) && seq[entry->seq_slot] == entry->seq)
+    {
+        if (data) memcpy( data, (char *)entry->name + entry->name_len, min( size, entry->data_len ) );
+        *type  = entry->type;
+        *total = entry->data_len;
+        entry->used = TRUE;
+        interlocked_xchg_add( &value_cache_hits, 1 );
+        ret = TRUE;
+    }
+    RtlReleaseSRWLockShared( &value_cache_lock );
+
+    if (entry && !ret)
+    {
+        RtlAcquireSRWLockExclusive( &value_cache_lock );
+        if ((entry = value_cache_find( handle, name )) && seq[entry->seq_slot] != entry->seq)
+        {
+            value_cache_remove( entry );
+            value_cache_stale++;
+        }
+        RtlReleaseSRWLockExclusive( &value_cache_lock );
+    }
+
+    if (!(interlocked_xchg_add( &value_cache_lookups, 1 ) % 65536) && TRACE_ON(regstats))
+        value_cache_dump_stats();
+    return ret;
+}
+
+/* store a value returned by the server in the cache; type is -1 if the value doesn't exist */
+static void value_cache_put( HANDLE handle, const UNICODE_STRING *name, int type, const void *data,
+                             DWORD data_len, unsigned int seq_slot, unsigned int seq )
+{
+    struct value_cache_entry *entry, *old;
+    struct list *ptr;
+
+    if (!get_registry_seq() || seq_slot >= REGISTRY_SEQ_SLOTS || data_len > VALUE_CACHE_MAX_DATA) return;
+    if (!(entry = RtlAllocateHeap( GetProcessHeap(), 0,
+                                   FIELD_OFFSET( struct value_cache_entry, name ) + name->Length + data_len )))
+        return;
+    entry->handle   = handle;
+    entry->seq_slot = seq_slot;
+    entry->seq      = seq;
+    entry->used     = FALSE;
+    entry->type     = type;
+    entry->data_len = data_len;
+    entry->name_len = name->Length;
+    memcpy( entry->name, name->Buffer, name->Length );
+    memcpy( (char *)entry->name + name->Length, data, data_len );
+
+    RtlAcquireSRWLockExclusive( &value_cache_lock );
+    if ((old = value_cache_find( handle, name ))) value_cache_remove( old );
+    list_add_head( value_cache_bucket( handle ), &entry->entry );
+    list_add_head( &value_cache_lru, &entry->lru_entry );
+    if (++value_cache_count > VALUE_CACHE_ENTRIES)
+    {
+        while ((ptr = list_tail( &value_cache_lru )))
+        {
+            old = LIST_ENTRY( ptr, struct value_cache_entry, lru_entry );
+            if (!old->used) break;
+            old->used = FALSE;
+            list_remove( &old->lru_entry );
+            list_add_head( &value_cache_lru, &old->lru_entry );
+        }
+        value_cache_remove( old );
+        value_cache_evicted++;
+    }
+    RtlReleaseSRWLockExclusive( &value_cache_lock );
+}
+
+/***********************************************************************
+ *           reg_cache_close_handle
+ *
+ * Remove the cached values of a key handle that has been closed.
+ */
+void reg_cache_close_handle( HANDLE handle )
+{
+    struct value_cache_entry *entry, *next;
+    struct list *bucket;
+
+    if (!value_cache_count) return;
+
+    RtlAcquireSRWLockExclusive( &value_cache_lock );
+    bucket = value_cache_bucket( handle );
+    LIST_FOR_EACH_ENTRY_SAFE( entry, next, bucket, struct value_cache_entry, entry )
+        if (entry->handle == handle) value_cache_remove( entry );
+    RtlReleaseSRWLockExclusive( &value_cache_lock );
+}
+
 /******************************************************************************
  * NtCreateKey [NTDLL.@]
  * ZwCreateKey [NTDLL.@]
@@ -537,6 +719,8 @@ NTSTATUS WINAPI NtQueryValueKey( HANDLE handle, const UNICODE_STRING *name,
     NTSTATUS ret;
     UCHAR *data_ptr;
     unsigned int fixed_size, min_size;
+    DWORD data_size, total;
+    int type;
 
     TRACE( "(%p,%s,%d,%p,%d)\n", handle, debugstr_us(name), info_class, info, length );
 
@@ -574,21 +758,35 @@ NTSTATUS WINAPI NtQueryValueKey( HANDLE handle, const UNICODE_STRING *name,
         return STATUS_INVALID_PARAMETER;
     }
 
-    SERVER_START_REQ( get_key_value )
+    data_size = (length > fixed_size && data_ptr) ? length - fixed_size : 0;
+    if (value_cache_get( handle, name, data_ptr, data_size, &type, &total ))
+        ret = (type == -1) ? STATUS_OBJECT_NAME_NOT_FOUND : STATUS_SUCCESS;
+    else
     {
-        req->hkey = wine_server_obj_handle( handle );
-        wine_server_add_data( req, name->Buffer, name->Length );
-        if (length > fixed_size && data_ptr) wine_server_set_reply( req, data_ptr, length - fixed_size );
-        if (!(ret = wine_server_call( req )))
+        SERVER_START_REQ( get_key_value )
         {
-            copy_key_value_info( info_class, info, length, reply->type,
-                                 name->Length, reply->total );
-            *result_len = fixed_size + (info_class == KeyValueBasicInformation ? 0 : reply->total);
-            if (length < min_size) ret = STATUS_BUFFER_TOO_SMALL;
-            else if (length < *result_len) ret = STATUS_BUFFER_OVERFLOW;
+            req->hkey = wine_server_obj_handle( handle );
+            wine_server_add_data( req, name->Buffer, name->Length );
+            if (data_size) wine_server_set_reply( req, data_ptr, data_size );
+            ret = wine_server_call( req );
+            type  = reply->type;
+            total = reply->total;
+            /* only cache missing values and values that have been read completely */
+            if (ret == STATUS_OBJECT_NAME_NOT_FOUND)
+                value_cache_put( handle, name, -1, NULL, 0, reply->seq_slot, reply->seq );
+            else if (!ret && wine_server_reply_size( reply ) == total)
+                value_cache_put( handle, name, type, data_ptr, total, reply->seq_slot, reply->seq );
         }
+        SERVER_END_REQ;
+    }
+
+    if (!ret)
+    {
+        copy_key_value_info( info_class, info, length, type, name->Length, total );
+        *result_len = fixed_size + (info_class == KeyValueBasicInformation ? 0 : total);
+        if (length < min_size) ret = STATUS_BUFFER_TOO_SMALL;
+        else if (length < *result_len) ret = STATUS_BUFFER_OVERFLOW;
     }
-    SERVER_END_REQ;
     return ret;
 }
 
@@ -28,12 +28,18 @@
 #endif
 #include <errno.h>
 #include <fcntl.h>
+#ifdef HAVE_POLL_H
+#include <poll.h>
+#endif
 #ifdef HAVE_LWP_H
 #include <lwp.h>
 #endif
 #ifdef HAVE_PTHREAD_NP_H
 # include <pthread_np.h>
 #endif
+#ifdef HAVE_SCHED_H
+# include <sched.h>
+#endif
 #include <signal.h>
 #include <stdarg.h>
 #include <stdio.h>
@@ -60,6 +66,9 @@
 #ifdef HAVE_SYS_SYSCALL_H
 # include <sys/syscall.h>
 #endif
+#ifdef HAVE_SYS_TIME_H
+# include <sys/time.h>
+#endif
 #ifdef HAVE_SYS_UIO_H
 #include <sys/uio.h>
 #endif
@@ -80,6 +89,7 @@
 #include "wine/library.h"
 #include "wine/server.h"
 #include "wine/debug.h"
+#include "wine/exception.h"
 #include "ntdll_misc.h"
 
 WINE_DEFAULT_DEBUG_CHANNEL(server);
@@ -129,6 +139,8 @@ static RTL_CRITICAL_SECTION_DEBUG critsect_debug =
 };
 static RTL_CRITICAL_SECTION fd_cache_section = { &critsect_debug, -1, 0, 0, 0, 0 };
 
+static unsigned int request_spin_count;  /* number of spins waiting for a shared memory reply */
+
 /* atomically exchange a 64-bit value */
 static inline LONG64 interlocked_xchg64( LONG64 *dest, LONG64 val )
 {
@@ -278,6 +290,115 @@ static inline unsigned int wait_reply( struct __server_request_info *req )
 }
 
 
+/***********************************************************************
+ *           copy_request_to_shm
+ *
+ * Copy a request and its data to the shared request block.
+ */
+static unsigned int copy_request_to_shm( request_shm_t *shm, const struct __server_request_info *req )
+{
+    char *ptr = (char *)(shm + 1);
+    unsigned int i;
+
+    memcpy( &shm->header, &req->u.req, sizeof(req->u.req) );
+    if (!req->u.req.request_header.request_size) return STATUS_SUCCESS;
+
+    __TRY
+    {
+        for (i = 0; i < req->data_count; i++)
+        {
+            memcpy( ptr, req->data[i].ptr, req->data[i].size );
+            ptr += req->data[i].size;
+        }
+    }
+    __EXCEPT_PAGE_FAULT
+    {
+        return STATUS_ACCESS_VIOLATION;
+    }
+    __ENDTRY
+    return STATUS_SUCCESS;
+}
+
+
+/***********************************************************************
+ *           send_shm_request
+ *
+ * Tell the server that a request is waiting in the shared request block.
+ */
+static unsigned int send_shm_request( request_shm_t *shm )
+{
+    union generic_request call;
+    int ret;
+
+    memset( &call, 0, sizeof(call) );
+    call.request_header.req = REQUEST_SHM_CALL;
+    interlocked_xchg( &shm->state, REQUEST_SHM_PENDING );
+
+    if ((ret = write( ntdll_get_thread_data()->request_fd, &call, sizeof(call) )) == sizeof(call))
+        return STATUS_SUCCESS;
+
+    if (ret >= 0) server_protocol_error( "partial write %d\n", ret );
+    if (errno == EPIPE) abort_thread(0);
+    server_protocol_perror( "write" );
+}
+
+
+/***********************************************************************
+ *           wait_shm_reply
+ *
+ * Wait for the server to write the reply to the shared request block.
+ */
+static unsigned int wait_shm_reply( request_shm_t *shm, struct __server_request_info *req )
+{
+    unsigned int i;
+    int state;
+
+    /* most requests are short, spin for a while before going to sleep */
+    for (i = 0; i < request_spin_count; i++)
+    {
+        if (*(volatile int *)&shm->state != REQUEST_SHM_PENDING) break;
+#if defined(__i386__) || defined(__x86_64__)
+        __asm__ __volatile__( "pause" : : : "memory" );
+#endif
+    }
+
+    if (interlocked_cmpxchg( &shm->state, REQUEST_SHM_WAITING, REQUEST_SHM_PENDING ) == REQUEST_SHM_PENDING)
+    {
+        while (*(volatile int *)&shm->state == REQUEST_SHM_WAITING)
+        {
+#if defined(__linux__) && defined(__NR_futex)
+            struct timespec timeout = { 1, 0 };
+            struct pollfd pfd;
+
+            if (!syscall( __NR_futex, &shm->state, 0 /* FUTEX_WAIT */, REQUEST_SHM_WAITING, &timeout, 0, 0 ))
+                continue;
+            if (errno != ETIMEDOUT) continue;
+
+            /* the server may have died without waking us up */
+            pfd.fd = ntdll_get_thread_data()->reply_fd;
+            pfd.events = POLLIN;
+            pfd.revents = 0;
+            if (poll( &pfd, 1, 0 ) == 1 && (pfd.revents & (POLLERR | POLLHUP))) abort_thread(0);
+#else
+            sched_yield();
+#endif
+        }
+    }
+
+    /* the exchange provides the barrier for reading the reply */
+    if ((state = interlocked_xchg( &shm->state, REQUEST_SHM_IDLE )) != REQUEST_SHM_DONE)
+    {
+        if (state == REQUEST_SHM_DEAD) abort_thread(0);
+        server_protocol_error( "invalid shared request state %d\n", state );
+    }
+
+    memcpy( &req->u.reply, &shm->header, sizeof(req->u.reply) );
+    if (req->u.reply.reply_header.reply_size)
+        memcpy( req->reply_data, shm + 1, req->u.reply.reply_header.reply_size );
+    return req->u.reply.reply_header.error;
+}
+
+
 /***********************************************************************
  *           wine_server_call (NTDLL.@)
  *
@@ -303,9 +424,13 @@ static inline unsigned int wait_reply( struct __server_request_info *req )
 unsigned int wine_server_call( void *req_ptr )
 {
     struct __server_request_info * const req = req_ptr;
+    request_shm_t *shm = ntdll_get_thread_data()->request_shm;
     sigset_t old_set;
     unsigned int ret;
 
+    /* closed handles must be gone before anything else is done */
+    if (deferred_close_count) flush_deferred_close();
+
     /* trigger write watches, otherwise read() might return EFAULT */
     if (req->u.req.request_header.reply_size &&
         !virtual_check_buffer_for_write( req->reply_data, req->u.req.request_header.reply_size ))
@@ -314,10 +439,30 @@ unsigned int wine_server_call( void *req_ptr )
         return ret;
     }
 
-    pthread_sigmask( SIG_BLOCK, &server_block_set, &old_set );
-    ret = send_request( req );
-    if (!ret) ret = wait_reply( req );
-    pthread_sigmask( SIG_SETMASK, &old_set, NULL );
+    /* requests too large for the shared block go through the pipe */
+    if (shm && (req->u.req.request_header.request_size > REQUEST_SHM_DATA_SIZE ||
+                req->u.req.request_header.reply_size > REQUEST_SHM_DATA_SIZE))
+        shm = NULL;
+
+    if (shm)
+    {
+        /* a signal handler making its own server call would reuse the block */
+        pthread_sigmask( SIG_BLOCK, &server_block_set, &old_set );
+        if (!(ret = copy_request_to_shm( shm, req )))
+        {
+            ret = send_shm_request( shm );
+            if (!ret) ret = wait_shm_reply( shm, req );
+        }
+        pthread_sigmask( SIG_SETMASK, &old_set, NULL );
+    }
+    else
+    {
+        pthread_sigmask( SIG_BLOCK, &server_block_set, &old_set );
+        ret = send_request( req );
+        if (!ret) ret = wait_reply( req );
+        pthread_sigmask( SIG_SETMASK, &old_set, NULL );
+    }
+
     return ret;
 }
 
@@ -1058,6 +1203,73 @@ static int server_get_shared_memory_fd( HANDLE thread, int *unix_fd )
     return ret;
 }
 
+/***********************************************************************
+ *           server_get_esync_fd
+ *
+ * Receive the eventfd backing an esync object, or the esync shared
+ * memory block if handle is 0.
+ */
+NTSTATUS server_get_esync_fd( HANDLE handle, enum esync_type *type, unsigned int *shm_idx,
+                              unsigned int *access, int *unix_fd )
+{
+    obj_handle_t fd_handle;
+    sigset_t sigset;
+    NTSTATUS ret;
+
+    server_enter_uninterrupted_section( &fd_cache_section, &sigset );
+
+    SERVER_START_REQ( get_esync_fd )
+    {
+        req->handle = wine_server_obj_handle( handle );
+        if (!(ret = wine_server_call( req )))
+        {
+            if (type) *type = reply->type;
+            if (shm_idx) *shm_idx = reply->shm_idx;
+            if (access) *access = reply->access;
+            *unix_fd = receive_fd( &fd_handle );
+            if (*unix_fd == -1) ret = STATUS_TOO_MANY_OPENED_FILES;
+            else assert( wine_server_ptr_handle(fd_handle) == handle );
+        }
+    }
+    SERVER_END_REQ;
+
+    server_leave_uninterrupted_section( &fd_cache_section, &sigset );
+    return ret;
+}
+
+/***********************************************************************
+ *           server_init_request_shm
+ *
+ * Map the shared memory block used to send requests, if the server supports it.
+ */
+static void server_init_request_shm(void)
+{
+#if defined(__linux__) && defined(__NR_futex)
+    obj_handle_t dummy;
+    SIZE_T size = REQUEST_SHM_SIZE;
+    void *mem = NULL;
+    sigset_t sigset;
+    int fd = -1;
+
+    if (!request_spin_count && sysconf( _SC_NPROCESSORS_ONLN ) > 1) request_spin_count = 2000;
+
+    server_enter_uninterrupted_section( &fd_cache_section, &sigset );
+
+    SERVER_START_REQ( get_request_shm )
+    {
+        if (!wine_server_call( req )) fd = receive_fd( &dummy );
+    }
+    SERVER_END_REQ;
+
+    server_leave_uninterrupted_section( &fd_cache_section, &sigset );
+
+    if (fd == -1) return;
+    if (!virtual_map_shared_memory( fd, &mem, 0, &size, PAGE_READWRITE ))
+        ntdll_get_thread_data()->request_shm = mem;
+    close( fd );
+#endif
+}
+
 /* The shared memory wineserver communication is still highly experimental
  * and might cause unexpected results when the client/server status gets
  * out of synchronization. The feature will be disabled by default until it
@@ -1643,6 +1855,7 @@ size_t server_init_thread( void *entry_point )
     /* initialize thread shared memory pointers */
     NtCurrentTeb()->Reserved5[1] = server_get_shared_memory( 0 );
     NtCurrentTeb()->Reserved5[2] = server_get_shared_memory( NtCurrentTeb()->ClientId.UniqueThread );
+    if (ret == STATUS_SUCCESS) server_init_request_shm();
 
     is_wow64 = !is_win64 && (server_cpus & ((1 << CPU_x86_64) | (1 << CPU_ARM64))) != 0;
     ntdll_get_thread_data()->wow64_redir = is_wow64;
@@ -42,6 +42,10 @@
 #ifdef HAVE_SCHED_H
 # include <sched.h>
 #endif
+#ifdef HAVE_SYS_SYSCALL_H
+# include <sys/syscall.h>
+#endif
+#include <limits.h>
 #include <string.h>
 #include <stdarg.h>
 #include <stdio.h>
@@ -55,6 +59,7 @@
 #include "winternl.h"
 #include "wine/server.h"
 #include "wine/debug.h"
+#include "wine/list.h"
 #include "ntdll_misc.h"
 
 WINE_DEFAULT_DEBUG_CHANNEL(ntdll);
@@ -199,6 +204,9 @@ NTSTATUS WINAPI NtCreateSemaphore( OUT PHANDLE SemaphoreHandle,
     }
     SERVER_END_REQ;
 
+    if (!ret && (!attr || !attr->ObjectName || !attr->ObjectName->Length))
+        allow_deferred_close( *SemaphoreHandle );
+
     RtlFreeHeap( GetProcessHeap(), 0, objattr );
     return ret;
 }
@@ -266,6 +274,10 @@ NTSTATUS WINAPI NtQuerySemaphore( HANDLE handle, SEMAPHORE_INFORMATION_CLASS cla
 NTSTATUS WINAPI NtReleaseSemaphore( HANDLE handle, ULONG count, PULONG previous )
 {
     NTSTATUS ret;
+
+    if (do_esync() && (ret = esync_release_semaphore( handle, count, previous )) != STATUS_NOT_IMPLEMENTED)
+        return ret;
+
     SERVER_START_REQ( release_semaphore )
     {
         req->handle = wine_server_obj_handle( handle );
@@ -307,6 +319,9 @@ NTSTATUS WINAPI NtCreateEvent( PHANDLE EventHandle, ACCESS_MASK DesiredAccess,
     }
     SERVER_END_REQ;
 
+    if (!ret && (!attr || !attr->ObjectName || !attr->ObjectName->Length))
+        allow_deferred_close( *EventHandle );
+
     RtlFreeHeap( GetProcessHeap(), 0, objattr );
     return ret;
 }
@@ -346,6 +361,9 @@ NTSTATUS WINAPI NtSetEvent( HANDLE handle, PULONG NumberOfThreadsReleased )
 
     /* FIXME: set NumberOfThreadsReleased */
 
+    if (do_esync() && (ret = esync_set_event( handle )) != STATUS_NOT_IMPLEMENTED)
+        return ret;
+
     SERVER_START_REQ( event_op )
     {
         req->handle = wine_server_obj_handle( handle );
@@ -366,6 +384,9 @@ NTSTATUS WINAPI NtResetEvent( HANDLE handle, PULONG NumberOfThreadsReleased )
     /* resetting an event can't release any thread... */
     if (NumberOfThreadsReleased) *NumberOfThreadsReleased = 0;
 
+    if (do_esync() && (ret = esync_reset_event( handle )) != STATUS_NOT_IMPLEMENTED)
+        return ret;
+
     SERVER_START_REQ( event_op )
     {
         req->handle = wine_server_obj_handle( handle );
@@ -510,6 +531,9 @@ NTSTATUS WINAPI NtReleaseMutant( IN HANDLE handle, OUT PLONG prev_count OPTIONAL
 {
     NTSTATUS    status;
 
+    if (do_esync() && (status = esync_release_mutex( handle, prev_count )) != STATUS_NOT_IMPLEMENTED)
+        return status;
+
     SERVER_START_REQ( release_mutex )
     {
         req->handle = wine_server_obj_handle( handle );
@@ -1022,13 +1046,26 @@ static NTSTATUS wait_objects( DWORD count, const HANDLE *handles,
 {
     select_op_t select_op;
     UINT i, flags = SELECT_INTERRUPTIBLE;
+    NTSTATUS ret;
 
     if (!count || count > MAXIMUM_WAIT_OBJECTS) return STATUS_INVALID_PARAMETER_1;
 
+    tp_worker_block_begin( timeout );
+
+    if (do_esync())
+    {
+        ret = esync_wait_objects( count, handles, wait_any, alertable, timeout );
+        if (ret != STATUS_NOT_IMPLEMENTED) goto done;
+    }
+
     if (alertable) flags |= SELECT_ALERTABLE;
     select_op.wait.op = wait_any ? SELECT_WAIT : SELECT_WAIT_ALL;
     for (i = 0; i < count; i++) select_op.wait.handles[i] = wine_server_obj_handle( handles[i] );
-    return server_select( &select_op, offsetof( select_op_t, wait.handles[count] ), flags, timeout );
+    ret = server_select( &select_op, offsetof( select_op_t, wait.handles[count] ), flags, timeout );
+
+done:
+    tp_worker_block_end( timeout );
+    return ret;
 }
 
 
@@ -1060,14 +1097,27 @@ NTSTATUS WINAPI NtSignalAndWaitForSingleObject( HANDLE hSignalObject, HANDLE hWa
 {
     select_op_t select_op;
     UINT flags = SELECT_INTERRUPTIBLE;
+    NTSTATUS ret;
 
     if (!hSignalObject) return STATUS_INVALID_HANDLE;
 
+    tp_worker_block_begin( timeout );
+
+    if (do_esync())
+    {
+        ret = esync_signal_and_wait( hSignalObject, hWaitObject, alertable, timeout );
+        if (ret != STATUS_NOT_IMPLEMENTED) goto done;
+    }
+
     if (alertable) flags |= SELECT_ALERTABLE;
     select_op.signal_and_wait.op = SELECT_SIGNAL_AND_WAIT;
     select_op.signal_and_wait.wait = wine_server_obj_handle( hWaitObject );
     select_op.signal_and_wait.signal = wine_server_obj_handle( hSignalObject );
-    return server_select( &select_op, sizeof(select_op.signal_and_wait), flags, timeout );
+    ret = server_select( &select_op, sizeof(select_op.signal_and_wait), flags, timeout );
+
+done:
+    tp_worker_block_end( timeout );
+    return ret;
 }
 
 
@@ -1090,12 +1140,20 @@ NTSTATUS WINAPI NtYieldExecution(void)
  */
 NTSTATUS WINAPI NtDelayExecution( BOOLEAN alertable, const LARGE_INTEGER *timeout )
 {
+    NTSTATUS ret;
+
     /* if alertable, we need to query the server */
     if (alertable)
-        return server_select( NULL, 0, SELECT_INTERRUPTIBLE | SELECT_ALERTABLE, timeout );
+    {
+        tp_worker_block_begin( timeout );
+        ret = server_select( NULL, 0, SELECT_INTERRUPTIBLE | SELECT_ALERTABLE, timeout );
+        tp_worker_block_end( timeout );
+        return ret;
+    }
 
     if (!timeout || timeout->QuadPart == TIMEOUT_INFINITE)  /* sleep forever */
     {
+        tp_worker_block_begin( NULL );
         for (;;) select( 0, NULL, NULL, NULL, NULL );
     }
     else
@@ -1113,6 +1171,7 @@ NTSTATUS WINAPI NtDelayExecution( BOOLEAN alertable, const LARGE_INTEGER *timeou
         NtYieldExecution();
         if (!when) return STATUS_SUCCESS;
 
+        tp_worker_block_begin( timeout );
         for (;;)
         {
             struct timeval tv;
@@ -1123,6 +1182,7 @@ NTSTATUS WINAPI NtDelayExecution( BOOLEAN alertable, const LARGE_INTEGER *timeou
             tv.tv_usec = diff % 1000000;
             if (select( 0, NULL, NULL, NULL, &tv ) != -1) break;
         }
+        tp_worker_block_end( timeout );
     }
     return STATUS_SUCCESS;
 }
@@ -1432,6 +1492,123 @@ NTSTATUS NTDLL_AddCompletion( HANDLE hFile, ULONG_PTR CompletionValue,
     return status;
 }
 
+#ifdef __linux__
+
+static int wait_op = 128; /*FUTEX_WAIT|FUTEX_PRIVATE_FLAG*/
+static int wake_op = 129; /*FUTEX_WAKE|FUTEX_PRIVATE_FLAG*/
+static int wait_bitset_op = 137; /*FUTEX_WAIT_BITSET|FUTEX_PRIVATE_FLAG*/
+static int wake_bitset_op = 138; /*FUTEX_WAKE_BITSET|FUTEX_PRIVATE_FLAG*/
+
+static inline int futex_wait( const int *addr, int val, struct timespec *timeout )
+{
+    return syscall( __NR_futex, addr, wait_op, val, timeout, 0, 0 );
+}
+
+static inline int futex_wake( const int *addr, int val )
+{
+    return syscall( __NR_futex, addr, wake_op, val, NULL, 0, 0 );
+}
+
+static inline int futex_wait_bitset( const int *addr, int val, struct timespec *timeout, int mask )
+{
+    return syscall( __NR_futex, addr, wait_bitset_op, val, timeout, 0, mask );
+}
+
+static inline int futex_wake_bitset( const int *addr, int val, int mask )
+{
+    return syscall( __NR_futex, addr, wake_bitset_op, val, NULL, 0, mask );
+}
+
+static inline int use_futexes(void)
+{
+    static int supported = -1;
+
+    if (supported == -1)
+    {
+        futex_wait( &supported, 10, NULL );
+        if (errno == ENOSYS)
+        {
+            wait_op = 0; /*FUTEX_WAIT*/
+            wake_op = 1; /*FUTEX_WAKE*/
+            wait_bitset_op = 9; /*FUTEX_WAIT_BITSET*/
+            wake_bitset_op = 10; /*FUTEX_WAKE_BITSET*/
+            futex_wait( &supported, 10, NULL );
+        }
+        supported = (errno != ENOSYS);
+    }
+    return supported;
+}
+
+/* convert an NT timeout to the relative timespec expected by FUTEX_WAIT */
+static void timespec_from_timeout( struct timespec *timespec, const LARGE_INTEGER *timeout )
+{
+    LARGE_INTEGER now;
+    LONGLONG diff;
+
+    if (timeout->QuadPart >= 0)
+    {
+        NtQuerySystemTime( &now );
+        diff = timeout->QuadPart - now.QuadPart;
+    }
+    else diff = -timeout->QuadPart;
+
+    if (diff < 0) diff = 0;
+    timespec->tv_sec  = diff / 10000000;
+    timespec->tv_nsec = (diff % 10000000) * 100;
+}
+
+static NTSTATUS futex_wait_timeout( const int *addr, int val, const LARGE_INTEGER *timeout )
+{
+    struct timespec timespec;
+    int ret;
+
+    if (timeout && timeout->QuadPart != TIMEOUT_INFINITE)
+    {
+        timespec_from_timeout( &timespec, timeout );
+        ret = futex_wait( addr, val, &timespec );
+    }
+    else ret = futex_wait( addr, val, NULL );
+
+    if (ret == -1 && errno == ETIMEDOUT) return STATUS_TIMEOUT;
+    return STATUS_SUCCESS;
+}
+
+static inline NTSTATUS fast_wait_once( RTL_RUN_ONCE *once, ULONG_PTR val )
+{
+    if (!use_futexes()) return STATUS_NOT_IMPLEMENTED;
+
+    /* the low bits change when the initialization completes, which is all we need to wait on */
+    futex_wait( (int *)&once->Ptr, (int)val, NULL );
+    return STATUS_SUCCESS;
+}
+
+static inline NTSTATUS fast_wake_once( RTL_RUN_ONCE *once )
+{
+    if (!use_futexes()) return STATUS_NOT_IMPLEMENTED;
+
+    futex_wake( (int *)&once->Ptr, INT_MAX );
+    return STATUS_SUCCESS;
+}
+
+#else
+
+static inline int use_futexes(void)
+{
+    return 0;
+}
+
+static inline NTSTATUS fast_wait_once( RTL_RUN_ONCE *once, ULONG_PTR val )
+{
+    return STATUS_NOT_IMPLEMENTED;
+}
+
+static inline NTSTATUS fast_wake_once( RTL_RUN_ONCE *once )
+{
+    return STATUS_NOT_IMPLEMENTED;
+}
+
+#endif
+
 /******************************************************************
  *              RtlRunOnceInitialize (NTDLL.@)
  */
@@ -1469,6 +1646,7 @@ DWORD WINAPI RtlRunOnceBeginInitialize( RTL_RUN_ONCE *once, ULONG flags, void **
 
         case 1:  /* in progress, wait */
             if (flags & RTL_RUN_ONCE_ASYNC) return STATUS_INVALID_PARAMETER;
+            if (fast_wait_once( once, val ) != STATUS_NOT_IMPLEMENTED) break;
             next = val & ~3;
             if (interlocked_cmpxchg_ptr( &once->Ptr, (void *)((ULONG_PTR)&next | 1),
                                          (void *)val ) == (void *)val)
@@ -1508,6 +1686,7 @@ DWORD WINAPI RtlRunOnceComplete( RTL_RUN_ONCE *once, ULONG flags, void *context
         {
         case 1:  /* in progress */
             if (interlocked_cmpxchg_ptr( &once->Ptr, context, (void *)val ) != (void *)val) break;
+            if (fast_wake_once( once ) != STATUS_NOT_IMPLEMENTED) return STATUS_SUCCESS;
             val &= ~3;
             while (val)
             {
@@ -1669,15 +1848,292 @@ static inline void srwlock_leave_shared( RTL_SRWLOCK *lock, unsigned int val )
         NtReleaseKeyedEvent( keyed_event, srwlock_key_exclusive(lock), FALSE, NULL );
 }
 
+#ifdef __linux__
+
+/* Futex-based SRW lock implementation
+ *
+ * The kernel takes care of queueing the waiters, so the lock word only has
+ * to describe the owners and whether anybody needs to be woken up:
+ *
+ *    31 - set if the lock is owned exclusively
+ * 30-16 - number of threads waiting for exclusive access; unlike the keyed
+ *         event implementation this doesn't include the owner
+ *    15 - set if there are threads waiting for shared access
+ *  14-0 - number of shared owners, not counting the shared waiters
+ *
+ * Exclusive and shared waiters sleep on the same word with different futex
+ * bitsets, so releasing the lock wakes only the threads that can make
+ * progress.
+ */
+
+#define SRWLOCK_FUTEX_EXCLUSIVE_LOCK_BIT        0x80000000
+#define SRWLOCK_FUTEX_EXCLUSIVE_WAITERS_MASK    0x7fff0000
+#define SRWLOCK_FUTEX_EXCLUSIVE_WAITERS_INC     0x00010000
+#define SRWLOCK_FUTEX_SHARED_WAITERS_BIT        0x00008000
+#define SRWLOCK_FUTEX_SHARED_OWNERS_MASK        0x00007fff
+#define SRWLOCK_FUTEX_SHARED_OWNERS_INC         0x00000001
+
+#define SRWLOCK_FUTEX_BITSET_EXCLUSIVE  1
+#define SRWLOCK_FUTEX_BITSET_SHARED     2
+
+static NTSTATUS fast_try_acquire_srw_exclusive( RTL_SRWLOCK *lock )
+{
+    unsigned int old, new;
+    NTSTATUS ret;
+
+    if (!use_futexes()) return STATUS_NOT_IMPLEMENTED;
+
+    do
+    {
+        old = *(unsigned int *)&lock->Ptr;
+
+        if (!(old & SRWLOCK_FUTEX_EXCLUSIVE_LOCK_BIT) && !(old & SRWLOCK_FUTEX_SHARED_OWNERS_MASK))
+        {
+            new = old | SRWLOCK_FUTEX_EXCLUSIVE_LOCK_BIT;
+            ret = STATUS_SUCCESS;
+        }
+        else
+        {
+            new = old;
+            ret = STATUS_TIMEOUT;
+        }
+    } while (interlocked_cmpxchg( (int *)&lock->Ptr, new, old ) != old);
+
+    return ret;
+}
+
+static NTSTATUS fast_acquire_srw_exclusive( RTL_SRWLOCK *lock )
+{
+    unsigned int old, new;
+    BOOL wait;
+
+    if (!use_futexes()) return STATUS_NOT_IMPLEMENTED;
+
+    /* register as an exclusive waiter first, so that no new shared owners get in */
+    do
+    {
+        old = *(unsigned int *)&lock->Ptr;
+        new = old + SRWLOCK_FUTEX_EXCLUSIVE_WAITERS_INC;
+        if (!(new & SRWLOCK_FUTEX_EXCLUSIVE_WAITERS_MASK)) RtlRaiseStatus( STATUS_RESOURCE_NOT_OWNED );
+    } while (interlocked_cmpxchg( (int *)&lock->Ptr, new, old ) != old);
+
+    for (;;)
+    {
+        do
+        {
+            old = *(unsigned int *)&lock->Ptr;
+
+            if (!(old & SRWLOCK_FUTEX_EXCLUSIVE_LOCK_BIT) && !(old & SRWLOCK_FUTEX_SHARED_OWNERS_MASK))
+            {
+                new = (old | SRWLOCK_FUTEX_EXCLUSIVE_LOCK_BIT) - SRWLOCK_FUTEX_EXCLUSIVE_WAITERS_INC;
+                wait = FALSE;
+            }
+            else
+            {
+                new = old;
+                wait = TRUE;
+            }
+        } while (interlocked_cmpxchg( (int *)&lock->Ptr, new, old ) != old);
+
+        if (!wait) return STATUS_SUCCESS;
+
+        futex_wait_bitset( (int *)&lock->Ptr, new, NULL, SRWLOCK_FUTEX_BITSET_EXCLUSIVE );
+    }
+}
+
+static NTSTATUS fast_try_acquire_srw_shared( RTL_SRWLOCK *lock )
+{
+    unsigned int old, new;
+    NTSTATUS ret;
+
+    if (!use_futexes()) return STATUS_NOT_IMPLEMENTED;
+
+    do
+    {
+        old = *(unsigned int *)&lock->Ptr;
+
+        if (!(old & SRWLOCK_FUTEX_EXCLUSIVE_LOCK_BIT) && !(old & SRWLOCK_FUTEX_EXCLUSIVE_WAITERS_MASK))
+        {
+            new = old + SRWLOCK_FUTEX_SHARED_OWNERS_INC;
+            if (!(new & SRWLOCK_FUTEX_SHARED_OWNERS_MASK)) RtlRaiseStatus( STATUS_RESOURCE_NOT_OWNED );
+            ret = STATUS_SUCCESS;
+        }
+        else
+        {
+            new = old;
+            ret = STATUS_TIMEOUT;
+        }
+    } while (interlocked_cmpxchg( (int *)&lock->Ptr, new, old ) != old);
+
+    return ret;
+}
+
+static NTSTATUS fast_acquire_srw_shared( RTL_SRWLOCK *lock )
+{
+    unsigned int old, new;
+    BOOL wait;
+
+    if (!use_futexes()) return STATUS_NOT_IMPLEMENTED;
+
+    for (;;)
+    {
+        do
+        {
+            old = *(unsigned int *)&lock->Ptr;
+
+            if (!(old & SRWLOCK_FUTEX_EXCLUSIVE_LOCK_BIT) && !(old & SRWLOCK_FUTEX_EXCLUSIVE_WAITERS_MASK))
+            {
+                new = old + SRWLOCK_FUTEX_SHARED_OWNERS_INC;
+                if (!(new & SRWLOCK_FUTEX_SHARED_OWNERS_MASK)) RtlRaiseStatus( STATUS_RESOURCE_NOT_OWNED );
+                wait = FALSE;
+            }
+            else
+            {
+                new = old | SRWLOCK_FUTEX_SHARED_WAITERS_BIT;
+                wait = TRUE;
+            }
+        } while (interlocked_cmpxchg( (int *)&lock->Ptr, new, old ) != old);
+
+        if (!wait) return STATUS_SUCCESS;
+
+        futex_wait_bitset( (int *)&lock->Ptr, new, NULL, SRWLOCK_FUTEX_BITSET_SHARED );
+    }
+}
+
+static NTSTATUS fast_release_srw_exclusive( RTL_SRWLOCK *lock )
+{
+    unsigned int old, new;
+
+    if (!use_futexes()) return STATUS_NOT_IMPLEMENTED;
+
+    do
+    {
+        old = *(unsigned int *)&lock->Ptr;
+
+        if (!(old & SRWLOCK_FUTEX_EXCLUSIVE_LOCK_BIT))
+        {
+            ERR( "lock %p is not owned exclusive (%#x)\n", lock, old );
+            return STATUS_RESOURCE_NOT_OWNED;
+        }
+
+        new = old & ~SRWLOCK_FUTEX_EXCLUSIVE_LOCK_BIT;
+        if (!(new & SRWLOCK_FUTEX_EXCLUSIVE_WAITERS_MASK))
+            new &= ~SRWLOCK_FUTEX_SHARED_WAITERS_BIT;
+    } while (interlocked_cmpxchg( (int *)&lock->Ptr, new, old ) != old);
+
+    /* exclusive waiters go first, like in the keyed event implementation */
+    if (new & SRWLOCK_FUTEX_EXCLUSIVE_WAITERS_MASK)
+        futex_wake_bitset( (int *)&lock->Ptr, 1, SRWLOCK_FUTEX_BITSET_EXCLUSIVE );
+    else if (old & SRWLOCK_FUTEX_SHARED_WAITERS_BIT)
+        futex_wake_bitset( (int *)&lock->Ptr, INT_MAX, SRWLOCK_FUTEX_BITSET_SHARED );
+
+    return STATUS_SUCCESS;
+}
+
+static NTSTATUS fast_release_srw_shared( RTL_SRWLOCK *lock )
+{
+    unsigned int old, new;
+
+    if (!use_futexes()) return STATUS_NOT_IMPLEMENTED;
+
+    do
+    {
+        old = *(unsigned int *)&lock->Ptr;
+
+        if ((old & SRWLOCK_FUTEX_EXCLUSIVE_LOCK_BIT) || !(old & SRWLOCK_FUTEX_SHARED_OWNERS_MASK))
+        {
+            ERR( "lock %p is not owned shared (%#x)\n", lock, old );
+            return STATUS_RESOURCE_NOT_OWNED;
+        }
+
+        new = old - SRWLOCK_FUTEX_SHARED_OWNERS_INC;
+    } while (interlocked_cmpxchg( (int *)&lock->Ptr, new, old ) != old);
+
+    /* only the last shared owner can let an exclusive waiter in */
+    if (!(new & SRWLOCK_FUTEX_SHARED_OWNERS_MASK) && (new & SRWLOCK_FUTEX_EXCLUSIVE_WAITERS_MASK))
+        futex_wake_bitset( (int *)&lock->Ptr, 1, SRWLOCK_FUTEX_BITSET_EXCLUSIVE );
+
+    return STATUS_SUCCESS;
+}
+
+#else
+
+static inline NTSTATUS fast_try_acquire_srw_exclusive( RTL_SRWLOCK *lock )
+{
+    return STATUS_NOT_IMPLEMENTED;
+}
+
+static inline NTSTATUS fast_acquire_srw_exclusive( RTL_SRWLOCK *lock )
+{
+    return STATUS_NOT_IMPLEMENTED;
+}
+
+static inline NTSTATUS fast_try_acquire_srw_shared( RTL_SRWLOCK *lock )
+{
+    return STATUS_NOT_IMPLEMENTED;
+}
+
+static inline NTSTATUS fast_acquire_srw_shared( RTL_SRWLOCK *lock )
+{
+    return STATUS_NOT_IMPLEMENTED;
+}
+
+static inline NTSTATUS fast_release_srw_exclusive( RTL_SRWLOCK *lock )
+{
+    return STATUS_NOT_IMPLEMENTED;
+}
+
+static inline NTSTATUS fast_release_srw_shared( RTL_SRWLOCK *lock )
+{
+    return STATUS_NOT_IMPLEMENTED;
+}
+
+#endif
+
+#ifdef __linux__
+
+/* With futexes the condition variable holds a wake sequence number instead of
+ * the waiter count; sleepers wait for it to change. */
+
+static NTSTATUS fast_wait_cv( RTL_CONDITION_VARIABLE *variable, int val, const LARGE_INTEGER *timeout )
+{
+    if (!use_futexes()) return STATUS_NOT_IMPLEMENTED;
+    return futex_wait_timeout( (int *)&variable->Ptr, val, timeout );
+}
+
+static NTSTATUS fast_wake_cv( RTL_CONDITION_VARIABLE *variable, int count )
+{
+    if (!use_futexes()) return STATUS_NOT_IMPLEMENTED;
+
+    interlocked_xchg_add( (int *)&variable->Ptr, 1 );
+    futex_wake( (int *)&variable->Ptr, count );
+    return STATUS_SUCCESS;
+}
+
+#else
+
+static inline NTSTATUS fast_wait_cv( RTL_CONDITION_VARIABLE *variable, int val, const LARGE_INTEGER *timeout )
+{
+    return STATUS_NOT_IMPLEMENTED;
+}
+
+static inline NTSTATUS fast_wake_cv( RTL_CONDITION_VARIABLE *variable, int count )
+{
+    return STATUS_NOT_IMPLEMENTED;
+}
+
+#endif
+
 /***********************************************************************
  *              RtlInitializeSRWLock (NTDLL.@)
  *
  * NOTES
  *  Please note that SRWLocks do not keep track of the owner of a lock.
  *  It doesn't make any difference which thread for example unlocks an
- *  SRWLock (see corresponding tests). This implementation uses two
- *  keyed events (one for the exclusive waiters and one for the shared
- *  waiters) and is limited to 2^15-1 waiting threads.
+ *  SRWLock (see corresponding tests). This implementation uses futexes
+ *  when available, and otherwise two keyed events (one for the exclusive
+ *  waiters and one for the shared waiters); both are limited to 2^15-1
+ *  waiting threads.
  */
 void WINAPI RtlInitializeSRWLock( RTL_SRWLOCK *lock )
 {
@@ -1694,6 +2150,9 @@ void WINAPI RtlInitializeSRWLock( RTL_SRWLOCK *lock )
  */
 void WINAPI RtlAcquireSRWLockExclusive( RTL_SRWLOCK *lock )
 {
+    if (fast_acquire_srw_exclusive( lock ) != STATUS_NOT_IMPLEMENTED)
+        return;
+
     if (srwlock_lock_exclusive( (unsigned int *)&lock->Ptr, SRWLOCK_RES_EXCLUSIVE ))
         NtWaitForKeyedEvent( keyed_event, srwlock_key_exclusive(lock), FALSE, NULL );
 }
@@ -1708,6 +2167,10 @@ void WINAPI RtlAcquireSRWLockExclusive( RTL_SRWLOCK *lock )
 void WINAPI RtlAcquireSRWLockShared( RTL_SRWLOCK *lock )
 {
     unsigned int val, tmp;
+
+    if (fast_acquire_srw_shared( lock ) != STATUS_NOT_IMPLEMENTED)
+        return;
+
     /* Acquires a shared lock. If it's currently not possible to add elements to
      * the shared queue, then request exclusive access instead. */
     for (val = *(unsigned int *)&lock->Ptr;; val = tmp)
@@ -1738,6 +2201,9 @@ void WINAPI RtlAcquireSRWLockShared( RTL_SRWLOCK *lock )
  */
 void WINAPI RtlReleaseSRWLockExclusive( RTL_SRWLOCK *lock )
 {
+    if (fast_release_srw_exclusive( lock ) != STATUS_NOT_IMPLEMENTED)
+        return;
+
     srwlock_leave_exclusive( lock, srwlock_unlock_exclusive( (unsigned int *)&lock->Ptr,
                              - SRWLOCK_RES_EXCLUSIVE ) - SRWLOCK_RES_EXCLUSIVE );
 }
@@ -1747,6 +2213,9 @@ void WINAPI RtlReleaseSRWLockExclusive( RTL_SRWLOCK *lock )
  */
 void WINAPI RtlReleaseSRWLockShared( RTL_SRWLOCK *lock )
 {
+    if (fast_release_srw_shared( lock ) != STATUS_NOT_IMPLEMENTED)
+        return;
+
     srwlock_leave_shared( lock, srwlock_lock_exclusive( (unsigned int *)&lock->Ptr,
                           - SRWLOCK_RES_SHARED ) - SRWLOCK_RES_SHARED );
 }
@@ -1760,6 +2229,11 @@ void WINAPI RtlReleaseSRWLockShared( RTL_SRWLOCK *lock )
  */
 BOOLEAN WINAPI RtlTryAcquireSRWLockExclusive( RTL_SRWLOCK *lock )
 {
+    NTSTATUS ret;
+
+    if ((ret = fast_try_acquire_srw_exclusive( lock )) != STATUS_NOT_IMPLEMENTED)
+        return (ret == STATUS_SUCCESS);
+
     return interlocked_cmpxchg( (int *)&lock->Ptr, SRWLOCK_MASK_IN_EXCLUSIVE |
                                 SRWLOCK_RES_EXCLUSIVE, 0 ) == 0;
 }
@@ -1770,6 +2244,11 @@ BOOLEAN WINAPI RtlTryAcquireSRWLockExclusive( RTL_SRWLOCK *lock )
 BOOLEAN WINAPI RtlTryAcquireSRWLockShared( RTL_SRWLOCK *lock )
 {
     unsigned int val, tmp;
+    NTSTATUS ret;
+
+    if ((ret = fast_try_acquire_srw_shared( lock )) != STATUS_NOT_IMPLEMENTED)
+        return (ret == STATUS_SUCCESS);
+
     for (val = *(unsigned int *)&lock->Ptr;; val = tmp)
     {
         if (val & SRWLOCK_MASK_EXCLUSIVE_QUEUE)
@@ -1813,6 +2292,9 @@ void WINAPI RtlInitializeConditionVariable( RTL_CONDITION_VARIABLE *variable )
  */
 void WINAPI RtlWakeConditionVariable( RTL_CONDITION_VARIABLE *variable )
 {
+    if (fast_wake_cv( variable, 1 ) != STATUS_NOT_IMPLEMENTED)
+        return;
+
     if (interlocked_dec_if_nonzero( (int *)&variable->Ptr ))
         NtReleaseKeyedEvent( keyed_event, &variable->Ptr, FALSE, NULL );
 }
@@ -1824,7 +2306,12 @@ void WINAPI RtlWakeConditionVariable( RTL_CONDITION_VARIABLE *variable )
  */
 void WINAPI RtlWakeAllConditionVariable( RTL_CONDITION_VARIABLE *variable )
 {
-    int val = interlocked_xchg( (int *)&variable->Ptr, 0 );
+    int val;
+
+    if (fast_wake_cv( variable, INT_MAX ) != STATUS_NOT_IMPLEMENTED)
+        return;
+
+    val = interlocked_xchg( (int *)&variable->Ptr, 0 );
     while (val-- > 0)
         NtReleaseKeyedEvent( keyed_event, &variable->Ptr, FALSE, NULL );
 }
@@ -1848,14 +2335,19 @@ NTSTATUS WINAPI RtlSleepConditionVariableCS( RTL_CONDITION_VARIABLE *variable, R
                                              const LARGE_INTEGER *timeout )
 {
     NTSTATUS status;
-    interlocked_xchg_add( (int *)&variable->Ptr, 1 );
+    int val = *(int *)&variable->Ptr;
+
+    if (!use_futexes()) interlocked_xchg_add( (int *)&variable->Ptr, 1 );
     RtlLeaveCriticalSection( crit );
 
-    status = NtWaitForKeyedEvent( keyed_event, &variable->Ptr, FALSE, timeout );
-    if (status != STATUS_SUCCESS)
+    if ((status = fast_wait_cv( variable, val, timeout )) == STATUS_NOT_IMPLEMENTED)
     {
-        if (!interlocked_dec_if_nonzero( (int *)&variable->Ptr ))
-            status = NtWaitForKeyedEvent( keyed_event, &variable->Ptr, FALSE, NULL );
+        status = NtWaitForKeyedEvent( keyed_event, &variable->Ptr, FALSE, timeout );
+        if (status != STATUS_SUCCESS)
+        {
+            if (!interlocked_dec_if_nonzero( (int *)&variable->Ptr ))
+                status = NtWaitForKeyedEvent( keyed_event, &variable->Ptr, FALSE, NULL );
+        }
     }
 
     RtlEnterCriticalSection( crit );
@@ -1885,18 +2377,23 @@ NTSTATUS WINAPI RtlSleepConditionVariableSRW( RTL_CONDITION_VARIABLE *variable,
                                               const LARGE_INTEGER *timeout, ULONG flags )
 {
     NTSTATUS status;
-    interlocked_xchg_add( (int *)&variable->Ptr, 1 );
+    int val = *(int *)&variable->Ptr;
+
+    if (!use_futexes()) interlocked_xchg_add( (int *)&variable->Ptr, 1 );
 
     if (flags & RTL_CONDITION_VARIABLE_LOCKMODE_SHARED)
         RtlReleaseSRWLockShared( lock );
     else
         RtlReleaseSRWLockExclusive( lock );
 
-    status = NtWaitForKeyedEvent( keyed_event, &variable->Ptr, FALSE, timeout );
-    if (status != STATUS_SUCCESS)
+    if ((status = fast_wait_cv( variable, val, timeout )) == STATUS_NOT_IMPLEMENTED)
     {
-        if (!interlocked_dec_if_nonzero( (int *)&variable->Ptr ))
-            status = NtWaitForKeyedEvent( keyed_event, &variable->Ptr, FALSE, NULL );
+        status = NtWaitForKeyedEvent( keyed_event, &variable->Ptr, FALSE, timeout );
+        if (status != STATUS_SUCCESS)
+        {
+            if (!interlocked_dec_if_nonzero( (int *)&variable->Ptr ))
+                status = NtWaitForKeyedEvent( keyed_event, &variable->Ptr, FALSE, NULL );
+        }
     }
 
     if (flags & RTL_CONDITION_VARIABLE_LOCKMODE_SHARED)
@@ -1905,3 +2402,183 @@ NTSTATUS WINAPI RtlSleepConditionVariableSRW( RTL_CONDITION_VARIABLE *variable,
         RtlAcquireSRWLockExclusive( lock );
     return status;
 }
+
+static inline BOOL compare_addr( const void *addr, const void *cmp, SIZE_T size )
+{
+    switch (size)
+    {
+        case 1:
+            return (*(const volatile UCHAR *)addr == *(const UCHAR *)cmp);
+        case 2:
+            return (*(const volatile USHORT *)addr == *(const USHORT *)cmp);
+        case 4:
+            return (*(const volatile ULONG *)addr == *(const ULONG *)cmp);
+        case 8:
+            return (*(const volatile ULONG64 *)addr == *(const ULONG64 *)cmp);
+    }
+
+    return FALSE;
+}
+
+#ifdef __linux__
+
+/* Futexes only work on 32-bit values, so waiters for an address sleep on one
+ * of a few wake counters selected by hashing the address; wakers bump the
+ * counter, which also covers a wake racing with the comparison. */
+static int addr_futex_table[256];
+
+static inline int *hash_addr( const void *addr )
+{
+    ULONG_PTR val = (ULONG_PTR)addr;
+    return &addr_futex_table[(val >> 2) & 255];
+}
+
+static NTSTATUS fast_wait_addr( const void *addr, const void *cmp, SIZE_T size,
+                                const LARGE_INTEGER *timeout )
+{
+    int *futex, val;
+
+    if (!use_futexes()) return STATUS_NOT_IMPLEMENTED;
+
+    futex = hash_addr( addr );
+
+    /* read the counter before comparing, so that a wake in between makes the wait return */
+    val = interlocked_cmpxchg( futex, 0, 0 );
+    if (!compare_addr( addr, cmp, size )) return STATUS_SUCCESS;
+
+    return futex_wait_timeout( futex, val, timeout );
+}
+
+static NTSTATUS fast_wake_addr( const void *addr )
+{
+    int *futex;
+
+    if (!use_futexes()) return STATUS_NOT_IMPLEMENTED;
+
+    futex = hash_addr( addr );
+    interlocked_xchg_add( futex, 1 );
+    futex_wake( futex, INT_MAX );
+    return STATUS_SUCCESS;
+}
+
+#else
+
+static inline NTSTATUS fast_wait_addr( const void *addr, const void *cmp, SIZE_T size,
+                                       const LARGE_INTEGER *timeout )
+{
+    return STATUS_NOT_IMPLEMENTED;
+}
+
+static inline NTSTATUS fast_wake_addr( const void *addr )
+{
+    return STATUS_NOT_IMPLEMENTED;
+}
+
+#endif
+
+/* keyed event fallback: each waiter queues itself and waits on its own key */
+struct addr_wait
+{
+    struct list       entry;
+    const void       *addr;
+    struct addr_wait *next_woken;
+    BOOL              woken;
+};
+
+static struct list addr_wait_list = LIST_INIT( addr_wait_list );
+
+static RTL_CRITICAL_SECTION addr_section;
+static RTL_CRITICAL_SECTION_DEBUG addr_section_debug =
+{
+    0, 0, &addr_section,
+    { &addr_section_debug.ProcessLocksList, &addr_section_debug.ProcessLocksList },
+      0, 0, { (DWORD_PTR)(__FILE__ ": addr_section") }
+};
+static RTL_CRITICAL_SECTION addr_section = { &addr_section_debug, -1, 0, 0, 0, 0 };
+
+static void wake_addr_waiters( const void *addr, BOOL all )
+{
+    struct addr_wait *wait, *next, *woken = NULL;
+
+    RtlEnterCriticalSection( &addr_section );
+    LIST_FOR_EACH_ENTRY_SAFE( wait, next, &addr_wait_list, struct addr_wait, entry )
+    {
+        if (wait->addr != addr) continue;
+        list_remove( &wait->entry );
+        wait->woken = TRUE;
+        wait->next_woken = woken;
+        woken = wait;
+        if (!all) break;
+    }
+    RtlLeaveCriticalSection( &addr_section );
+
+    /* a released waiter returns and frees its entry, so fetch the next one first */
+    while ((wait = woken))
+    {
+        woken = wait->next_woken;
+        NtReleaseKeyedEvent( keyed_event, wait, FALSE, NULL );
+    }
+}
+
+/***********************************************************************
+ *           RtlWaitOnAddress   (NTDLL.@)
+ */
+NTSTATUS WINAPI RtlWaitOnAddress( const void *addr, const void *cmp, SIZE_T size,
+                                  const LARGE_INTEGER *timeout )
+{
+    struct addr_wait wait;
+    NTSTATUS status;
+
+    if (size != 1 && size != 2 && size != 4 && size != 8)
+        return STATUS_INVALID_PARAMETER;
+
+    if ((status = fast_wait_addr( addr, cmp, size, timeout )) != STATUS_NOT_IMPLEMENTED)
+        return status;
+
+    RtlEnterCriticalSection( &addr_section );
+    if (!compare_addr( addr, cmp, size ))
+    {
+        RtlLeaveCriticalSection( &addr_section );
+        return STATUS_SUCCESS;
+    }
+    wait.addr  = addr;
+    wait.woken = FALSE;
+    list_add_tail( &addr_wait_list, &wait.entry );
+    RtlLeaveCriticalSection( &addr_section );
+
+    status = NtWaitForKeyedEvent( keyed_event, &wait, FALSE, timeout );
+    if (status != STATUS_SUCCESS)
+    {
+        BOOL woken;
+
+        RtlEnterCriticalSection( &addr_section );
+        if (!(woken = wait.woken)) list_remove( &wait.entry );
+        RtlLeaveCriticalSection( &addr_section );
+
+        /* a waker already picked us, wait for its release */
+        if (woken) status = NtWaitForKeyedEvent( keyed_event, &wait, FALSE, NULL );
+    }
+    return status;
+}
+
+/***********************************************************************
+ *           RtlWakeAddressAll   (NTDLL.@)
+ */
+void WINAPI RtlWakeAddressAll( const void *addr )
+{
+    if (fast_wake_addr( addr ) != STATUS_NOT_IMPLEMENTED)
+        return;
+
+    wake_addr_waiters( addr, TRUE );
+}
+
+/***********************************************************************
+ *           RtlWakeAddressSingle   (NTDLL.@)
+ */
+void WINAPI RtlWakeAddressSingle( const void *addr )
+{
+    if (fast_wake_addr( addr ) != STATUS_NOT_IMPLEMENTED)
+        return;
+
+    wake_addr_waiters( addr, FALSE );
+}
@@ -873,6 +873,80 @@ static void test_redirection(void)
     pRtlWow64EnableFsRedirectionEx( old, &cur );
 }
 
+/* Look up mixed-case names in a directory, and check that changes to it are noticed */
+static void test_case_insensitive_lookup(void)
+{
+    static const char * const formats[] = { "%s\\FILE%02u.DAT", "%s\\fIlE%02u.dAt", "%s\\file%02u.dat" };
+    char testdir[MAX_PATH], path[MAX_PATH], path2[MAX_PATH];
+    unsigned int i, j, count;
+    DWORD attrs;
+    HANDLE h;
+
+    GetTempPathA( MAX_PATH, testdir );
+    strcat( testdir, "caselookup" );
+    if (!CreateDirectoryA( testdir, NULL ))
+    {
+        skip( "couldn't create %s, error %u\n", testdir, GetLastError() );
+        return;
+    }
+
+    for (count = 0; count < 50; count++)
+    {
+        sprintf( path, "%s\\File%02u.Dat", testdir, count );
+        h = CreateFileA( path, GENERIC_WRITE, 0, NULL, CREATE_NEW, 0, NULL );
+        if (h == INVALID_HANDLE_VALUE) break;
+        CloseHandle( h );
+    }
+    ok( count == 50, "only created %u files, error %u\n", count, GetLastError() );
+
+    for (i = 0; i < 2 * count; i++)
+    {
+        for (j = 0; j < sizeof(formats) / sizeof(formats[0]); j++)
+        {
+            sprintf( path, formats[j], testdir, i );
+            attrs = GetFileAttributesA( path );
+            ok( (attrs != INVALID_FILE_ATTRIBUTES) == (i < count), "lookup of %s returned %#x\n", path, attrs );
+        }
+    }
+
+    /* changes must be visible right away, also once most of the names are gone */
+    for (i = 0; i < count; i += 5)
+    {
+        for (j = i; j < i + 4; j++)
+        {
+            sprintf( path, "%s\\File%02u.Dat", testdir, j );
+            ok( DeleteFileA( path ), "failed to delete %s, error %u\n", path, GetLastError() );
+        }
+    }
+    for (i = 0; i < count; i++)
+    {
+        sprintf( path, formats[i % 3], testdir, i );
+        attrs = GetFileAttributesA( path );
+        ok( (attrs != INVALID_FILE_ATTRIBUTES) == (i % 5 == 4), "lookup of %s returned %#x\n", path, attrs );
+    }
+
+    sprintf( path, "%s\\NewFile.Txt", testdir );
+    h = CreateFileA( path, GENERIC_WRITE, 0, NULL, CREATE_NEW, 0, NULL );
+    ok( h != INVALID_HANDLE_VALUE, "failed to create %s, error %u\n", path, GetLastError() );
+    CloseHandle( h );
+    sprintf( path, "%s\\NEWFILE.TXT", testdir );
+    ok( GetFileAttributesA( path ) != INVALID_FILE_ATTRIBUTES, "%s not found\n", path );
+
+    sprintf( path2, "%s\\Renamed.Txt", testdir );
+    ok( MoveFileA( path, path2 ), "failed to rename %s, error %u\n", path, GetLastError() );
+    ok( GetFileAttributesA( path ) == INVALID_FILE_ATTRIBUTES, "%s still exists\n", path );
+    sprintf( path, "%s\\rENAMED.tXT", testdir );
+    ok( GetFileAttributesA( path ) != INVALID_FILE_ATTRIBUTES, "%s not found\n", path );
+    DeleteFileA( path2 );
+
+    for (i = 4; i < count; i += 5)
+    {
+        sprintf( path, "%s\\File%02u.Dat", testdir, i );
+        DeleteFileA( path );
+    }
+    RemoveDirectoryA( testdir );
+}
+
 START_TEST(directory)
 {
     WCHAR sysdir[MAX_PATH];
@@ -902,4 +976,5 @@ START_TEST(directory)
     test_NtQueryDirectoryFile();
     test_NtQueryDirectoryFile_case();
     test_redirection();
+    test_case_insensitive_lookup();
 }
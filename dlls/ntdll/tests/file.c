@@ -4459,6 +4459,74 @@ static void test_flush_buffers_file(void)
     DeleteFileA(buffer);
 }
 
+static DWORD WINAPI flush_thread(void *arg)
+{
+    IO_STATUS_BLOCK io;
+    char buffer[4096];
+    DWORD i, written;
+    NTSTATUS status;
+
+    memset(buffer, 0x55, sizeof(buffer));
+    for (i = 0; i < 20; i++)
+    {
+        if (!WriteFile(arg, buffer, sizeof(buffer), &written, NULL)) break;
+        status = pNtFlushBuffersFile(arg, &io);
+        if (status) break;
+    }
+    return i;
+}
+
+static void test_flush_overlapped(void)
+{
+    char path[MAX_PATH], buffer[MAX_PATH], data[16];
+    HANDLE file, threads[4];
+    IO_STATUS_BLOCK io;
+    OVERLAPPED ovl;
+    NTSTATUS status;
+    DWORD i, ret;
+    BOOL res;
+
+    GetTempPathA(MAX_PATH, path);
+    GetTempFileNameA(path, "foo", 0, buffer);
+    file = CreateFileA(buffer, GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+                       FILE_FLAG_OVERLAPPED | FILE_FLAG_DELETE_ON_CLOSE, 0);
+    ok(file != INVALID_HANDLE_VALUE, "failed to create temp file\n");
+
+    memset(&ovl, 0, sizeof(ovl));
+    ovl.hEvent = CreateEventA(NULL, TRUE, FALSE, NULL);
+    memset(data, 0xaa, sizeof(data));
+    res = WriteFile(file, data, sizeof(data), NULL, &ovl);
+    if (!res && GetLastError() == ERROR_IO_PENDING)
+        res = GetOverlappedResult(file, &ovl, &ret, TRUE);
+    ok(res, "WriteFile failed: %u\n", GetLastError());
+    CloseHandle(ovl.hEvent);
+
+    /* flushing is synchronous even on overlapped handles */
+    status = pNtFlushBuffersFile(file, &io);
+    ok(status == STATUS_SUCCESS, "expected STATUS_SUCCESS, got %#x\n", status);
+
+    SetLastError(0xdeadbeef);
+    res = FlushFileBuffers(file);
+    ok(res, "FlushFileBuffers failed: %u\n", GetLastError());
+    CloseHandle(file);
+
+    /* flushes running concurrently from several threads */
+    file = CreateFileA(buffer, GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+                       FILE_FLAG_DELETE_ON_CLOSE, 0);
+    ok(file != INVALID_HANDLE_VALUE, "failed to create temp file\n");
+    for (i = 0; i < sizeof(threads) / sizeof(threads[0]); i++)
+        threads[i] = CreateThread(NULL, 0, flush_thread, file, 0, NULL);
+    ret = WaitForMultipleObjects(sizeof(threads) / sizeof(threads[0]), threads, TRUE, 60000);
+    ok(ret == WAIT_OBJECT_0, "waiting for threads failed: %u\n", ret);
+    for (i = 0; i < sizeof(threads) / sizeof(threads[0]); i++)
+    {
+        GetExitCodeThread(threads[i], &ret);
+        ok(ret == 20, "thread %u did %u flushes\n", i, ret);
+        CloseHandle(threads[i]);
+    }
+    CloseHandle(file);
+}
+
 static void test_query_ea(void)
 {
     #define EA_BUFFER_SIZE 4097
@@ -4776,6 +4844,7 @@ START_TEST(file)
     test_query_attribute_information_file();
     test_ioctl();
     test_flush_buffers_file();
+    test_flush_overlapped();
     test_query_ea();
     test_junction_points();
 }
@@ -0,0 +1,274 @@
+/*
+ * Unit tests for the ntdll heap functions
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+#include "ntdll_test.h"
+
+static PVOID    (WINAPI *pRtlAllocateHeap)(HANDLE,ULONG,SIZE_T);
+static HANDLE   (WINAPI *pRtlCreateHeap)(ULONG,PVOID,SIZE_T,SIZE_T,PVOID,PRTL_HEAP_DEFINITION);
+static HANDLE   (WINAPI *pRtlDestroyHeap)(HANDLE);
+static BOOLEAN  (WINAPI *pRtlFreeHeap)(HANDLE,ULONG,PVOID);
+static NTSTATUS (WINAPI *pRtlQueryHeapInformation)(HANDLE,HEAP_INFORMATION_CLASS,PVOID,SIZE_T,PSIZE_T);
+static PVOID    (WINAPI *pRtlReAllocateHeap)(HANDLE,ULONG,PVOID,SIZE_T);
+static NTSTATUS (WINAPI *pRtlSetHeapInformation)(HANDLE,HEAP_INFORMATION_CLASS,PVOID,SIZE_T);
+static SIZE_T   (WINAPI *pRtlSizeHeap)(HANDLE,ULONG,const void *);
+static BOOLEAN  (WINAPI *pRtlValidateHeap)(HANDLE,ULONG,LPCVOID);
+static NTSTATUS (WINAPI *pRtlWalkHeap)(HANDLE,PVOID);
+
+#define NTDLL_GET_PROC(func) \
+    p ## func = (void *)GetProcAddress(hntdll, #func)
+
+static void init_pointers(void)
+{
+    HMODULE hntdll = GetModuleHandleA("ntdll.dll");
+
+    NTDLL_GET_PROC(RtlAllocateHeap);
+    NTDLL_GET_PROC(RtlCreateHeap);
+    NTDLL_GET_PROC(RtlDestroyHeap);
+    NTDLL_GET_PROC(RtlFreeHeap);
+    NTDLL_GET_PROC(RtlQueryHeapInformation);
+    NTDLL_GET_PROC(RtlReAllocateHeap);
+    NTDLL_GET_PROC(RtlSetHeapInformation);
+    NTDLL_GET_PROC(RtlSizeHeap);
+    NTDLL_GET_PROC(RtlValidateHeap);
+    NTDLL_GET_PROC(RtlWalkHeap);
+}
+
+static HANDLE create_lfh_heap(void)
+{
+    ULONG info = 2;
+    NTSTATUS status;
+    HANDLE heap;
+
+    heap = pRtlCreateHeap(HEAP_GROWABLE, NULL, 0, 0, NULL, NULL);
+    ok(heap != NULL, "RtlCreateHeap failed\n");
+    status = pRtlSetHeapInformation(heap, HeapCompatibilityInformation, &info, sizeof(info));
+    ok(!status, "RtlSetHeapInformation failed: %#x\n", status);
+    return heap;
+}
+
+static void test_lfh(void)
+{
+    static const SIZE_T sizes[] = { 0, 1, 15, 16, 17, 255, 256, 257, 1000, 4096, 16383, 16384, 16385, 100000 };
+    void *ptrs[sizeof(sizes) / sizeof(sizes[0])], *ptr;
+    ULONG info;
+    SIZE_T size;
+    NTSTATUS status;
+    BOOLEAN ret;
+    HANDLE heap;
+    unsigned int i, j;
+
+    if (!pRtlSetHeapInformation || !pRtlQueryHeapInformation)
+    {
+        win_skip("RtlSetHeapInformation not supported, skipping test\n");
+        return;
+    }
+
+    heap = pRtlCreateHeap(HEAP_GROWABLE, NULL, 0, 0, NULL, NULL);
+    ok(heap != NULL, "RtlCreateHeap failed\n");
+
+    info = 0xdeadbeef;
+    status = pRtlQueryHeapInformation(heap, HeapCompatibilityInformation, &info, sizeof(info), &size);
+    ok(!status, "RtlQueryHeapInformation failed: %#x\n", status);
+    ok(info == 0 || info == 2, "got %u\n", info);
+
+    info = 2;
+    status = pRtlSetHeapInformation(heap, HeapCompatibilityInformation, &info, 0);
+    ok(status == STATUS_BUFFER_TOO_SMALL, "got %#x\n", status);
+    status = pRtlSetHeapInformation(heap, HeapCompatibilityInformation, &info, sizeof(info));
+    ok(!status, "RtlSetHeapInformation failed: %#x\n", status);
+    /* enabling it twice is fine */
+    status = pRtlSetHeapInformation(heap, HeapCompatibilityInformation, &info, sizeof(info));
+    ok(!status, "RtlSetHeapInformation failed: %#x\n", status);
+
+    info = 0xdeadbeef;
+    status = pRtlQueryHeapInformation(heap, HeapCompatibilityInformation, &info, sizeof(info), &size);
+    ok(!status, "RtlQueryHeapInformation failed: %#x\n", status);
+    ok(info == 2, "got %u\n", info);
+
+    for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+    {
+        ptrs[i] = pRtlAllocateHeap(heap, HEAP_ZERO_MEMORY, sizes[i]);
+        ok(ptrs[i] != NULL, "failed to allocate %lu bytes\n", sizes[i]);
+        ok(!((ULONG_PTR)ptrs[i] % (2 * sizeof(void *))), "got unaligned block %p\n", ptrs[i]);
+        for (j = 0; j < sizes[i]; j++)
+            if (((BYTE *)ptrs[i])[j]) break;
+        ok(j == sizes[i], "block %p of %lu bytes not zeroed at %u\n", ptrs[i], sizes[i], j);
+        memset(ptrs[i], 0x55, sizes[i]);
+        size = pRtlSizeHeap(heap, 0, ptrs[i]);
+        ok(size == sizes[i], "expected %lu, got %lu\n", sizes[i], size);
+        ok(pRtlValidateHeap(heap, 0, ptrs[i]), "block %p is not valid\n", ptrs[i]);
+    }
+
+    for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+    {
+        /* growing keeps the contents, and zeroes the new part if requested */
+        ptr = pRtlReAllocateHeap(heap, HEAP_ZERO_MEMORY, ptrs[i], sizes[i] + 100);
+        ok(ptr != NULL, "failed to reallocate %lu bytes\n", sizes[i] + 100);
+        if (!ptr) continue;
+        for (j = 0; j < sizes[i]; j++)
+            if (((BYTE *)ptr)[j] != 0x55) break;
+        ok(j == sizes[i], "block %p contents changed at %u\n", ptr, j);
+        for (; j < sizes[i] + 100; j++)
+            if (((BYTE *)ptr)[j]) break;
+        ok(j == sizes[i] + 100, "block %p not zeroed at %u\n", ptr, j);
+        size = pRtlSizeHeap(heap, 0, ptr);
+        ok(size == sizes[i] + 100, "expected %lu, got %lu\n", sizes[i] + 100, size);
+
+        ptr = pRtlReAllocateHeap(heap, 0, ptr, sizes[i]);
+        ok(ptr != NULL, "failed to reallocate %lu bytes\n", sizes[i]);
+        size = pRtlSizeHeap(heap, 0, ptr);
+        ok(size == sizes[i], "expected %lu, got %lu\n", sizes[i], size);
+        ptrs[i] = ptr;
+    }
+
+    for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+    {
+        ret = pRtlFreeHeap(heap, 0, ptrs[i]);
+        ok(ret, "failed to free %p\n", ptrs[i]);
+    }
+
+    /* the front end can't be disabled */
+    info = 0;
+    status = pRtlSetHeapInformation(heap, HeapCompatibilityInformation, &info, sizeof(info));
+    ok(status == STATUS_UNSUCCESSFUL, "got %#x\n", status);
+
+    ok(pRtlValidateHeap(heap, 0, NULL), "heap is not valid\n");
+    pRtlDestroyHeap(heap);
+
+    /* heaps that aren't serialized can't use it */
+    heap = pRtlCreateHeap(HEAP_GROWABLE | HEAP_NO_SERIALIZE, NULL, 0, 0, NULL, NULL);
+    ok(heap != NULL, "RtlCreateHeap failed\n");
+    info = 2;
+    status = pRtlSetHeapInformation(heap, HeapCompatibilityInformation, &info, sizeof(info));
+    ok(status == STATUS_UNSUCCESSFUL, "got %#x\n", status);
+    pRtlDestroyHeap(heap);
+}
+
+static void test_lfh_pointers(void)
+{
+    PROCESS_HEAP_ENTRY entry;
+    BOOL found = FALSE;
+    char stack_buf[64];
+    char *ptr, *ptr2;
+    HANDLE heap;
+
+    if (!pRtlSetHeapInformation || !pRtlWalkHeap)
+    {
+        win_skip("RtlSetHeapInformation or RtlWalkHeap not supported, skipping test\n");
+        return;
+    }
+
+    heap = create_lfh_heap();
+    ptr = pRtlAllocateHeap(heap, 0, 24);
+    ok(ptr != NULL, "RtlAllocateHeap failed\n");
+    ptr2 = pRtlAllocateHeap(heap, 0, 24);
+    ok(ptr2 != NULL, "RtlAllocateHeap failed\n");
+
+    ok(pRtlValidateHeap(heap, 0, ptr), "block %p is not valid\n", ptr);
+    ok(!pRtlValidateHeap(heap, 0, ptr + 8), "interior pointer %p is valid\n", ptr + 8);
+    ok(!pRtlValidateHeap(heap, 0, ptr + 16), "interior pointer %p is valid\n", ptr + 16);
+    ok(!pRtlValidateHeap(heap, 0, stack_buf + 16), "stack pointer %p is valid\n", stack_buf + 16);
+
+    memset(&entry, 0, sizeof(entry));
+    while (!pRtlWalkHeap(heap, &entry))
+    {
+        if (entry.lpData != ptr) continue;
+        ok(entry.wFlags & PROCESS_HEAP_ENTRY_BUSY, "got flags %#x\n", entry.wFlags);
+        ok(entry.cbData >= 24, "got size %u\n", entry.cbData);
+        found = TRUE;
+    }
+    ok(found, "block %p not reported by RtlWalkHeap\n", ptr);
+
+    ok(pRtlFreeHeap(heap, 0, ptr), "failed to free %p\n", ptr);
+    ok(pRtlValidateHeap(heap, 0, ptr2), "block %p is not valid\n", ptr2);
+    ok(pRtlFreeHeap(heap, 0, ptr2), "failed to free %p\n", ptr2);
+    ok(pRtlValidateHeap(heap, 0, NULL), "heap is not valid\n");
+    pRtlDestroyHeap(heap);
+}
+
+#define LFH_THREADS     4
+#define LFH_SLOTS       256
+#define LFH_ITERATIONS  20000
+
+static HANDLE lfh_thread_heap;
+
+static DWORD WINAPI lfh_thread(void *arg)
+{
+    unsigned char *slots[LFH_SLOTS] = { NULL };
+    DWORD seed = (DWORD_PTR)arg, failures = 0;
+    unsigned int i, idx;
+
+    for (i = 0; i < LFH_ITERATIONS; i++)
+    {
+        seed = seed * 1103515245 + 12345;
+        idx = (seed >> 16) % LFH_SLOTS;
+        if (slots[idx])
+        {
+            /* make sure nobody else handed out the same block */
+            if (slots[idx][0] != (unsigned char)idx) failures++;
+            if (!pRtlFreeHeap(lfh_thread_heap, 0, slots[idx])) failures++;
+            slots[idx] = NULL;
+        }
+        else if (!(slots[idx] = pRtlAllocateHeap(lfh_thread_heap, 0, 8 + (seed >> 8) % 512)))
+            failures++;
+        else
+            memset(slots[idx], idx, 8);
+    }
+    for (i = 0; i < LFH_SLOTS; i++)
+        if (slots[i] && !pRtlFreeHeap(lfh_thread_heap, 0, slots[i])) failures++;
+
+    return failures;
+}
+
+static void test_lfh_threads(void)
+{
+    HANDLE threads[LFH_THREADS];
+    DWORD ret, failures;
+    unsigned int i;
+
+    if (!pRtlSetHeapInformation)
+    {
+        win_skip("RtlSetHeapInformation not supported, skipping test\n");
+        return;
+    }
+
+    lfh_thread_heap = create_lfh_heap();
+    for (i = 0; i < LFH_THREADS; i++)
+        threads[i] = CreateThread(NULL, 0, lfh_thread, (void *)(DWORD_PTR)(i + 1), 0, NULL);
+    ret = WaitForMultipleObjects(LFH_THREADS, threads, TRUE, 60000);
+    ok(ret == WAIT_OBJECT_0, "waiting for threads failed: %u\n", ret);
+
+    for (i = 0; i < LFH_THREADS; i++)
+    {
+        GetExitCodeThread(threads[i], &failures);
+        ok(!failures, "thread %u got %u failures\n", i, failures);
+        CloseHandle(threads[i]);
+    }
+
+    ok(pRtlValidateHeap(lfh_thread_heap, 0, NULL), "heap is not valid\n");
+    pRtlDestroyHeap(lfh_thread_heap);
+}
+
+START_TEST(heap)
+{
+    init_pointers();
+
+    test_lfh();
+    test_lfh_pointers();
+    test_lfh_threads();
+}
@@ -2094,6 +2094,132 @@ static void test_mutant(void)
     NtClose( mutant );
 }
 
+static HANDLE close_thread_handle;
+static volatile LONG close_thread_state;
+
+static DWORD WINAPI close_thread_proc( void *arg )
+{
+    NTSTATUS status = pNtClose( close_thread_handle );
+    InterlockedExchange( &close_thread_state, status ? -1 : 1 );
+    /* no server calls until the main thread has checked the handle */
+    while (close_thread_state != 2) Sleep( 0 );
+    return 0;
+}
+
+static void test_handle_churn(void)
+{
+    HANDLE handle, dup, handles[200], thread;
+    unsigned int i;
+    NTSTATUS status;
+    DWORD ret;
+
+    /* closed handles must be gone for any later use */
+    handle = CreateEventA( NULL, FALSE, FALSE, NULL );
+    ok( handle != NULL, "CreateEvent failed, error %u\n", GetLastError() );
+    status = pNtClose( handle );
+    ok( status == STATUS_SUCCESS, "NtClose returned %08x\n", status );
+    SetLastError( 0xdeadbeef );
+    ret = SetEvent( handle );
+    ok( !ret && GetLastError() == ERROR_INVALID_HANDLE, "SetEvent returned %d, error %u\n", ret, GetLastError() );
+    status = pNtClose( handle );
+    ok( status == STATUS_INVALID_HANDLE, "NtClose returned %08x\n", status );
+
+    handle = CreateSemaphoreA( NULL, 0, 1, NULL );
+    ok( handle != NULL, "CreateSemaphore failed, error %u\n", GetLastError() );
+    status = pNtClose( handle );
+    ok( status == STATUS_SUCCESS, "NtClose returned %08x\n", status );
+    status = pNtClose( handle );
+    ok( status == STATUS_INVALID_HANDLE, "NtClose returned %08x\n", status );
+
+    /* protected handles can't be closed */
+    handle = CreateEventA( NULL, FALSE, FALSE, NULL );
+    ok( handle != NULL, "CreateEvent failed, error %u\n", GetLastError() );
+    ret = SetHandleInformation( handle, HANDLE_FLAG_PROTECT_FROM_CLOSE, HANDLE_FLAG_PROTECT_FROM_CLOSE );
+    ok( ret, "SetHandleInformation failed, error %u\n", GetLastError() );
+    status = pNtClose( handle );
+    ok( status == STATUS_HANDLE_NOT_CLOSABLE, "NtClose returned %08x\n", status );
+    ret = SetHandleInformation( handle, HANDLE_FLAG_PROTECT_FROM_CLOSE, 0 );
+    ok( ret, "SetHandleInformation failed, error %u\n", GetLastError() );
+    status = pNtClose( handle );
+    ok( status == STATUS_SUCCESS, "NtClose returned %08x\n", status );
+
+    /* closing a handle doesn't affect its duplicates */
+    handle = CreateEventA( NULL, TRUE, FALSE, NULL );
+    ok( handle != NULL, "CreateEvent failed, error %u\n", GetLastError() );
+    ret = DuplicateHandle( GetCurrentProcess(), handle, GetCurrentProcess(), &dup, 0, FALSE, DUPLICATE_SAME_ACCESS );
+    ok( ret, "DuplicateHandle failed, error %u\n", GetLastError() );
+    status = pNtClose( handle );
+    ok( status == STATUS_SUCCESS, "NtClose returned %08x\n", status );
+    ret = SetEvent( dup );
+    ok( ret, "SetEvent failed, error %u\n", GetLastError() );
+    ok( !WaitForSingleObject( dup, 0 ), "event not signaled\n" );
+    status = pNtClose( dup );
+    ok( status == STATUS_SUCCESS, "NtClose returned %08x\n", status );
+
+    /* more handles than can be queued at once */
+    for (i = 0; i < sizeof(handles) / sizeof(handles[0]); i++)
+    {
+        handles[i] = CreateEventA( NULL, FALSE, FALSE, NULL );
+        ok( handles[i] != NULL, "%u: CreateEvent failed, error %u\n", i, GetLastError() );
+    }
+    for (i = 0; i < sizeof(handles) / sizeof(handles[0]); i++)
+    {
+        status = pNtClose( handles[i] );
+        ok( status == STATUS_SUCCESS, "%u: NtClose returned %08x\n", i, status );
+    }
+    for (i = 0; i < sizeof(handles) / sizeof(handles[0]); i++)
+    {
+        SetLastError( 0xdeadbeef );
+        ret = WaitForSingleObject( handles[i], 0 );
+        ok( ret == WAIT_FAILED && GetLastError() == ERROR_INVALID_HANDLE,
+            "%u: WaitForSingleObject returned %u, error %u\n", i, ret, GetLastError() );
+    }
+
+    /* a handle closed by another thread is gone for this thread too */
+    close_thread_handle = CreateEventA( NULL, FALSE, FALSE, NULL );
+    ok( close_thread_handle != NULL, "CreateEvent failed, error %u\n", GetLastError() );
+    close_thread_state = 0;
+    thread = CreateThread( NULL, 0, close_thread_proc, NULL, 0, NULL );
+    ok( thread != NULL, "CreateThread failed, error %u\n", GetLastError() );
+    while (!close_thread_state) Sleep( 0 );
+    ok( close_thread_state == 1, "NtClose failed in thread\n" );
+    SetLastError( 0xdeadbeef );
+    ret = SetEvent( close_thread_handle );
+    ok( !ret && GetLastError() == ERROR_INVALID_HANDLE, "SetEvent returned %d, error %u\n", ret, GetLastError() );
+    InterlockedExchange( &close_thread_state, 2 );
+    WaitForSingleObject( thread, INFINITE );
+    CloseHandle( thread );
+
+    /* a close of the source doesn't affect the new handle, even if it gets the same value */
+    handle = CreateEventA( NULL, TRUE, FALSE, NULL );
+    ok( handle != NULL, "CreateEvent failed, error %u\n", GetLastError() );
+    ret = DuplicateHandle( GetCurrentProcess(), handle, GetCurrentProcess(), &dup, 0, FALSE,
+                           DUPLICATE_SAME_ACCESS | DUPLICATE_CLOSE_SOURCE );
+    ok( ret, "DuplicateHandle failed, error %u\n", GetLastError() );
+    if (dup != handle)
+    {
+        status = pNtClose( handle );
+        ok( status == STATUS_INVALID_HANDLE, "NtClose returned %08x\n", status );
+    }
+    ret = SetEvent( dup );
+    ok( ret, "SetEvent failed, error %u\n", GetLastError() );
+    status = pNtClose( dup );
+    ok( status == STATUS_SUCCESS, "NtClose returned %08x\n", status );
+
+    /* values of closed handles are reused without stale closes */
+    handle = CreateEventA( NULL, TRUE, FALSE, NULL );
+    ok( handle != NULL, "CreateEvent failed, error %u\n", GetLastError() );
+    status = pNtClose( handle );
+    ok( status == STATUS_SUCCESS, "NtClose returned %08x\n", status );
+    dup = CreateEventA( NULL, TRUE, FALSE, NULL );
+    ok( dup != NULL, "CreateEvent failed, error %u\n", GetLastError() );
+    ret = SetEvent( dup );
+    ok( ret, "SetEvent failed, error %u\n", GetLastError() );
+    ok( !WaitForSingleObject( dup, 0 ), "event not signaled\n" );
+    status = pNtClose( dup );
+    ok( status == STATUS_SUCCESS, "NtClose returned %08x\n", status );
+}
+
 START_TEST(om)
 {
     HMODULE hntdll = GetModuleHandleA("ntdll.dll");
@@ -2161,4 +2287,5 @@ START_TEST(om)
     test_mutant();
     test_keyed_events();
     test_null_device();
+    test_handle_churn();
 }
@@ -1683,6 +1683,144 @@ static void test_redirection(void)
     pNtClose( key64 );
 }
 
+static void check_dword_value( HANDLE key, UNICODE_STRING *name, NTSTATUS expect_status, DWORD expect, int line )
+{
+    char buffer[FIELD_OFFSET(KEY_VALUE_PARTIAL_INFORMATION, Data[sizeof(DWORD)])];
+    KEY_VALUE_PARTIAL_INFORMATION *info = (KEY_VALUE_PARTIAL_INFORMATION *)buffer;
+    NTSTATUS status;
+    DWORD len;
+
+    status = pNtQueryValueKey( key, name, KeyValuePartialInformation, buffer, sizeof(buffer), &len );
+    ok_(__FILE__,line)( status == expect_status, "NtQueryValueKey returned %x, expected %x\n", status, expect_status );
+    if (status || expect_status) return;
+    ok_(__FILE__,line)( info->Type == REG_DWORD, "got type %u\n", info->Type );
+    ok_(__FILE__,line)( info->DataLength == sizeof(DWORD), "got length %u\n", info->DataLength );
+    ok_(__FILE__,line)( *(DWORD *)info->Data == expect, "got %u, expected %u\n", *(DWORD *)info->Data, expect );
+}
+
+/* repeated queries must see the changes made through other handles */
+static void test_value_cache(void)
+{
+    static const WCHAR subkeyW[] = {'c','a','c','h','e',0};
+    UNICODE_STRING name, upper, subname;
+    OBJECT_ATTRIBUTES attr;
+    HANDLE key1, key2, subkey;
+    NTSTATUS status;
+    DWORD value;
+    int i;
+
+    pRtlCreateUnicodeStringFromAsciiz( &name, "cachetest" );
+    pRtlCreateUnicodeStringFromAsciiz( &upper, "CACHETEST" );
+    InitializeObjectAttributes( &attr, &winetestpath, 0, 0, 0 );
+    status = pNtOpenKey( &key1, KEY_READ | KEY_SET_VALUE, &attr );
+    ok( status == STATUS_SUCCESS, "NtOpenKey failed: %x\n", status );
+    status = pNtOpenKey( &key2, KEY_READ | KEY_SET_VALUE, &attr );
+    ok( status == STATUS_SUCCESS, "NtOpenKey failed: %x\n", status );
+
+    check_dword_value( key1, &name, STATUS_OBJECT_NAME_NOT_FOUND, 0, __LINE__ );
+    check_dword_value( key1, &name, STATUS_OBJECT_NAME_NOT_FOUND, 0, __LINE__ );
+    for (i = 1; i <= 3; i++)
+    {
+        value = i;
+        status = pNtSetValueKey( key2, &name, 0, REG_DWORD, &value, sizeof(value) );
+        ok( status == STATUS_SUCCESS, "NtSetValueKey failed: %x\n", status );
+        check_dword_value( key1, &name, STATUS_SUCCESS, i, __LINE__ );
+        check_dword_value( key1, &upper, STATUS_SUCCESS, i, __LINE__ );
+        check_dword_value( key2, &name, STATUS_SUCCESS, i, __LINE__ );
+    }
+
+    status = pNtDeleteValueKey( key2, &name );
+    ok( status == STATUS_SUCCESS, "NtDeleteValueKey failed: %x\n", status );
+    check_dword_value( key1, &name, STATUS_OBJECT_NAME_NOT_FOUND, 0, __LINE__ );
+
+    value = 4;
+    status = pNtSetValueKey( key1, &upper, 0, REG_DWORD, &value, sizeof(value) );
+    ok( status == STATUS_SUCCESS, "NtSetValueKey failed: %x\n", status );
+    check_dword_value( key1, &name, STATUS_SUCCESS, 4, __LINE__ );
+
+    /* the handle value is likely to be reused for the next key */
+    pNtClose( key1 );
+    pRtlInitUnicodeString( &subname, subkeyW );
+    InitializeObjectAttributes( &attr, &subname, 0, key2, 0 );
+    status = pNtCreateKey( &subkey, KEY_ALL_ACCESS, &attr, 0, 0, 0, 0 );
+    ok( status == STATUS_SUCCESS, "NtCreateKey failed: %x\n", status );
+    check_dword_value( subkey, &name, STATUS_OBJECT_NAME_NOT_FOUND, 0, __LINE__ );
+
+    /* values of deleted keys can no longer be queried */
+    value = 5;
+    status = pNtSetValueKey( subkey, &name, 0, REG_DWORD, &value, sizeof(value) );
+    ok( status == STATUS_SUCCESS, "NtSetValueKey failed: %x\n", status );
+    check_dword_value( subkey, &name, STATUS_SUCCESS, 5, __LINE__ );
+    status = pNtDeleteKey( subkey );
+    ok( status == STATUS_SUCCESS, "NtDeleteKey failed: %x\n", status );
+    check_dword_value( subkey, &name, STATUS_KEY_DELETED, 0, __LINE__ );
+    pNtClose( subkey );
+
+    pNtDeleteValueKey( key2, &name );
+    pNtClose( key2 );
+    pRtlFreeUnicodeString( &name );
+    pRtlFreeUnicodeString( &upper );
+}
+
+/* a handle closed by another process must not return the values of its old key */
+static void test_value_cache_remote_close( const char *argv0 )
+{
+    static const WCHAR subkeyW[] = {'c','a','c','h','e',0};
+    UNICODE_STRING name, subname;
+    PROCESS_INFORMATION pi;
+    STARTUPINFOA si = { sizeof(si) };
+    OBJECT_ATTRIBUTES attr;
+    HANDLE key, key2, subkey;
+    char cmdline[MAX_PATH];
+    NTSTATUS status;
+    DWORD value = 6;
+    BOOL ret;
+
+    pRtlCreateUnicodeStringFromAsciiz( &name, "cachetest" );
+    InitializeObjectAttributes( &attr, &winetestpath, 0, 0, 0 );
+    status = pNtOpenKey( &key, KEY_READ | KEY_SET_VALUE, &attr );
+    ok( status == STATUS_SUCCESS, "NtOpenKey failed: %x\n", status );
+    status = pNtOpenKey( &key2, KEY_ALL_ACCESS, &attr );
+    ok( status == STATUS_SUCCESS, "NtOpenKey failed: %x\n", status );
+    status = pNtSetValueKey( key, &name, 0, REG_DWORD, &value, sizeof(value) );
+    ok( status == STATUS_SUCCESS, "NtSetValueKey failed: %x\n", status );
+    check_dword_value( key, &name, STATUS_SUCCESS, 6, __LINE__ );
+
+    sprintf( cmdline, "\"%s\" reg close %p %u", argv0, key, GetCurrentProcessId() );
+    ret = CreateProcessA( NULL, cmdline, NULL, NULL, FALSE, 0, NULL, NULL, &si, &pi );
+    ok( ret, "CreateProcess failed, error %u\n", GetLastError() );
+    winetest_wait_child_process( pi.hProcess );
+    CloseHandle( pi.hProcess );
+    CloseHandle( pi.hThread );
+
+    /* the handle value is likely to be reused for the next key */
+    pRtlInitUnicodeString( &subname, subkeyW );
+    InitializeObjectAttributes( &attr, &subname, 0, key2, 0 );
+    status = pNtCreateKey( &subkey, KEY_ALL_ACCESS, &attr, 0, 0, 0, 0 );
+    ok( status == STATUS_SUCCESS, "NtCreateKey failed: %x\n", status );
+    if (subkey == key)
+        check_dword_value( key, &name, STATUS_OBJECT_NAME_NOT_FOUND, 0, __LINE__ );
+    else
+        check_dword_value( key, &name, STATUS_INVALID_HANDLE, 0, __LINE__ );
+
+    pNtDeleteKey( subkey );
+    pNtClose( subkey );
+    pNtDeleteValueKey( key2, &name );
+    pNtClose( key2 );
+    pRtlFreeUnicodeString( &name );
+}
+
+static void close_remote_handle( HANDLE handle, DWORD pid )
+{
+    HANDLE process = OpenProcess( PROCESS_DUP_HANDLE, FALSE, pid );
+    BOOL ret;
+
+    ok( process != NULL, "OpenProcess failed, error %u\n", GetLastError() );
+    ret = DuplicateHandle( process, handle, NULL, NULL, 0, FALSE, DUPLICATE_CLOSE_SOURCE );
+    ok( ret, "DuplicateHandle failed, error %u\n", GetLastError() );
+    CloseHandle( process );
+}
+
 static void test_long_value_name(void)
 {
     HANDLE key;
@@ -1930,8 +2068,24 @@ static void test_notify(void)
 START_TEST(reg)
 {
     static const WCHAR winetest[] = {'\\','W','i','n','e','T','e','s','t',0};
+    char **argv;
+    int argc;
+
     if(!InitFunctionPtrs())
         return;
+
+    argc = winetest_get_mainargs( &argv );
+    if (argc >= 5 && !strcmp( argv[2], "close" ))
+    {
+        HANDLE handle;
+        DWORD pid;
+
+        sscanf( argv[3], "%p", &handle );
+        sscanf( argv[4], "%u", &pid );
+        close_remote_handle( handle, pid );
+        return;
+    }
+
     pRtlFormatCurrentUserKeyPath(&winetestpath);
     winetestpath.Buffer = pRtlReAllocateHeap(GetProcessHeap(), HEAP_ZERO_MEMORY, winetestpath.Buffer,
                            winetestpath.MaximumLength + sizeof(winetest)*sizeof(WCHAR));
@@ -1950,6 +2104,8 @@ START_TEST(reg)
     test_NtQueryKey();
     test_NtQueryLicenseKey();
     test_NtQueryValueKey();
+    test_value_cache();
+    test_value_cache_remote_close( argv[0] );
     test_long_value_name();
     test_notify();
     test_NtDeleteKey();
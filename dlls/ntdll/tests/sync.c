@@ -0,0 +1,228 @@
+/*
+ * Unit tests for the ntdll synchronization primitives
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+#include "ntdll_test.h"
+
+static void     (WINAPI *pRtlAcquireSRWLockExclusive)(RTL_SRWLOCK *);
+static void     (WINAPI *pRtlAcquireSRWLockShared)(RTL_SRWLOCK *);
+static void     (WINAPI *pRtlInitializeConditionVariable)(RTL_CONDITION_VARIABLE *);
+static void     (WINAPI *pRtlInitializeSRWLock)(RTL_SRWLOCK *);
+static void     (WINAPI *pRtlReleaseSRWLockExclusive)(RTL_SRWLOCK *);
+static void     (WINAPI *pRtlReleaseSRWLockShared)(RTL_SRWLOCK *);
+static NTSTATUS (WINAPI *pRtlSleepConditionVariableSRW)(RTL_CONDITION_VARIABLE *,RTL_SRWLOCK *,
+                                                        const LARGE_INTEGER *,ULONG);
+static NTSTATUS (WINAPI *pRtlWaitOnAddress)(const void *,const void *,SIZE_T,const LARGE_INTEGER *);
+static void     (WINAPI *pRtlWakeAddressAll)(const void *);
+static void     (WINAPI *pRtlWakeAddressSingle)(const void *);
+static void     (WINAPI *pRtlWakeAllConditionVariable)(RTL_CONDITION_VARIABLE *);
+
+#define NTDLL_GET_PROC(func) \
+    p ## func = (void *)GetProcAddress(hntdll, #func)
+
+static void init_pointers(void)
+{
+    HMODULE hntdll = GetModuleHandleA("ntdll.dll");
+
+    NTDLL_GET_PROC(RtlAcquireSRWLockExclusive);
+    NTDLL_GET_PROC(RtlAcquireSRWLockShared);
+    NTDLL_GET_PROC(RtlInitializeConditionVariable);
+    NTDLL_GET_PROC(RtlInitializeSRWLock);
+    NTDLL_GET_PROC(RtlReleaseSRWLockExclusive);
+    NTDLL_GET_PROC(RtlReleaseSRWLockShared);
+    NTDLL_GET_PROC(RtlSleepConditionVariableSRW);
+    NTDLL_GET_PROC(RtlWaitOnAddress);
+    NTDLL_GET_PROC(RtlWakeAddressAll);
+    NTDLL_GET_PROC(RtlWakeAddressSingle);
+    NTDLL_GET_PROC(RtlWakeAllConditionVariable);
+}
+
+static LONG address_var;
+
+static DWORD WINAPI wait_on_address_thread(void *arg)
+{
+    LONG compare = 0;
+    NTSTATUS status;
+
+    status = pRtlWaitOnAddress(&address_var, &compare, sizeof(compare), NULL);
+    ok(!status, "got %#x\n", status);
+    ok(address_var == 1, "got %d\n", address_var);
+    return 0;
+}
+
+static void test_wait_on_address(void)
+{
+    LARGE_INTEGER timeout;
+    LONG64 compare;
+    NTSTATUS status;
+    HANDLE threads[4];
+    DWORD ret;
+    int i;
+
+    if (!pRtlWaitOnAddress)
+    {
+        win_skip("RtlWaitOnAddress not supported, skipping test\n");
+        return;
+    }
+
+    address_var = 0;
+    compare = 0;
+    timeout.QuadPart = -10000; /* 1 ms */
+
+    status = pRtlWaitOnAddress(&address_var, &compare, 0, &timeout);
+    ok(status == STATUS_INVALID_PARAMETER, "got %#x\n", status);
+    status = pRtlWaitOnAddress(&address_var, &compare, 3, &timeout);
+    ok(status == STATUS_INVALID_PARAMETER, "got %#x\n", status);
+    status = pRtlWaitOnAddress(&address_var, &compare, 16, &timeout);
+    ok(status == STATUS_INVALID_PARAMETER, "got %#x\n", status);
+
+    /* values that differ return immediately */
+    compare = 1;
+    status = pRtlWaitOnAddress(&address_var, &compare, 1, &timeout);
+    ok(!status, "got %#x\n", status);
+    status = pRtlWaitOnAddress(&address_var, &compare, 2, &timeout);
+    ok(!status, "got %#x\n", status);
+    status = pRtlWaitOnAddress(&address_var, &compare, 4, &timeout);
+    ok(!status, "got %#x\n", status);
+
+    compare = 0;
+    status = pRtlWaitOnAddress(&address_var, &compare, 4, &timeout);
+    ok(status == STATUS_TIMEOUT, "got %#x\n", status);
+    ok(address_var == 0, "got %d\n", address_var);
+
+    /* waking without waiters is a no-op */
+    pRtlWakeAddressSingle(&address_var);
+    pRtlWakeAddressAll(&address_var);
+    status = pRtlWaitOnAddress(&address_var, &compare, 4, &timeout);
+    ok(status == STATUS_TIMEOUT, "got %#x\n", status);
+
+    for (i = 0; i < sizeof(threads) / sizeof(threads[0]); i++)
+        threads[i] = CreateThread(NULL, 0, wait_on_address_thread, NULL, 0, NULL);
+
+    Sleep(100);
+    InterlockedExchange(&address_var, 1);
+    pRtlWakeAddressAll(&address_var);
+
+    ret = WaitForMultipleObjects(sizeof(threads) / sizeof(threads[0]), threads, TRUE, 5000);
+    ok(ret == WAIT_OBJECT_0, "waiting for threads failed: %u\n", ret);
+    for (i = 0; i < sizeof(threads) / sizeof(threads[0]); i++)
+        CloseHandle(threads[i]);
+}
+
+/* SRW locks and condition variables under contention */
+
+static RTL_SRWLOCK contention_lock;
+static RTL_CONDITION_VARIABLE contention_cv;
+static LONG contention_count, contention_turn, contention_start;
+static LONG contention_iterations;
+
+static DWORD WINAPI srwlock_contention_thread(void *arg)
+{
+    LONG i, shared_reads = 0;
+
+    while (!contention_start) Sleep(0);
+
+    for (i = 0; i < contention_iterations; i++)
+    {
+        if (i % 4 == 3)
+        {
+            pRtlAcquireSRWLockShared(&contention_lock);
+            if (contention_count >= 0) shared_reads++;
+            pRtlReleaseSRWLockShared(&contention_lock);
+        }
+        else
+        {
+            pRtlAcquireSRWLockExclusive(&contention_lock);
+            contention_count++;
+            pRtlReleaseSRWLockExclusive(&contention_lock);
+        }
+    }
+    return shared_reads;
+}
+
+static DWORD WINAPI condvar_contention_thread(void *arg)
+{
+    LONG id = (LONG_PTR)arg, threads = contention_start;
+    LONG i;
+
+    for (i = 0; i < contention_iterations; i++)
+    {
+        pRtlAcquireSRWLockExclusive(&contention_lock);
+        while (contention_turn % threads != id)
+            pRtlSleepConditionVariableSRW(&contention_cv, &contention_lock, NULL, 0);
+        contention_turn++;
+        contention_count++;
+        pRtlReleaseSRWLockExclusive(&contention_lock);
+        pRtlWakeAllConditionVariable(&contention_cv);
+    }
+    return 0;
+}
+
+static void run_contention(const char *name, LPTHREAD_START_ROUTINE proc, LONG threads, LONG iterations)
+{
+    HANDLE handles[16];
+    DWORD ret;
+    LONG i;
+
+    pRtlInitializeSRWLock(&contention_lock);
+    pRtlInitializeConditionVariable(&contention_cv);
+    contention_count = contention_turn = contention_start = 0;
+    contention_iterations = iterations;
+
+    if (proc == condvar_contention_thread) contention_start = threads;
+    for (i = 0; i < threads; i++)
+        handles[i] = CreateThread(NULL, 0, proc, (void *)(LONG_PTR)i, 0, NULL);
+
+    InterlockedExchange(&contention_start, threads);
+
+    ret = WaitForMultipleObjects(threads, handles, TRUE, 60000);
+    ok(ret == WAIT_OBJECT_0, "%s: waiting for %d threads failed: %u\n", name, threads, ret);
+    for (i = 0; i < threads; i++)
+        CloseHandle(handles[i]);
+
+    if (proc == srwlock_contention_thread)
+        ok(contention_count == threads * (iterations - iterations / 4),
+           "%s: got count %d with %d threads\n", name, contention_count, threads);
+    else
+        ok(contention_count == threads * iterations,
+           "%s: got count %d with %d threads\n", name, contention_count, threads);
+}
+
+static void test_contention(void)
+{
+    LONG threads;
+
+    if (!pRtlAcquireSRWLockExclusive || !pRtlSleepConditionVariableSRW)
+    {
+        win_skip("SRW locks not supported, skipping test\n");
+        return;
+    }
+
+    for (threads = 2; threads <= 16; threads *= 4)
+    {
+        run_contention("srwlock", srwlock_contention_thread, threads, 1000);
+        run_contention("condvar", condvar_contention_thread, threads, 50);
+    }
+}
+
+START_TEST(sync)
+{
+    init_pointers();
+
+    test_wait_on_address();
+    test_contention();
+}
@@ -22,18 +22,21 @@
 
 static HMODULE hntdll = 0;
 static NTSTATUS (WINAPI *pTpAllocCleanupGroup)(TP_CLEANUP_GROUP **);
+static NTSTATUS (WINAPI *pTpAllocIoCompletion)(TP_IO **,HANDLE,PTP_IO_CALLBACK,void *,TP_CALLBACK_ENVIRON *);
 static NTSTATUS (WINAPI *pTpAllocPool)(TP_POOL **,PVOID);
 static NTSTATUS (WINAPI *pTpAllocTimer)(TP_TIMER **,PTP_TIMER_CALLBACK,PVOID,TP_CALLBACK_ENVIRON *);
 static NTSTATUS (WINAPI *pTpAllocWait)(TP_WAIT **,PTP_WAIT_CALLBACK,PVOID,TP_CALLBACK_ENVIRON *);
 static NTSTATUS (WINAPI *pTpAllocWork)(TP_WORK **,PTP_WORK_CALLBACK,PVOID,TP_CALLBACK_ENVIRON *);
 static NTSTATUS (WINAPI *pTpCallbackMayRunLong)(TP_CALLBACK_INSTANCE *);
 static VOID     (WINAPI *pTpCallbackReleaseSemaphoreOnCompletion)(TP_CALLBACK_INSTANCE *,HANDLE,DWORD);
+static VOID     (WINAPI *pTpCancelAsyncIoOperation)(TP_IO *);
 static VOID     (WINAPI *pTpDisassociateCallback)(TP_CALLBACK_INSTANCE *);
 static BOOL     (WINAPI *pTpIsTimerSet)(TP_TIMER *);
 static VOID     (WINAPI *pTpReleaseWait)(TP_WAIT *);
 static VOID     (WINAPI *pTpPostWork)(TP_WORK *);
 static VOID     (WINAPI *pTpReleaseCleanupGroup)(TP_CLEANUP_GROUP *);
 static VOID     (WINAPI *pTpReleaseCleanupGroupMembers)(TP_CLEANUP_GROUP *,BOOL,PVOID);
+static VOID     (WINAPI *pTpReleaseIoCompletion)(TP_IO *);
 static VOID     (WINAPI *pTpReleasePool)(TP_POOL *);
 static VOID     (WINAPI *pTpReleaseTimer)(TP_TIMER *);
 static VOID     (WINAPI *pTpReleaseWork)(TP_WORK *);
@@ -41,6 +44,8 @@ static VOID     (WINAPI *pTpSetPoolMaxThreads)(TP_POOL *,DWORD);
 static VOID     (WINAPI *pTpSetTimer)(TP_TIMER *,LARGE_INTEGER *,LONG,LONG);
 static VOID     (WINAPI *pTpSetWait)(TP_WAIT *,HANDLE,LARGE_INTEGER *);
 static NTSTATUS (WINAPI *pTpSimpleTryPost)(PTP_SIMPLE_CALLBACK,PVOID,TP_CALLBACK_ENVIRON *);
+static VOID     (WINAPI *pTpStartAsyncIoOperation)(TP_IO *);
+static VOID     (WINAPI *pTpWaitForIoCompletion)(TP_IO *,BOOL);
 static VOID     (WINAPI *pTpWaitForTimer)(TP_TIMER *,BOOL);
 static VOID     (WINAPI *pTpWaitForWait)(TP_WAIT *,BOOL);
 static VOID     (WINAPI *pTpWaitForWork)(TP_WORK *,BOOL);
@@ -63,17 +68,20 @@ static BOOL init_threadpool(void)
     }
 
     NTDLL_GET_PROC(TpAllocCleanupGroup);
+    NTDLL_GET_PROC(TpAllocIoCompletion);
     NTDLL_GET_PROC(TpAllocPool);
     NTDLL_GET_PROC(TpAllocTimer);
     NTDLL_GET_PROC(TpAllocWait);
     NTDLL_GET_PROC(TpAllocWork);
     NTDLL_GET_PROC(TpCallbackMayRunLong);
     NTDLL_GET_PROC(TpCallbackReleaseSemaphoreOnCompletion);
+    NTDLL_GET_PROC(TpCancelAsyncIoOperation);
     NTDLL_GET_PROC(TpDisassociateCallback);
     NTDLL_GET_PROC(TpIsTimerSet);
     NTDLL_GET_PROC(TpPostWork);
     NTDLL_GET_PROC(TpReleaseCleanupGroup);
     NTDLL_GET_PROC(TpReleaseCleanupGroupMembers);
+    NTDLL_GET_PROC(TpReleaseIoCompletion);
     NTDLL_GET_PROC(TpReleasePool);
     NTDLL_GET_PROC(TpReleaseTimer);
     NTDLL_GET_PROC(TpReleaseWait);
@@ -82,6 +90,8 @@ static BOOL init_threadpool(void)
     NTDLL_GET_PROC(TpSetTimer);
     NTDLL_GET_PROC(TpSetWait);
     NTDLL_GET_PROC(TpSimpleTryPost);
+    NTDLL_GET_PROC(TpStartAsyncIoOperation);
+    NTDLL_GET_PROC(TpWaitForIoCompletion);
     NTDLL_GET_PROC(TpWaitForTimer);
     NTDLL_GET_PROC(TpWaitForWait);
     NTDLL_GET_PROC(TpWaitForWork);
@@ -705,6 +715,140 @@ static void test_tp_work_scheduler(void)
     pTpReleasePool(pool);
 }
 
+struct burst_context
+{
+    LONG count;
+    LONG expected;
+    HANDLE event;
+};
+
+static void CALLBACK burst_cb(TP_CALLBACK_INSTANCE *instance, void *userdata)
+{
+    struct burst_context *context = userdata;
+    if (InterlockedIncrement(&context->count) == context->expected)
+        SetEvent(context->event);
+}
+
+static void CALLBACK blocking_cb(TP_CALLBACK_INSTANCE *instance, void *userdata)
+{
+    struct burst_context *context = userdata;
+    if (InterlockedIncrement(&context->count) == context->expected)
+        SetEvent(context->event);
+    WaitForSingleObject(context->event, 5000);
+}
+
+struct dependent_context
+{
+    SRWLOCK lock;
+    CONDITION_VARIABLE cv;
+    BOOL released;
+    LONG waited;
+};
+
+static void CALLBACK dependent_wait_cb(TP_CALLBACK_INSTANCE *instance, void *userdata)
+{
+    struct dependent_context *context = userdata;
+    AcquireSRWLockExclusive(&context->lock);
+    while (!context->released)
+    {
+        if (!SleepConditionVariableSRW(&context->cv, &context->lock, 10000, 0)) break;
+    }
+    if (context->released) InterlockedIncrement(&context->waited);
+    ReleaseSRWLockExclusive(&context->lock);
+}
+
+static void CALLBACK dependent_release_cb(TP_CALLBACK_INSTANCE *instance, void *userdata)
+{
+    struct dependent_context *context = userdata;
+    AcquireSRWLockExclusive(&context->lock);
+    context->released = TRUE;
+    ReleaseSRWLockExclusive(&context->lock);
+    WakeAllConditionVariable(&context->cv);
+}
+
+static void test_tp_work_burst(void)
+{
+    TP_CALLBACK_ENVIRON environment;
+    struct dependent_context dependent;
+    struct burst_context context;
+    TP_CLEANUP_GROUP *group;
+    SYSTEM_INFO info;
+    NTSTATUS status;
+    TP_POOL *pool;
+    DWORD result;
+    int i;
+
+    pool = NULL;
+    status = pTpAllocPool(&pool, NULL);
+    ok(!status, "TpAllocPool failed with status %x\n", status);
+    ok(pool != NULL, "expected pool != NULL\n");
+
+    group = NULL;
+    status = pTpAllocCleanupGroup(&group);
+    ok(!status, "TpAllocCleanupGroup failed with status %x\n", status);
+    ok(group != NULL, "expected group != NULL\n");
+
+    memset(&environment, 0, sizeof(environment));
+    environment.Version = 1;
+    environment.Pool = pool;
+    environment.CleanupGroup = group;
+
+    context.event = CreateEventA(NULL, TRUE, FALSE, NULL);
+    ok(context.event != NULL, "CreateEventA failed %u\n", GetLastError());
+
+    /* a burst of tiny callbacks */
+    context.count = 0;
+    context.expected = 1000;
+    for (i = 0; i < context.expected; i++)
+    {
+        status = pTpSimpleTryPost(burst_cb, &context, &environment);
+        if (status) break;
+    }
+    ok(!status, "TpSimpleTryPost failed with status %x\n", status);
+    result = WaitForSingleObject(context.event, 10000);
+    ok(result == WAIT_OBJECT_0, "WaitForSingleObject returned %u\n", result);
+    ok(context.count == context.expected, "expected %u callbacks, got %u\n", context.expected, context.count);
+    pTpReleaseCleanupGroupMembers(group, FALSE, NULL);
+
+    /* workers waiting inside a callback are replaced, even when more
+     * callbacks are blocked than there are processors */
+    GetSystemInfo(&info);
+    ResetEvent(context.event);
+    context.count = 0;
+    context.expected = info.dwNumberOfProcessors * 2 + 2;
+    for (i = 0; i < context.expected; i++)
+    {
+        status = pTpSimpleTryPost(blocking_cb, &context, &environment);
+        ok(!status, "TpSimpleTryPost failed with status %x\n", status);
+    }
+    result = WaitForSingleObject(context.event, 5000);
+    ok(result == WAIT_OBJECT_0, "only %u of %u callbacks were started\n", context.count, context.expected);
+    SetEvent(context.event);
+    pTpReleaseCleanupGroupMembers(group, FALSE, NULL);
+
+    /* callbacks waiting on a condition variable, which is only signaled
+     * by a callback queued after them, don't starve it */
+    InitializeSRWLock(&dependent.lock);
+    InitializeConditionVariable(&dependent.cv);
+    dependent.released = FALSE;
+    dependent.waited = 0;
+    for (i = 0; i < info.dwNumberOfProcessors; i++)
+    {
+        status = pTpSimpleTryPost(dependent_wait_cb, &dependent, &environment);
+        ok(!status, "TpSimpleTryPost failed with status %x\n", status);
+    }
+    status = pTpSimpleTryPost(dependent_release_cb, &dependent, &environment);
+    ok(!status, "TpSimpleTryPost failed with status %x\n", status);
+    pTpReleaseCleanupGroupMembers(group, FALSE, NULL);
+    ok(dependent.waited == info.dwNumberOfProcessors, "expected %u released callbacks, got %d\n",
+       info.dwNumberOfProcessors, dependent.waited);
+
+    /* cleanup */
+    CloseHandle(context.event);
+    pTpReleaseCleanupGroup(group);
+    pTpReleasePool(pool);
+}
+
 static void CALLBACK simple_release_cb(TP_CALLBACK_INSTANCE *instance, void *userdata)
 {
     HANDLE *semaphores = userdata;
@@ -1897,6 +2041,206 @@ static void test_tp_multi_wait(void)
     CloseHandle(semaphore);
 }
 
+struct io_cb_context
+{
+    unsigned int count;
+    void *ovl;
+    NTSTATUS ret;
+    ULONG_PTR length;
+    TP_IO *io;
+    HANDLE event;
+    void *order[3];
+};
+
+static void CALLBACK io_cb(TP_CALLBACK_INSTANCE *instance, void *userdata,
+        void *cvalue, IO_STATUS_BLOCK *iosb, TP_IO *io)
+{
+    struct io_cb_context *context = userdata;
+    if (context->count < sizeof(context->order) / sizeof(context->order[0]))
+        context->order[context->count] = cvalue;
+    ++context->count;
+    context->ovl = cvalue;
+    context->ret = U(*iosb).Status;
+    context->length = iosb->Information;
+    context->io = io;
+    if (context->event) SetEvent(context->event);
+}
+
+static void CALLBACK io_block_cb(TP_CALLBACK_INSTANCE *instance, void *userdata)
+{
+    HANDLE *events = userdata;
+    DWORD ret;
+
+    SetEvent(events[0]);
+    ret = WaitForSingleObject(events[1], 5000);
+    ok(!ret, "wait failed, ret %u\n", ret);
+}
+
+static void test_tp_io(void)
+{
+    static const char pipe_name[] = "\\\\.\\pipe\\wine_threadpool_io_test";
+    TP_CALLBACK_ENVIRON environment;
+    struct io_cb_context userdata;
+    char in[1], in2[1], out[1], ins[3];
+    HANDLE client, server, events[2];
+    OVERLAPPED ovl, ovl2, ovls[3];
+    TP_POOL *pool;
+    NTSTATUS status;
+    unsigned int i;
+    DWORD size;
+    TP_IO *io;
+    BOOL ret;
+
+    if (!pTpAllocIoCompletion)
+    {
+        win_skip("TpAllocIoCompletion is not available\n");
+        return;
+    }
+
+    memset(&ovl, 0, sizeof(ovl));
+    memset(&ovl2, 0, sizeof(ovl2));
+    memset(&userdata, 0, sizeof(userdata));
+    userdata.event = CreateEventA(NULL, FALSE, FALSE, NULL);
+
+    status = pTpAllocPool(&pool, NULL);
+    ok(!status, "failed to allocate pool, status %#x\n", status);
+    /* a single worker, so that callbacks run in the order they are queued */
+    pTpSetPoolMaxThreads(pool, 1);
+
+    memset(&environment, 0, sizeof(environment));
+    environment.Version = 1;
+    environment.Pool = pool;
+
+    server = CreateNamedPipeA(pipe_name, PIPE_ACCESS_INBOUND | FILE_FLAG_OVERLAPPED,
+            0, 1, 1024, 1024, 0, NULL);
+    ok(server != INVALID_HANDLE_VALUE, "failed to create server pipe, error %u\n", GetLastError());
+    client = CreateFileA(pipe_name, GENERIC_WRITE, 0, NULL, OPEN_EXISTING, 0, 0);
+    ok(client != INVALID_HANDLE_VALUE, "failed to create client pipe, error %u\n", GetLastError());
+
+    status = pTpAllocIoCompletion(&io, server, io_cb, &userdata, &environment);
+    ok(!status, "got %#x\n", status);
+
+    /* a completion is dispatched to the callback */
+    pTpStartAsyncIoOperation(io);
+    ret = ReadFile(server, in, sizeof(in), NULL, &ovl);
+    ok(!ret, "wrong ret %d\n", ret);
+    ok(GetLastError() == ERROR_IO_PENDING, "wrong error %u\n", GetLastError());
+
+    ret = WriteFile(client, out, sizeof(out), NULL, NULL);
+    ok(ret, "WriteFile() failed, error %u\n", GetLastError());
+
+    pTpWaitForIoCompletion(io, FALSE);
+    ok(userdata.count == 1, "callback ran %u times\n", userdata.count);
+    ok(userdata.ovl == &ovl, "expected %p, got %p\n", &ovl, userdata.ovl);
+    ok(userdata.ret == STATUS_SUCCESS, "got status %#x\n", userdata.ret);
+    ok(userdata.length == 1, "got length %lu\n", userdata.length);
+    ok(userdata.io == io, "expected %p, got %p\n", io, userdata.io);
+
+    /* waiting also waits for operations in flight */
+    userdata.count = 0;
+    pTpStartAsyncIoOperation(io);
+    pTpStartAsyncIoOperation(io);
+    ret = ReadFile(server, in, sizeof(in), NULL, &ovl);
+    ok(!ret, "wrong ret %d\n", ret);
+    ret = ReadFile(server, in2, sizeof(in2), NULL, &ovl2);
+    ok(!ret, "wrong ret %d\n", ret);
+
+    ret = WriteFile(client, out, sizeof(out), NULL, NULL);
+    ok(ret, "WriteFile() failed, error %u\n", GetLastError());
+    ret = WriteFile(client, out, sizeof(out), NULL, NULL);
+    ok(ret, "WriteFile() failed, error %u\n", GetLastError());
+
+    pTpWaitForIoCompletion(io, FALSE);
+    ok(userdata.count == 2, "callback ran %u times\n", userdata.count);
+
+    /* an operation which was started and cancelled doesn't block the wait */
+    userdata.count = 0;
+    pTpStartAsyncIoOperation(io);
+    pTpCancelAsyncIoOperation(io);
+    pTpWaitForIoCompletion(io, FALSE);
+    ok(!userdata.count, "callback ran %u times\n", userdata.count);
+
+    /* queued completions are dispatched in the order they arrived */
+    userdata.count = 0;
+    events[0] = CreateEventA(NULL, FALSE, FALSE, NULL);
+    events[1] = CreateEventA(NULL, FALSE, FALSE, NULL);
+    status = pTpSimpleTryPost(io_block_cb, events, &environment);
+    ok(!status, "TpSimpleTryPost failed with status %x\n", status);
+    ret = WaitForSingleObject(events[0], 1000);
+    ok(!ret, "wait failed, ret %u\n", ret);
+
+    for (i = 0; i < 3; i++)
+    {
+        memset(&ovls[i], 0, sizeof(ovls[i]));
+        ovls[i].hEvent = CreateEventA(NULL, TRUE, FALSE, NULL);
+        pTpStartAsyncIoOperation(io);
+        ret = ReadFile(server, &ins[i], 1, NULL, &ovls[i]);
+        ok(!ret && GetLastError() == ERROR_IO_PENDING, "ReadFile returned %d, error %u\n", ret, GetLastError());
+    }
+    for (i = 0; i < 3; i++)
+    {
+        ret = WriteFile(client, out, sizeof(out), NULL, NULL);
+        ok(ret, "WriteFile() failed, error %u\n", GetLastError());
+    }
+    for (i = 0; i < 3; i++)
+    {
+        ret = GetOverlappedResult(server, &ovls[i], &size, TRUE);
+        ok(ret, "GetOverlappedResult failed, error %u\n", GetLastError());
+    }
+
+    SetEvent(events[1]);
+    pTpWaitForIoCompletion(io, FALSE);
+    ok(userdata.count == 3, "callback ran %u times\n", userdata.count);
+    for (i = 0; i < 3; i++)
+    {
+        ok(userdata.order[i] == &ovls[i], "%u: expected %p, got %p\n", i, &ovls[i], userdata.order[i]);
+        CloseHandle(ovls[i].hEvent);
+    }
+    CloseHandle(events[0]);
+    CloseHandle(events[1]);
+
+    pTpReleaseIoCompletion(io);
+    CloseHandle(server);
+
+    /* releasing the object with I/O in flight is allowed */
+    server = CreateNamedPipeA(pipe_name, PIPE_ACCESS_INBOUND | FILE_FLAG_OVERLAPPED,
+            0, 1, 1024, 1024, 0, NULL);
+    ok(server != INVALID_HANDLE_VALUE, "failed to create server pipe, error %u\n", GetLastError());
+    CloseHandle(client);
+    client = CreateFileA(pipe_name, GENERIC_WRITE, 0, NULL, OPEN_EXISTING, 0, 0);
+    ok(client != INVALID_HANDLE_VALUE, "failed to create client pipe, error %u\n", GetLastError());
+
+    userdata.count = 0;
+    status = pTpAllocIoCompletion(&io, server, io_cb, &userdata, &environment);
+    ok(!status, "got %#x\n", status);
+    pTpStartAsyncIoOperation(io);
+    ret = ReadFile(server, in, sizeof(in), NULL, &ovl);
+    ok(!ret, "wrong ret %d\n", ret);
+    pTpReleaseIoCompletion(io);
+
+    ret = WriteFile(client, out, sizeof(out), NULL, NULL);
+    ok(ret, "WriteFile() failed, error %u\n", GetLastError());
+    ret = GetOverlappedResult(server, &ovl, &size, TRUE);
+    ok(ret, "GetOverlappedResult failed, error %u\n", GetLastError());
+    Sleep(50);
+    ok(!userdata.count, "callback ran %u times\n", userdata.count);
+
+    /* the released object isn't used for I/O started on the file later on */
+    ret = ReadFile(server, in, sizeof(in), NULL, &ovl);
+    ok(!ret && GetLastError() == ERROR_IO_PENDING, "ReadFile returned %d, error %u\n", ret, GetLastError());
+    ret = WriteFile(client, out, sizeof(out), NULL, NULL);
+    ok(ret, "WriteFile() failed, error %u\n", GetLastError());
+    ret = GetOverlappedResult(server, &ovl, &size, TRUE);
+    ok(ret, "GetOverlappedResult failed, error %u\n", GetLastError());
+    Sleep(50);
+    ok(!userdata.count, "callback ran %u times\n", userdata.count);
+
+    CloseHandle(client);
+    CloseHandle(server);
+    CloseHandle(userdata.event);
+    pTpReleasePool(pool);
+}
+
 START_TEST(threadpool)
 {
     test_RtlQueueWorkItem();
@@ -1908,6 +2252,7 @@ START_TEST(threadpool)
     test_tp_simple();
     test_tp_work();
     test_tp_work_scheduler();
+    test_tp_work_burst();
     test_tp_group_wait();
     test_tp_group_cancel();
     test_tp_instance();
@@ -1916,4 +2261,5 @@ START_TEST(threadpool)
     test_tp_window_length();
     test_tp_wait();
     test_tp_multi_wait();
+    test_tp_io();
 }
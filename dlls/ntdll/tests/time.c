@@ -100,7 +100,7 @@ static void test_pRtlTimeToTimeFields(void)
 
 static void test_NtQueryPerformanceCounter(void)
 {
-    LARGE_INTEGER counter, frequency;
+    LARGE_INTEGER counter, frequency, counter2, frequency2;
     NTSTATUS status;
 
     status = pNtQueryPerformanceCounter(NULL, NULL);
@@ -116,6 +116,12 @@ static void test_NtQueryPerformanceCounter(void)
     ok(status == STATUS_SUCCESS, "expected STATUS_SUCCESS, got %08x\n", status);
     status = pNtQueryPerformanceCounter(&counter, &frequency);
     ok(status == STATUS_SUCCESS, "expected STATUS_SUCCESS, got %08x\n", status);
+
+    status = pNtQueryPerformanceCounter(&counter2, &frequency2);
+    ok(status == STATUS_SUCCESS, "expected STATUS_SUCCESS, got %08x\n", status);
+    ok(frequency2.QuadPart == frequency.QuadPart, "frequency changed from %x%08x to %x%08x\n",
+       frequency.u.HighPart, frequency.u.LowPart, frequency2.u.HighPart, frequency2.u.LowPart);
+    ok(counter2.QuadPart >= counter.QuadPart, "counter went backwards\n");
 }
 
 static void test_NtGetTickCount(void)
@@ -141,6 +147,69 @@ static void test_NtGetTickCount(void)
 #endif
 }
 
+static ULONGLONG read_ksystem_time(volatile KSYSTEM_TIME *time)
+{
+    ULONGLONG high, low;
+
+    do
+    {
+        high = time->High1Time;
+        low = time->LowPart;
+    }
+    while (high != time->High2Time);
+    return high << 32 | low;
+}
+
+/* the fields are updated at least every 15.6ms */
+#define UPDATE_INTERVAL (16 * TICKSPERMSEC)
+
+static void test_user_shared_data_time(void)
+{
+    KSHARED_USER_DATA *user_shared_data = (void *)0x7ffe0000;
+    ULONGLONG interrupt, system, prev_interrupt, prev_system;
+    LONGLONG offset, first_offset;
+    LARGE_INTEGER now;
+    DWORD tick, prev_tick, count;
+    FILETIME ft;
+    int i;
+
+    prev_interrupt = read_ksystem_time(&user_shared_data->InterruptTime);
+    prev_system = read_ksystem_time(&user_shared_data->SystemTime);
+    prev_tick = user_shared_data->u.TickCount.LowPart;
+    first_offset = prev_system - prev_interrupt;
+
+    for (i = 0; i < 100; ++i)
+    {
+        interrupt = read_ksystem_time(&user_shared_data->InterruptTime);
+        system = read_ksystem_time(&user_shared_data->SystemTime);
+        tick = user_shared_data->u.TickCount.LowPart;
+        ok(interrupt >= prev_interrupt, "InterruptTime went backwards\n");
+        ok(system >= prev_system, "SystemTime went backwards\n");
+        ok((LONG)(tick - prev_tick) >= 0, "TickCount went backwards from %u to %u\n", prev_tick, tick);
+
+        /* both times are updated together */
+        offset = system - interrupt;
+        ok(offset - first_offset < UPDATE_INTERVAL && first_offset - offset < UPDATE_INTERVAL,
+           "SystemTime and InterruptTime drifted apart by %d ms\n", (int)((offset - first_offset) / TICKSPERMSEC));
+
+        /* GetTickCount and GetSystemTimeAsFileTime are consistent with the fields */
+        count = GetTickCount();
+        GetSystemTimeAsFileTime(&ft);
+        prev_tick = user_shared_data->u.TickCount.LowPart;
+        prev_system = read_ksystem_time(&user_shared_data->SystemTime);
+        prev_interrupt = read_ksystem_time(&user_shared_data->InterruptTime);
+        ok((LONG)(count - tick) >= 0 && (LONG)(prev_tick - count) >= 0,
+           "GetTickCount returned %u, TickCount was %u and %u\n", count, tick, prev_tick);
+        now.u.LowPart = ft.dwLowDateTime;
+        now.u.HighPart = ft.dwHighDateTime;
+        ok(now.QuadPart + UPDATE_INTERVAL > system && now.QuadPart < prev_system + UPDATE_INTERVAL,
+           "system time %d ms after SystemTime, which then advanced by %d ms\n",
+           (int)((now.QuadPart - (LONGLONG)system) / TICKSPERMSEC), (int)((prev_system - system) / TICKSPERMSEC));
+
+        Sleep(1);
+    }
+}
+
 START_TEST(time)
 {
     HMODULE mod = GetModuleHandleA("ntdll.dll");
@@ -154,4 +223,5 @@ START_TEST(time)
         win_skip("Required time conversion functions are not available\n");
     test_NtQueryPerformanceCounter();
     test_NtGetTickCount();
+    test_user_shared_data_time();
 }
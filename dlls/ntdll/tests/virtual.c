@@ -0,0 +1,168 @@
+/*
+ * Unit tests for the ntdll virtual memory functions
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+#include "ntdll_test.h"
+
+static NTSTATUS (WINAPI *pNtAllocateVirtualMemory)(HANDLE,PVOID *,ULONG_PTR,SIZE_T *,ULONG,ULONG);
+static NTSTATUS (WINAPI *pNtFreeVirtualMemory)(HANDLE,PVOID *,SIZE_T *,ULONG);
+static NTSTATUS (WINAPI *pNtProtectVirtualMemory)(HANDLE,PVOID *,SIZE_T *,ULONG,ULONG *);
+static NTSTATUS (WINAPI *pNtQueryVirtualMemory)(HANDLE,LPCVOID,MEMORY_INFORMATION_CLASS,PVOID,SIZE_T,SIZE_T *);
+
+#define NTDLL_GET_PROC(func) \
+    p ## func = (void *)GetProcAddress(hntdll, #func)
+
+static void init_pointers(void)
+{
+    HMODULE hntdll = GetModuleHandleA("ntdll.dll");
+
+    NTDLL_GET_PROC(NtAllocateVirtualMemory);
+    NTDLL_GET_PROC(NtFreeVirtualMemory);
+    NTDLL_GET_PROC(NtProtectVirtualMemory);
+    NTDLL_GET_PROC(NtQueryVirtualMemory);
+}
+
+static void test_query_holes(void)
+{
+    MEMORY_BASIC_INFORMATION info;
+    SIZE_T size, len;
+    NTSTATUS status;
+    char *base, *addr;
+
+    /* reserve a range, then carve holes into it */
+    base = NULL;
+    size = 0x100000;
+    status = pNtAllocateVirtualMemory(GetCurrentProcess(), (void **)&base, 0, &size, MEM_RESERVE, PAGE_NOACCESS);
+    ok(!status, "NtAllocateVirtualMemory failed: %#x\n", status);
+    if (status) return;
+    size = 0;
+    status = pNtFreeVirtualMemory(GetCurrentProcess(), (void **)&base, &size, MEM_RELEASE);
+    ok(!status, "NtFreeVirtualMemory failed: %#x\n", status);
+
+    addr = base + 0x20000;
+    size = 0x10000;
+    status = pNtAllocateVirtualMemory(GetCurrentProcess(), (void **)&addr, 0, &size, MEM_RESERVE, PAGE_NOACCESS);
+    if (status)
+    {
+        skip("range %p got reused, skipping test\n", base);
+        return;
+    }
+
+    memset(&info, 0xcc, sizeof(info));
+    status = pNtQueryVirtualMemory(GetCurrentProcess(), base + 0x10000, MemoryBasicInformation,
+                                   &info, sizeof(info), &len);
+    ok(!status, "NtQueryVirtualMemory failed: %#x\n", status);
+    ok(info.BaseAddress == base + 0x10000, "got base %p\n", info.BaseAddress);
+    ok(info.State == MEM_FREE, "got state %#x\n", info.State);
+    ok((char *)info.BaseAddress + info.RegionSize == base + 0x20000, "got size %#lx\n", info.RegionSize);
+
+    memset(&info, 0xcc, sizeof(info));
+    status = pNtQueryVirtualMemory(GetCurrentProcess(), base + 0x28000, MemoryBasicInformation,
+                                   &info, sizeof(info), &len);
+    ok(!status, "NtQueryVirtualMemory failed: %#x\n", status);
+    ok(info.AllocationBase == base + 0x20000, "got allocation base %p\n", info.AllocationBase);
+    ok(info.BaseAddress == base + 0x28000, "got base %p\n", info.BaseAddress);
+    ok(info.RegionSize == 0x8000, "got size %#lx\n", info.RegionSize);
+    ok(info.State == MEM_RESERVE, "got state %#x\n", info.State);
+
+    memset(&info, 0xcc, sizeof(info));
+    status = pNtQueryVirtualMemory(GetCurrentProcess(), base + 0x30000, MemoryBasicInformation,
+                                   &info, sizeof(info), &len);
+    ok(!status, "NtQueryVirtualMemory failed: %#x\n", status);
+    ok(info.BaseAddress == base + 0x30000, "got base %p\n", info.BaseAddress);
+    ok(info.State == MEM_FREE, "got state %#x\n", info.State);
+
+    size = 0;
+    status = pNtFreeVirtualMemory(GetCurrentProcess(), (void **)&addr, &size, MEM_RELEASE);
+    ok(!status, "NtFreeVirtualMemory failed: %#x\n", status);
+}
+
+#define MANY_VIEWS  1000
+
+static void test_many_views(void)
+{
+    MEMORY_BASIC_INFORMATION info;
+    unsigned int i, count;
+    ULONG old_prot;
+    SIZE_T size, len;
+    NTSTATUS status;
+    void **views, *addr;
+
+    views = HeapAlloc(GetProcessHeap(), 0, MANY_VIEWS * sizeof(*views));
+
+    for (count = 0; count < MANY_VIEWS; count++)
+    {
+        views[count] = NULL;
+        size = 0x1000;
+        status = pNtAllocateVirtualMemory(GetCurrentProcess(), &views[count], 0, &size,
+                                          MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+        if (status) break;
+    }
+    ok(count == MANY_VIEWS, "only got %u views, status %#x\n", count, status);
+
+    /* every view must be found from an address in its middle */
+    for (i = 0; i < count; i++)
+    {
+        memset(&info, 0xcc, sizeof(info));
+        status = pNtQueryVirtualMemory(GetCurrentProcess(), (char *)views[i] + 0x800,
+                                       MemoryBasicInformation, &info, sizeof(info), &len);
+        ok(!status, "NtQueryVirtualMemory failed: %#x\n", status);
+        ok(info.AllocationBase == views[i], "%u: got allocation base %p, expected %p\n",
+           i, info.AllocationBase, views[i]);
+        ok(info.RegionSize == 0x1000, "%u: got size %#lx\n", i, info.RegionSize);
+        ok(info.Protect == PAGE_READWRITE, "%u: got protection %#x\n", i, info.Protect);
+    }
+
+    for (i = 0; i < count; i += 2)
+    {
+        addr = views[i];
+        size = 0x1000;
+        status = pNtProtectVirtualMemory(GetCurrentProcess(), &addr, &size, PAGE_READONLY, &old_prot);
+        ok(!status, "NtProtectVirtualMemory failed: %#x\n", status);
+        ok(old_prot == PAGE_READWRITE, "%u: got old protection %#x\n", i, old_prot);
+    }
+
+    /* free every other view, the remaining ones must still be found */
+    for (i = 1; i < count; i += 2)
+    {
+        size = 0;
+        status = pNtFreeVirtualMemory(GetCurrentProcess(), &views[i], &size, MEM_RELEASE);
+        ok(!status, "freeing view %u failed: %#x\n", i, status);
+    }
+    for (i = 0; i < count; i += 2)
+    {
+        status = pNtQueryVirtualMemory(GetCurrentProcess(), views[i], MemoryBasicInformation,
+                                       &info, sizeof(info), &len);
+        ok(!status, "NtQueryVirtualMemory failed: %#x\n", status);
+        ok(info.AllocationBase == views[i], "%u: got allocation base %p, expected %p\n",
+           i, info.AllocationBase, views[i]);
+        ok(info.Protect == PAGE_READONLY, "%u: got protection %#x\n", i, info.Protect);
+        size = 0;
+        status = pNtFreeVirtualMemory(GetCurrentProcess(), &views[i], &size, MEM_RELEASE);
+        ok(!status, "freeing view %u failed: %#x\n", i, status);
+    }
+
+    HeapFree(GetProcessHeap(), 0, views);
+}
+
+START_TEST(virtual)
+{
+    init_pointers();
+
+    test_query_holes();
+    test_many_views();
+}
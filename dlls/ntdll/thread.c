@@ -371,6 +371,10 @@ BYTE* CDECL __wine_user_shared_data(void)
     user_shared_data->TickCountLowDeprecated = interrupt.LowPart;
     user_shared_data->TickCountMultiplier = 1 << 24;
 
+    /* we never apply a bias to the interrupt time or the performance counter */
+    user_shared_data->InterruptTimeBias = 0;
+    user_shared_data->QpcBias = 0;
+
     spinlock = 0;
     return (BYTE *)user_shared_data;
 }
@@ -384,8 +388,9 @@ static void *user_shared_data_thread(void *arg)
     {
         __wine_user_shared_data();
 
+        /* update at 1ms granularity, like Windows does with timeBeginPeriod(1) */
         tv.tv_sec = 0;
-        tv.tv_usec = 15600;
+        tv.tv_usec = 1000;
         select(0, NULL, NULL, NULL, &tv);
     }
     return NULL;
@@ -397,6 +402,7 @@ void create_user_shared_data_thread(void)
     static int thread_created;
     pthread_attr_t attr;
     pthread_t thread;
+    LARGE_INTEGER counter, frequency;
 
     if (interlocked_cmpxchg(&thread_created, 1, 0) != 0)
         return;
@@ -404,6 +410,8 @@ void create_user_shared_data_thread(void)
     FIXME("Creating user shared data update thread.\n");
 
     user_shared_data = user_shared_data_external;
+    NtQueryPerformanceCounter( &counter, &frequency );
+    user_shared_data->QpcFrequency = frequency.QuadPart;
     __wine_user_shared_data();
 
     pthread_attr_init(&attr);
@@ -571,6 +579,7 @@ void exit_thread( int status )
 {
     static void *prev_teb;
     shmlocal_t *shmlocal;
+    request_shm_t *request_shm;
     sigset_t sigset;
     TEB *teb;
 
@@ -597,6 +606,11 @@ void exit_thread( int status )
     shmlocal = interlocked_xchg_ptr( &NtCurrentTeb()->Reserved5[2], NULL );
     if (shmlocal) NtUnmapViewOfSection( NtCurrentProcess(), shmlocal );
 
+    /* any later request from this thread goes through the pipe */
+    request_shm = ntdll_get_thread_data()->request_shm;
+    ntdll_get_thread_data()->request_shm = NULL;
+    if (request_shm) NtUnmapViewOfSection( NtCurrentProcess(), request_shm );
+
     pthread_sigmask( SIG_BLOCK, &server_block_set, NULL );
 
     if ((teb = interlocked_xchg_ptr( &prev_teb, NtCurrentTeb() )))
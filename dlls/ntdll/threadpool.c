@@ -37,6 +37,7 @@
 #include "ntdll_misc.h"
 
 WINE_DEFAULT_DEBUG_CHANNEL(threadpool);
+WINE_DECLARE_DEBUG_CHANNEL(tpstats);
 
 /*
  * Old thread pooling API
@@ -114,8 +115,20 @@ struct timer_queue
  */
 
 #define THREADPOOL_WORKER_TIMEOUT 5000
+#define THREADPOOL_MAX_QUEUES 64
+#define THREADPOOL_FAIRNESS_INTERVAL 16
+#define THREADPOOL_STARVATION_TIMEOUT 100
 #define MAXIMUM_WAITQUEUE_OBJECTS (MAXIMUM_WAIT_OBJECTS - 1)
 
+/* queue of threadpool objects with pending callbacks */
+struct threadpool_queue
+{
+    RTL_SRWLOCK             lock;
+    /* objects in the queue, locked via .lock */
+    struct list             objects;
+    int                     count;
+};
+
 /* internal threadpool representation */
 struct threadpool
 {
@@ -123,14 +136,49 @@ struct threadpool
     LONG                    objcount;
     BOOL                    shutdown;
     CRITICAL_SECTION        cs;
-    /* pool of work items, locked via .cs */
-    struct list             pool;
     RTL_CONDITION_VARIABLE  update_event;
-    /* information about worker threads, locked via .cs */
+    /* information about worker threads, locked via .cs; the counters
+     * are also read without lock to decide whether a worker has to be woken */
+    struct list             workers;
     int                     max_workers;
     int                     min_workers;
-    int                     num_workers;
-    int                     num_busy_workers;
+    LONG                    num_workers;
+    LONG                    num_busy_workers;
+    LONG                    num_blocked_workers;
+    int                     max_running;
+    /* statistics, locked via .cs */
+    ULONG                   stats_executed;
+    ULONG                   stats_stolen;
+    ULONG                   stats_created;
+    ULONG                   stats_retired;
+    int                     stats_peak_workers;
+    /* starvation monitoring, locked via monitor.cs */
+    struct list             monitor_entry;
+    BOOL                    monitored;
+    ULONG                   monitor_progress;
+    ULONG                   monitor_time;
+    /* one queue per processor, workers steal from the other queues when
+     * their own queue is empty */
+    unsigned int            next_home_queue;
+    unsigned int            next_queue;
+    unsigned int            num_queues;
+    struct threadpool_queue queues[1];
+};
+
+/* internal threadpool worker representation, stored on the stack of the worker */
+struct threadpool_worker
+{
+    struct threadpool       *pool;
+    struct threadpool_queue *queue;
+    /* information about the worker, locked via .pool->cs */
+    struct list             entry;
+    /* only accessed by the worker thread itself */
+    unsigned int            next_queue;
+    BOOL                    running;
+    BOOL                    long_running;
+    unsigned int            blocked;    /* nesting level of blocking waits and long callbacks */
+    ULONG                   executed;
+    ULONG                   stolen;
 };
 
 enum threadpool_objtype
@@ -138,12 +186,20 @@ enum threadpool_objtype
     TP_OBJECT_TYPE_SIMPLE,
     TP_OBJECT_TYPE_WORK,
     TP_OBJECT_TYPE_TIMER,
-    TP_OBJECT_TYPE_WAIT
+    TP_OBJECT_TYPE_WAIT,
+    TP_OBJECT_TYPE_IO
+};
+
+struct io_completion
+{
+    IO_STATUS_BLOCK iosb;
+    ULONG_PTR       cvalue;
 };
 
 /* internal threadpool object representation */
 struct threadpool_object
 {
+    void                   *win32_callback; /* leave space for kernel32 to store the win32 callback */
     LONG                    refcount;
     BOOL                    shutdown;
     /* read-only information */
@@ -158,8 +214,10 @@ struct threadpool_object
     /* information about the group, locked via .group->cs */
     struct list             group_entry;
     BOOL                    is_group_member;
-    /* information about the pool, locked via .pool->cs */
+    /* information about the callbacks, locked via .lock */
+    RTL_SRWLOCK             lock;
     struct list             pool_entry;
+    BOOL                    queued;
     RTL_CONDITION_VARIABLE  finished_event;
     RTL_CONDITION_VARIABLE  group_finished_event;
     LONG                    num_pending_callbacks;
@@ -191,6 +249,7 @@ struct threadpool_object
         struct
         {
             PTP_WAIT_CALLBACK callback;
+            /* locked via .lock */
             LONG            signaled;
             /* information about the wait object, locked via waitqueue.cs */
             struct waitqueue_bucket *bucket;
@@ -199,6 +258,17 @@ struct threadpool_object
             ULONGLONG       timeout;
             HANDLE          handle;
         } wait;
+        struct
+        {
+            PTP_IO_CALLBACK callback;
+            HANDLE          file;
+            /* information about the I/O object, locked via .lock */
+            unsigned int    pending_count;
+            unsigned int    completion_head;
+            unsigned int    completion_count;
+            unsigned int    completion_max;
+            struct io_completion *completions;
+        } io;
     } u;
 };
 
@@ -280,6 +350,56 @@ static RTL_CRITICAL_SECTION_DEBUG waitqueue_debug =
       0, 0, { (DWORD_PTR)(__FILE__ ": waitqueue.cs") }
 };
 
+/* global I/O completion queue object */
+static RTL_CRITICAL_SECTION_DEBUG ioqueue_debug;
+
+static struct
+{
+    CRITICAL_SECTION        cs;
+    LONG                    objcount;
+    BOOL                    thread_running;
+    HANDLE                  port;
+}
+ioqueue =
+{
+    { &ioqueue_debug, -1, 0, 0, 0, 0 },         /* cs */
+    0,                                          /* objcount */
+    FALSE,                                      /* thread_running */
+    NULL                                        /* port */
+};
+
+static RTL_CRITICAL_SECTION_DEBUG ioqueue_debug =
+{
+    0, 0, &ioqueue.cs,
+    { &ioqueue_debug.ProcessLocksList, &ioqueue_debug.ProcessLocksList },
+      0, 0, { (DWORD_PTR)(__FILE__ ": ioqueue.cs") }
+};
+
+/* global starvation monitor object, watches pools whose workers are all busy */
+static RTL_CRITICAL_SECTION_DEBUG monitor_debug;
+
+static struct
+{
+    CRITICAL_SECTION        cs;
+    BOOL                    thread_running;
+    struct list             pools;
+    RTL_CONDITION_VARIABLE  update_event;
+}
+monitor =
+{
+    { &monitor_debug, -1, 0, 0, 0, 0 },         /* cs */
+    FALSE,                                      /* thread_running */
+    LIST_INIT( monitor.pools ),                 /* pools */
+    RTL_CONDITION_VARIABLE_INIT                 /* update_event */
+};
+
+static RTL_CRITICAL_SECTION_DEBUG monitor_debug =
+{
+    0, 0, &monitor.cs,
+    { &monitor_debug.ProcessLocksList, &monitor_debug.ProcessLocksList },
+      0, 0, { (DWORD_PTR)(__FILE__ ": monitor.cs") }
+};
+
 struct waitqueue_bucket
 {
     struct list             bucket_entry;
@@ -315,6 +435,13 @@ static inline struct threadpool_object *impl_from_TP_WAIT( TP_WAIT *wait )
     return object;
 }
 
+static inline struct threadpool_object *impl_from_TP_IO( TP_IO *io )
+{
+    struct threadpool_object *object = (struct threadpool_object *)io;
+    assert( object->type == TP_OBJECT_TYPE_IO );
+    return object;
+}
+
 static inline struct threadpool_group *impl_from_TP_CLEANUP_GROUP( TP_CLEANUP_GROUP *group )
 {
     return (struct threadpool_group *)group;
@@ -326,9 +453,14 @@ static inline struct threadpool_instance *impl_from_TP_CALLBACK_INSTANCE( TP_CAL
 }
 
 static void CALLBACK threadpool_worker_proc( void *param );
+static BOOL tp_object_queue_callback( struct threadpool_object *object, BOOL signaled );
 static void tp_object_submit( struct threadpool_object *object, BOOL signaled );
 static void tp_object_prepare_shutdown( struct threadpool_object *object );
 static BOOL tp_object_release( struct threadpool_object *object );
+static BOOL tp_object_is_finished( struct threadpool_object *object, BOOL group );
+static BOOL tp_io_grow_completions( struct threadpool_object *io );
+static void tp_monitor_add( struct threadpool *pool );
+static BOOL tp_threadpool_release( struct threadpool *pool );
 static struct threadpool *default_threadpool = NULL;
 
 static inline LONG interlocked_inc( PLONG dest )
@@ -1296,13 +1428,344 @@ static NTSTATUS tp_new_worker_thread( struct threadpool *pool )
     if (status == STATUS_SUCCESS)
     {
         interlocked_inc( &pool->refcount );
-        pool->num_workers++;
-        pool->num_busy_workers++;
+        interlocked_inc( &pool->num_workers );
+        interlocked_inc( &pool->num_busy_workers );
+        pool->stats_created++;
+        pool->stats_peak_workers = max( pool->stats_peak_workers, pool->num_workers );
         NtClose( thread );
     }
     return status;
 }
 
+/***********************************************************************
+ *           tp_threadpool_dump_stats    (internal)
+ *
+ * Prints the statistics of a threadpool to the tpstats debug channel.
+ * Caller must hold .cs.
+ */
+static void tp_threadpool_dump_stats( struct threadpool *pool, const char *reason )
+{
+    struct threadpool_worker *worker;
+    ULONG executed = pool->stats_executed;
+    ULONG stolen = pool->stats_stolen;
+
+    if (!TRACE_ON(tpstats)) return;
+
+    LIST_FOR_EACH_ENTRY( worker, &pool->workers, struct threadpool_worker, entry )
+    {
+        executed += worker->executed;
+        stolen   += worker->stolen;
+    }
+
+    TRACE_(tpstats)( "pool %p (%s): %d workers, %d busy, %d blocked, peak %d, limit %d/%d, "
+                     "%u created, %u retired, %u callbacks, %u stolen\n", pool, reason,
+                     pool->num_workers, pool->num_busy_workers, pool->num_blocked_workers,
+                     pool->stats_peak_workers, pool->max_running, pool->max_workers,
+                     pool->stats_created, pool->stats_retired, executed, stolen );
+}
+
+/***********************************************************************
+ *           tp_threadpool_inject    (internal)
+ *
+ * Starts a new worker thread when no worker is idle, and fewer workers than
+ * processors are running callbacks without being blocked. Caller must
+ * hold .cs.
+ */
+static void tp_threadpool_inject( struct threadpool *pool, BOOL blocked )
+{
+    if (pool->num_busy_workers < pool->num_workers)
+        return;
+    if (pool->num_workers >= pool->max_workers)
+        return;
+    if (pool->num_workers - pool->num_blocked_workers >= pool->max_running)
+        return;
+
+    if (tp_new_worker_thread( pool ) == STATUS_SUCCESS && blocked)
+        tp_threadpool_dump_stats( pool, "worker blocked" );
+}
+
+/***********************************************************************
+ *           tp_threadpool_schedule    (internal)
+ *
+ * Makes sure that a newly queued object is picked up, either by waking an
+ * idle worker or by starting a new one.
+ */
+static void tp_threadpool_schedule( struct threadpool *pool )
+{
+    /* All workers are busy and no more may be started, one of them will
+     * pick up the object when its current callback returns. The monitor
+     * starts another worker if none of them returns in time. */
+    if (pool->num_busy_workers >= pool->num_workers &&
+        (pool->num_workers >= pool->max_workers ||
+         pool->num_workers - pool->num_blocked_workers >= pool->max_running))
+    {
+        if (!pool->monitored && pool->num_workers < pool->max_workers)
+            tp_monitor_add( pool );
+        return;
+    }
+
+    RtlEnterCriticalSection( &pool->cs );
+    if (pool->num_busy_workers < pool->num_workers)
+        RtlWakeConditionVariable( &pool->update_event );
+    else
+        tp_threadpool_inject( pool, FALSE );
+    RtlLeaveCriticalSection( &pool->cs );
+}
+
+/***********************************************************************
+ *           tp_threadpool_has_work    (internal)
+ *
+ * Checks whether any of the queues of a threadpool is non-empty.
+ */
+static BOOL tp_threadpool_has_work( struct threadpool *pool )
+{
+    unsigned int i;
+    int count;
+
+    for (i = 0; i < pool->num_queues; i++)
+    {
+        RtlAcquireSRWLockShared( &pool->queues[i].lock );
+        count = pool->queues[i].count;
+        RtlReleaseSRWLockShared( &pool->queues[i].lock );
+        if (count) return TRUE;
+    }
+    return FALSE;
+}
+
+/***********************************************************************
+ *           tp_threadpool_progress    (internal)
+ *
+ * Returns the number of callbacks completed by the workers of a pool.
+ * Caller must hold .cs.
+ */
+static ULONG tp_threadpool_progress( struct threadpool *pool )
+{
+    struct threadpool_worker *worker;
+    ULONG executed = pool->stats_executed;
+
+    LIST_FOR_EACH_ENTRY( worker, &pool->workers, struct threadpool_worker, entry )
+        executed += worker->executed;
+    return executed;
+}
+
+/***********************************************************************
+ *           monitor_thread_proc    (internal)
+ *
+ * Starts a new worker for pools with queued work when none of their busy
+ * workers completed a callback within THREADPOOL_STARVATION_TIMEOUT. This
+ * catches workers blocked in waits that tp_worker_block_begin doesn't see,
+ * like critical sections, keyed events or server calls, as well as
+ * callbacks waiting for work queued after them.
+ */
+static void CALLBACK monitor_thread_proc( void *param )
+{
+    struct threadpool *pool, *next;
+    LARGE_INTEGER timeout;
+    ULONG progress, now;
+    BOOL done;
+
+    TRACE( "starting starvation monitor thread\n" );
+
+    RtlEnterCriticalSection( &monitor.cs );
+    for (;;)
+    {
+        now = NtGetTickCount();
+
+        LIST_FOR_EACH_ENTRY_SAFE( pool, next, &monitor.pools, struct threadpool, monitor_entry )
+        {
+            RtlEnterCriticalSection( &pool->cs );
+            progress = tp_threadpool_progress( pool );
+            done = !tp_threadpool_has_work( pool );
+            if (progress != pool->monitor_progress)
+            {
+                pool->monitor_progress = progress;
+                pool->monitor_time = now;
+            }
+            else if (!done && now - pool->monitor_time >= THREADPOOL_STARVATION_TIMEOUT &&
+                     pool->num_busy_workers >= pool->num_workers &&
+                     pool->num_workers < pool->max_workers &&
+                     tp_new_worker_thread( pool ) == STATUS_SUCCESS)
+            {
+                pool->monitor_time = now;
+                tp_threadpool_dump_stats( pool, "workers starved" );
+            }
+            RtlLeaveCriticalSection( &pool->cs );
+
+            if (done)
+            {
+                list_remove( &pool->monitor_entry );
+                pool->monitored = FALSE;
+                tp_threadpool_release( pool );
+            }
+        }
+
+        if (!list_empty( &monitor.pools ))
+        {
+            timeout.QuadPart = (ULONGLONG)THREADPOOL_STARVATION_TIMEOUT * -10000;
+            RtlSleepConditionVariableCS( &monitor.update_event, &monitor.cs, &timeout );
+            continue;
+        }
+
+        /* No pool needs to be watched, if none is added within some amount
+         * of time, then we can shutdown this thread. */
+        timeout.QuadPart = (ULONGLONG)THREADPOOL_WORKER_TIMEOUT * -10000;
+        if (RtlSleepConditionVariableCS( &monitor.update_event, &monitor.cs,
+            &timeout ) == STATUS_TIMEOUT && list_empty( &monitor.pools ))
+        {
+            break;
+        }
+    }
+
+    monitor.thread_running = FALSE;
+    RtlLeaveCriticalSection( &monitor.cs );
+
+    TRACE( "terminating starvation monitor thread\n" );
+    RtlExitUserThread( 0 );
+}
+
+/***********************************************************************
+ *           tp_monitor_add    (internal)
+ *
+ * Adds a pool whose workers are all busy to the starvation monitor, until
+ * its queues are empty again.
+ */
+static void tp_monitor_add( struct threadpool *pool )
+{
+    HANDLE thread;
+
+    RtlEnterCriticalSection( &monitor.cs );
+    if (pool->monitored)
+        goto out;
+
+    if (!monitor.thread_running)
+    {
+        if (RtlCreateUserThread( GetCurrentProcess(), NULL, FALSE, NULL, 0, 0,
+                                 monitor_thread_proc, NULL, &thread, NULL ))
+            goto out;
+        monitor.thread_running = TRUE;
+        NtClose( thread );
+    }
+
+    RtlEnterCriticalSection( &pool->cs );
+    pool->monitor_progress = tp_threadpool_progress( pool );
+    pool->monitor_time = NtGetTickCount();
+    RtlLeaveCriticalSection( &pool->cs );
+
+    interlocked_inc( &pool->refcount );
+    pool->monitored = TRUE;
+    if (list_empty( &monitor.pools ))
+        RtlWakeConditionVariable( &monitor.update_event );
+    list_add_tail( &monitor.pools, &pool->monitor_entry );
+
+out:
+    RtlLeaveCriticalSection( &monitor.cs );
+}
+
+/***********************************************************************
+ *           tp_queue_push    (internal)
+ *
+ * Appends an object to a queue. Caller must hold .lock of the object.
+ */
+static void tp_queue_push( struct threadpool_queue *queue, struct threadpool_object *object )
+{
+    RtlAcquireSRWLockExclusive( &queue->lock );
+    list_add_tail( &queue->objects, &object->pool_entry );
+    queue->count++;
+    RtlReleaseSRWLockExclusive( &queue->lock );
+}
+
+/***********************************************************************
+ *           tp_queue_pop    (internal)
+ *
+ * Removes the first object from a queue.
+ */
+static struct threadpool_object *tp_queue_pop( struct threadpool_queue *queue )
+{
+    struct threadpool_object *object = NULL;
+    struct list *ptr;
+
+    RtlAcquireSRWLockExclusive( &queue->lock );
+    if ((ptr = list_head( &queue->objects )))
+    {
+        object = LIST_ENTRY( ptr, struct threadpool_object, pool_entry );
+        list_remove( &object->pool_entry );
+        queue->count--;
+    }
+    RtlReleaseSRWLockExclusive( &queue->lock );
+    return object;
+}
+
+/***********************************************************************
+ *           tp_worker_next_object    (internal)
+ *
+ * Takes the next object from the queues of a threadpool, starting the
+ * search at .next_queue of the worker, which is usually its own queue.
+ */
+static struct threadpool_object *tp_worker_next_object( struct threadpool_worker *worker )
+{
+    struct threadpool *pool = worker->pool;
+    struct threadpool_object *object;
+    struct threadpool_queue *queue;
+    unsigned int i;
+
+    for (i = 0; i < pool->num_queues; i++)
+    {
+        queue = &pool->queues[(worker->next_queue + i) % pool->num_queues];
+
+        /* skip empty queues without taking their lock */
+        if (!queue->count)
+            continue;
+
+        if ((object = tp_queue_pop( queue )))
+        {
+            if (queue != worker->queue) worker->stolen++;
+            return object;
+        }
+    }
+    return NULL;
+}
+
+/***********************************************************************
+ *           tp_worker_block_begin    (internal)
+ *
+ * Called before a thread starts a blocking wait. When the thread is a worker
+ * executing a callback, it no longer counts against the processor limit, and
+ * a replacement worker is started if objects are waiting to be processed.
+ */
+void tp_worker_block_begin( const LARGE_INTEGER *timeout )
+{
+    struct threadpool_worker *worker = ntdll_get_thread_data()->tp_worker;
+    struct threadpool *pool;
+
+    if (!worker || !worker->running) return;
+    if (timeout && !timeout->QuadPart) return;
+    if (worker->blocked++) return;
+
+    pool = worker->pool;
+    interlocked_inc( &pool->num_blocked_workers );
+
+    if (pool->num_busy_workers >= pool->num_workers && tp_threadpool_has_work( pool ))
+    {
+        RtlEnterCriticalSection( &pool->cs );
+        tp_threadpool_inject( pool, TRUE );
+        RtlLeaveCriticalSection( &pool->cs );
+    }
+}
+
+/***********************************************************************
+ *           tp_worker_block_end    (internal)
+ */
+void tp_worker_block_end( const LARGE_INTEGER *timeout )
+{
+    struct threadpool_worker *worker = ntdll_get_thread_data()->tp_worker;
+
+    if (!worker || !worker->running) return;
+    if (timeout && !timeout->QuadPart) return;
+    if (--worker->blocked) return;
+
+    interlocked_dec( &worker->pool->num_blocked_workers );
+}
+
 /***********************************************************************
  *           tp_timerqueue_lock    (internal)
  *
@@ -1626,6 +2089,218 @@ static void tp_waitqueue_unlock( struct threadpool_object *wait )
     RtlLeaveCriticalSection( &waitqueue.cs );
 }
 
+/***********************************************************************
+ *           ioqueue_thread_proc    (internal)
+ *
+ * Dispatches the completions of all threadpool I/O objects in the process,
+ * which share a single completion port, to the pools of the objects.
+ */
+static void CALLBACK ioqueue_thread_proc( void *param )
+{
+    struct threadpool_object *io;
+    struct io_completion *completion;
+    IO_STATUS_BLOCK iosb;
+    ULONG_PTR key, value;
+    BOOL release, schedule;
+    NTSTATUS status;
+
+    TRACE( "starting I/O completion thread\n" );
+
+    for (;;)
+    {
+        status = NtRemoveIoCompletion( ioqueue.port, &key, &value, &iosb, NULL );
+        if (status)
+        {
+            ERR( "NtRemoveIoCompletion failed, status %#x\n", status );
+            continue;
+        }
+
+        /* a packet without key is sent when the last object is released */
+        if (!key)
+        {
+            RtlEnterCriticalSection( &ioqueue.cs );
+            if (!ioqueue.objcount)
+            {
+                ioqueue.thread_running = FALSE;
+                RtlLeaveCriticalSection( &ioqueue.cs );
+                break;
+            }
+            RtlLeaveCriticalSection( &ioqueue.cs );
+            continue;
+        }
+
+        io = (struct threadpool_object *)key;
+        assert( io->type == TP_OBJECT_TYPE_IO );
+        release = schedule = FALSE;
+
+        RtlAcquireSRWLockExclusive( &io->lock );
+        TRACE( "completion for %p, pending %u\n", io, io->u.io.pending_count );
+
+        if (!io->u.io.pending_count)
+            WARN( "unexpected completion for %p, StartThreadpoolIo wasn't called\n", io );
+        else
+            release = !--io->u.io.pending_count;
+
+        if (io->shutdown)
+        {
+            /* the object was closed with I/O still in flight, drop the completion */
+        }
+        else if (io->u.io.completion_count == io->u.io.completion_max &&
+                 !tp_io_grow_completions( io ))
+        {
+            ERR( "failed to queue completion for %p\n", io );
+        }
+        else
+        {
+            completion = &io->u.io.completions[(io->u.io.completion_head + io->u.io.completion_count++) %
+                                               io->u.io.completion_max];
+            completion->iosb = iosb;
+            completion->cvalue = value;
+            schedule = tp_object_queue_callback( io, FALSE );
+        }
+
+        if (tp_object_is_finished( io, TRUE ))
+            RtlWakeAllConditionVariable( &io->group_finished_event );
+        if (tp_object_is_finished( io, FALSE ))
+            RtlWakeAllConditionVariable( &io->finished_event );
+        RtlReleaseSRWLockExclusive( &io->lock );
+
+        if (schedule) tp_threadpool_schedule( io->pool );
+
+        /* drop the reference held for the I/O in flight */
+        if (release) tp_object_release( io );
+    }
+
+    TRACE( "terminating I/O completion thread\n" );
+    RtlExitUserThread( 0 );
+}
+
+/***********************************************************************
+ *           tp_ioqueue_unbind    (internal)
+ *
+ * Removes the binding of the file to the completion port, so that I/O
+ * started later on the file doesn't post packets with a stale key.
+ * Completions of I/O already in flight are still delivered.
+ */
+static void tp_ioqueue_unbind( struct threadpool_object *io )
+{
+    FILE_COMPLETION_INFORMATION info;
+    IO_STATUS_BLOCK iosb;
+    NTSTATUS status;
+
+    assert( io->type == TP_OBJECT_TYPE_IO );
+
+    info.CompletionPort = NULL;
+    info.CompletionKey  = 0;
+    status = NtSetInformationFile( io->u.io.file, &iosb, &info, sizeof(info),
+                                   FileReplaceCompletionInformation );
+    if (status) WARN( "failed to unbind %p, status %#x\n", io, status );
+
+    NtClose( io->u.io.file );
+    io->u.io.file = NULL;
+}
+
+/***********************************************************************
+ *           tp_ioqueue_lock    (internal)
+ *
+ * Binds a file handle to the global I/O completion port, with the
+ * threadpool object as completion key, and makes sure the completion
+ * thread is running. A duplicate of the file handle is kept, so that
+ * the binding can be removed again when the object is released.
+ */
+static NTSTATUS tp_ioqueue_lock( struct threadpool_object *io, HANDLE file )
+{
+    FILE_COMPLETION_INFORMATION info;
+    IO_STATUS_BLOCK iosb;
+    NTSTATUS status = STATUS_SUCCESS;
+    HANDLE thread;
+
+    assert( io->type == TP_OBJECT_TYPE_IO );
+
+    io->u.io.pending_count      = 0;
+    io->u.io.completion_head    = 0;
+    io->u.io.completion_count   = 0;
+    io->u.io.completion_max     = 0;
+    io->u.io.completions        = NULL;
+
+    status = NtDuplicateObject( NtCurrentProcess(), file, NtCurrentProcess(), &io->u.io.file,
+                                0, 0, DUPLICATE_SAME_ACCESS );
+    if (status) return status;
+
+    RtlEnterCriticalSection( &ioqueue.cs );
+
+    if (!ioqueue.port)
+    {
+        status = NtCreateIoCompletion( &ioqueue.port, IO_COMPLETION_ALL_ACCESS, NULL, 0 );
+        if (status) goto out;
+    }
+
+    info.CompletionPort = ioqueue.port;
+    info.CompletionKey  = (ULONG_PTR)io;
+    status = NtSetInformationFile( file, &iosb, &info, sizeof(info), FileCompletionInformation );
+    if (status) goto out;
+
+    if (!ioqueue.thread_running)
+    {
+        status = RtlCreateUserThread( GetCurrentProcess(), NULL, FALSE, NULL, 0, 0,
+                                      ioqueue_thread_proc, NULL, &thread, NULL );
+        if (status)
+        {
+            RtlLeaveCriticalSection( &ioqueue.cs );
+            tp_ioqueue_unbind( io );
+            return status;
+        }
+        ioqueue.thread_running = TRUE;
+        NtClose( thread );
+    }
+
+    ioqueue.objcount++;
+
+out:
+    RtlLeaveCriticalSection( &ioqueue.cs );
+    if (status) NtClose( io->u.io.file );
+    return status;
+}
+
+/***********************************************************************
+ *           tp_ioqueue_unlock    (internal)
+ */
+static void tp_ioqueue_unlock( struct threadpool_object *io )
+{
+    assert( io->type == TP_OBJECT_TYPE_IO );
+
+    RtlEnterCriticalSection( &ioqueue.cs );
+    assert( ioqueue.objcount > 0 );
+    if (!--ioqueue.objcount)
+        NtSetIoCompletion( ioqueue.port, 0, 0, STATUS_SUCCESS, 0 );
+    RtlLeaveCriticalSection( &ioqueue.cs );
+}
+
+/***********************************************************************
+ *           tp_io_grow_completions    (internal)
+ *
+ * Makes room for more queued completions. Caller must hold .lock of the object.
+ */
+static BOOL tp_io_grow_completions( struct threadpool_object *io )
+{
+    unsigned int max = max( io->u.io.completion_max * 2, 4 );
+    struct io_completion *completions;
+    unsigned int i;
+
+    completions = RtlAllocateHeap( GetProcessHeap(), 0, max * sizeof(*completions) );
+    if (!completions) return FALSE;
+
+    /* unwrap the ring, the oldest completion moves to the front */
+    for (i = 0; i < io->u.io.completion_count; i++)
+        completions[i] = io->u.io.completions[(io->u.io.completion_head + i) % io->u.io.completion_max];
+
+    RtlFreeHeap( GetProcessHeap(), 0, io->u.io.completions );
+    io->u.io.completions = completions;
+    io->u.io.completion_head = 0;
+    io->u.io.completion_max = max;
+    return TRUE;
+}
+
 /***********************************************************************
  *           tp_threadpool_alloc    (internal)
  *
@@ -1633,9 +2308,12 @@ static void tp_waitqueue_unlock( struct threadpool_object *wait )
  */
 static NTSTATUS tp_threadpool_alloc( struct threadpool **out )
 {
+    unsigned int i, num_queues;
     struct threadpool *pool;
 
-    pool = RtlAllocateHeap( GetProcessHeap(), 0, sizeof(*pool) );
+    num_queues = min( max( NtCurrentTeb()->Peb->NumberOfProcessors, 1 ), THREADPOOL_MAX_QUEUES );
+
+    pool = RtlAllocateHeap( GetProcessHeap(), 0, FIELD_OFFSET( struct threadpool, queues[num_queues] ) );
     if (!pool)
         return STATUS_NO_MEMORY;
 
@@ -1646,15 +2324,37 @@ static NTSTATUS tp_threadpool_alloc( struct threadpool **out )
     RtlInitializeCriticalSection( &pool->cs );
     pool->cs.DebugInfo->Spare[0] = (DWORD_PTR)(__FILE__ ": threadpool.cs");
 
-    list_init( &pool->pool );
     RtlInitializeConditionVariable( &pool->update_event );
 
+    list_init( &pool->workers );
     pool->max_workers           = 500;
     pool->min_workers           = 0;
     pool->num_workers           = 0;
     pool->num_busy_workers      = 0;
+    pool->num_blocked_workers   = 0;
+    pool->max_running           = max( NtCurrentTeb()->Peb->NumberOfProcessors, 1 );
+
+    pool->stats_executed        = 0;
+    pool->stats_stolen          = 0;
+    pool->stats_created         = 0;
+    pool->stats_retired         = 0;
+    pool->stats_peak_workers    = 0;
+
+    pool->monitored             = FALSE;
+    pool->monitor_progress      = 0;
+    pool->monitor_time          = 0;
+
+    pool->next_home_queue       = 0;
+    pool->next_queue            = 0;
+    pool->num_queues            = num_queues;
+    for (i = 0; i < num_queues; i++)
+    {
+        RtlInitializeSRWLock( &pool->queues[i].lock );
+        list_init( &pool->queues[i].objects );
+        pool->queues[i].count   = 0;
+    }
 
-    TRACE( "allocated threadpool %p\n", pool );
+    TRACE( "allocated threadpool %p with %u queues\n", pool, num_queues );
 
     *out = pool;
     return STATUS_SUCCESS;
@@ -1689,7 +2389,11 @@ static BOOL tp_threadpool_release( struct threadpool *pool )
 
     assert( pool->shutdown );
     assert( !pool->objcount );
-    assert( list_empty( &pool->pool ) );
+    assert( !tp_threadpool_has_work( pool ) );
+
+    RtlEnterCriticalSection( &pool->cs );
+    tp_threadpool_dump_stats( pool, "destroyed" );
+    RtlLeaveCriticalSection( &pool->cs );
 
     pool->cs.DebugInfo->Spare[0] = 0;
     RtlDeleteCriticalSection( &pool->cs );
@@ -1731,24 +2435,26 @@ static NTSTATUS tp_threadpool_lock( struct threadpool **out, TP_CALLBACK_ENVIRON
         pool = default_threadpool;
     }
 
-    RtlEnterCriticalSection( &pool->cs );
+    /* Keep a reference, and increment objcount to ensure that the
+     * last thread doesn't terminate. */
+    interlocked_inc( &pool->refcount );
+    interlocked_inc( &pool->objcount );
 
     /* Make sure that the threadpool has at least one thread. */
     if (!pool->num_workers)
-        status = tp_new_worker_thread( pool );
-
-    /* Keep a reference, and increment objcount to ensure that the
-     * last thread doesn't terminate. */
-    if (status == STATUS_SUCCESS)
     {
-        interlocked_inc( &pool->refcount );
-        pool->objcount++;
+        RtlEnterCriticalSection( &pool->cs );
+        if (!pool->num_workers)
+            status = tp_new_worker_thread( pool );
+        RtlLeaveCriticalSection( &pool->cs );
     }
 
-    RtlLeaveCriticalSection( &pool->cs );
-
     if (status != STATUS_SUCCESS)
+    {
+        interlocked_dec( &pool->objcount );
+        tp_threadpool_release( pool );
         return status;
+    }
 
     *out = pool;
     return STATUS_SUCCESS;
@@ -1761,9 +2467,7 @@ static NTSTATUS tp_threadpool_lock( struct threadpool **out, TP_CALLBACK_ENVIRON
  */
 static void tp_threadpool_unlock( struct threadpool *pool )
 {
-    RtlEnterCriticalSection( &pool->cs );
-    pool->objcount--;
-    RtlLeaveCriticalSection( &pool->cs );
+    interlocked_dec( &pool->objcount );
     tp_threadpool_release( pool );
 }
 
@@ -1850,7 +2554,9 @@ static void tp_object_initialize( struct threadpool_object *object, struct threa
     memset( &object->group_entry, 0, sizeof(object->group_entry) );
     object->is_group_member         = FALSE;
 
+    RtlInitializeSRWLock( &object->lock );
     memset( &object->pool_entry, 0, sizeof(object->pool_entry) );
+    object->queued                  = FALSE;
     RtlInitializeConditionVariable( &object->finished_event );
     RtlInitializeConditionVariable( &object->group_finished_event );
     object->num_pending_callbacks   = 0;
@@ -1903,66 +2609,83 @@ static void tp_object_initialize( struct threadpool_object *object, struct threa
 }
 
 /***********************************************************************
- *           tp_object_submit    (internal)
+ *           tp_object_queue_callback    (internal)
  *
- * Submits a threadpool object to the associated threadpool. This
- * function has to be VOID because TpPostWork can never fail on Windows.
+ * Adds a pending callback to a threadpool object, and queues the object if
+ * it isn't already. Callbacks submitted from a worker of the same pool are
+ * queued on the queue of that worker. Caller must hold .lock, and has to
+ * call tp_threadpool_schedule when TRUE is returned.
  */
-static void tp_object_submit( struct threadpool_object *object, BOOL signaled )
+static BOOL tp_object_queue_callback( struct threadpool_object *object, BOOL signaled )
 {
+    struct threadpool_worker *worker = ntdll_get_thread_data()->tp_worker;
     struct threadpool *pool = object->pool;
-    NTSTATUS status = STATUS_UNSUCCESSFUL;
+    struct threadpool_queue *queue;
 
     assert( !object->shutdown );
     assert( !pool->shutdown );
 
-    RtlEnterCriticalSection( &pool->cs );
+    /* Increment refcount, and count how often the object was signaled. */
+    interlocked_inc( &object->refcount );
+    object->num_pending_callbacks++;
+    if (object->type == TP_OBJECT_TYPE_WAIT && signaled)
+        object->u.wait.signaled++;
 
-    /* Start new worker threads if required. */
-    if (pool->num_busy_workers >= pool->num_workers &&
-        pool->num_workers < pool->max_workers)
-        status = tp_new_worker_thread( pool );
+    if (object->queued)
+        return FALSE;
 
-    /* Queue work item and increment refcount. */
+    if (worker && worker->pool == pool)
+        queue = worker->queue;
+    else
+        queue = &pool->queues[pool->next_queue++ % pool->num_queues];
+
+    /* The queue holds an additional reference until the object is taken from it. */
     interlocked_inc( &object->refcount );
-    if (!object->num_pending_callbacks++)
-        list_add_tail( &pool->pool, &object->pool_entry );
+    object->queued = TRUE;
+    tp_queue_push( queue, object );
+    return TRUE;
+}
 
-    /* Count how often the object was signaled. */
-    if (object->type == TP_OBJECT_TYPE_WAIT && signaled)
-        object->u.wait.signaled++;
+/***********************************************************************
+ *           tp_object_submit    (internal)
+ *
+ * Submits a threadpool object to the associated threadpool. This
+ * function has to be VOID because TpPostWork can never fail on Windows.
+ */
+static void tp_object_submit( struct threadpool_object *object, BOOL signaled )
+{
+    BOOL schedule;
 
-    /* No new thread started - wake up one existing thread. */
-    if (status != STATUS_SUCCESS)
-    {
-        assert( pool->num_workers > 0 );
-        RtlWakeConditionVariable( &pool->update_event );
-    }
+    RtlAcquireSRWLockExclusive( &object->lock );
+    schedule = tp_object_queue_callback( object, signaled );
+    RtlReleaseSRWLockExclusive( &object->lock );
 
-    RtlLeaveCriticalSection( &pool->cs );
+    if (schedule)
+        tp_threadpool_schedule( object->pool );
 }
 
 /***********************************************************************
  *           tp_object_cancel    (internal)
  *
- * Cancels all currently pending callbacks for a specific object.
+ * Cancels all currently pending callbacks for a specific object. The object
+ * stays in its queue until a worker takes it, and is skipped then.
  */
 static void tp_object_cancel( struct threadpool_object *object )
 {
-    struct threadpool *pool = object->pool;
-    LONG pending_callbacks = 0;
+    LONG pending_callbacks;
 
-    RtlEnterCriticalSection( &pool->cs );
-    if (object->num_pending_callbacks)
-    {
-        pending_callbacks = object->num_pending_callbacks;
-        object->num_pending_callbacks = 0;
-        list_remove( &object->pool_entry );
+    RtlAcquireSRWLockExclusive( &object->lock );
+    pending_callbacks = object->num_pending_callbacks;
+    object->num_pending_callbacks = 0;
 
-        if (object->type == TP_OBJECT_TYPE_WAIT)
-            object->u.wait.signaled = 0;
+    if (object->type == TP_OBJECT_TYPE_WAIT)
+        object->u.wait.signaled = 0;
+    if (object->type == TP_OBJECT_TYPE_IO)
+    {
+        object->u.io.completion_head = 0;
+        object->u.io.completion_count = 0;
     }
-    RtlLeaveCriticalSection( &pool->cs );
+    RtlReleaseSRWLockExclusive( &object->lock );
 
     while (pending_callbacks--)
         tp_object_release( object );
@@ -1976,20 +2699,37 @@ static void tp_object_cancel( struct threadpool_object *object )
  */
 static void tp_object_wait( struct threadpool_object *object, BOOL group_wait )
 {
-    struct threadpool *pool = object->pool;
-
-    RtlEnterCriticalSection( &pool->cs );
+    RtlAcquireSRWLockExclusive( &object->lock );
     if (group_wait)
     {
-        while (object->num_pending_callbacks || object->num_running_callbacks)
-            RtlSleepConditionVariableCS( &object->group_finished_event, &pool->cs, NULL );
+        while (!tp_object_is_finished( object, TRUE ))
+            RtlSleepConditionVariableSRW( &object->group_finished_event, &object->lock, NULL, 0 );
     }
     else
     {
-        while (object->num_pending_callbacks || object->num_associated_callbacks)
-            RtlSleepConditionVariableCS( &object->finished_event, &pool->cs, NULL );
+        while (!tp_object_is_finished( object, FALSE ))
+            RtlSleepConditionVariableSRW( &object->finished_event, &object->lock, NULL, 0 );
     }
-    RtlLeaveCriticalSection( &pool->cs );
+    RtlReleaseSRWLockExclusive( &object->lock );
+}
+
+/***********************************************************************
+ *           tp_object_is_finished    (internal)
+ *
+ * Checks whether all callbacks of an object, and for I/O objects all started
+ * I/O operations, have been processed. Caller must hold .lock.
+ */
+static BOOL tp_object_is_finished( struct threadpool_object *object, BOOL group )
+{
+    if (object->num_pending_callbacks)
+        return FALSE;
+    if (object->type == TP_OBJECT_TYPE_IO && object->u.io.pending_count)
+        return FALSE;
+
+    if (group)
+        return !object->num_running_callbacks;
+    else
+        return !object->num_associated_callbacks;
 }
 
 /***********************************************************************
@@ -2043,6 +2783,12 @@ static BOOL tp_object_release( struct threadpool_object *object )
     if (object->race_dll)
         LdrUnloadDll( object->race_dll );
 
+    if (object->type == TP_OBJECT_TYPE_IO)
+    {
+        tp_ioqueue_unlock( object );
+        RtlFreeHeap( GetProcessHeap(), 0, object->u.io.completions );
+    }
+
     RtlFreeHeap( GetProcessHeap(), 0, object );
     return TRUE;
 }
@@ -2054,28 +2800,55 @@ static void CALLBACK threadpool_worker_proc( void *param )
 {
     TP_CALLBACK_INSTANCE *callback_instance;
     struct threadpool_instance instance;
+    struct threadpool_worker worker;
     struct threadpool *pool = param;
+    struct threadpool_object *object;
     TP_WAIT_RESULT wait_result = 0;
+    struct io_completion completion;
     LARGE_INTEGER timeout;
-    struct list *ptr;
+    BOOL requeue;
     NTSTATUS status;
 
     TRACE( "starting worker thread for pool %p\n", pool );
 
+    worker.pool         = pool;
+    worker.running      = FALSE;
+    worker.long_running = FALSE;
+    worker.blocked      = 0;
+    worker.executed     = 0;
+    worker.stolen       = 0;
+
     RtlEnterCriticalSection( &pool->cs );
-    pool->num_busy_workers--;
+    worker.next_queue = pool->next_home_queue++ % pool->num_queues;
+    worker.queue = &pool->queues[worker.next_queue];
+    list_add_tail( &pool->workers, &worker.entry );
+    RtlLeaveCriticalSection( &pool->cs );
+
+    ntdll_get_thread_data()->tp_worker = &worker;
+
     for (;;)
     {
-        while ((ptr = list_head( &pool->pool )))
+        while ((object = tp_worker_next_object( &worker )))
         {
-            struct threadpool_object *object = LIST_ENTRY( ptr, struct threadpool_object, pool_entry );
-            assert( object->num_pending_callbacks > 0 );
+            RtlAcquireSRWLockExclusive( &object->lock );
+            object->queued = FALSE;
 
-            /* If further pending callbacks are queued, move the work item to
-             * the end of the pool list. Otherwise remove it from the pool. */
-            list_remove( &object->pool_entry );
-            if (--object->num_pending_callbacks)
-                list_add_tail( &pool->pool, &object->pool_entry );
+            /* All callbacks were canceled while the object was queued. */
+            if (!object->num_pending_callbacks)
+            {
+                RtlReleaseSRWLockExclusive( &object->lock );
+                tp_object_release( object );
+                continue;
+            }
+
+            /* If further pending callbacks are queued, move the object to the
+             * end of the queue of this worker, where other workers can steal it. */
+            requeue = --object->num_pending_callbacks > 0;
+            if (requeue)
+            {
+                object->queued = TRUE;
+                tp_queue_push( worker.queue, object );
+            }
 
             /* For wait objects check if they were signaled or have timed out. */
             if (object->type == TP_OBJECT_TYPE_WAIT)
@@ -2084,11 +2857,41 @@ static void CALLBACK threadpool_worker_proc( void *param )
                 if (wait_result == WAIT_OBJECT_0) object->u.wait.signaled--;
             }
 
-            /* Leave critical section and do the actual callback. */
+            /* For I/O objects take one of the queued completions. */
+            if (object->type == TP_OBJECT_TYPE_IO)
+            {
+                assert( object->u.io.completion_count > 0 );
+                completion = object->u.io.completions[object->u.io.completion_head];
+                object->u.io.completion_head = (object->u.io.completion_head + 1) % object->u.io.completion_max;
+                object->u.io.completion_count--;
+            }
+
+            /* Leave the lock and do the actual callback. */
             object->num_associated_callbacks++;
             object->num_running_callbacks++;
-            pool->num_busy_workers++;
-            RtlLeaveCriticalSection( &pool->cs );
+            RtlReleaseSRWLockExclusive( &object->lock );
+
+            /* The reference of the queue is kept when the object was queued again,
+             * the pending callback still holds a reference otherwise. */
+            if (requeue)
+                tp_threadpool_schedule( pool );
+            else
+                tp_object_release( object );
+
+            /* Objects on other queues must not be starved by objects with many
+             * pending callbacks, or by callbacks submitting new work to this worker,
+             * so the search regularly starts at the next queue. */
+            if (requeue || !(worker.executed % THREADPOOL_FAIRNESS_INTERVAL))
+                worker.next_queue = (worker.next_queue + 1) % pool->num_queues;
+            else
+                worker.next_queue = worker.queue - pool->queues;
+
+            worker.running = TRUE;
+            if (object->may_run_long)
+            {
+                worker.long_running = TRUE;
+                if (!worker.blocked++) interlocked_inc( &pool->num_blocked_workers );
+            }
 
             /* Initialize threadpool instance struct. */
             callback_instance = (TP_CALLBACK_INSTANCE *)&instance;
@@ -2141,6 +2944,17 @@ static void CALLBACK threadpool_worker_proc( void *param )
                     break;
                 }
 
+                case TP_OBJECT_TYPE_IO:
+                {
+                    TRACE( "executing I/O callback %p(%p, %p, %#lx, %p, %p)\n",
+                           object->u.io.callback, callback_instance, object->userdata,
+                           completion.cvalue, &completion.iosb, object );
+                    object->u.io.callback( callback_instance, object->userdata,
+                                           (void *)completion.cvalue, &completion.iosb, (TP_IO *)object );
+                    TRACE( "callback %p returned\n", object->u.io.callback );
+                    break;
+                }
+
                 default:
                     assert(0);
                     break;
@@ -2181,8 +2995,15 @@ static void CALLBACK threadpool_worker_proc( void *param )
             }
 
         skip_cleanup:
-            RtlEnterCriticalSection( &pool->cs );
-            pool->num_busy_workers--;
+            if (worker.long_running)
+            {
+                worker.long_running = FALSE;
+                if (!--worker.blocked) interlocked_dec( &pool->num_blocked_workers );
+            }
+            worker.running = FALSE;
+            worker.executed++;
+
+            RtlAcquireSRWLockExclusive( &object->lock );
 
             /* Simple callbacks are automatically shutdown after execution. */
             if (object->type == TP_OBJECT_TYPE_SIMPLE)
@@ -2192,19 +3013,32 @@ static void CALLBACK threadpool_worker_proc( void *param )
             }
 
             object->num_running_callbacks--;
-            if (!object->num_pending_callbacks && !object->num_running_callbacks)
+            if (tp_object_is_finished( object, TRUE ))
                 RtlWakeAllConditionVariable( &object->group_finished_event );
 
             if (instance.associated)
             {
                 object->num_associated_callbacks--;
-                if (!object->num_pending_callbacks && !object->num_associated_callbacks)
+                if (tp_object_is_finished( object, FALSE ))
                     RtlWakeAllConditionVariable( &object->finished_event );
             }
 
+            RtlReleaseSRWLockExclusive( &object->lock );
             tp_object_release( object );
         }
 
+        RtlEnterCriticalSection( &pool->cs );
+        interlocked_dec( &pool->num_busy_workers );
+
+        /* Objects might have been queued before this worker was accounted as
+         * idle, in which case nobody was woken up to process them. */
+        if (tp_threadpool_has_work( pool ))
+        {
+            interlocked_inc( &pool->num_busy_workers );
+            RtlLeaveCriticalSection( &pool->cs );
+            continue;
+        }
+
         /* Shutdown worker thread if requested. */
         if (pool->shutdown)
             break;
@@ -2216,13 +3050,23 @@ static void CALLBACK threadpool_worker_proc( void *param )
          * can be terminated. */
         timeout.QuadPart = (ULONGLONG)THREADPOOL_WORKER_TIMEOUT * -10000;
         if (RtlSleepConditionVariableCS( &pool->update_event, &pool->cs, &timeout ) == STATUS_TIMEOUT &&
-            !list_head( &pool->pool ) && (pool->num_workers > max( pool->min_workers, 1 ) ||
+            !tp_threadpool_has_work( pool ) && (pool->num_workers > max( pool->min_workers, 1 ) ||
             (!pool->min_workers && !pool->objcount)))
         {
             break;
         }
+
+        interlocked_inc( &pool->num_busy_workers );
+        RtlLeaveCriticalSection( &pool->cs );
     }
-    pool->num_workers--;
+    ntdll_get_thread_data()->tp_worker = NULL;
+
+    list_remove( &worker.entry );
+    interlocked_dec( &pool->num_workers );
+    pool->stats_executed += worker.executed;
+    pool->stats_stolen   += worker.stolen;
+    pool->stats_retired++;
+    tp_threadpool_dump_stats( pool, "worker terminated" );
     RtlLeaveCriticalSection( &pool->cs );
 
     TRACE( "terminating worker thread for pool %p\n", pool );
@@ -2240,6 +3084,46 @@ NTSTATUS WINAPI TpAllocCleanupGroup( TP_CLEANUP_GROUP **out )
     return tp_group_alloc( (struct threadpool_group **)out );
 }
 
+/***********************************************************************
+ *           TpAllocIoCompletion    (NTDLL.@)
+ */
+NTSTATUS WINAPI TpAllocIoCompletion( TP_IO **out, HANDLE file, PTP_IO_CALLBACK callback,
+                                     PVOID userdata, TP_CALLBACK_ENVIRON *environment )
+{
+    struct threadpool_object *object;
+    struct threadpool *pool;
+    NTSTATUS status;
+
+    TRACE( "%p %p %p %p %p\n", out, file, callback, userdata, environment );
+
+    object = RtlAllocateHeap( GetProcessHeap(), 0, sizeof(*object) );
+    if (!object)
+        return STATUS_NO_MEMORY;
+
+    status = tp_threadpool_lock( &pool, environment );
+    if (status)
+    {
+        RtlFreeHeap( GetProcessHeap(), 0, object );
+        return status;
+    }
+
+    object->type = TP_OBJECT_TYPE_IO;
+    object->u.io.callback = callback;
+
+    status = tp_ioqueue_lock( object, file );
+    if (status)
+    {
+        tp_threadpool_unlock( pool );
+        RtlFreeHeap( GetProcessHeap(), 0, object );
+        return status;
+    }
+
+    tp_object_initialize( object, pool, userdata, environment );
+
+    *out = (TP_IO *)object;
+    return STATUS_SUCCESS;
+}
+
 /***********************************************************************
  *           TpAllocPool    (NTDLL.@)
  */
@@ -2384,6 +3268,7 @@ NTSTATUS WINAPI TpCallbackMayRunLong( TP_CALLBACK_INSTANCE *instance )
 {
     struct threadpool_instance *this = impl_from_TP_CALLBACK_INSTANCE( instance );
     struct threadpool_object *object = this->object;
+    struct threadpool_worker *worker;
     struct threadpool *pool;
     NTSTATUS status = STATUS_SUCCESS;
 
@@ -2416,6 +3301,14 @@ NTSTATUS WINAPI TpCallbackMayRunLong( TP_CALLBACK_INSTANCE *instance )
 
     RtlLeaveCriticalSection( &pool->cs );
     this->may_run_long = TRUE;
+
+    /* The worker no longer counts against the processor limit. */
+    worker = ntdll_get_thread_data()->tp_worker;
+    if (worker && !worker->long_running)
+    {
+        worker->long_running = TRUE;
+        if (!worker->blocked++) interlocked_inc( &pool->num_blocked_workers );
+    }
     return status;
 }
 
@@ -2474,6 +3367,30 @@ VOID WINAPI TpCallbackUnloadDllOnCompletion( TP_CALLBACK_INSTANCE *instance, HMO
         this->cleanup.library = module;
 }
 
+/***********************************************************************
+ *           TpCancelAsyncIoOperation    (NTDLL.@)
+ */
+VOID WINAPI TpCancelAsyncIoOperation( TP_IO *io )
+{
+    struct threadpool_object *this = impl_from_TP_IO( io );
+    BOOL release = FALSE;
+
+    TRACE( "%p\n", io );
+
+    RtlAcquireSRWLockExclusive( &this->lock );
+    if (this->u.io.pending_count)
+    {
+        release = !--this->u.io.pending_count;
+        if (tp_object_is_finished( this, TRUE ))
+            RtlWakeAllConditionVariable( &this->group_finished_event );
+        if (tp_object_is_finished( this, FALSE ))
+            RtlWakeAllConditionVariable( &this->finished_event );
+    }
+    RtlReleaseSRWLockExclusive( &this->lock );
+
+    if (release) tp_object_release( this );
+}
+
 /***********************************************************************
  *           TpDisassociateCallback    (NTDLL.@)
  */
@@ -2481,7 +3398,6 @@ VOID WINAPI TpDisassociateCallback( TP_CALLBACK_INSTANCE *instance )
 {
     struct threadpool_instance *this = impl_from_TP_CALLBACK_INSTANCE( instance );
     struct threadpool_object *object = this->object;
-    struct threadpool *pool;
 
     TRACE( "%p\n", instance );
 
@@ -2494,14 +3410,13 @@ VOID WINAPI TpDisassociateCallback( TP_CALLBACK_INSTANCE *instance )
     if (!this->associated)
         return;
 
-    pool = object->pool;
-    RtlEnterCriticalSection( &pool->cs );
+    RtlAcquireSRWLockExclusive( &object->lock );
 
     object->num_associated_callbacks--;
-    if (!object->num_pending_callbacks && !object->num_associated_callbacks)
+    if (tp_object_is_finished( object, FALSE ))
         RtlWakeAllConditionVariable( &object->finished_event );
 
-    RtlLeaveCriticalSection( &pool->cs );
+    RtlReleaseSRWLockExclusive( &object->lock );
     this->associated = FALSE;
 }
 
@@ -2615,6 +3530,24 @@ VOID WINAPI TpReleaseCleanupGroupMembers( TP_CLEANUP_GROUP *group, BOOL cancel_p
     }
 }
 
+/***********************************************************************
+ *           TpReleaseIoCompletion    (NTDLL.@)
+ */
+VOID WINAPI TpReleaseIoCompletion( TP_IO *io )
+{
+    struct threadpool_object *this = impl_from_TP_IO( io );
+
+    TRACE( "%p\n", io );
+
+    /* completions of I/O still in flight are dropped from now on */
+    tp_ioqueue_unbind( this );
+    tp_object_prepare_shutdown( this );
+    RtlAcquireSRWLockExclusive( &this->lock );
+    this->shutdown = TRUE;
+    RtlReleaseSRWLockExclusive( &this->lock );
+    tp_object_release( this );
+}
+
 /***********************************************************************
  *           TpReleasePool    (NTDLL.@)
  */
@@ -2883,6 +3816,36 @@ NTSTATUS WINAPI TpSimpleTryPost( PTP_SIMPLE_CALLBACK callback, PVOID userdata,
     return STATUS_SUCCESS;
 }
 
+/***********************************************************************
+ *           TpStartAsyncIoOperation    (NTDLL.@)
+ */
+VOID WINAPI TpStartAsyncIoOperation( TP_IO *io )
+{
+    struct threadpool_object *this = impl_from_TP_IO( io );
+
+    TRACE( "%p\n", io );
+
+    /* the object is kept alive until the completion arrives */
+    RtlAcquireSRWLockExclusive( &this->lock );
+    if (!this->u.io.pending_count++)
+        interlocked_inc( &this->refcount );
+    RtlReleaseSRWLockExclusive( &this->lock );
+}
+
+/***********************************************************************
+ *           TpWaitForIoCompletion    (NTDLL.@)
+ */
+VOID WINAPI TpWaitForIoCompletion( TP_IO *io, BOOL cancel_pending )
+{
+    struct threadpool_object *this = impl_from_TP_IO( io );
+
+    TRACE( "%p %d\n", io, cancel_pending );
+
+    if (cancel_pending)
+        tp_object_cancel( this );
+    tp_object_wait( this, FALSE );
+}
+
 /***********************************************************************
  *           TpWaitForTimer    (NTDLL.@)
  */
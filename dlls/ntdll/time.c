@@ -42,10 +42,12 @@
 # include <mach/mach_time.h>
 #endif
 
+#define NONAMELESSUNION
 #include "ntstatus.h"
 #define WIN32_NO_STATUS
 #include "windef.h"
 #include "winternl.h"
+#include "ddk/wdm.h"
 #include "wine/exception.h"
 #include "wine/unicode.h"
 #include "wine/debug.h"
@@ -468,11 +470,76 @@ NTSTATUS WINAPI NtQuerySystemTime( PLARGE_INTEGER Time )
     return STATUS_SUCCESS;
 }
 
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+
+/* The performance counter is read from the TSC when the CPU guarantees that
+ * it runs at a constant rate. The TSC frequency is determined once by the
+ * server, so that all processes report the same frequency, and shifted down
+ * so that the reported frequency is in the same range as on Windows. */
+
+#define TSC_MAX_FREQUENCY     (2 * TICKSPERSEC)    /* maximum reported frequency */
+
+static ULONGLONG tsc_frequency;   /* reported frequency, 0 if the TSC is not used */
+static int tsc_shift;             /* shift from TSC ticks to performance counter ticks */
+static RTL_RUN_ONCE tsc_once = RTL_RUN_ONCE_INIT;
+
+static inline ULONGLONG rdtsc(void)
+{
+    unsigned int low, high;
+    __asm__ __volatile__( "rdtsc" : "=a" (low), "=d" (high) );
+    return ((ULONGLONG)high << 32) | low;
+}
+
+static DWORD WINAPI init_tsc_frequency( RTL_RUN_ONCE *once, void *param, void **context )
+{
+    ULONGLONG freq = 0;
+
+    if (!have_invariant_tsc()) return TRUE;
+
+    SERVER_START_REQ( get_tsc_frequency )
+    {
+        if (!wine_server_call( req )) freq = (ULONGLONG)reply->frequency * 1000;
+    }
+    SERVER_END_REQ;
+
+    if (!freq)
+    {
+        WARN( "unknown TSC frequency, using the monotonic clock\n" );
+        return TRUE;
+    }
+    while (freq >> tsc_shift > TSC_MAX_FREQUENCY) tsc_shift++;
+    tsc_frequency = freq >> tsc_shift;
+    TRACE( "using TSC at %s Hz, performance counter frequency %s\n",
+           wine_dbgstr_longlong(freq), wine_dbgstr_longlong(tsc_frequency) );
+    return TRUE;
+}
+
+#endif
+
 /******************************************************************************
  *  NtQueryPerformanceCounter	[NTDLL.@]
  */
 NTSTATUS WINAPI NtQueryPerformanceCounter( LARGE_INTEGER *counter, LARGE_INTEGER *frequency )
 {
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+    RtlRunOnceExecuteOnce( &tsc_once, init_tsc_frequency, NULL, NULL );
+    if (tsc_frequency)
+    {
+        __TRY
+        {
+            counter->QuadPart = rdtsc() >> tsc_shift;
+            if (frequency) frequency->QuadPart = tsc_frequency;
+        }
+        __EXCEPT_PAGE_FAULT
+        {
+            return STATUS_ACCESS_VIOLATION;
+        }
+        __ENDTRY
+
+        return STATUS_SUCCESS;
+    }
+#endif
+
     __TRY
     {
         counter->QuadPart = monotonic_counter();
@@ -494,6 +561,9 @@ NTSTATUS WINAPI NtQueryPerformanceCounter( LARGE_INTEGER *counter, LARGE_INTEGER
  */
 ULONG WINAPI NtGetTickCount(void)
 {
+    /* once the update thread is running the shared data is kept current */
+    if (user_shared_data == user_shared_data_external)
+        return user_shared_data->u.TickCount.LowPart;
     return monotonic_counter() / TICKSPERMSEC;
 }
 
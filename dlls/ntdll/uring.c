@@ -0,0 +1,557 @@
+/*
+ * io_uring-based asynchronous file I/O
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+/*
+ * Overlapped reads and writes on regular files used to be done synchronously
+ * with pread/pwrite, since the server can't do anything useful with them.
+ * When the kernel supports io_uring, they are instead submitted from the
+ * calling thread to a ring shared by the whole process, and a completion
+ * thread reaps the results, fills the IO_STATUS_BLOCK and signals the event,
+ * queues the APC and posts to the completion port. Anything that can't be
+ * submitted returns STATUS_NOT_SUPPORTED and the caller does the I/O itself.
+ *
+ * Setting WINEIOURING=0 disables it.
+ */
+
+#include "config.h"
+#include "wine/port.h"
+
+#include <errno.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef HAVE_POLL_H
+#include <poll.h>
+#endif
+#ifdef HAVE_SYS_POLL_H
+# include <sys/poll.h>
+#endif
+#ifdef HAVE_SYS_MMAN_H
+# include <sys/mman.h>
+#endif
+#ifdef HAVE_SYS_STAT_H
+# include <sys/stat.h>
+#endif
+#ifdef HAVE_SYS_SYSCALL_H
+# include <sys/syscall.h>
+#endif
+#ifdef HAVE_SYS_UIO_H
+# include <sys/uio.h>
+#endif
+#ifdef HAVE_SYS_EVENTFD_H
+# include <sys/eventfd.h>
+#endif
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+#ifdef HAVE_LINUX_IO_URING_H
+# include <linux/io_uring.h>
+#endif
+
+#define NONAMELESSUNION
+#include "ntstatus.h"
+#define WIN32_NO_STATUS
+#include "windef.h"
+#include "winternl.h"
+#include "wine/server.h"
+#include "wine/list.h"
+#include "wine/debug.h"
+#include "ntdll_misc.h"
+
+WINE_DEFAULT_DEBUG_CHANNEL(file);
+
+#if defined(HAVE_LINUX_IO_URING_H) && defined(HAVE_SYS_EVENTFD_H) && defined(__NR_io_uring_setup)
+
+#define URING_ENTRIES 256
+
+struct uring_io
+{
+    struct list      entry;      /* entry in the list of operations in flight */
+    HANDLE           handle;     /* our own file handle for the completion port, NULL if none */
+    HANDLE           event;      /* our own handle to the event to signal, NULL if none */
+    PIO_APC_ROUTINE  apc;        /* APC to queue on success */
+    void            *apc_user;
+    IO_STATUS_BLOCK *iosb;
+    ULONG_PTR        cvalue;     /* completion key, 0 if none */
+    ULONG            tid;        /* thread that started the I/O, for the APC */
+    int              fd;         /* our own fd for the file */
+    dev_t            dev;        /* identity of the file, to find the writes to flush */
+    ino_t            ino;
+    int              opcode;     /* IORING_OP_* */
+    ULONGLONG        offset;
+    struct iovec     iov;
+    NTSTATUS        *sync_status; /* set for operations a thread is waiting for */
+};
+
+static RTL_CRITICAL_SECTION uring_section;
+static RTL_CRITICAL_SECTION_DEBUG critsect_debug =
+{
+    0, 0, &uring_section,
+    { &critsect_debug.ProcessLocksList, &critsect_debug.ProcessLocksList },
+      0, 0, { (DWORD_PTR)(__FILE__ ": uring_section") }
+};
+static RTL_CRITICAL_SECTION uring_section = { &critsect_debug, -1, 0, 0, 0, 0 };
+
+static int uring_enabled = -1;
+static int uring_fd = -1;
+static int uring_eventfd = -1;
+static unsigned int *sq_tail, *sq_mask, *sq_array;
+static unsigned int *cq_head, *cq_tail, *cq_mask;
+static struct io_uring_sqe *sqes;
+static struct io_uring_cqe *cqes;
+static unsigned int cq_entries;
+static LONG pending;  /* submitted and not reaped yet */
+static struct list inflight_list = LIST_INIT( inflight_list );  /* operations submitted and not reaped yet */
+static LONG reaped_seq;      /* incremented when an operation is reaped */
+static LONG flush_waiters;   /* number of threads waiting for writes to finish before a flush */
+
+static inline int io_uring_setup( unsigned int entries, struct io_uring_params *params )
+{
+    return syscall( __NR_io_uring_setup, entries, params );
+}
+
+static inline int io_uring_enter( int fd, unsigned int to_submit, unsigned int min_complete, unsigned int flags )
+{
+    return syscall( __NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0 );
+}
+
+static inline int io_uring_register( int fd, unsigned int opcode, void *arg, unsigned int nr_args )
+{
+    return syscall( __NR_io_uring_register, fd, opcode, arg, nr_args );
+}
+
+
+/***********************************************************************
+ *           complete_io
+ *
+ * Report the result of a finished operation; called from the completion thread.
+ */
+static void complete_io( struct uring_io *io, int res )
+{
+    NTSTATUS status = STATUS_SUCCESS;
+    ULONG info = 0;
+
+    if (res == -EFAULT && io->opcode != IORING_OP_FSYNC)
+    {
+        /* the kernel doesn't fault in write watched pages, do it the slow way */
+        if (io->opcode == IORING_OP_READV)
+        {
+            if (virtual_check_buffer_for_write( io->iov.iov_base, io->iov.iov_len ))
+                res = pread( io->fd, io->iov.iov_base, io->iov.iov_len, io->offset );
+        }
+        else res = pwrite( io->fd, io->iov.iov_base, io->iov.iov_len, io->offset );
+        if (res < 0) res = -errno;
+    }
+
+    if (res >= 0)
+    {
+        info = res;
+        if (io->opcode == IORING_OP_READV && !res && io->iov.iov_len) status = STATUS_END_OF_FILE;
+    }
+    else if (res == -EFAULT)
+        status = (io->opcode == IORING_OP_READV) ? STATUS_ACCESS_VIOLATION : STATUS_INVALID_USER_BUFFER;
+    else
+    {
+        errno = -res;
+        status = FILE_GetNtStatus();
+    }
+    close( io->fd );
+
+    TRACE( "op %u offset %s: status %08x info %u\n", io->opcode,
+           wine_dbgstr_longlong( io->offset ), status, info );
+
+    if (io->sync_status)
+    {
+        *io->sync_status = status;
+        RtlWakeAddressAll( io->sync_status );
+        RtlFreeHeap( GetProcessHeap(), 0, io );
+        return;
+    }
+
+    /* the caller may free the IO_STATUS_BLOCK and close its handles as soon as the
+     * status is set, so that's the last thing we touch; the event and the file
+     * handle used for the completion port are our own duplicates */
+    io->iosb->Information = info;
+    __atomic_store_n( &io->iosb->u.Status, status, __ATOMIC_RELEASE );
+
+    if (io->event)
+    {
+        NtSetEvent( io->event, NULL );
+        NtClose( io->event );
+    }
+    if (io->apc && !status)
+    {
+        OBJECT_ATTRIBUTES attr;
+        CLIENT_ID cid;
+        HANDLE thread;
+
+        InitializeObjectAttributes( &attr, NULL, 0, NULL, NULL );
+        cid.UniqueProcess = NtCurrentTeb()->ClientId.UniqueProcess;
+        cid.UniqueThread = ULongToHandle( io->tid );
+        if (!NtOpenThread( &thread, THREAD_SET_CONTEXT, &attr, &cid ))
+        {
+            NtQueueApcThread( thread, (PNTAPCFUNC)io->apc, (ULONG_PTR)io->apc_user,
+                              (ULONG_PTR)io->iosb, 0 );
+            NtClose( thread );
+        }
+    }
+    if (io->handle)
+    {
+        NTDLL_AddCompletion( io->handle, io->cvalue, status, info );
+        NtClose( io->handle );
+    }
+
+    RtlFreeHeap( GetProcessHeap(), 0, io );
+}
+
+
+/***********************************************************************
+ *           uring_thread
+ */
+static void CALLBACK uring_thread( void *arg )
+{
+    struct pollfd pfd;
+    ULONGLONG count;
+    unsigned int head;
+
+    pfd.fd = uring_eventfd;
+    pfd.events = POLLIN;
+
+    for (;;)
+    {
+        /* clear the eventfd before looking at the ring so that no completion is missed */
+        read( uring_eventfd, &count, sizeof(count) );
+
+        head = *cq_head;
+        while (head != __atomic_load_n( cq_tail, __ATOMIC_ACQUIRE ))
+        {
+            struct io_uring_cqe *cqe = &cqes[head & *cq_mask];
+            struct uring_io *io = (struct uring_io *)(ULONG_PTR)cqe->user_data;
+            int res = cqe->res;
+
+            __atomic_store_n( cq_head, ++head, __ATOMIC_RELEASE );
+            interlocked_xchg_add( &pending, -1 );
+
+            RtlEnterCriticalSection( &uring_section );
+            list_remove( &io->entry );
+            RtlLeaveCriticalSection( &uring_section );
+            if (flush_waiters)
+            {
+                interlocked_xchg_add( &reaped_seq, 1 );
+                RtlWakeAddressAll( &reaped_seq );
+            }
+
+            complete_io( io, res );
+        }
+
+        poll( &pfd, 1, -1 );
+    }
+}
+
+
+/***********************************************************************
+ *           init_uring
+ */
+static BOOL init_uring(void)
+{
+    struct io_uring_params params;
+    const char *str;
+    void *sq_ring, *cq_ring;
+    HANDLE thread;
+    int fd, efd;
+
+    if ((str = getenv( "WINEIOURING" )) && !atoi( str )) return FALSE;
+
+    memset( &params, 0, sizeof(params) );
+    if ((fd = io_uring_setup( URING_ENTRIES, &params )) == -1)
+    {
+        TRACE( "io_uring not available: %s\n", strerror( errno ));
+        return FALSE;
+    }
+
+    sq_ring = mmap( NULL, params.sq_off.array + params.sq_entries * sizeof(unsigned int),
+                    PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING );
+    cq_ring = mmap( NULL, params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe),
+                    PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING );
+    sqes = mmap( NULL, params.sq_entries * sizeof(struct io_uring_sqe),
+                 PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES );
+    if (sq_ring == MAP_FAILED || cq_ring == MAP_FAILED || sqes == MAP_FAILED) goto failed;
+
+    sq_tail  = (unsigned int *)((char *)sq_ring + params.sq_off.tail);
+    sq_mask  = (unsigned int *)((char *)sq_ring + params.sq_off.ring_mask);
+    sq_array = (unsigned int *)((char *)sq_ring + params.sq_off.array);
+    cq_head  = (unsigned int *)((char *)cq_ring + params.cq_off.head);
+    cq_tail  = (unsigned int *)((char *)cq_ring + params.cq_off.tail);
+    cq_mask  = (unsigned int *)((char *)cq_ring + params.cq_off.ring_mask);
+    cqes     = (struct io_uring_cqe *)((char *)cq_ring + params.cq_off.cqes);
+    cq_entries = params.cq_entries;
+
+    if ((efd = eventfd( 0, EFD_CLOEXEC | EFD_NONBLOCK )) == -1) goto failed;
+    if (io_uring_register( fd, IORING_REGISTER_EVENTFD, &efd, 1 ) == -1)
+    {
+        close( efd );
+        goto failed;
+    }
+    uring_fd = fd;
+    uring_eventfd = efd;
+
+    if (RtlCreateUserThread( GetCurrentProcess(), NULL, FALSE, NULL, 0, 0,
+                             uring_thread, NULL, &thread, NULL ))
+    {
+        ERR( "failed to create the io_uring completion thread\n" );
+        /* the ring stays mapped but is never used */
+        return FALSE;
+    }
+    NtClose( thread );
+    TRACE( "using io_uring for overlapped file I/O\n" );
+    return TRUE;
+
+failed:
+    WARN( "failed to set up io_uring: %s\n", strerror( errno ));
+    close( fd );
+    return FALSE;
+}
+
+
+/***********************************************************************
+ *           do_uring
+ */
+static BOOL do_uring(void)
+{
+    sigset_t sigset;
+
+    if (uring_enabled != -1) return uring_enabled;
+
+    server_enter_uninterrupted_section( &uring_section, &sigset );
+    if (uring_enabled == -1) uring_enabled = init_uring();
+    server_leave_uninterrupted_section( &uring_section, &sigset );
+    return uring_enabled;
+}
+
+
+/***********************************************************************
+ *           submit_io
+ *
+ * Queue an operation and submit it. On failure the caller keeps ownership of io.
+ */
+static NTSTATUS submit_io( struct uring_io *io, unsigned char flags )
+{
+    struct io_uring_sqe *sqe;
+    unsigned int tail, idx;
+    NTSTATUS status = STATUS_NOT_SUPPORTED;
+    sigset_t sigset;
+    int ret;
+
+    server_enter_uninterrupted_section( &uring_section, &sigset );
+
+    /* never have more operations in flight than the completion ring can hold */
+    if (pending < cq_entries)
+    {
+        tail = *sq_tail;
+        idx = tail & *sq_mask;
+        sqe = &sqes[idx];
+        memset( sqe, 0, sizeof(*sqe) );
+        sqe->opcode    = io->opcode;
+        sqe->flags     = flags;
+        sqe->fd        = io->fd;
+        sqe->user_data = (ULONG_PTR)io;
+        if (io->opcode != IORING_OP_FSYNC)
+        {
+            sqe->addr = (ULONG_PTR)&io->iov;
+            sqe->len  = 1;
+            sqe->off  = io->offset;
+        }
+        sq_array[idx] = idx;
+        __atomic_store_n( sq_tail, tail + 1, __ATOMIC_RELEASE );
+
+        while ((ret = io_uring_enter( uring_fd, 1, 0, 0 )) == -1 && errno == EINTR);
+        if (ret == 1)
+        {
+            interlocked_xchg_add( &pending, 1 );
+            list_add_tail( &inflight_list, &io->entry );
+            status = STATUS_PENDING;
+        }
+        else
+        {
+            /* not consumed by the kernel, take it back */
+            WARN( "io_uring_enter failed: %d %s\n", ret, strerror( errno ));
+            __atomic_store_n( sq_tail, tail, __ATOMIC_RELEASE );
+        }
+    }
+
+    server_leave_uninterrupted_section( &uring_section, &sigset );
+    return status;
+}
+
+
+/***********************************************************************
+ *           uring_read_write
+ *
+ * Start an overlapped read or write on a regular file. Returns STATUS_PENDING
+ * if it was submitted, STATUS_NOT_SUPPORTED if the caller has to do it.
+ */
+NTSTATUS uring_read_write( BOOL is_write, HANDLE handle, int unix_fd, HANDLE event,
+                           PIO_APC_ROUTINE apc, void *apc_user, IO_STATUS_BLOCK *iosb,
+                           void *buffer, ULONG length, ULONGLONG offset, ULONG_PTR cvalue )
+{
+    struct uring_io *io;
+    struct stat st;
+    NTSTATUS status;
+
+    /* without an event or an APC, GetOverlappedResult waits on the file handle,
+     * which only the server can signal */
+    if (!event && !apc) return STATUS_NOT_SUPPORTED;
+    if (!do_uring()) return STATUS_NOT_SUPPORTED;
+
+    if (fstat( unix_fd, &st ) == -1) return STATUS_NOT_SUPPORTED;
+    /* let the caller report reads at the end of file synchronously */
+    if (!is_write && offset >= st.st_size) return STATUS_NOT_SUPPORTED;
+
+    if (!(io = RtlAllocateHeap( GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(*io) ))) return STATUS_NOT_SUPPORTED;
+    if ((io->fd = dup( unix_fd )) == -1)
+    {
+        RtlFreeHeap( GetProcessHeap(), 0, io );
+        return STATUS_NOT_SUPPORTED;
+    }
+
+    /* the caller may close its handles as soon as the I/O is done, before we are */
+    if ((event && NtDuplicateObject( NtCurrentProcess(), event, NtCurrentProcess(), &io->event,
+                                     0, 0, DUPLICATE_SAME_ACCESS )) ||
+        (cvalue && NtDuplicateObject( NtCurrentProcess(), handle, NtCurrentProcess(), &io->handle,
+                                      0, 0, DUPLICATE_SAME_ACCESS )))
+    {
+        status = STATUS_NOT_SUPPORTED;
+        goto failed;
+    }
+    io->dev         = st.st_dev;
+    io->ino         = st.st_ino;
+    io->apc         = apc;
+    io->apc_user    = apc_user;
+    io->iosb        = iosb;
+    io->cvalue      = cvalue;
+    io->tid         = HandleToULong( NtCurrentTeb()->ClientId.UniqueThread );
+    io->opcode      = is_write ? IORING_OP_WRITEV : IORING_OP_READV;
+    io->offset      = offset;
+    io->iov.iov_base = buffer;
+    io->iov.iov_len  = length;
+    io->sync_status = NULL;
+
+    if (event) NtResetEvent( event, NULL );
+    iosb->Information = 0;
+    iosb->u.Status = STATUS_PENDING;
+
+    if ((status = submit_io( io, 0 )) == STATUS_PENDING) return status;
+
+failed:
+    if (io->event) NtClose( io->event );
+    if (io->handle) NtClose( io->handle );
+    close( io->fd );
+    RtlFreeHeap( GetProcessHeap(), 0, io );
+    return status;
+}
+
+
+/***********************************************************************
+ *           wait_for_writes
+ *
+ * Wait until the writes to a file submitted so far have been reaped.
+ */
+static void wait_for_writes( dev_t dev, ino_t ino )
+{
+    struct uring_io *io;
+    sigset_t sigset;
+    LONG seq;
+    BOOL busy;
+
+    interlocked_xchg_add( &flush_waiters, 1 );
+    for (;;)
+    {
+        busy = FALSE;
+        server_enter_uninterrupted_section( &uring_section, &sigset );
+        seq = reaped_seq;
+        LIST_FOR_EACH_ENTRY( io, &inflight_list, struct uring_io, entry )
+        {
+            if (io->opcode != IORING_OP_WRITEV || io->dev != dev || io->ino != ino) continue;
+            busy = TRUE;
+            break;
+        }
+        server_leave_uninterrupted_section( &uring_section, &sigset );
+        if (!busy) break;
+        RtlWaitOnAddress( &reaped_seq, &seq, sizeof(seq), NULL );
+    }
+    interlocked_xchg_add( &flush_waiters, -1 );
+}
+
+
+/***********************************************************************
+ *           uring_flush
+ *
+ * Flush a regular file once all previously submitted writes to it are done.
+ * Returns STATUS_NOT_SUPPORTED if the caller has to do it.
+ */
+NTSTATUS uring_flush( int unix_fd )
+{
+    NTSTATUS status = STATUS_PENDING, pending_status = STATUS_PENDING;
+    struct uring_io *io;
+    struct stat st;
+
+    if (!do_uring()) return STATUS_NOT_SUPPORTED;
+    if (fstat( unix_fd, &st ) == -1) return STATUS_NOT_SUPPORTED;
+
+    if (!(io = RtlAllocateHeap( GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(*io) )))
+        return STATUS_NOT_SUPPORTED;
+    if ((io->fd = dup( unix_fd )) == -1)
+    {
+        RtlFreeHeap( GetProcessHeap(), 0, io );
+        return STATUS_NOT_SUPPORTED;
+    }
+    io->dev = st.st_dev;
+    io->ino = st.st_ino;
+    io->opcode = IORING_OP_FSYNC;
+    io->sync_status = &status;
+
+    /* a drained fsync would also wait for the I/O on every other file of the process */
+    wait_for_writes( io->dev, io->ino );
+
+    if (submit_io( io, 0 ) != STATUS_PENDING)
+    {
+        close( io->fd );
+        RtlFreeHeap( GetProcessHeap(), 0, io );
+        return STATUS_NOT_SUPPORTED;
+    }
+
+    while (__atomic_load_n( &status, __ATOMIC_ACQUIRE ) == STATUS_PENDING)
+        RtlWaitOnAddress( &status, &pending_status, sizeof(status), NULL );
+    return status;
+}
+
+#else  /* HAVE_LINUX_IO_URING_H */
+
+NTSTATUS uring_read_write( BOOL is_write, HANDLE handle, int unix_fd, HANDLE event,
+                           PIO_APC_ROUTINE apc, void *apc_user, IO_STATUS_BLOCK *iosb,
+                           void *buffer, ULONG length, ULONGLONG offset, ULONG_PTR cvalue )
+{
+    return STATUS_NOT_SUPPORTED;
+}
+
+NTSTATUS uring_flush( int unix_fd )
+{
+    return STATUS_NOT_SUPPORTED;
+}
+
+#endif  /* HAVE_LINUX_IO_URING_H */
@@ -54,7 +54,7 @@
 #include "wine/server.h"
 #include "wine/exception.h"
 #include "wine/unicode.h"
-#include "wine/list.h"
+#include "wine/rbtree.h"
 #include "wine/debug.h"
 #include "ntdll_misc.h"
 
@@ -68,7 +68,8 @@ WINE_DECLARE_DEBUG_CHANNEL(module);
 /* File view */
 struct file_view
 {
-    struct list   entry;       /* Entry in global view list */
+    struct wine_rb_entry entry;      /* Entry in global views tree */
+    struct wine_rb_entry free_entry; /* Entry in free ranges tree, if followed by free space */
     void         *base;        /* Base address */
     size_t        size;        /* Size in bytes */
     HANDLE        mapping;     /* Handle to the file mapping */
@@ -99,7 +100,13 @@ static const BYTE VIRTUAL_Win32Flags[16] =
     PAGE_EXECUTE_WRITECOPY      /* READ | WRITE | EXEC | WRITECOPY */
 };
 
-static struct list views_list = LIST_INIT(views_list);
+static int compare_view( const void *addr, const struct wine_rb_entry *entry );
+static int compare_free_range( const void *addr, const struct wine_rb_entry *entry );
+
+/* all the views sorted by base address, and the subset of them that are followed by
+ * some free space, so that looking for a free area only needs to walk the holes */
+static struct wine_rb_tree views_tree = { compare_view };
+static struct wine_rb_tree free_tree = { compare_free_range };
 
 static RTL_CRITICAL_SECTION csVirtual;
 static RTL_CRITICAL_SECTION_DEBUG critsect_debug =
@@ -272,7 +279,7 @@ static void VIRTUAL_Dump(void)
 
     TRACE( "Dump of all virtual memory views:\n" );
     server_enter_uninterrupted_section( &csVirtual, &sigset );
-    LIST_FOR_EACH_ENTRY( view, &views_list, struct file_view, entry )
+    WINE_RB_FOR_EACH_ENTRY( view, &views_tree, struct file_view, entry )
     {
         VIRTUAL_DumpView( view );
     }
@@ -281,6 +288,36 @@ static void VIRTUAL_Dump(void)
 #endif
 
 
+/***********************************************************************
+ *           compare_view
+ *
+ * Compare an address with the base address of a view, for the views tree.
+ */
+static int compare_view( const void *addr, const struct wine_rb_entry *entry )
+{
+    const struct file_view *view = WINE_RB_ENTRY_VALUE( entry, const struct file_view, entry );
+
+    if (addr < view->base) return -1;
+    if (addr > view->base) return 1;
+    return 0;
+}
+
+
+/***********************************************************************
+ *           compare_free_range
+ *
+ * Compare an address with the base address of a view, for the free ranges tree.
+ */
+static int compare_free_range( const void *addr, const struct wine_rb_entry *entry )
+{
+    const struct file_view *view = WINE_RB_ENTRY_VALUE( entry, const struct file_view, free_entry );
+
+    if (addr < view->base) return -1;
+    if (addr > view->base) return 1;
+    return 0;
+}
+
+
 /***********************************************************************
  *           VIRTUAL_FindView
  *
@@ -295,15 +332,18 @@ static void VIRTUAL_Dump(void)
  */
 static struct file_view *VIRTUAL_FindView( const void *addr, size_t size )
 {
-    struct file_view *view;
+    struct wine_rb_entry *ptr = views_tree.root;
+
+    if ((const char *)addr + size < (const char *)addr) return NULL; /* overflow */
 
-    LIST_FOR_EACH_ENTRY( view, &views_list, struct file_view, entry )
+    while (ptr)
     {
-        if (view->base > addr) break;  /* no matching view */
-        if ((const char *)view->base + view->size <= (const char *)addr) continue;
-        if ((const char *)view->base + view->size < (const char *)addr + size) break;  /* size too large */
-        if ((const char *)addr + size < (const char *)addr) break; /* overflow */
-        return view;
+        struct file_view *view = WINE_RB_ENTRY_VALUE( ptr, struct file_view, entry );
+
+        if (view->base > addr) ptr = ptr->left;
+        else if ((const char *)view->base + view->size <= (const char *)addr) ptr = ptr->right;
+        else if ((const char *)view->base + view->size < (const char *)addr + size) break;  /* size too large */
+        else return view;
     }
     return NULL;
 }
@@ -324,22 +364,76 @@ static inline UINT_PTR get_mask( ULONG zero_bits )
 /***********************************************************************
  *           find_view_range
  *
- * Find the first view overlapping at least part of the specified range.
+ * Find a view overlapping at least part of the specified range.
  * The csVirtual section must be held by caller.
  */
 static struct file_view *find_view_range( const void *addr, size_t size )
 {
-    struct file_view *view;
+    struct wine_rb_entry *ptr = views_tree.root;
 
-    LIST_FOR_EACH_ENTRY( view, &views_list, struct file_view, entry )
+    while (ptr)
     {
-        if ((const char *)view->base >= (const char *)addr + size) break;
-        if ((const char *)view->base + view->size > (const char *)addr) return view;
+        struct file_view *view = WINE_RB_ENTRY_VALUE( ptr, struct file_view, entry );
+
+        if ((const char *)view->base >= (const char *)addr + size) ptr = ptr->left;
+        else if ((const char *)view->base + view->size <= (const char *)addr) ptr = ptr->right;
+        else return view;
     }
     return NULL;
 }
 
 
+/***********************************************************************
+ *           find_view_before
+ *
+ * Find the last view of a tree starting strictly below the specified address.
+ * The csVirtual section must be held by caller.
+ */
+static struct wine_rb_entry *find_view_before( const struct wine_rb_tree *tree, const void *addr )
+{
+    struct wine_rb_entry *ptr = tree->root, *ret = NULL;
+
+    while (ptr)
+    {
+        if (tree->compare( addr, ptr ) > 0)
+        {
+            ret = ptr;
+            ptr = ptr->right;
+        }
+        else ptr = ptr->left;
+    }
+    return ret;
+}
+
+
+/***********************************************************************
+ *           get_free_range
+ *
+ * Get the free range following a view of the free ranges tree, or the one
+ * below the first view if free_entry is NULL. Returns the end of the range.
+ * The csVirtual section must be held by caller.
+ */
+static char *get_free_range( struct wine_rb_entry *free_entry, char **start )
+{
+    struct wine_rb_entry *next;
+    struct file_view *view;
+
+    if (free_entry)
+    {
+        view = WINE_RB_ENTRY_VALUE( free_entry, struct file_view, free_entry );
+        *start = (char *)view->base + view->size;
+        next = wine_rb_next( &view->entry );
+    }
+    else
+    {
+        *start = NULL;
+        next = wine_rb_head( views_tree.root );
+    }
+    if (!next) return (char *)~(UINT_PTR)0;
+    return WINE_RB_ENTRY_VALUE( next, struct file_view, entry )->base;
+}
+
+
 /***********************************************************************
  *           find_free_area
  *
@@ -348,42 +442,58 @@ static struct file_view *find_view_range( const void *addr, size_t size )
  */
 static void *find_free_area( void *base, void *end, size_t size, size_t mask, int top_down )
 {
-    struct list *ptr;
-    void *start;
+    struct wine_rb_entry *ptr;
+    struct file_view *view;
+    char *start, *range_start, *range_end;
 
     if (top_down)
     {
         start = ROUND_ADDR( (char *)end - size, mask );
-        if (start >= end || start < base) return NULL;
+        if (start >= (char *)end || start < (char *)base) return NULL;
+        if (!(view = find_view_range( start, size ))) return start;
 
-        for (ptr = views_list.prev; ptr != &views_list; ptr = ptr->prev)
+        /* walk the free ranges below the conflicting view, highest first */
+        ptr = find_view_before( &free_tree, view->base );
+        for (;;)
         {
-            struct file_view *view = LIST_ENTRY( ptr, struct file_view, entry );
-
-            if ((char *)view->base + view->size <= (char *)start) break;
-            if ((char *)view->base >= (char *)start + size) continue;
-            start = ROUND_ADDR( (char *)view->base - size, mask );
-            /* stop if remaining space is not large enough */
-            if (!start || start >= end || start < base) return NULL;
+            range_end = get_free_range( ptr, &range_start );
+            if ((size_t)(range_end - range_start) >= size)
+            {
+                start = ROUND_ADDR( range_end - size, mask );
+                if (start >= range_start)
+                {
+                    /* stop if remaining space is not large enough */
+                    if (!start || start < (char *)base) return NULL;
+                    return start;
+                }
+            }
+            if (range_start < (char *)base || !ptr) return NULL;
+            ptr = wine_rb_prev( ptr );
         }
     }
     else
     {
         start = ROUND_ADDR( (char *)base + mask, mask );
-        if (start >= end || (char *)end - (char *)start < size) return NULL;
+        if (start >= (char *)end || (char *)end - start < size) return NULL;
+        if (!(view = find_view_range( start, size ))) return start;
 
-        for (ptr = views_list.next; ptr != &views_list; ptr = ptr->next)
-        {
-            struct file_view *view = LIST_ENTRY( ptr, struct file_view, entry );
+        /* walk the free ranges above the conflicting view, lowest first */
+        ptr = find_view_before( &free_tree, (char *)view->base + 1 );
+        if (ptr && WINE_RB_ENTRY_VALUE( ptr, struct file_view, free_entry ) != view)
+            ptr = wine_rb_next( ptr );
+        else if (!ptr)
+            ptr = wine_rb_head( free_tree.root );
 
-            if ((char *)view->base >= (char *)start + size) break;
-            if ((char *)view->base + view->size <= (char *)start) continue;
-            start = ROUND_ADDR( (char *)view->base + view->size + mask, mask );
+        for ( ; ptr; ptr = wine_rb_next( ptr ))
+        {
+            range_end = get_free_range( ptr, &range_start );
+            start = ROUND_ADDR( range_start + mask, mask );
             /* stop if remaining space is not large enough */
-            if (!start || start >= end || (char *)end - (char *)start < size) return NULL;
+            if (!start || start >= (char *)end || (char *)end - start < size) return NULL;
+            if (start < range_end && (size_t)(range_end - start) >= size) return start;
         }
     }
-    return start;
+    return NULL;
 }
 
 
@@ -425,7 +535,7 @@ static void remove_reserved_area( void *addr, size_t size )
     wine_mmap_remove_reserved_area( addr, size, 0 );
 
     /* unmap areas not covered by an existing view */
-    LIST_FOR_EACH_ENTRY( view, &views_list, struct file_view, entry )
+    WINE_RB_FOR_EACH_ENTRY( view, &views_tree, struct file_view, entry )
     {
         if ((char *)view->base >= (char *)addr + size)
         {
@@ -469,6 +579,24 @@ static inline void unmap_area( void *addr, size_t size )
 }
 
 
+/***********************************************************************
+ *           update_free_range
+ *
+ * Add a view to the free ranges tree if it is followed by free space,
+ * remove it otherwise. The csVirtual section must be held by caller.
+ */
+static void update_free_range( struct file_view *view )
+{
+    struct wine_rb_entry *next = wine_rb_next( &view->entry );
+    BOOL is_free = !next || (char *)view->base + view->size <
+                            (char *)WINE_RB_ENTRY_VALUE( next, struct file_view, entry )->base;
+    BOOL in_tree = wine_rb_get( &free_tree, view->base ) != NULL;
+
+    if (is_free && !in_tree) wine_rb_put( &free_tree, view->base, &view->free_entry );
+    else if (!is_free && in_tree) wine_rb_remove( &free_tree, &view->free_entry );
+}
+
+
 /***********************************************************************
  *           delete_view
  *
@@ -476,8 +604,12 @@ static inline void unmap_area( void *addr, size_t size )
  */
 static void delete_view( struct file_view *view ) /* [in] View */
 {
+    struct wine_rb_entry *prev = wine_rb_prev( &view->entry );
+
     if (!(view->protect & VPROT_SYSTEM)) unmap_area( view->base, view->size );
-    list_remove( &view->entry );
+    if (wine_rb_get( &free_tree, view->base )) wine_rb_remove( &free_tree, &view->free_entry );
+    wine_rb_remove( &views_tree, &view->entry );
+    if (prev) update_free_range( WINE_RB_ENTRY_VALUE( prev, struct file_view, entry ));
     if (view->mapping) close_handle( view->mapping );
     RtlFreeHeap( virtual_heap, 0, view );
 }
@@ -491,7 +623,7 @@ static void delete_view( struct file_view *view ) /* [in] View */
 static NTSTATUS create_view( struct file_view **view_ret, void *base, size_t size, unsigned int vprot )
 {
     struct file_view *view;
-    struct list *ptr;
+    struct wine_rb_entry *ptr;
     SIZE_T view_size = sizeof(*view) + (size >> page_shift) - 1;
     int unix_prot = VIRTUAL_GetUnixProt( vprot );
 
@@ -534,22 +666,27 @@ static NTSTATUS create_view( struct file_view **view_ret, void *base, size_t siz
     view->protect = vprot;
     memset( view->prot, vprot, size >> page_shift );
 
-    /* Insert it in the linked list */
+    /* Check for overlapping views. This can happen if the previous view
+     * was a system view that got unmapped behind our back. In that case
+     * we recover by simply deleting it. */
 
-    LIST_FOR_EACH( ptr, &views_list )
+    if ((ptr = wine_rb_get( &views_tree, base )) != NULL)
     {
-        struct file_view *next = LIST_ENTRY( ptr, struct file_view, entry );
-        if (next->base > base) break;
+        struct file_view *prev = WINE_RB_ENTRY_VALUE( ptr, struct file_view, entry );
+        TRACE( "overlapping view %p-%p for %p-%p\n",
+               prev->base, (char *)prev->base + prev->size,
+               base, (char *)base + view->size );
+        assert( prev->protect & VPROT_SYSTEM );
+        delete_view( prev );
     }
-    list_add_before( ptr, &view->entry );
 
-    /* Check for overlapping views. This can happen if the previous view
-     * was a system view that got unmapped behind our back. In that case
-     * we recover by simply deleting it. */
+    /* Insert it in the tree */
+
+    wine_rb_put( &views_tree, base, &view->entry );
 
-    if ((ptr = list_prev( &views_list, &view->entry )) != NULL)
+    if ((ptr = wine_rb_prev( &view->entry )) != NULL)
     {
-        struct file_view *prev = LIST_ENTRY( ptr, struct file_view, entry );
+        struct file_view *prev = WINE_RB_ENTRY_VALUE( ptr, struct file_view, entry );
         if ((char *)prev->base + prev->size > (char *)base)
         {
             TRACE( "overlapping prev view %p-%p for %p-%p\n",
@@ -559,9 +696,9 @@ static NTSTATUS create_view( struct file_view **view_ret, void *base, size_t siz
             delete_view( prev );
         }
     }
-    if ((ptr = list_next( &views_list, &view->entry )) != NULL)
+    if ((ptr = wine_rb_next( &view->entry )) != NULL)
     {
-        struct file_view *next = LIST_ENTRY( ptr, struct file_view, entry );
+        struct file_view *next = WINE_RB_ENTRY_VALUE( ptr, struct file_view, entry );
         if ((char *)base + view->size > (char *)next->base)
         {
             TRACE( "overlapping next view %p-%p for %p-%p\n",
@@ -572,6 +709,10 @@ static NTSTATUS create_view( struct file_view **view_ret, void *base, size_t siz
         }
     }
 
+    update_free_range( view );
+    if ((ptr = wine_rb_prev( &view->entry )) != NULL)
+        update_free_range( WINE_RB_ENTRY_VALUE( ptr, struct file_view, entry ));
+
     *view_ret = view;
     VIRTUAL_DEBUG_DUMP_VIEW( view );
 
@@ -1045,13 +1186,13 @@ static NTSTATUS allocate_dos_memory( struct file_view **view, unsigned int vprot
     void * const low_64k = (void *)0x10000;
     const size_t dosmem_size = 0x110000;
     int unix_prot = VIRTUAL_GetUnixProt( vprot );
-    struct list *ptr;
+    struct wine_rb_entry *ptr;
 
     /* check for existing view */
 
-    if ((ptr = list_head( &views_list )))
+    if ((ptr = wine_rb_head( views_tree.root )))
     {
-        struct file_view *first_view = LIST_ENTRY( ptr, struct file_view, entry );
+        struct file_view *first_view = WINE_RB_ENTRY_VALUE( ptr, struct file_view, entry );
         if (first_view->base < (void *)dosmem_size) return STATUS_CONFLICTING_ADDRESSES;
     }
 
@@ -1867,7 +2008,7 @@ void VIRTUAL_SetForceExec( BOOL enable )
     {
         force_exec_prot = enable;
 
-        LIST_FOR_EACH_ENTRY( view, &views_list, struct file_view, entry )
+        WINE_RB_FOR_EACH_ENTRY( view, &views_tree, struct file_view, entry )
         {
             UINT i, count;
             char *addr = view->base;
@@ -2416,7 +2557,7 @@ static NTSTATUS get_basic_memory_info( HANDLE process, LPCVOID addr,
 {
     struct file_view *view;
     char *base, *alloc_base = 0;
-    struct list *ptr;
+    struct wine_rb_entry *ptr;
     SIZE_T size = 0;
     sigset_t sigset;
 
@@ -2456,30 +2597,20 @@ static NTSTATUS get_basic_memory_info( HANDLE process, LPCVOID addr,
     /* Find the view containing the address */
 
     server_enter_uninterrupted_section( &csVirtual, &sigset );
-    ptr = list_head( &views_list );
-    for (;;)
+    ptr = find_view_before( &views_tree, base + 1 );
+    view = ptr ? WINE_RB_ENTRY_VALUE( ptr, struct file_view, entry ) : NULL;
+    if (view && (char *)view->base + view->size > base)
     {
-        if (!ptr)
-        {
-            size = (char *)working_set_limit - alloc_base;
-            view = NULL;
-            break;
-        }
-        view = LIST_ENTRY( ptr, struct file_view, entry );
-        if ((char *)view->base > base)
-        {
-            size = (char *)view->base - alloc_base;
-            view = NULL;
-            break;
-        }
-        if ((char *)view->base + view->size > base)
-        {
-            alloc_base = view->base;
-            size = view->size;
-            break;
-        }
-        alloc_base = (char *)view->base + view->size;
-        ptr = list_next( &views_list, ptr );
+        alloc_base = view->base;
+        size = view->size;
+    }
+    else
+    {
+        if (view) alloc_base = (char *)view->base + view->size;
+        ptr = ptr ? wine_rb_next( ptr ) : wine_rb_head( views_tree.root );
+        if (ptr) size = (char *)WINE_RB_ENTRY_VALUE( ptr, struct file_view, entry )->base - alloc_base;
+        else size = (char *)working_set_limit - alloc_base;
+        view = NULL;
     }
 
     /* Fill the info structure */
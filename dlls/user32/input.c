@@ -54,6 +54,116 @@ WINE_DECLARE_DEBUG_CHANNEL(keyboard);
 
 INT global_key_state_counter = 0;
 
+/* number of attempts at reading a consistent input state from the shared memory */
+#define SHM_INPUT_READ_RETRIES 4
+
+/***********************************************************************
+ *           begin_shm_input_read
+ *
+ * Start reading the input state published by the server; returns the
+ * sequence counter, which is odd while the server is updating the state.
+ */
+static inline int begin_shm_input_read( const volatile shmlocal_t *shm )
+{
+    int seq = shm->input_seq;
+#ifdef __GNUC__
+    __asm__ __volatile__( "" : : : "memory" );
+#else
+    seq |= 1;  /* no way to order the reads, always use the server call */
+#endif
+    return seq;
+}
+
+/***********************************************************************
+ *           end_shm_input_read
+ *
+ * Check that the input state didn't change while we were reading it.
+ */
+static inline BOOL end_shm_input_read( const volatile shmlocal_t *shm, int seq )
+{
+#ifdef __GNUC__
+    __asm__ __volatile__( "" : : : "memory" );
+#endif
+    return shm->input_seq == seq;
+}
+
+/***********************************************************************
+ *           get_shm_key_state
+ *
+ * Retrieve the thread key state from the shared memory, doing the same
+ * synchronization with the desktop key state as the server.
+ */
+static BOOL get_shm_key_state( const volatile shmlocal_t *shm, BYTE key, BYTE *state )
+{
+    int i, seq;
+
+    for (i = 0; i < SHM_INPUT_READ_RETRIES; i++)
+    {
+        if ((seq = begin_shm_input_read( shm )) & 1) continue;
+        if (!shm->input_valid) return FALSE;
+        if (!shm->keystate_lock && shm->desktop_keystate[key] != shm->shadow_keystate[key])
+            *state = shm->desktop_keystate[key] & ~0x40;
+        else
+            *state = shm->keystate[key];
+        if (end_shm_input_read( shm, seq )) return TRUE;
+    }
+    return FALSE;
+}
+
+/***********************************************************************
+ *           get_shm_async_key_state
+ */
+static BOOL get_shm_async_key_state( const volatile shmlocal_t *shm, BYTE key, BYTE *state )
+{
+    int i, seq;
+
+    for (i = 0; i < SHM_INPUT_READ_RETRIES; i++)
+    {
+        if ((seq = begin_shm_input_read( shm )) & 1) continue;
+        if (!shm->input_valid) return FALSE;
+        *state = shm->desktop_keystate[key];
+        if (end_shm_input_read( shm, seq )) return TRUE;
+    }
+    return FALSE;
+}
+
+/***********************************************************************
+ *           get_shm_cursor_pos
+ */
+static BOOL get_shm_cursor_pos( const volatile shmlocal_t *shm, POINT *pt, DWORD *last_change )
+{
+    int i, seq;
+
+    for (i = 0; i < SHM_INPUT_READ_RETRIES; i++)
+    {
+        if ((seq = begin_shm_input_read( shm )) & 1) continue;
+        if (!shm->input_valid) return FALSE;
+        pt->x = shm->cursor_x;
+        pt->y = shm->cursor_y;
+        *last_change = shm->cursor_change;
+        if (end_shm_input_read( shm, seq )) return TRUE;
+    }
+    return FALSE;
+}
+
+/***********************************************************************
+ *           get_shm_queue_bits
+ */
+static BOOL get_shm_queue_bits( const volatile shmlocal_t *shm, DWORD *wake_bits, DWORD *changed_bits )
+{
+    int i, seq;
+
+    for (i = 0; i < SHM_INPUT_READ_RETRIES; i++)
+    {
+        if ((seq = begin_shm_input_read( shm )) & 1) continue;
+        if (!shm->input_valid) return FALSE;
+        *wake_bits = shm->wake_bits;
+        *changed_bits = shm->changed_bits;
+        if (end_shm_input_read( shm, seq )) return TRUE;
+    }
+    return FALSE;
+}
+
 /***********************************************************************
  *           get_key_state
  */
@@ -238,21 +348,25 @@ void WINAPI mouse_event( DWORD dwFlags, DWORD dx, DWORD dy,
  */
 BOOL WINAPI DECLSPEC_HOTPATCH GetCursorPos( POINT *pt )
 {
+    shmlocal_t *shm = wine_get_shmlocal();
     BOOL ret;
     DWORD last_change;
 
     if (!pt) return FALSE;
 
-    SERVER_START_REQ( set_cursor )
+    if (!shm || !(ret = get_shm_cursor_pos( shm, pt, &last_change )))
     {
-        if ((ret = !wine_server_call( req )))
+        SERVER_START_REQ( set_cursor )
         {
-            pt->x = reply->new_x;
-            pt->y = reply->new_y;
-            last_change = reply->last_change;
+            if ((ret = !wine_server_call( req )))
+            {
+                pt->x = reply->new_x;
+                pt->y = reply->new_y;
+                last_change = reply->last_change;
+            }
         }
+        SERVER_END_REQ;
     }
-    SERVER_END_REQ;
 
     /* query new position from graphics driver if we haven't updated recently */
     if (ret && GetTickCount() - last_change > 100) ret = USER_Driver->pGetCursorPos( pt );
@@ -391,8 +505,9 @@ static void check_for_events( UINT flags )
 SHORT WINAPI DECLSPEC_HOTPATCH GetAsyncKeyState( INT key )
 {
     struct user_key_state_info *key_state_info = get_user_thread_info()->key_state;
+    shmlocal_t *shm = wine_get_shmlocal();
     INT counter = global_key_state_counter;
-    BYTE prev_key_state;
+    BYTE prev_key_state, state;
     SHORT ret;
 
     if (key < 0 || key >= 256) return 0;
@@ -401,6 +516,10 @@ SHORT WINAPI DECLSPEC_HOTPATCH GetAsyncKeyState( INT key )
 
     if ((ret = USER_Driver->pGetAsyncKeyState( key )) == -1)
     {
+        /* the "pressed since last call" bit has to be cleared by the server */
+        if (shm && get_shm_async_key_state( shm, key, &state ) && !(state & 0x40))
+            return (state & 0x80) ? 0x8000 : 0;
+
         if (key_state_info &&
             !(key_state_info->state[key] & 0xc0) &&
             key_state_info->counter == counter &&
@@ -453,7 +572,8 @@ SHORT WINAPI DECLSPEC_HOTPATCH GetAsyncKeyState( INT key )
  */
 DWORD WINAPI GetQueueStatus( UINT flags )
 {
-    DWORD ret;
+    shmlocal_t *shm = wine_get_shmlocal();
+    DWORD ret, wake_bits, changed_bits;
 
     if (flags & ~(QS_ALLINPUT | QS_ALLPOSTMESSAGE | QS_SMRESULT))
     {
@@ -463,6 +583,10 @@ DWORD WINAPI GetQueueStatus( UINT flags )
 
     check_for_events( flags );
 
+    /* nothing to clear, so the server doesn't need to be involved */
+    if (shm && get_shm_queue_bits( shm, &wake_bits, &changed_bits ) && !(changed_bits & flags))
+        return MAKELONG( 0, wake_bits & flags );
+
     SERVER_START_REQ( get_queue_status )
     {
         req->clear_bits = flags;
@@ -821,15 +945,22 @@ BOOL WINAPI AttachThreadInput( DWORD from, DWORD to, BOOL attach )
  */
 SHORT WINAPI DECLSPEC_HOTPATCH GetKeyState(INT vkey)
 {
+    shmlocal_t *shm = wine_get_shmlocal();
     SHORT retval = 0;
+    BYTE state;
 
-    SERVER_START_REQ( get_key_state )
+    if (vkey >= 0 && shm && get_shm_key_state( shm, vkey & 0xff, &state ))
+        retval = (signed char)state;
+    else
     {
-        req->tid = GetCurrentThreadId();
-        req->key = vkey;
-        if (!wine_server_call( req )) retval = (signed char)reply->state;
+        SERVER_START_REQ( get_key_state )
+        {
+            req->tid = GetCurrentThreadId();
+            req->key = vkey;
+            if (!wine_server_call( req )) retval = (signed char)reply->state;
+        }
+        SERVER_END_REQ;
     }
-    SERVER_END_REQ;
     TRACE("key (0x%x) -> %x\n", vkey, retval);
     return retval;
 }
@@ -28,6 +28,7 @@
 #include "wined3d_private.h"
 
 WINE_DEFAULT_DEBUG_CHANNEL(d3d);
+WINE_DECLARE_DEBUG_CHANNEL(d3d_perf);
 
 #define WINED3D_BUFFER_HASDESC      0x01    /* A vertex description has been found. */
 #define WINED3D_BUFFER_USE_BO       0x02    /* Use a buffer object for this buffer. */
@@ -796,6 +797,8 @@ ULONG CDECL wined3d_buffer_decref(struct wined3d_buffer *buffer)
 
     if (!refcount)
     {
+        /* Give back the streaming buffer slice of a buffer destroyed while mapped. */
+        wined3d_buffer_unmap_streaming(buffer);
         buffer->resource.parent_ops->wined3d_object_destroyed(buffer->resource.parent);
         resource_cleanup(&buffer->resource);
         wined3d_cs_destroy_object(buffer->resource.device->cs, wined3d_buffer_destroy_object, buffer);
@@ -1300,6 +1303,203 @@ HRESULT wined3d_buffer_upload_data(struct wined3d_buffer *buffer,
     return WINED3D_OK;
 }
 
+/* Context activation is done by the caller. */
+struct wined3d_streaming_buffer *wined3d_streaming_buffer_create(struct wined3d_context *context)
+{
+    static const GLbitfield flags = GL_MAP_READ_BIT | GL_MAP_WRITE_BIT
+            | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    const struct wined3d_gl_info *gl_info = context->gl_info;
+    struct wined3d_streaming_buffer *stream;
+
+    if (!gl_info->supported[ARB_BUFFER_STORAGE] || !gl_info->supported[ARB_COPY_BUFFER]
+            || !gl_info->supported[ARB_SYNC])
+        return NULL;
+
+    if (!(stream = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(*stream))))
+        return NULL;
+    stream->size = WINED3D_STREAMING_BUFFER_SIZE;
+    list_init(&stream->mapped);
+
+    GL_EXTCALL(glGenBuffers(1, &stream->buffer_object));
+    GL_EXTCALL(glBindBuffer(GL_COPY_READ_BUFFER, stream->buffer_object));
+    GL_EXTCALL(glBufferStorage(GL_COPY_READ_BUFFER, stream->size, NULL, flags));
+    stream->map_ptr = GL_EXTCALL(glMapBufferRange(GL_COPY_READ_BUFFER, 0, stream->size, flags));
+    checkGLcall("create streaming buffer");
+
+    if (!stream->map_ptr || ((DWORD_PTR)stream->map_ptr & (RESOURCE_ALIGNMENT - 1)))
+    {
+        WARN("Failed to map streaming buffer, pointer %p.\n", stream->map_ptr);
+        if (stream->map_ptr)
+            GL_EXTCALL(glUnmapBuffer(GL_COPY_READ_BUFFER));
+        GL_EXTCALL(glDeleteBuffers(1, &stream->buffer_object));
+        checkGLcall("destroy streaming buffer");
+        HeapFree(GetProcessHeap(), 0, stream);
+        return NULL;
+    }
+
+    TRACE("Created streaming buffer %p, %u bytes.\n", stream, stream->size);
+    return stream;
+}
+
+/* Context activation is done by the caller. */
+void wined3d_streaming_buffer_destroy(struct wined3d_streaming_buffer *stream, struct wined3d_context *context)
+{
+    const struct wined3d_gl_info *gl_info = context->gl_info;
+    unsigned int i;
+
+    for (i = 0; i < stream->fence_count; ++i)
+        GL_EXTCALL(glDeleteSync(stream->fences[(stream->first_fence + i) % WINED3D_STREAMING_FENCE_COUNT].sync));
+    GL_EXTCALL(glBindBuffer(GL_COPY_READ_BUFFER, stream->buffer_object));
+    GL_EXTCALL(glUnmapBuffer(GL_COPY_READ_BUFFER));
+    GL_EXTCALL(glDeleteBuffers(1, &stream->buffer_object));
+    checkGLcall("destroy streaming buffer");
+    HeapFree(GetProcessHeap(), 0, stream);
+}
+
+/* Retire the data covered by signalled fences and fence the data copied
+ * since the last fence. Context activation is done by the caller. */
+void wined3d_streaming_buffer_poll(struct wined3d_streaming_buffer *stream,
+        struct wined3d_context *context, BOOL force)
+{
+    const struct wined3d_gl_info *gl_info = context->gl_info;
+    struct wined3d_streaming_fence *fence;
+    GLenum ret;
+
+    while (stream->fence_count)
+    {
+        fence = &stream->fences[stream->first_fence];
+        ret = GL_EXTCALL(glClientWaitSync(fence->sync, 0, 0));
+        checkGLcall("glClientWaitSync");
+        if (ret == GL_TIMEOUT_EXPIRED)
+            break;
+        if (ret == GL_WAIT_FAILED)
+            ERR("Failed to wait for streaming buffer fence.\n");
+
+        GL_EXTCALL(glDeleteSync(fence->sync));
+        checkGLcall("glDeleteSync");
+        InterlockedExchange(&stream->tail, fence->position);
+        stream->first_fence = (stream->first_fence + 1) % WINED3D_STREAMING_FENCE_COUNT;
+        --stream->fence_count;
+    }
+
+    if (stream->submitted == stream->fenced || stream->fence_count == WINED3D_STREAMING_FENCE_COUNT)
+        return;
+    if (!force && stream->submitted - stream->fenced < stream->size / WINED3D_STREAMING_FENCE_COUNT)
+        return;
+
+    fence = &stream->fences[(stream->first_fence + stream->fence_count) % WINED3D_STREAMING_FENCE_COUNT];
+    fence->sync = GL_EXTCALL(glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0));
+    checkGLcall("glFenceSync");
+    fence->position = stream->fenced = stream->submitted;
+    ++stream->fence_count;
+
+    /* Make sure the fence gets to the GPU while the application is waiting for space. */
+    if (force)
+        gl_info->gl_ops.gl.p_glFlush();
+}
+
+/* Everything before the returned position has been unmapped and may be
+ * fenced and retired. Application thread only. */
+static unsigned int wined3d_streaming_buffer_unmapped(const struct wined3d_streaming_buffer *stream)
+{
+    struct list *head;
+
+    if (!(head = list_head(&stream->mapped)))
+        return stream->head;
+    return LIST_ENTRY(head, struct wined3d_buffer, stream_entry)->stream_start;
+}
+
+/* Serve a DISCARD map from the streaming buffer, without a round-trip to
+ * the CS thread. Returns FALSE if the map has to take the regular path. */
+BOOL wined3d_buffer_map_streaming(struct wined3d_buffer *buffer, struct wined3d_map_desc *map_desc,
+        const struct wined3d_box *box, DWORD flags)
+{
+    struct wined3d_streaming_buffer *stream = buffer->resource.device->streaming_buffer;
+    unsigned int size, head, tail, pos, skip;
+
+    if (!stream || !(flags & WINED3D_MAP_DISCARD) || buffer->stream_ptr || buffer->resource.map_count
+            || !(buffer->flags & WINED3D_BUFFER_USE_BO) || buffer->flags & WINED3D_BUFFER_PIN_SYSMEM
+            || buffer->conversion_map)
+        return FALSE;
+
+    size = (buffer->resource.size + RESOURCE_ALIGNMENT - 1) & ~(RESOURCE_ALIGNMENT - 1);
+    if (size > stream->size / 4)
+        return FALSE;
+
+    head = stream->head;
+    tail = InterlockedCompareExchange(&stream->tail, 0, 0);
+    pos = head & (stream->size - 1);
+    skip = pos + size > stream->size ? stream->size - pos : 0;
+    if (head + skip + size - tail > stream->size)
+    {
+        TRACE_(d3d_perf)("Streaming buffer full, mapping buffer %p synchronously.\n", buffer);
+        wined3d_cs_emit_upload_streaming(buffer->resource.device->cs, NULL, 0,
+                wined3d_streaming_buffer_unmapped(stream));
+        return FALSE;
+    }
+
+    buffer->stream_start = head;
+    buffer->stream_offset = skip ? 0 : pos;
+    buffer->stream_ptr = stream->map_ptr + buffer->stream_offset;
+    list_add_tail(&stream->mapped, &buffer->stream_entry);
+    stream->head = head + skip + size;
+
+    map_desc->row_pitch = map_desc->slice_pitch = buffer->desc.byte_width;
+    map_desc->data = buffer->stream_ptr + (box ? box->left : 0);
+
+    TRACE("Returning streaming memory at %p for buffer %p.\n", map_desc->data, buffer);
+    return TRUE;
+}
+
+BOOL wined3d_buffer_unmap_streaming(struct wined3d_buffer *buffer)
+{
+    struct wined3d_streaming_buffer *stream = buffer->resource.device->streaming_buffer;
+
+    if (!buffer->stream_ptr)
+        return FALSE;
+
+    list_remove(&buffer->stream_entry);
+    wined3d_cs_emit_upload_streaming(buffer->resource.device->cs, buffer,
+            buffer->stream_offset, wined3d_streaming_buffer_unmapped(stream));
+    buffer->stream_ptr = NULL;
+    return TRUE;
+}
+
+/* Copy the contents written to the streaming buffer to the buffer, on the
+ * CS thread. Context activation is done by the caller. */
+void wined3d_buffer_upload_streaming(struct wined3d_buffer *buffer, struct wined3d_context *context,
+        unsigned int offset)
+{
+    struct wined3d_streaming_buffer *stream = buffer->resource.device->streaming_buffer;
+    const struct wined3d_gl_info *gl_info = context->gl_info;
+
+    TRACE("buffer %p, context %p, offset %u.\n", buffer, context, offset);
+
+    /* The buffer may have switched to a path that needs the data in system
+     * memory since the map. */
+    if (buffer->resource.map_count || buffer->conversion_map
+            || !(buffer->flags & WINED3D_BUFFER_USE_BO) || buffer->flags & WINED3D_BUFFER_PIN_SYSMEM
+            || !wined3d_buffer_prepare_location(buffer, context, WINED3D_LOCATION_BUFFER))
+    {
+        TRACE_(d3d_perf)("Uploading streamed data for buffer %p through a map.\n", buffer);
+        wined3d_buffer_upload_data(buffer, NULL, stream->map_ptr + offset);
+    }
+    else
+    {
+        GL_EXTCALL(glBindBuffer(GL_COPY_READ_BUFFER, stream->buffer_object));
+        GL_EXTCALL(glBindBuffer(GL_COPY_WRITE_BUFFER, buffer->buffer_object));
+        GL_EXTCALL(glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+                offset, 0, buffer->resource.size));
+        checkGLcall("streaming buffer copy");
+
+        wined3d_buffer_validate_location(buffer, WINED3D_LOCATION_BUFFER);
+        wined3d_buffer_invalidate_location(buffer, ~WINED3D_LOCATION_BUFFER);
+        if (buffer->resource.heap_memory)
+            wined3d_buffer_evict_sysmem(buffer);
+        buffer_mark_used(buffer);
+    }
+}
+
 static ULONG buffer_resource_incref(struct wined3d_resource *resource)
 {
     return wined3d_buffer_incref(buffer_from_resource(resource));
@@ -3968,7 +3968,26 @@ BOOL context_apply_draw_state(struct wined3d_context *context,
 
     if (context->shader_update_mask & ~(1u << WINED3D_SHADER_TYPE_COMPUTE))
     {
+        LARGE_INTEGER start, end;
+
+        if (TRACE_ON(d3d_perf))
+            QueryPerformanceCounter(&start);
         device->shader_backend->shader_select(device->shader_priv, context, state);
+        if (TRACE_ON(d3d_perf))
+        {
+            QueryPerformanceCounter(&end);
+            context->device->shader_stall_time += end.QuadPart - start.QuadPart;
+            ++context->device->shader_stall_count;
+        }
+
+        if (context->shaders_pending)
+        {
+            /* Leave the shader update mask alone, so that selection is
+             * retried on the next draw. */
+            TRACE("Shaders are still being compiled, skipping draw.\n");
+            context->shaders_pending = 0;
+            return FALSE;
+        }
         context->shader_update_mask &= 1u << WINED3D_SHADER_TYPE_COMPUTE;
     }
 
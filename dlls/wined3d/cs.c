@@ -21,6 +21,7 @@
 #include "wined3d_private.h"
 
 WINE_DEFAULT_DEBUG_CHANNEL(d3d);
+WINE_DECLARE_DEBUG_CHANNEL(d3d_perf);
 
 #define WINED3D_INITIAL_CS_SIZE 4096
 
@@ -43,10 +44,13 @@ enum wined3d_cs_op
     WINED3D_CS_OP_SET_STREAM_OUTPUT,
     WINED3D_CS_OP_SET_INDEX_BUFFER,
     WINED3D_CS_OP_SET_CONSTANT_BUFFER,
+    WINED3D_CS_OP_SET_CONSTANT_BUFFERS,
     WINED3D_CS_OP_SET_TEXTURE,
     WINED3D_CS_OP_SET_SHADER_RESOURCE_VIEW,
+    WINED3D_CS_OP_SET_SHADER_RESOURCE_VIEWS,
     WINED3D_CS_OP_SET_UNORDERED_ACCESS_VIEW,
     WINED3D_CS_OP_SET_SAMPLER,
+    WINED3D_CS_OP_SET_SAMPLERS,
     WINED3D_CS_OP_SET_SHADER,
     WINED3D_CS_OP_SET_RASTERIZER_STATE,
     WINED3D_CS_OP_SET_RENDER_STATE,
@@ -70,6 +74,7 @@ enum wined3d_cs_op
     WINED3D_CS_OP_UPDATE_SUB_RESOURCE,
     WINED3D_CS_OP_ADD_DIRTY_TEXTURE_REGION,
     WINED3D_CS_OP_CLEAR_UNORDERED_ACCESS_VIEW,
+    WINED3D_CS_OP_UPLOAD_STREAMING,
     WINED3D_CS_OP_STOP,
 };
 
@@ -79,6 +84,18 @@ struct wined3d_cs_packet
     BYTE data[1];
 };
 
+/* Per-frame command stream statistics, only collected when the d3d_perf
+ * channel is enabled. All fields are updated by the emitting thread. */
+struct wined3d_cs_stats
+{
+    LARGE_INTEGER frequency;
+    unsigned int packets[WINED3D_CS_OP_STOP];
+    unsigned int packet_count;
+    size_t bytes;
+    LONGLONG wait_time;
+    unsigned int wait_count;
+};
+
 struct wined3d_cs_nop
 {
     enum wined3d_cs_op opcode;
@@ -213,6 +230,15 @@ struct wined3d_cs_set_constant_buffer
     struct wined3d_buffer *buffer;
 };
 
+struct wined3d_cs_set_constant_buffers
+{
+    enum wined3d_cs_op opcode;
+    enum wined3d_shader_type type;
+    unsigned int start_idx;
+    unsigned int count;
+    struct wined3d_buffer *buffers[1];
+};
+
 struct wined3d_cs_set_texture
 {
     enum wined3d_cs_op opcode;
@@ -237,6 +263,15 @@ struct wined3d_cs_set_shader_resource_view
     struct wined3d_shader_resource_view *view;
 };
 
+struct wined3d_cs_set_shader_resource_views
+{
+    enum wined3d_cs_op opcode;
+    enum wined3d_shader_type type;
+    unsigned int start_idx;
+    unsigned int count;
+    struct wined3d_shader_resource_view *views[1];
+};
+
 struct wined3d_cs_set_unordered_access_view
 {
     enum wined3d_cs_op opcode;
@@ -253,6 +288,15 @@ struct wined3d_cs_set_sampler
     struct wined3d_sampler *sampler;
 };
 
+struct wined3d_cs_set_samplers
+{
+    enum wined3d_cs_op opcode;
+    enum wined3d_shader_type type;
+    unsigned int start_idx;
+    unsigned int count;
+    struct wined3d_sampler *samplers[1];
+};
+
 struct wined3d_cs_set_shader
 {
     enum wined3d_cs_op opcode;
@@ -421,6 +465,14 @@ struct wined3d_cs_clear_unordered_access_view
     struct wined3d_uvec4 clear_value;
 };
 
+struct wined3d_cs_upload_streaming
+{
+    enum wined3d_cs_op opcode;
+    struct wined3d_buffer *buffer;
+    unsigned int offset;
+    unsigned int end;
+};
+
 struct wined3d_cs_stop
 {
     enum wined3d_cs_op opcode;
@@ -1151,6 +1203,42 @@ void wined3d_cs_emit_set_constant_buffer(struct wined3d_cs *cs, enum wined3d_sha
     cs->ops->submit(cs, WINED3D_CS_QUEUE_DEFAULT);
 }
 
+static void wined3d_cs_exec_set_constant_buffers(struct wined3d_cs *cs, const void *data)
+{
+    const struct wined3d_cs_set_constant_buffers *op = data;
+    struct wined3d_buffer *prev;
+    unsigned int i;
+
+    for (i = 0; i < op->count; ++i)
+    {
+        prev = cs->state.cb[op->type][op->start_idx + i];
+        cs->state.cb[op->type][op->start_idx + i] = op->buffers[i];
+
+        if (op->buffers[i])
+            InterlockedIncrement(&op->buffers[i]->resource.bind_count);
+        if (prev)
+            InterlockedDecrement(&prev->resource.bind_count);
+    }
+
+    device_invalidate_state(cs->device, STATE_CONSTANT_BUFFER(op->type));
+}
+
+void wined3d_cs_emit_set_constant_buffers(struct wined3d_cs *cs, enum wined3d_shader_type type,
+        unsigned int start_idx, unsigned int count, struct wined3d_buffer *const *buffers)
+{
+    struct wined3d_cs_set_constant_buffers *op;
+
+    op = cs->ops->require_space(cs, FIELD_OFFSET(struct wined3d_cs_set_constant_buffers, buffers[count]),
+            WINED3D_CS_QUEUE_DEFAULT);
+    op->opcode = WINED3D_CS_OP_SET_CONSTANT_BUFFERS;
+    op->type = type;
+    op->start_idx = start_idx;
+    op->count = count;
+    memcpy(op->buffers, buffers, count * sizeof(*buffers));
+
+    cs->ops->submit(cs, WINED3D_CS_QUEUE_DEFAULT);
+}
+
 static void wined3d_cs_exec_set_texture(struct wined3d_cs *cs, const void *data)
 {
     const struct wined3d_gl_info *gl_info = &cs->device->adapter->gl_info;
@@ -1275,6 +1363,45 @@ void wined3d_cs_emit_set_shader_resource_view(struct wined3d_cs *cs, enum wined3
     cs->ops->submit(cs, WINED3D_CS_QUEUE_DEFAULT);
 }
 
+static void wined3d_cs_exec_set_shader_resource_views(struct wined3d_cs *cs, const void *data)
+{
+    const struct wined3d_cs_set_shader_resource_views *op = data;
+    struct wined3d_shader_resource_view *prev;
+    unsigned int i;
+
+    for (i = 0; i < op->count; ++i)
+    {
+        prev = cs->state.shader_resource_view[op->type][op->start_idx + i];
+        cs->state.shader_resource_view[op->type][op->start_idx + i] = op->views[i];
+
+        if (op->views[i])
+            InterlockedIncrement(&op->views[i]->resource->bind_count);
+        if (prev)
+            InterlockedDecrement(&prev->resource->bind_count);
+    }
+
+    if (op->type != WINED3D_SHADER_TYPE_COMPUTE)
+        device_invalidate_state(cs->device, STATE_GRAPHICS_SHADER_RESOURCE_BINDING);
+    else
+        device_invalidate_state(cs->device, STATE_COMPUTE_SHADER_RESOURCE_BINDING);
+}
+
+void wined3d_cs_emit_set_shader_resource_views(struct wined3d_cs *cs, enum wined3d_shader_type type,
+        unsigned int start_idx, unsigned int count, struct wined3d_shader_resource_view *const *views)
+{
+    struct wined3d_cs_set_shader_resource_views *op;
+
+    op = cs->ops->require_space(cs, FIELD_OFFSET(struct wined3d_cs_set_shader_resource_views, views[count]),
+            WINED3D_CS_QUEUE_DEFAULT);
+    op->opcode = WINED3D_CS_OP_SET_SHADER_RESOURCE_VIEWS;
+    op->type = type;
+    op->start_idx = start_idx;
+    op->count = count;
+    memcpy(op->views, views, count * sizeof(*views));
+
+    cs->ops->submit(cs, WINED3D_CS_QUEUE_DEFAULT);
+}
+
 static void wined3d_cs_exec_set_unordered_access_view(struct wined3d_cs *cs, const void *data)
 {
     const struct wined3d_cs_set_unordered_access_view *op = data;
@@ -1330,6 +1457,33 @@ void wined3d_cs_emit_set_sampler(struct wined3d_cs *cs, enum wined3d_shader_type
     cs->ops->submit(cs, WINED3D_CS_QUEUE_DEFAULT);
 }
 
+static void wined3d_cs_exec_set_samplers(struct wined3d_cs *cs, const void *data)
+{
+    const struct wined3d_cs_set_samplers *op = data;
+
+    memcpy(&cs->state.sampler[op->type][op->start_idx], op->samplers, op->count * sizeof(*op->samplers));
+    if (op->type != WINED3D_SHADER_TYPE_COMPUTE)
+        device_invalidate_state(cs->device, STATE_GRAPHICS_SHADER_RESOURCE_BINDING);
+    else
+        device_invalidate_state(cs->device, STATE_COMPUTE_SHADER_RESOURCE_BINDING);
+}
+
+void wined3d_cs_emit_set_samplers(struct wined3d_cs *cs, enum wined3d_shader_type type,
+        unsigned int start_idx, unsigned int count, struct wined3d_sampler *const *samplers)
+{
+    struct wined3d_cs_set_samplers *op;
+
+    op = cs->ops->require_space(cs, FIELD_OFFSET(struct wined3d_cs_set_samplers, samplers[count]),
+            WINED3D_CS_QUEUE_DEFAULT);
+    op->opcode = WINED3D_CS_OP_SET_SAMPLERS;
+    op->type = type;
+    op->start_idx = start_idx;
+    op->count = count;
+    memcpy(op->samplers, samplers, count * sizeof(*samplers));
+
+    cs->ops->submit(cs, WINED3D_CS_QUEUE_DEFAULT);
+}
+
 static void wined3d_cs_exec_set_shader(struct wined3d_cs *cs, const void *data)
 {
     const struct wined3d_cs_set_shader *op = data;
@@ -2275,6 +2429,45 @@ void wined3d_cs_emit_clear_unordered_access_view_uint(struct wined3d_cs *cs,
     cs->ops->submit(cs, WINED3D_CS_QUEUE_DEFAULT);
 }
 
+static void wined3d_cs_exec_upload_streaming(struct wined3d_cs *cs, const void *data)
+{
+    const struct wined3d_cs_upload_streaming *op = data;
+    struct wined3d_streaming_buffer *stream = cs->device->streaming_buffer;
+    struct wined3d_context *context;
+
+    if (stream)
+    {
+        context = context_acquire(cs->device, NULL, 0);
+        if (op->buffer)
+            wined3d_buffer_upload_streaming(op->buffer, context, op->offset);
+        stream->submitted = op->end;
+        wined3d_streaming_buffer_poll(stream, context, !op->buffer);
+        context_release(context);
+    }
+
+    if (op->buffer)
+        wined3d_resource_release(&op->buffer->resource);
+}
+
+/* Without a buffer this only retires completed streaming buffer memory.
+ * "end" is the position up to which the streaming buffer is unmapped. */
+void wined3d_cs_emit_upload_streaming(struct wined3d_cs *cs, struct wined3d_buffer *buffer,
+        unsigned int offset, unsigned int end)
+{
+    struct wined3d_cs_upload_streaming *op;
+
+    op = cs->ops->require_space(cs, sizeof(*op), WINED3D_CS_QUEUE_DEFAULT);
+    op->opcode = WINED3D_CS_OP_UPLOAD_STREAMING;
+    op->buffer = buffer;
+    op->offset = offset;
+    op->end = end;
+
+    if (buffer)
+        wined3d_resource_acquire(&buffer->resource);
+
+    cs->ops->submit(cs, WINED3D_CS_QUEUE_DEFAULT);
+}
+
 static void wined3d_cs_emit_stop(struct wined3d_cs *cs)
 {
     struct wined3d_cs_stop *op;
@@ -2305,10 +2498,13 @@ static void (* const wined3d_cs_op_handlers[])(struct wined3d_cs *cs, const void
     /* WINED3D_CS_OP_SET_STREAM_OUTPUT           */ wined3d_cs_exec_set_stream_output,
     /* WINED3D_CS_OP_SET_INDEX_BUFFER            */ wined3d_cs_exec_set_index_buffer,
     /* WINED3D_CS_OP_SET_CONSTANT_BUFFER         */ wined3d_cs_exec_set_constant_buffer,
+    /* WINED3D_CS_OP_SET_CONSTANT_BUFFERS        */ wined3d_cs_exec_set_constant_buffers,
     /* WINED3D_CS_OP_SET_TEXTURE                 */ wined3d_cs_exec_set_texture,
     /* WINED3D_CS_OP_SET_SHADER_RESOURCE_VIEW    */ wined3d_cs_exec_set_shader_resource_view,
+    /* WINED3D_CS_OP_SET_SHADER_RESOURCE_VIEWS   */ wined3d_cs_exec_set_shader_resource_views,
     /* WINED3D_CS_OP_SET_UNORDERED_ACCESS_VIEW   */ wined3d_cs_exec_set_unordered_access_view,
     /* WINED3D_CS_OP_SET_SAMPLER                 */ wined3d_cs_exec_set_sampler,
+    /* WINED3D_CS_OP_SET_SAMPLERS                */ wined3d_cs_exec_set_samplers,
     /* WINED3D_CS_OP_SET_SHADER                  */ wined3d_cs_exec_set_shader,
     /* WINED3D_CS_OP_SET_RASTERIZER_STATE        */ wined3d_cs_exec_set_rasterizer_state,
     /* WINED3D_CS_OP_SET_RENDER_STATE            */ wined3d_cs_exec_set_render_state,
@@ -2332,8 +2528,108 @@ static void (* const wined3d_cs_op_handlers[])(struct wined3d_cs *cs, const void
     /* WINED3D_CS_OP_UPDATE_SUB_RESOURCE         */ wined3d_cs_exec_update_sub_resource,
     /* WINED3D_CS_OP_ADD_DIRTY_TEXTURE_REGION    */ wined3d_cs_exec_add_dirty_texture_region,
     /* WINED3D_CS_OP_CLEAR_UNORDERED_ACCESS_VIEW */ wined3d_cs_exec_clear_unordered_access_view,
+    /* WINED3D_CS_OP_UPLOAD_STREAMING            */ wined3d_cs_exec_upload_streaming,
 };
 
+static const char *debug_cs_op(enum wined3d_cs_op op)
+{
+    switch (op)
+    {
+#define WINED3D_TO_STR(type) case type: return #type
+        WINED3D_TO_STR(WINED3D_CS_OP_NOP);
+        WINED3D_TO_STR(WINED3D_CS_OP_PRESENT);
+        WINED3D_TO_STR(WINED3D_CS_OP_CLEAR);
+        WINED3D_TO_STR(WINED3D_CS_OP_DISPATCH);
+        WINED3D_TO_STR(WINED3D_CS_OP_DRAW);
+        WINED3D_TO_STR(WINED3D_CS_OP_FLUSH);
+        WINED3D_TO_STR(WINED3D_CS_OP_SET_PREDICATION);
+        WINED3D_TO_STR(WINED3D_CS_OP_SET_VIEWPORT);
+        WINED3D_TO_STR(WINED3D_CS_OP_SET_SCISSOR_RECT);
+        WINED3D_TO_STR(WINED3D_CS_OP_SET_RENDERTARGET_VIEW);
+        WINED3D_TO_STR(WINED3D_CS_OP_SET_DEPTH_STENCIL_VIEW);
+        WINED3D_TO_STR(WINED3D_CS_OP_SET_VERTEX_DECLARATION);
+        WINED3D_TO_STR(WINED3D_CS_OP_SET_STREAM_SOURCE);
+        WINED3D_TO_STR(WINED3D_CS_OP_SET_STREAM_SOURCE_FREQ);
+        WINED3D_TO_STR(WINED3D_CS_OP_SET_STREAM_OUTPUT);
+        WINED3D_TO_STR(WINED3D_CS_OP_SET_INDEX_BUFFER);
+        WINED3D_TO_STR(WINED3D_CS_OP_SET_CONSTANT_BUFFER);
+        WINED3D_TO_STR(WINED3D_CS_OP_SET_CONSTANT_BUFFERS);
+        WINED3D_TO_STR(WINED3D_CS_OP_SET_TEXTURE);
+        WINED3D_TO_STR(WINED3D_CS_OP_SET_SHADER_RESOURCE_VIEW);
+        WINED3D_TO_STR(WINED3D_CS_OP_SET_SHADER_RESOURCE_VIEWS);
+        WINED3D_TO_STR(WINED3D_CS_OP_SET_UNORDERED_ACCESS_VIEW);
+        WINED3D_TO_STR(WINED3D_CS_OP_SET_SAMPLER);
+        WINED3D_TO_STR(WINED3D_CS_OP_SET_SAMPLERS);
+        WINED3D_TO_STR(WINED3D_CS_OP_SET_SHADER);
+        WINED3D_TO_STR(WINED3D_CS_OP_SET_RASTERIZER_STATE);
+        WINED3D_TO_STR(WINED3D_CS_OP_SET_RENDER_STATE);
+        WINED3D_TO_STR(WINED3D_CS_OP_SET_TEXTURE_STATE);
+        WINED3D_TO_STR(WINED3D_CS_OP_SET_SAMPLER_STATE);
+        WINED3D_TO_STR(WINED3D_CS_OP_SET_TRANSFORM);
+        WINED3D_TO_STR(WINED3D_CS_OP_SET_CLIP_PLANE);
+        WINED3D_TO_STR(WINED3D_CS_OP_SET_COLOR_KEY);
+        WINED3D_TO_STR(WINED3D_CS_OP_SET_MATERIAL);
+        WINED3D_TO_STR(WINED3D_CS_OP_SET_LIGHT);
+        WINED3D_TO_STR(WINED3D_CS_OP_SET_LIGHT_ENABLE);
+        WINED3D_TO_STR(WINED3D_CS_OP_PUSH_CONSTANTS);
+        WINED3D_TO_STR(WINED3D_CS_OP_RESET_STATE);
+        WINED3D_TO_STR(WINED3D_CS_OP_CALLBACK);
+        WINED3D_TO_STR(WINED3D_CS_OP_QUERY_ISSUE);
+        WINED3D_TO_STR(WINED3D_CS_OP_PRELOAD_RESOURCE);
+        WINED3D_TO_STR(WINED3D_CS_OP_UNLOAD_RESOURCE);
+        WINED3D_TO_STR(WINED3D_CS_OP_MAP);
+        WINED3D_TO_STR(WINED3D_CS_OP_UNMAP);
+        WINED3D_TO_STR(WINED3D_CS_OP_BLT_SUB_RESOURCE);
+        WINED3D_TO_STR(WINED3D_CS_OP_UPDATE_SUB_RESOURCE);
+        WINED3D_TO_STR(WINED3D_CS_OP_ADD_DIRTY_TEXTURE_REGION);
+        WINED3D_TO_STR(WINED3D_CS_OP_CLEAR_UNORDERED_ACCESS_VIEW);
+        WINED3D_TO_STR(WINED3D_CS_OP_UPLOAD_STREAMING);
+#undef WINED3D_TO_STR
+        default:
+            return wine_dbg_sprintf("UNKNOWN_OP(%#x)", op);
+    }
+}
+
+static void wined3d_cs_stats_add_wait(struct wined3d_cs_stats *stats, const LARGE_INTEGER *start)
+{
+    LARGE_INTEGER end;
+
+    QueryPerformanceCounter(&end);
+    stats->wait_time += end.QuadPart - start->QuadPart;
+    ++stats->wait_count;
+}
+
+static void wined3d_cs_stats_add_packet(struct wined3d_cs_stats *stats, const void *data, size_t size)
+{
+    enum wined3d_cs_op opcode = *(const enum wined3d_cs_op *)data;
+    unsigned int i;
+
+    if (opcode >= WINED3D_CS_OP_STOP)
+        return;
+
+    ++stats->packets[opcode];
+    ++stats->packet_count;
+    stats->bytes += size;
+
+    if (opcode != WINED3D_CS_OP_PRESENT)
+        return;
+
+    TRACE_(d3d_perf)("Frame: %u packets, %lu bytes, producer waited %.3f ms in %u waits.\n",
+            stats->packet_count, (unsigned long)stats->bytes,
+            stats->wait_time * 1000.0 / stats->frequency.QuadPart, stats->wait_count);
+    for (i = 0; i < ARRAY_SIZE(stats->packets); ++i)
+    {
+        if (stats->packets[i])
+            TRACE_(d3d_perf)("    %s: %u.\n", debug_cs_op(i), stats->packets[i]);
+    }
+
+    memset(stats->packets, 0, sizeof(stats->packets));
+    stats->packet_count = 0;
+    stats->bytes = 0;
+    stats->wait_time = 0;
+    stats->wait_count = 0;
+}
+
 #if defined(STAGING_CSMT)
 static BOOL wined3d_cs_st_check_space(struct wined3d_cs *cs, size_t size, enum wined3d_cs_queue_id queue_id)
 {
@@ -2374,6 +2670,10 @@ static void wined3d_cs_st_submit(struct wined3d_cs *cs, enum wined3d_cs_queue_id
 
     data = cs->data;
     start = cs->start;
+    /* In the multithreaded case this is the CS thread submitting to itself;
+     * the packets are counted where they were emitted. */
+    if (cs->stats && !cs->thread)
+        wined3d_cs_stats_add_packet(cs->stats, &data[start], cs->end - start);
     cs->start = cs->end;
 
     opcode = *(const enum wined3d_cs_op *)&data[start];
@@ -2408,6 +2708,21 @@ static BOOL wined3d_cs_queue_is_empty(const struct wined3d_cs_queue *queue)
     return *(volatile LONG *)&queue->head == queue->tail;
 }
 
+static void wined3d_cs_queue_wait_empty(const struct wined3d_cs_queue *queue, struct wined3d_cs *cs)
+{
+    LARGE_INTEGER wait_start;
+
+    if (wined3d_cs_queue_is_empty(queue))
+        return;
+
+    if (cs->stats)
+        QueryPerformanceCounter(&wait_start);
+    while (!wined3d_cs_queue_is_empty(queue))
+        wined3d_pause();
+    if (cs->stats)
+        wined3d_cs_stats_add_wait(cs->stats, &wait_start);
+}
+
 static void wined3d_cs_queue_submit(struct wined3d_cs_queue *queue, struct wined3d_cs *cs)
 {
     struct wined3d_cs_packet *packet;
@@ -2426,6 +2741,14 @@ static void wined3d_cs_mt_submit(struct wined3d_cs *cs, enum wined3d_cs_queue_id
     if (cs->thread_id == GetCurrentThreadId())
         return wined3d_cs_st_submit(cs, queue_id);
 
+    if (cs->stats)
+    {
+        const struct wined3d_cs_queue *queue = &cs->queue[queue_id];
+        const struct wined3d_cs_packet *packet = (const struct wined3d_cs_packet *)&queue->data[queue->head];
+
+        wined3d_cs_stats_add_packet(cs->stats, packet->data, packet->size);
+    }
+
     wined3d_cs_queue_submit(&cs->queue[queue_id], cs);
 }
 
@@ -2449,6 +2772,8 @@ static void *wined3d_cs_queue_require_space(struct wined3d_cs_queue *queue, size
     size_t queue_size = ARRAY_SIZE(queue->data);
     size_t header_size, packet_size, remaining;
     struct wined3d_cs_packet *packet;
+    LARGE_INTEGER wait_start;
+    BOOL waited = FALSE;
 
     header_size = FIELD_OFFSET(struct wined3d_cs_packet, data[0]);
     size = (size + header_size - 1) & ~(header_size - 1);
@@ -2498,8 +2823,16 @@ static void *wined3d_cs_queue_require_space(struct wined3d_cs_queue *queue, size
 
         TRACE("Waiting for free space. Head %u, tail %u, packet size %lu.\n",
                 head, tail, (unsigned long)packet_size);
+        if (cs->stats && !waited)
+        {
+            QueryPerformanceCounter(&wait_start);
+            waited = TRUE;
+        }
     }
 
+    if (waited)
+        wined3d_cs_stats_add_wait(cs->stats, &wait_start);
+
     packet = (struct wined3d_cs_packet *)&queue->data[queue->head];
     packet->size = size;
     return packet->data;
@@ -2528,8 +2861,7 @@ static void wined3d_cs_mt_finish(struct wined3d_cs *cs, enum wined3d_cs_queue_id
     if (cs->thread_id == GetCurrentThreadId())
         return wined3d_cs_st_finish(cs, queue_id);
 
-    while (!wined3d_cs_queue_is_empty(&cs->queue[queue_id]))
-        wined3d_pause();
+    wined3d_cs_queue_wait_empty(&cs->queue[queue_id], cs);
 }
 
 static const struct wined3d_cs_ops wined3d_cs_mt_ops =
@@ -2663,6 +2995,9 @@ struct wined3d_cs *wined3d_cs_create(struct wined3d_device *device)
     if (!(cs->data = HeapAlloc(GetProcessHeap(), 0, cs->data_size)))
         goto fail;
 
+    if (TRACE_ON(d3d_perf) && (cs->stats = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(*cs->stats))))
+        QueryPerformanceFrequency(&cs->stats->frequency);
+
     if (wined3d_settings.cs_multithreaded
             && !RtlIsCriticalSectionLockedByThread(NtCurrentTeb()->Peb->LoaderLock))
     {
@@ -2697,6 +3032,7 @@ struct wined3d_cs *wined3d_cs_create(struct wined3d_device *device)
     return cs;
 
 fail:
+    HeapFree(GetProcessHeap(), 0, cs->stats);
     state_cleanup(&cs->state);
     HeapFree(GetProcessHeap(), 0, cs->fb.render_targets);
     HeapFree(GetProcessHeap(), 0, cs);
@@ -2714,6 +3050,7 @@ void wined3d_cs_destroy(struct wined3d_cs *cs)
     }
 
     state_cleanup(&cs->state);
+    HeapFree(GetProcessHeap(), 0, cs->stats);
     HeapFree(GetProcessHeap(), 0, cs->fb.render_targets);
     HeapFree(GetProcessHeap(), 0, cs->data);
     HeapFree(GetProcessHeap(), 0, cs);
@@ -1015,6 +1015,11 @@ static void wined3d_device_delete_opengl_contexts_cs(void *object)
     device->shader_backend->shader_free_private(device);
     destroy_dummy_textures(device, context);
     destroy_default_samplers(device, context);
+    if (device->streaming_buffer)
+    {
+        wined3d_streaming_buffer_destroy(device->streaming_buffer, context);
+        device->streaming_buffer = NULL;
+    }
     context_release(context);
 
     while (device->context_count)
@@ -1062,6 +1067,7 @@ static void wined3d_device_create_primary_opengl_context_cs(void *object)
     context = context_acquire(device, target, 0);
     create_dummy_textures(device, context);
     create_default_samplers(device, context);
+    device->streaming_buffer = wined3d_streaming_buffer_create(context);
     context_release(context);
 }
 
@@ -1950,13 +1956,20 @@ void CDECL wined3d_device_set_viewport(struct wined3d_device *device, const stru
     TRACE("x %.8e, y %.8e, w %.8e, h %.8e, min_z %.8e, max_z %.8e.\n",
           viewport->x, viewport->y, viewport->width, viewport->height, viewport->min_z, viewport->max_z);
 
+    if (device->recording)
+        device->recording->changed.viewport = TRUE;
+
+    if (!memcmp(&device->update_state->viewport, viewport, sizeof(*viewport)))
+    {
+        TRACE("Application is setting the old viewport over, nothing to do.\n");
+        return;
+    }
     device->update_state->viewport = *viewport;
 
     /* Handle recording of state blocks */
     if (device->recording)
     {
         TRACE("Recording... not performing anything\n");
-        device->recording->changed.viewport = TRUE;
         return;
     }
 
@@ -2231,6 +2244,54 @@ static void wined3d_device_set_constant_buffer(struct wined3d_device *device,
         wined3d_buffer_decref(prev);
 }
 
+void CDECL wined3d_device_set_constant_buffers(struct wined3d_device *device, enum wined3d_shader_type type,
+        unsigned int start_idx, unsigned int count, struct wined3d_buffer *const *buffers)
+{
+    unsigned int i, first = ~0u, last = 0;
+    struct wined3d_buffer *prev;
+
+    TRACE("device %p, type %#x, start_idx %u, count %u, buffers %p.\n",
+            device, type, start_idx, count, buffers);
+
+    if (type >= WINED3D_SHADER_TYPE_COUNT || start_idx >= MAX_CONSTANT_BUFFERS)
+    {
+        WARN("Invalid type %#x, start index %u.\n", type, start_idx);
+        return;
+    }
+    if (count > MAX_CONSTANT_BUFFERS - start_idx)
+    {
+        WARN("Invalid count %u, clamping.\n", count);
+        count = MAX_CONSTANT_BUFFERS - start_idx;
+    }
+
+    /* Only the changed part of the range is sent to the command stream. */
+    for (i = 0; i < count; ++i)
+    {
+        if (buffers[i] == device->update_state->cb[type][start_idx + i])
+            continue;
+        if (first == ~0u)
+            first = i;
+        last = i;
+    }
+    if (first == ~0u)
+        return;
+
+    for (i = first; i <= last; ++i)
+    {
+        if (buffers[i])
+            wined3d_buffer_incref(buffers[i]);
+    }
+    if (!device->recording)
+        wined3d_cs_emit_set_constant_buffers(device->cs, type, start_idx + first, last - first + 1, &buffers[first]);
+    for (i = first; i <= last; ++i)
+    {
+        prev = device->update_state->cb[type][start_idx + i];
+        device->update_state->cb[type][start_idx + i] = buffers[i];
+        if (prev)
+            wined3d_buffer_decref(prev);
+    }
+}
+
 void CDECL wined3d_device_set_vs_cb(struct wined3d_device *device, UINT idx, struct wined3d_buffer *buffer)
 {
     TRACE("device %p, idx %u, buffer %p.\n", device, idx, buffer);
@@ -2281,6 +2342,53 @@ static void wined3d_device_set_shader_resource_view(struct wined3d_device *devic
         wined3d_shader_resource_view_decref(prev);
 }
 
+void CDECL wined3d_device_set_shader_resource_views(struct wined3d_device *device, enum wined3d_shader_type type,
+        unsigned int start_idx, unsigned int count, struct wined3d_shader_resource_view *const *views)
+{
+    struct wined3d_shader_resource_view *prev;
+    unsigned int i, first = ~0u, last = 0;
+
+    TRACE("device %p, type %#x, start_idx %u, count %u, views %p.\n",
+            device, type, start_idx, count, views);
+
+    if (type >= WINED3D_SHADER_TYPE_COUNT || start_idx >= MAX_SHADER_RESOURCE_VIEWS)
+    {
+        WARN("Invalid type %#x, start index %u.\n", type, start_idx);
+        return;
+    }
+    if (count > MAX_SHADER_RESOURCE_VIEWS - start_idx)
+    {
+        WARN("Invalid count %u, clamping.\n", count);
+        count = MAX_SHADER_RESOURCE_VIEWS - start_idx;
+    }
+
+    for (i = 0; i < count; ++i)
+    {
+        if (views[i] == device->update_state->shader_resource_view[type][start_idx + i])
+            continue;
+        if (first == ~0u)
+            first = i;
+        last = i;
+    }
+    if (first == ~0u)
+        return;
+
+    for (i = first; i <= last; ++i)
+    {
+        if (views[i])
+            wined3d_shader_resource_view_incref(views[i]);
+    }
+    if (!device->recording)
+        wined3d_cs_emit_set_shader_resource_views(device->cs, type, start_idx + first, last - first + 1, &views[first]);
+    for (i = first; i <= last; ++i)
+    {
+        prev = device->update_state->shader_resource_view[type][start_idx + i];
+        device->update_state->shader_resource_view[type][start_idx + i] = views[i];
+        if (prev)
+            wined3d_shader_resource_view_decref(prev);
+    }
+}
+
 void CDECL wined3d_device_set_vs_resource_view(struct wined3d_device *device,
         UINT idx, struct wined3d_shader_resource_view *view)
 {
@@ -2333,6 +2441,53 @@ static void wined3d_device_set_sampler(struct wined3d_device *device,
         wined3d_sampler_decref(prev);
 }
 
+void CDECL wined3d_device_set_samplers(struct wined3d_device *device, enum wined3d_shader_type type,
+        unsigned int start_idx, unsigned int count, struct wined3d_sampler *const *samplers)
+{
+    unsigned int i, first = ~0u, last = 0;
+    struct wined3d_sampler *prev;
+
+    TRACE("device %p, type %#x, start_idx %u, count %u, samplers %p.\n",
+            device, type, start_idx, count, samplers);
+
+    if (type >= WINED3D_SHADER_TYPE_COUNT || start_idx >= MAX_SAMPLER_OBJECTS)
+    {
+        WARN("Invalid type %#x, start index %u.\n", type, start_idx);
+        return;
+    }
+    if (count > MAX_SAMPLER_OBJECTS - start_idx)
+    {
+        WARN("Invalid count %u, clamping.\n", count);
+        count = MAX_SAMPLER_OBJECTS - start_idx;
+    }
+
+    for (i = 0; i < count; ++i)
+    {
+        if (samplers[i] == device->update_state->sampler[type][start_idx + i])
+            continue;
+        if (first == ~0u)
+            first = i;
+        last = i;
+    }
+    if (first == ~0u)
+        return;
+
+    for (i = first; i <= last; ++i)
+    {
+        if (samplers[i])
+            wined3d_sampler_incref(samplers[i]);
+    }
+    if (!device->recording)
+        wined3d_cs_emit_set_samplers(device->cs, type, start_idx + first, last - first + 1, &samplers[first]);
+    for (i = first; i <= last; ++i)
+    {
+        prev = device->update_state->sampler[type][start_idx + i];
+        device->update_state->sampler[type][start_idx + i] = samplers[i];
+        if (prev)
+            wined3d_sampler_decref(prev);
+    }
+}
+
 void CDECL wined3d_device_set_vs_sampler(struct wined3d_device *device, UINT idx, struct wined3d_sampler *sampler)
 {
     TRACE("device %p, idx %u, sampler %p.\n", device, idx, sampler);
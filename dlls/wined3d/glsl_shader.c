@@ -42,6 +42,7 @@
 
 WINE_DEFAULT_DEBUG_CHANNEL(d3d_shader);
 WINE_DECLARE_DEBUG_CHANNEL(d3d);
+WINE_DECLARE_DEBUG_CHANNEL(d3d_perf);
 WINE_DECLARE_DEBUG_CHANNEL(winediag);
 
 #define WINED3D_GLSL_SAMPLE_PROJECTED   0x01
@@ -131,6 +132,7 @@ struct shader_glsl_priv
     struct wine_rb_tree ffp_fragment_shaders;
     BOOL ffp_proj_control;
     BOOL legacy_lighting;
+    UINT64 program_cache_seed;
 };
 
 struct glsl_vs_program
@@ -495,6 +497,11 @@ void print_glsl_info_log(const struct wined3d_gl_info *gl_info, GLuint id, BOOL
     }
 }
 
+static BOOL shader_glsl_use_parallel_compile(const struct wined3d_gl_info *gl_info)
+{
+    return wined3d_settings.async_shaders && gl_info->supported[ARB_PARALLEL_SHADER_COMPILE];
+}
+
 /* Context activation is done by the caller. */
 static void shader_glsl_compile(const struct wined3d_gl_info *gl_info, GLuint shader, const char *src)
 {
@@ -512,7 +519,10 @@ static void shader_glsl_compile(const struct wined3d_gl_info *gl_info, GLuint sh
     checkGLcall("glShaderSource");
     GL_EXTCALL(glCompileShader(shader));
     checkGLcall("glCompileShader");
-    print_glsl_info_log(gl_info, shader, FALSE);
+    /* Querying the info log would wait for a parallel compile to finish.
+     * The log is dumped together with the program if linking fails. */
+    if (!shader_glsl_use_parallel_compile(gl_info) || TRACE_ON(d3d_shader))
+        print_glsl_info_log(gl_info, shader, FALSE);
 }
 
 /* Context activation is done by the caller. */
@@ -557,6 +567,8 @@ static void shader_glsl_dump_program_source(const struct wined3d_gl_info *gl_inf
         GL_EXTCALL(glGetShaderiv(shaders[i], GL_COMPILE_STATUS, &tmp));
         FIXME("    GL_COMPILE_STATUS: %d.\n", tmp);
         FIXME("\n");
+        if (!tmp && shader_glsl_use_parallel_compile(gl_info))
+            print_glsl_info_log(gl_info, shaders[i], FALSE);
 
         ptr = source;
         GL_EXTCALL(glGetShaderSource(shaders[i], source_size, NULL, source));
@@ -586,6 +598,613 @@ void shader_glsl_validate_link(const struct wined3d_gl_info *gl_info, GLuint pro
     print_glsl_info_log(gl_info, program, TRUE);
 }
 
+/* On-disk cache of linked GLSL programs.
+ *
+ * Linked programs are saved with glGetProgramBinary() and reloaded with
+ * glProgramBinary() the next time an identical program is linked. Programs
+ * are keyed by the GLSL source of their attached shaders, which is derived
+ * from the D3D bytecode and compile args, the state that affects linking,
+ * and the GL driver and wined3d versions. Each program is stored in its own
+ * file, and the least recently used files are removed when the cache grows
+ * beyond its size limit. */
+#define WINED3D_PROGRAM_CACHE_MAGIC     0x50443357u /* "W3DP" */
+#define WINED3D_PROGRAM_CACHE_VERSION   1
+#define WINED3D_PROGRAM_CACHE_HASH_INIT 0xcbf29ce484222325ull
+/* Temporary files older than this (in 100ns units) were left behind by an
+ * interrupted store and are deleted when the directory is scanned. */
+#define WINED3D_PROGRAM_CACHE_TMP_AGE   (60 * 60 * (ULONGLONG)10000000)
+
+static const WCHAR glsl_program_cache_tmp_prefixW[] = {'w','3','d',0};
+
+struct glsl_program_cache_header
+{
+    DWORD magic;
+    DWORD version;
+    UINT64 key;
+    UINT64 checksum;
+    GLenum format;
+    DWORD size;
+};
+
+struct glsl_program_cache_entry
+{
+    struct wine_rb_entry entry;
+    UINT64 key;
+    DWORD size;
+    ULONGLONG last_use;
+};
+
+static CRITICAL_SECTION glsl_program_cache_cs;
+static CRITICAL_SECTION_DEBUG glsl_program_cache_cs_debug =
+{
+    0, 0, &glsl_program_cache_cs,
+    {&glsl_program_cache_cs_debug.ProcessLocksList,
+    &glsl_program_cache_cs_debug.ProcessLocksList},
+    0, 0, {(DWORD_PTR)(__FILE__ ": glsl_program_cache_cs")}
+};
+static CRITICAL_SECTION glsl_program_cache_cs = {&glsl_program_cache_cs_debug, -1, 0, 0, 0, 0};
+
+static struct
+{
+    BOOL initialized;
+    BOOL enabled;
+    WCHAR path[MAX_PATH];
+    unsigned int path_len;
+    struct wine_rb_tree entries;
+    UINT64 size;
+    UINT64 max_size;
+
+    unsigned int hits;
+    unsigned int misses;
+    unsigned int rejects;
+    unsigned int stores;
+    unsigned int evictions;
+} glsl_program_cache;
+
+static UINT64 glsl_program_cache_hash(UINT64 hash, const void *data, SIZE_T size)
+{
+    const BYTE *ptr = data;
+
+    while (size--)
+    {
+        hash ^= *ptr++;
+        hash *= 0x100000001b3ull;
+    }
+
+    return hash;
+}
+
+static int glsl_program_cache_compare(const void *key, const struct wine_rb_entry *entry)
+{
+    UINT64 k = *(const UINT64 *)key;
+    UINT64 e = WINE_RB_ENTRY_VALUE(entry, struct glsl_program_cache_entry, entry)->key;
+
+    return k < e ? -1 : k > e;
+}
+
+static void glsl_program_cache_dump_stats(void)
+{
+    TRACE_(d3d_perf)("Program cache: %u hits, %u misses, %u rejected, %u stored, %u evicted, "
+            "%s/%s bytes.\n", glsl_program_cache.hits, glsl_program_cache.misses, glsl_program_cache.rejects,
+            glsl_program_cache.stores, glsl_program_cache.evictions,
+            wine_dbgstr_longlong(glsl_program_cache.size), wine_dbgstr_longlong(glsl_program_cache.max_size));
+}
+
+/* Builds "<path><key>.bin" in the supplied buffer. */
+static const WCHAR *glsl_program_cache_get_file_name(UINT64 key, WCHAR *name)
+{
+    static const WCHAR extW[] = {'.','b','i','n',0};
+    static const char hex[] = "0123456789abcdef";
+    unsigned int i;
+
+    memcpy(name, glsl_program_cache.path, glsl_program_cache.path_len * sizeof(*name));
+    for (i = 0; i < 16; ++i)
+        name[glsl_program_cache.path_len + i] = hex[(key >> (60 - 4 * i)) & 0xf];
+    memcpy(&name[glsl_program_cache.path_len + 16], extW, sizeof(extW));
+
+    return name;
+}
+
+static BOOL glsl_program_cache_parse_file_name(const WCHAR *name, UINT64 *key)
+{
+    unsigned int i;
+    UINT64 k = 0;
+
+    for (i = 0; i < 16; ++i)
+    {
+        if (name[i] >= '0' && name[i] <= '9')
+            k = (k << 4) | (name[i] - '0');
+        else if (name[i] >= 'a' && name[i] <= 'f')
+            k = (k << 4) | (name[i] - 'a' + 10);
+        else
+            return FALSE;
+    }
+    if (name[16] != '.' || name[17] != 'b' || name[18] != 'i' || name[19] != 'n' || name[20])
+        return FALSE;
+
+    *key = k;
+    return TRUE;
+}
+
+static ULONGLONG glsl_program_cache_get_time(void)
+{
+    FILETIME ft;
+
+    GetSystemTimeAsFileTime(&ft);
+    return ((ULONGLONG)ft.dwHighDateTime << 32) | ft.dwLowDateTime;
+}
+
+static void glsl_program_cache_remove(struct glsl_program_cache_entry *entry)
+{
+    WCHAR name[MAX_PATH + 24];
+
+    DeleteFileW(glsl_program_cache_get_file_name(entry->key, name));
+    glsl_program_cache.size -= entry->size;
+    wine_rb_remove(&glsl_program_cache.entries, &entry->entry);
+    HeapFree(GetProcessHeap(), 0, entry);
+}
+
+static struct glsl_program_cache_entry *glsl_program_cache_add(UINT64 key, DWORD size, ULONGLONG last_use)
+{
+    struct glsl_program_cache_entry *entry;
+    struct wine_rb_entry *e;
+
+    if ((e = wine_rb_get(&glsl_program_cache.entries, &key)))
+    {
+        entry = WINE_RB_ENTRY_VALUE(e, struct glsl_program_cache_entry, entry);
+        glsl_program_cache.size -= entry->size;
+    }
+    else
+    {
+        if (!(entry = HeapAlloc(GetProcessHeap(), 0, sizeof(*entry))))
+            return NULL;
+        entry->key = key;
+        wine_rb_put(&glsl_program_cache.entries, &key, &entry->entry);
+    }
+    entry->size = size;
+    entry->last_use = last_use;
+    glsl_program_cache.size += size;
+
+    return entry;
+}
+
+static void glsl_program_cache_free_entry(struct wine_rb_entry *entry, void *context)
+{
+    HeapFree(GetProcessHeap(), 0, WINE_RB_ENTRY_VALUE(entry, struct glsl_program_cache_entry, entry));
+}
+
+static int glsl_program_cache_compare_last_use(const void *a, const void *b)
+{
+    const struct glsl_program_cache_entry *e1 = *(struct glsl_program_cache_entry * const *)a;
+    const struct glsl_program_cache_entry *e2 = *(struct glsl_program_cache_entry * const *)b;
+
+    return e1->last_use < e2->last_use ? -1 : e1->last_use > e2->last_use;
+}
+
+static BOOL glsl_program_cache_is_tmp_file(const WCHAR *name)
+{
+    static const WCHAR tmpW[] = {'.','t','m','p',0};
+    unsigned int len = strlenW(name), prefix_len = ARRAY_SIZE(glsl_program_cache_tmp_prefixW) - 1;
+
+    return len > prefix_len + 4 && !memcmp(name, glsl_program_cache_tmp_prefixW, prefix_len * sizeof(*name))
+            && !strcmpiW(&name[len - 4], tmpW);
+}
+
+/* Rebuilds the entry list from the cache directory, which may be shared with
+ * other processes, using the file modification times as last use times.
+ * Stale temporary files are deleted along the way. Returns the number of
+ * entries found. */
+static unsigned int glsl_program_cache_scan(void)
+{
+    static const WCHAR patternW[] = {'*',0};
+    unsigned int len = glsl_program_cache.path_len, count = 0;
+    WCHAR *path = glsl_program_cache.path;
+    ULONGLONG now, last_write;
+    WIN32_FIND_DATAW data;
+    HANDLE find;
+    UINT64 key;
+
+    wine_rb_clear(&glsl_program_cache.entries, glsl_program_cache_free_entry, NULL);
+    glsl_program_cache.size = 0;
+
+    memcpy(&path[len], patternW, sizeof(patternW));
+    find = FindFirstFileW(path, &data);
+    path[len] = 0;
+    if (find == INVALID_HANDLE_VALUE)
+        return 0;
+
+    now = glsl_program_cache_get_time();
+    do
+    {
+        if (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+            continue;
+        last_write = ((ULONGLONG)data.ftLastWriteTime.dwHighDateTime << 32) | data.ftLastWriteTime.dwLowDateTime;
+
+        if (glsl_program_cache_parse_file_name(data.cFileName, &key))
+        {
+            if (data.nFileSizeHigh)
+                continue;
+            if (!glsl_program_cache_add(key, data.nFileSizeLow, last_write))
+                break;
+            ++count;
+        }
+        else if (glsl_program_cache_is_tmp_file(data.cFileName)
+                && last_write + WINED3D_PROGRAM_CACHE_TMP_AGE < now && len + strlenW(data.cFileName) < MAX_PATH)
+        {
+            TRACE("Deleting stale temporary file %s.\n", debugstr_w(data.cFileName));
+            strcpyW(&path[len], data.cFileName);
+            DeleteFileW(path);
+            path[len] = 0;
+        }
+    } while (FindNextFileW(find, &data));
+    FindClose(find);
+
+    return count;
+}
+
+/* Removes the least recently used entries from a freshly scanned cache until
+ * it fits in max_size. The entries are sorted once per pass. */
+static void glsl_program_cache_trim(unsigned int count, UINT64 max_size)
+{
+    struct glsl_program_cache_entry *entry, **entries;
+    unsigned int i = 0;
+
+    if (!count || glsl_program_cache.size <= max_size)
+        return;
+    if (!(entries = HeapAlloc(GetProcessHeap(), 0, count * sizeof(*entries))))
+        return;
+
+    WINE_RB_FOR_EACH_ENTRY(entry, &glsl_program_cache.entries, struct glsl_program_cache_entry, entry)
+    {
+        entries[i++] = entry;
+    }
+    qsort(entries, count, sizeof(*entries), glsl_program_cache_compare_last_use);
+
+    /* Leave some room, so that the next few stores don't each need a pass. */
+    max_size -= max_size / 8;
+    for (i = 0; i < count && glsl_program_cache.size > max_size; ++i)
+    {
+        TRACE("Evicting program %s, %u bytes.\n", wine_dbgstr_longlong(entries[i]->key), entries[i]->size);
+        glsl_program_cache_remove(entries[i]);
+        ++glsl_program_cache.evictions;
+    }
+
+    HeapFree(GetProcessHeap(), 0, entries);
+}
+
+static void glsl_program_cache_evict(UINT64 max_size)
+{
+    if (glsl_program_cache.size <= max_size)
+        return;
+    glsl_program_cache_trim(glsl_program_cache_scan(), max_size);
+}
+
+static BOOL glsl_program_cache_get_path(WCHAR *path, unsigned int size)
+{
+    static const WCHAR localappdataW[] = {'L','O','C','A','L','A','P','P','D','A','T','A',0};
+    static const WCHAR subdirW[] = {'\\','w','i','n','e','\\','s','h','a','d','e','r','_','c','a','c','h','e',0};
+    unsigned int len;
+
+    if (wined3d_settings.shader_cache_path)
+    {
+        if (!(len = MultiByteToWideChar(CP_ACP, 0, wined3d_settings.shader_cache_path, -1, path, size)))
+            return FALSE;
+        return len > 1;
+    }
+
+    if (!(len = GetEnvironmentVariableW(localappdataW, path, size)) || len + ARRAY_SIZE(subdirW) > size)
+        return FALSE;
+    memcpy(&path[len], subdirW, sizeof(subdirW));
+
+    return TRUE;
+}
+
+static void glsl_program_cache_init(void)
+{
+    unsigned int len, count;
+    WCHAR *path, *ptr;
+
+    glsl_program_cache.initialized = TRUE;
+    wine_rb_init(&glsl_program_cache.entries, glsl_program_cache_compare);
+
+    path = glsl_program_cache.path;
+    if (!wined3d_settings.shader_cache_size || !glsl_program_cache_get_path(path, MAX_PATH - 24))
+    {
+        TRACE("Program cache disabled.\n");
+        return;
+    }
+
+    len = strlenW(path);
+    if (path[len - 1] != '\\' && path[len - 1] != '/')
+        path[len++] = '\\';
+    path[len] = 0;
+
+    /* Create any missing parent directories as well. */
+    for (ptr = path + 1; *ptr; ++ptr)
+    {
+        if ((*ptr == '\\' || *ptr == '/') && ptr[-1] != ':')
+        {
+            WCHAR c = *ptr;
+
+            *ptr = 0;
+            CreateDirectoryW(path, NULL);
+            *ptr = c;
+        }
+    }
+    if (GetFileAttributesW(path) == INVALID_FILE_ATTRIBUTES)
+    {
+        WARN("Failed to create program cache directory %s.\n", debugstr_w(path));
+        return;
+    }
+
+    glsl_program_cache.path_len = len;
+    glsl_program_cache.max_size = (UINT64)wined3d_settings.shader_cache_size * 1024 * 1024;
+    glsl_program_cache.enabled = TRUE;
+
+    count = glsl_program_cache_scan();
+    TRACE("Using program cache %s, %s bytes in use.\n",
+            debugstr_w(path), wine_dbgstr_longlong(glsl_program_cache.size));
+    glsl_program_cache_trim(count, glsl_program_cache.max_size);
+}
+
+static BOOL glsl_program_cache_enabled(void)
+{
+    BOOL enabled;
+
+    EnterCriticalSection(&glsl_program_cache_cs);
+    if (!glsl_program_cache.initialized)
+        glsl_program_cache_init();
+    enabled = glsl_program_cache.enabled;
+    LeaveCriticalSection(&glsl_program_cache_cs);
+
+    return enabled;
+}
+
+/* Context activation is done by the caller. */
+static BOOL glsl_program_cache_load(const struct wined3d_gl_info *gl_info, GLuint program_id, UINT64 key)
+{
+    struct glsl_program_cache_header header;
+    struct glsl_program_cache_entry *entry = NULL;
+    WCHAR name[MAX_PATH + 24];
+    struct wine_rb_entry *e;
+    BOOL ret = FALSE;
+    void *data = NULL;
+    FILETIME ft;
+    HANDLE file = INVALID_HANDLE_VALUE;
+    DWORD size;
+    GLint tmp;
+
+    EnterCriticalSection(&glsl_program_cache_cs);
+
+    if (!(e = wine_rb_get(&glsl_program_cache.entries, &key)))
+    {
+        ++glsl_program_cache.misses;
+        goto done;
+    }
+    entry = WINE_RB_ENTRY_VALUE(e, struct glsl_program_cache_entry, entry);
+
+    file = CreateFileW(glsl_program_cache_get_file_name(key, name), GENERIC_READ | FILE_WRITE_ATTRIBUTES,
+            FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, 0, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        goto done;
+
+    if (!ReadFile(file, &header, sizeof(header), &size, NULL) || size != sizeof(header)
+            || header.magic != WINED3D_PROGRAM_CACHE_MAGIC || header.version != WINED3D_PROGRAM_CACHE_VERSION
+            || header.key != key || GetFileSize(file, NULL) != sizeof(header) + header.size)
+        goto done;
+
+    if (!(data = HeapAlloc(GetProcessHeap(), 0, header.size)))
+        goto done;
+    if (!ReadFile(file, data, header.size, &size, NULL) || size != header.size
+            || glsl_program_cache_hash(WINED3D_PROGRAM_CACHE_HASH_INIT, data, size) != header.checksum)
+        goto done;
+
+    GL_EXTCALL(glProgramBinary(program_id, header.format, data, header.size));
+    GL_EXTCALL(glGetProgramiv(program_id, GL_LINK_STATUS, &tmp));
+    checkGLcall("glProgramBinary");
+    if (!tmp)
+        goto done;
+
+    /* Keep the file modification time as the last use time, so that the
+     * eviction order survives across runs. */
+    entry->last_use = glsl_program_cache_get_time();
+    ft.dwLowDateTime = (DWORD)entry->last_use;
+    ft.dwHighDateTime = entry->last_use >> 32;
+    SetFileTime(file, NULL, NULL, &ft);
+
+    TRACE("Loaded program %u from cache entry %s.\n", program_id, wine_dbgstr_longlong(key));
+    ++glsl_program_cache.hits;
+    ret = TRUE;
+
+done:
+    if (file != INVALID_HANDLE_VALUE)
+        CloseHandle(file);
+    HeapFree(GetProcessHeap(), 0, data);
+    if (!ret && entry)
+    {
+        WARN("Discarding invalid program cache entry %s.\n", wine_dbgstr_longlong(key));
+        glsl_program_cache_remove(entry);
+        ++glsl_program_cache.rejects;
+        ++glsl_program_cache.misses;
+    }
+    if (!((glsl_program_cache.hits + glsl_program_cache.misses) % 256))
+        glsl_program_cache_dump_stats();
+    LeaveCriticalSection(&glsl_program_cache_cs);
+
+    return ret;
+}
+
+/* Context activation is done by the caller. */
+static void glsl_program_cache_store(const struct wined3d_gl_info *gl_info, GLuint program_id, UINT64 key)
+{
+    struct glsl_program_cache_header *header;
+    WCHAR name[MAX_PATH + 24], tmp_name[MAX_PATH];
+    GLint status, length;
+    GLsizei size;
+    HANDLE file;
+    DWORD written;
+    BOOL ret;
+
+    GL_EXTCALL(glGetProgramiv(program_id, GL_LINK_STATUS, &status));
+    GL_EXTCALL(glGetProgramiv(program_id, GL_PROGRAM_BINARY_LENGTH, &length));
+    checkGLcall("glGetProgramiv");
+    if (!status || length <= 0)
+        return;
+
+    if (!(header = HeapAlloc(GetProcessHeap(), 0, sizeof(*header) + length)))
+        return;
+
+    GL_EXTCALL(glGetProgramBinary(program_id, length, &size, &header->format, header + 1));
+    checkGLcall("glGetProgramBinary");
+    if (size <= 0 || size > length)
+    {
+        HeapFree(GetProcessHeap(), 0, header);
+        return;
+    }
+    header->magic = WINED3D_PROGRAM_CACHE_MAGIC;
+    header->version = WINED3D_PROGRAM_CACHE_VERSION;
+    header->key = key;
+    header->size = size;
+    header->checksum = glsl_program_cache_hash(WINED3D_PROGRAM_CACHE_HASH_INIT, header + 1, size);
+
+    EnterCriticalSection(&glsl_program_cache_cs);
+
+    if (sizeof(*header) + size > glsl_program_cache.max_size)
+        goto done;
+
+    /* Write to a temporary file and rename it into place, so that neither
+     * a crash nor a concurrent writer can leave a partial entry behind. */
+    if (!GetTempFileNameW(glsl_program_cache.path, glsl_program_cache_tmp_prefixW, 0, tmp_name))
+        goto done;
+    file = CreateFileW(tmp_name, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, 0, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        DeleteFileW(tmp_name);
+        goto done;
+    }
+    ret = WriteFile(file, header, sizeof(*header) + size, &written, NULL) && written == sizeof(*header) + size;
+    CloseHandle(file);
+    if (!ret || !MoveFileExW(tmp_name, glsl_program_cache_get_file_name(key, name), MOVEFILE_REPLACE_EXISTING))
+    {
+        WARN("Failed to write program cache entry %s.\n", wine_dbgstr_longlong(key));
+        DeleteFileW(tmp_name);
+        goto done;
+    }
+
+    if (glsl_program_cache_add(key, sizeof(*header) + size, glsl_program_cache_get_time()))
+    {
+        TRACE("Stored program %u as cache entry %s, %d bytes.\n", program_id, wine_dbgstr_longlong(key), size);
+        ++glsl_program_cache.stores;
+        glsl_program_cache_evict(glsl_program_cache.max_size);
+    }
+
+done:
+    LeaveCriticalSection(&glsl_program_cache_cs);
+    HeapFree(GetProcessHeap(), 0, header);
+}
+
+/* Context activation is done by the caller. */
+static UINT64 shader_glsl_get_program_cache_key(const struct wined3d_gl_info *gl_info,
+        struct shader_glsl_priv *priv, GLuint program_id, UINT64 link_state)
+{
+    GLint i, j, shader_count, source_size = 0;
+    UINT64 hash, shader_hashes[8];
+    char *source = NULL;
+    GLuint shaders[8];
+
+    if (!priv->program_cache_seed)
+    {
+        static const GLenum names[] = {GL_VENDOR, GL_RENDERER, GL_VERSION, GL_SHADING_LANGUAGE_VERSION_ARB};
+        static const char build[] = PACKAGE_VERSION;
+        const char *str;
+
+        hash = glsl_program_cache_hash(WINED3D_PROGRAM_CACHE_HASH_INIT, build, sizeof(build));
+        for (i = 0; i < ARRAY_SIZE(names); ++i)
+        {
+            if ((str = (const char *)gl_info->gl_ops.gl.p_glGetString(names[i])))
+                hash = glsl_program_cache_hash(hash, str, strlen(str) + 1);
+        }
+        priv->program_cache_seed = hash;
+    }
+
+    GL_EXTCALL(glGetAttachedShaders(program_id, ARRAY_SIZE(shaders), &shader_count, shaders));
+    for (i = 0; i < shader_count; ++i)
+    {
+        GLint type, length;
+
+        GL_EXTCALL(glGetShaderiv(shaders[i], GL_SHADER_TYPE, &type));
+        GL_EXTCALL(glGetShaderiv(shaders[i], GL_SHADER_SOURCE_LENGTH, &length));
+        if (length > source_size)
+        {
+            HeapFree(GetProcessHeap(), 0, source);
+            if (!(source = HeapAlloc(GetProcessHeap(), 0, length)))
+            {
+                ERR("Failed to allocate %d bytes for shader source.\n", length);
+                return 0;
+            }
+            source_size = length;
+        }
+        GL_EXTCALL(glGetShaderSource(shaders[i], source_size, &length, source));
+
+        hash = glsl_program_cache_hash(WINED3D_PROGRAM_CACHE_HASH_INIT, &type, sizeof(type));
+        hash = glsl_program_cache_hash(hash, source, length);
+
+        /* The order in which attached shaders are returned is unspecified. */
+        for (j = i; j > 0 && shader_hashes[j - 1] > hash; --j)
+            shader_hashes[j] = shader_hashes[j - 1];
+        shader_hashes[j] = hash;
+    }
+    checkGLcall("get shader sources");
+    HeapFree(GetProcessHeap(), 0, source);
+
+    hash = glsl_program_cache_hash(priv->program_cache_seed, &link_state, sizeof(link_state));
+    return glsl_program_cache_hash(hash, shader_hashes, shader_count * sizeof(*shader_hashes));
+}
+
+static UINT64 shader_glsl_hash_stream_output(UINT64 hash, const struct wined3d_stream_output_desc *so_desc)
+{
+    const struct wined3d_stream_output_element *e;
+    unsigned int i, data[5];
+
+    for (i = 0; i < so_desc->element_count; ++i)
+    {
+        e = &so_desc->elements[i];
+        data[0] = e->stream_idx;
+        data[1] = e->register_idx;
+        data[2] = e->component_idx;
+        data[3] = e->component_count;
+        data[4] = e->output_slot;
+        hash = glsl_program_cache_hash(hash, data, sizeof(data));
+    }
+
+    return hash;
+}
+
+/* Context activation is done by the caller. */
+static void shader_glsl_link_program(const struct wined3d_gl_info *gl_info,
+        struct shader_glsl_priv *priv, GLuint program_id, UINT64 link_state)
+{
+    BOOL use_cache = gl_info->supported[ARB_GET_PROGRAM_BINARY] && glsl_program_cache_enabled();
+    UINT64 key = 0;
+
+    if (use_cache)
+    {
+        if (!(key = shader_glsl_get_program_cache_key(gl_info, priv, program_id, link_state)))
+            use_cache = FALSE;
+        else if (glsl_program_cache_load(gl_info, program_id, key))
+            return;
+        else
+            GL_EXTCALL(glProgramParameteri(program_id, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE));
+    }
+
+    TRACE("Linking GLSL shader program %u.\n", program_id);
+    GL_EXTCALL(glLinkProgram(program_id));
+    shader_glsl_validate_link(gl_info, program_id);
+
+    if (use_cache)
+        glsl_program_cache_store(gl_info, program_id, key);
+}
+
 static BOOL shader_glsl_use_layout_qualifier(const struct wined3d_gl_info *gl_info)
 {
     /* Layout qualifiers were introduced in GLSL 1.40. The Nvidia Legacy GPU
@@ -9672,9 +10291,7 @@ static HRESULT shader_glsl_compile_compute_shader(struct shader_glsl_priv *priv,
 
     list_add_head(&shader->linked_programs, &entry->cs.shader_entry);
 
-    TRACE("Linking GLSL shader program %u.\n", program_id);
-    GL_EXTCALL(glLinkProgram(program_id));
-    shader_glsl_validate_link(gl_info, program_id);
+    shader_glsl_link_program(gl_info, priv, program_id, 0);
 
     GL_EXTCALL(glUseProgram(program_id));
     checkGLcall("glUseProgram");
@@ -9734,7 +10351,29 @@ static void set_glsl_compute_shader_program(const struct wined3d_context *contex
 }
 
 /* Context activation is done by the caller. */
-static void set_glsl_shader_program(const struct wined3d_context *context, const struct wined3d_state *state,
+static BOOL shader_glsl_program_shaders_ready(const struct wined3d_gl_info *gl_info,
+        const struct glsl_program_key *key)
+{
+    GLuint ids[] = {key->vs_id, key->hs_id, key->ds_id, key->gs_id, key->ps_id};
+    unsigned int i;
+    GLint status;
+
+    for (i = 0; i < ARRAY_SIZE(ids); ++i)
+    {
+        if (!ids[i])
+            continue;
+        GL_EXTCALL(glGetShaderiv(ids[i], GL_COMPLETION_STATUS_ARB, &status));
+        if (!status)
+            return FALSE;
+    }
+    checkGLcall("query shader completion status");
+
+    return TRUE;
+}
+
+/* Context activation is done by the caller. Returns FALSE if the program
+ * can't be linked yet, because its shaders are still being compiled. */
+static BOOL set_glsl_shader_program(const struct wined3d_context *context, const struct wined3d_state *state,
         struct shader_glsl_priv *priv, struct glsl_context_data *ctx_data)
 {
     const struct wined3d_gl_info *gl_info = context->gl_info;
@@ -9756,6 +10395,7 @@ static void set_glsl_shader_program(const struct wined3d_context *context, const
     struct list *ps_list = NULL, *vs_list = NULL;
     WORD attribs_map;
     struct wined3d_string_buffer *tmp_name;
+    UINT64 link_state;
 
     if (!(context->shader_update_mask & (1u << WINED3D_SHADER_TYPE_VERTEX)) && ctx_data->glsl_program)
     {
@@ -9856,7 +10496,14 @@ static void set_glsl_shader_program(const struct wined3d_context *context, const
     if ((!vs_id && !hs_id && !ds_id && !gs_id && !ps_id) || (entry = get_glsl_program_entry(priv, &key)))
     {
         ctx_data->glsl_program = entry;
-        return;
+        return TRUE;
+    }
+
+    if (wined3d_settings.async_shaders == WINED3D_ASYNC_SHADERS_SKIP_DRAW
+            && shader_glsl_use_parallel_compile(gl_info) && !shader_glsl_program_shaders_ready(gl_info, &key))
+    {
+        TRACE("Shaders for program %u/%u/%u/%u/%u are not ready yet.\n", vs_id, hs_id, ds_id, gs_id, ps_id);
+        return FALSE;
     }
 
     /* If we get to this point, then no matching program exists, so we create one */
@@ -9912,6 +10559,16 @@ static void set_glsl_shader_program(const struct wined3d_context *context, const
         attribs_map = (1u << WINED3D_FFP_ATTRIBS_COUNT) - 1;
     }
 
+    /* Attribute, fragment data and transform feedback bindings aren't part
+     * of the shader sources, but are baked into the program binary. */
+    link_state = attribs_map;
+    if (!shader_glsl_use_explicit_attrib_location(gl_info))
+        link_state |= 1u << 16;
+    if (ps_id && state_is_dual_source_blend(state))
+        link_state |= 1u << 17;
+    if (gshader)
+        link_state = shader_glsl_hash_stream_output(link_state, &gshader->u.gs.so_desc);
+
     if (!shader_glsl_use_explicit_attrib_location(gl_info))
     {
         /* Bind vertex attributes to a corresponding index number to match
@@ -9997,9 +10654,7 @@ static void set_glsl_shader_program(const struct wined3d_context *context, const
     }
 
     /* Link the program */
-    TRACE("Linking GLSL shader program %u.\n", program_id);
-    GL_EXTCALL(glLinkProgram(program_id));
-    shader_glsl_validate_link(gl_info, program_id);
+    shader_glsl_link_program(gl_info, priv, program_id, link_state);
 
     shader_glsl_init_vs_uniform_locations(gl_info, priv, program_id, &entry->vs,
             vshader ? vshader->limits->constant_float : 0);
@@ -10143,11 +10798,15 @@ static void set_glsl_shader_program(const struct wined3d_context *context, const
         if (entry->ps.color_key_location != -1)
             entry->constant_update_mask |= WINED3D_SHADER_CONST_FFP_COLOR_KEY;
     }
+
+    return TRUE;
 }
 
 static void shader_glsl_precompile(void *shader_priv, struct wined3d_shader *shader)
 {
     struct wined3d_device *device = shader->device;
+    const struct wined3d_state *state = &device->cs->state;
+    struct shader_glsl_priv *priv = shader_priv;
     struct wined3d_context *context;
 
     if (shader->reg_maps.shader_version.type == WINED3D_SHADER_TYPE_COMPUTE)
@@ -10155,7 +10814,84 @@ static void shader_glsl_precompile(void *shader_priv, struct wined3d_shader *sha
         context = context_acquire(device, NULL, 0);
         shader_glsl_compile_compute_shader(shader_priv, context, shader);
         context_release(context);
+        return;
     }
+
+    if (!device->context_count || !shader_glsl_use_parallel_compile(&device->adapter->gl_info))
+        return;
+
+    /* Only guess a variant from state that a draw would have too. The domain
+     * shader variant depends on the bound hull shader, the vertex and pixel
+     * shader variants on the vertex declaration. */
+    switch (shader->reg_maps.shader_version.type)
+    {
+        case WINED3D_SHADER_TYPE_DOMAIN:
+            if (!state->shader[WINED3D_SHADER_TYPE_HULL])
+                return;
+            break;
+
+        case WINED3D_SHADER_TYPE_VERTEX:
+        case WINED3D_SHADER_TYPE_PIXEL:
+            if (!state->vertex_declaration)
+                return;
+            break;
+
+        default:
+            break;
+    }
+
+    /* Start compiling the variant for the current state right away. The
+     * driver compiles it in the background, and the draw that needs it only
+     * has to wait for whatever is left of the compile. */
+    context = context_acquire(device, NULL, 0);
+    switch (shader->reg_maps.shader_version.type)
+    {
+        case WINED3D_SHADER_TYPE_VERTEX:
+        {
+            struct vs_compile_args args;
+
+            find_vs_compile_args(state, shader, context->stream_info.swizzle_map, &args, context->d3d_info);
+            find_glsl_vshader(context, priv, shader, &args);
+            break;
+        }
+
+        case WINED3D_SHADER_TYPE_HULL:
+            find_glsl_hull_shader(context, priv, shader);
+            break;
+
+        case WINED3D_SHADER_TYPE_DOMAIN:
+        {
+            struct ds_compile_args args;
+
+            find_ds_compile_args(state, shader, &args, context);
+            find_glsl_domain_shader(context, priv, shader, &args);
+            break;
+        }
+
+        case WINED3D_SHADER_TYPE_GEOMETRY:
+        {
+            struct gs_compile_args args;
+
+            find_gs_compile_args(state, shader, &args);
+            find_glsl_geometry_shader(context, priv, shader, &args);
+            break;
+        }
+
+        case WINED3D_SHADER_TYPE_PIXEL:
+        {
+            const struct ps_np2fixup_info *np2fixup_info;
+            struct ps_compile_args args;
+
+            find_ps_compile_args(state, shader, context->stream_info.position_transformed, &args, context);
+            find_glsl_pshader(context, &priv->shader_buffer, &priv->string_buffers,
+                    shader, &args, &np2fixup_info);
+            break;
+        }
+
+        default:
+            break;
+    }
+    context_release(context);
 }
 
 /* Context activation is done by the caller. */
@@ -10173,7 +10909,11 @@ static void shader_glsl_select(void *shader_priv, struct wined3d_context *contex
 
     prev_id = ctx_data->glsl_program ? ctx_data->glsl_program->id : 0;
 
-    set_glsl_shader_program(context, state, priv, ctx_data);
+    if (!set_glsl_shader_program(context, state, priv, ctx_data))
+    {
+        context->shaders_pending = 1;
+        return;
+    }
 
     if (ctx_data->glsl_program)
     {
@@ -10603,6 +11343,11 @@ static void shader_glsl_free(struct wined3d_device *device)
 {
     struct shader_glsl_priv *priv = device->shader_priv;
 
+    EnterCriticalSection(&glsl_program_cache_cs);
+    if (glsl_program_cache.enabled)
+        glsl_program_cache_dump_stats();
+    LeaveCriticalSection(&glsl_program_cache_cs);
+
     wine_rb_destroy(&priv->program_lookup, NULL, NULL);
     constant_heap_free(&priv->pconst_heap);
     constant_heap_free(&priv->vconst_heap);
@@ -10637,6 +11382,12 @@ static void shader_glsl_init_context_state(struct wined3d_context *context)
 
     gl_info->gl_ops.gl.p_glEnable(GL_PROGRAM_POINT_SIZE);
     checkGLcall("GL_PROGRAM_POINT_SIZE");
+
+    if (shader_glsl_use_parallel_compile(gl_info))
+    {
+        GL_EXTCALL(glMaxShaderCompilerThreadsARB(~0u));
+        checkGLcall("glMaxShaderCompilerThreadsARB");
+    }
 }
 
 static unsigned int shader_glsl_get_shader_model(const struct wined3d_gl_info *gl_info)
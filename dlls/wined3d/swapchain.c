@@ -25,6 +25,7 @@
 #include "wined3d_private.h"
 
 WINE_DEFAULT_DEBUG_CHANNEL(d3d);
+WINE_DECLARE_DEBUG_CHANNEL(d3d_perf);
 WINE_DECLARE_DEBUG_CHANNEL(fps);
 
 static void wined3d_swapchain_destroy_object(void *object)
@@ -511,6 +512,18 @@ static void swapchain_gl_present(struct wined3d_swapchain *swapchain,
         }
     }
 
+    if (TRACE_ON(d3d_perf) && swapchain->device->shader_stall_count)
+    {
+        struct wined3d_device *device = swapchain->device;
+        LARGE_INTEGER freq;
+
+        QueryPerformanceFrequency(&freq);
+        TRACE_(d3d_perf)("%p: %.3f ms in %u shader selections this frame.\n", swapchain,
+                1000.0 * device->shader_stall_time / freq.QuadPart, device->shader_stall_count);
+        device->shader_stall_time = 0;
+        device->shader_stall_count = 0;
+    }
+
     wined3d_texture_validate_location(swapchain->front_buffer, 0, WINED3D_LOCATION_DRAWABLE);
     wined3d_texture_invalidate_location(swapchain->front_buffer, 0, ~WINED3D_LOCATION_DRAWABLE);
     /* If the swapeffect is DISCARD, the back buffer is undefined. That means the SYSMEM
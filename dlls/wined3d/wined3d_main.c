@@ -94,6 +94,9 @@ struct wined3d_settings wined3d_settings =
     ~0U,            /* No PS shader model limit by default. */
     ~0u,            /* No CS shader model limit by default. */
     FALSE,          /* 3D support enabled by default. */
+    NULL,           /* Shader cache in the default location. */
+    256,            /* 256 MiB of cached shader programs. */
+    WINED3D_ASYNC_SHADERS_ENABLED, /* Compile shaders in the background where supported. */
 };
 
 struct wined3d * CDECL wined3d_create(DWORD flags)
@@ -323,6 +326,18 @@ static BOOL wined3d_dll_init(HINSTANCE hInstDLL)
             TRACE("Disabling 3D support.\n");
             wined3d_settings.no_3d = TRUE;
         }
+        if (!get_config_key(hkey, appkey, "ShaderCachePath", buffer, size))
+        {
+            size_t len = strlen(buffer) + 1;
+
+            wined3d_settings.shader_cache_path = HeapAlloc(GetProcessHeap(), 0, len);
+            if (!wined3d_settings.shader_cache_path) ERR("Failed to allocate shader cache path memory.\n");
+            else memcpy(wined3d_settings.shader_cache_path, buffer, len);
+        }
+        if (!get_config_key_dword(hkey, appkey, "ShaderCacheSize", &wined3d_settings.shader_cache_size))
+            TRACE("Limiting shader cache size to %u MiB.\n", wined3d_settings.shader_cache_size);
+        if (!get_config_key_dword(hkey, appkey, "AsyncShaderCompile", &wined3d_settings.async_shaders))
+            TRACE("Setting asynchronous shader compilation to %#x.\n", wined3d_settings.async_shaders);
     }
 
     if (appkey) RegCloseKey( appkey );
@@ -357,6 +372,7 @@ static BOOL wined3d_dll_destroy(HINSTANCE hInstDLL)
     HeapFree(GetProcessHeap(), 0, wndproc_table.entries);
 
     HeapFree(GetProcessHeap(), 0, wined3d_settings.logo);
+    HeapFree(GetProcessHeap(), 0, wined3d_settings.shader_cache_path);
     UnregisterClassA(WINED3D_OPENGL_WINDOW_CLASS_NAME, hInstDLL);
 
     DeleteCriticalSection(&wined3d_wndproc_cs);
@@ -373,6 +373,10 @@ static inline void wined3d_pause(void)
 #define ORM_BACKBUFFER  0
 #define ORM_FBO         1
 
+#define WINED3D_ASYNC_SHADERS_DISABLED  0
+#define WINED3D_ASYNC_SHADERS_ENABLED   1
+#define WINED3D_ASYNC_SHADERS_SKIP_DRAW 2
+
 #define PCI_VENDOR_NONE 0xffff /* e.g. 0x8086 for Intel and 0x10de for Nvidia */
 #define PCI_DEVICE_NONE 0xffff /* e.g. 0x14f for a Geforce6200 */
 
@@ -399,6 +403,9 @@ struct wined3d_settings
     unsigned int max_sm_ps;
     unsigned int max_sm_cs;
     BOOL no_3d;
+    char *shader_cache_path;
+    unsigned int shader_cache_size;
+    unsigned int async_shaders;
 };
 
 extern struct wined3d_settings wined3d_settings DECLSPEC_HIDDEN;
@@ -907,19 +914,6 @@ enum WINED3D_SHADER_INSTRUCTION_HANDLER
     WINED3DSIH_TABLE_SIZE
 };
 
-enum wined3d_shader_type
-{
-    WINED3D_SHADER_TYPE_PIXEL,
-    WINED3D_SHADER_TYPE_VERTEX,
-    WINED3D_SHADER_TYPE_GEOMETRY,
-    WINED3D_SHADER_TYPE_HULL,
-    WINED3D_SHADER_TYPE_DOMAIN,
-    WINED3D_SHADER_TYPE_GRAPHICS_COUNT,
-
-    WINED3D_SHADER_TYPE_COMPUTE = WINED3D_SHADER_TYPE_GRAPHICS_COUNT,
-    WINED3D_SHADER_TYPE_COUNT,
-};
-
 struct wined3d_shader_version
 {
     enum wined3d_shader_type type;
@@ -1835,7 +1829,8 @@ struct wined3d_context
     DWORD destroy_delayed : 1;
     DWORD transform_feedback_active : 1;
     DWORD transform_feedback_paused : 1;
-    DWORD padding : 7;
+    DWORD shaders_pending : 1;
+    DWORD padding : 6;
     DWORD last_swizzle_map; /* MAX_ATTRIBS, 16 */
     DWORD shader_update_mask;
     DWORD constant_update_mask;
@@ -2872,6 +2867,13 @@ struct wined3d_device
     struct wined3d_sampler *default_sampler;
     struct wined3d_sampler *null_sampler;
 
+    /* Ring buffer for DISCARD maps of dynamic buffers */
+    struct wined3d_streaming_buffer *streaming_buffer;
+
+    /* Time spent in shader selection during the current frame */
+    LONGLONG shader_stall_time;
+    unsigned int shader_stall_count;
+
     /* Command stream */
     struct wined3d_cs *cs;
 
@@ -3433,6 +3435,8 @@ struct wined3d_cs
     HANDLE event;
     BOOL waiting_for_event;
     LONG pending_presents;
+
+    struct wined3d_cs_stats *stats;
 };
 
 struct wined3d_cs *wined3d_cs_create(struct wined3d_device *device) DECLSPEC_HIDDEN;
@@ -3468,6 +3472,8 @@ void wined3d_cs_emit_set_color_key(struct wined3d_cs *cs, struct wined3d_texture
         WORD flags, const struct wined3d_color_key *color_key) DECLSPEC_HIDDEN;
 void wined3d_cs_emit_set_constant_buffer(struct wined3d_cs *cs, enum wined3d_shader_type type,
         UINT cb_idx, struct wined3d_buffer *buffer) DECLSPEC_HIDDEN;
+void wined3d_cs_emit_set_constant_buffers(struct wined3d_cs *cs, enum wined3d_shader_type type,
+        unsigned int start_idx, unsigned int count, struct wined3d_buffer *const *buffers) DECLSPEC_HIDDEN;
 void wined3d_cs_emit_set_depth_stencil_view(struct wined3d_cs *cs,
         struct wined3d_rendertarget_view *view) DECLSPEC_HIDDEN;
 void wined3d_cs_emit_set_index_buffer(struct wined3d_cs *cs, struct wined3d_buffer *buffer,
@@ -3485,8 +3491,12 @@ void wined3d_cs_emit_set_rendertarget_view(struct wined3d_cs *cs, unsigned int v
         struct wined3d_rendertarget_view *view) DECLSPEC_HIDDEN;
 void wined3d_cs_emit_set_shader_resource_view(struct wined3d_cs *cs, enum wined3d_shader_type type,
         UINT view_idx, struct wined3d_shader_resource_view *view) DECLSPEC_HIDDEN;
+void wined3d_cs_emit_set_shader_resource_views(struct wined3d_cs *cs, enum wined3d_shader_type type,
+        unsigned int start_idx, unsigned int count, struct wined3d_shader_resource_view *const *views) DECLSPEC_HIDDEN;
 void wined3d_cs_emit_set_sampler(struct wined3d_cs *cs, enum wined3d_shader_type type,
         UINT sampler_idx, struct wined3d_sampler *sampler) DECLSPEC_HIDDEN;
+void wined3d_cs_emit_set_samplers(struct wined3d_cs *cs, enum wined3d_shader_type type,
+        unsigned int start_idx, unsigned int count, struct wined3d_sampler *const *samplers) DECLSPEC_HIDDEN;
 void wined3d_cs_emit_set_sampler_state(struct wined3d_cs *cs, UINT sampler_idx,
         enum wined3d_sampler_state state, DWORD value) DECLSPEC_HIDDEN;
 void wined3d_cs_emit_set_scissor_rect(struct wined3d_cs *cs, const RECT *rect) DECLSPEC_HIDDEN;
@@ -3512,6 +3522,8 @@ void wined3d_cs_emit_unload_resource(struct wined3d_cs *cs, struct wined3d_resou
 void wined3d_cs_emit_update_sub_resource(struct wined3d_cs *cs, struct wined3d_resource *resource,
         unsigned int sub_resource_idx, const struct wined3d_box *box, const void *data, unsigned int row_pitch,
         unsigned int slice_pitch) DECLSPEC_HIDDEN;
+void wined3d_cs_emit_upload_streaming(struct wined3d_cs *cs, struct wined3d_buffer *buffer,
+        unsigned int offset, unsigned int end) DECLSPEC_HIDDEN;
 void wined3d_cs_init_object(struct wined3d_cs *cs,
         void (*callback)(void *object), void *object) DECLSPEC_HIDDEN;
 HRESULT wined3d_cs_map(struct wined3d_cs *cs, struct wined3d_resource *resource, unsigned int sub_resource_idx,
@@ -3551,6 +3563,41 @@ struct wined3d_map_range
     UINT size;
 };
 
+/* A persistently mapped ring buffer that DISCARD maps of dynamic buffers are
+ * served from. The application thread allocates from "head", the CS thread
+ * copies the data to the destination buffers and advances "tail" once the
+ * fences covering the copies have signalled. Nothing past the oldest slice
+ * that is still mapped is fenced, so "tail" never overtakes it. */
+#define WINED3D_STREAMING_BUFFER_SIZE   (16 * 1024 * 1024)
+#define WINED3D_STREAMING_FENCE_COUNT   16
+
+struct wined3d_streaming_fence
+{
+    GLsync sync;
+    unsigned int position;
+};
+
+struct wined3d_streaming_buffer
+{
+    GLuint buffer_object;
+    BYTE *map_ptr;
+    unsigned int size;
+
+    unsigned int head;
+    LONG tail;
+    struct list mapped; /* buffers with a mapped slice, oldest first; application thread only */
+
+    unsigned int submitted, fenced;
+    struct wined3d_streaming_fence fences[WINED3D_STREAMING_FENCE_COUNT];
+    unsigned int first_fence, fence_count;
+};
+
+struct wined3d_streaming_buffer *wined3d_streaming_buffer_create(struct wined3d_context *context) DECLSPEC_HIDDEN;
+void wined3d_streaming_buffer_destroy(struct wined3d_streaming_buffer *stream,
+        struct wined3d_context *context) DECLSPEC_HIDDEN;
+void wined3d_streaming_buffer_poll(struct wined3d_streaming_buffer *stream,
+        struct wined3d_context *context, BOOL force) DECLSPEC_HIDDEN;
+
 struct wined3d_buffer
 {
     struct wined3d_resource resource;
@@ -3575,6 +3622,11 @@ struct wined3d_buffer
     UINT stride;                                            /* 0 if no conversion */
     enum wined3d_buffer_conversion_type *conversion_map;    /* NULL if no conversion */
     UINT conversion_stride;                                 /* 0 if no shifted conversion */
+
+    /* DISCARD map served from the streaming buffer, application thread only */
+    BYTE *stream_ptr;
+    unsigned int stream_offset, stream_start;
+    struct list stream_entry;
 };
 
 static inline struct wined3d_buffer *buffer_from_resource(struct wined3d_resource *resource)
@@ -3594,6 +3646,11 @@ HRESULT wined3d_buffer_copy(struct wined3d_buffer *dst_buffer, unsigned int dst_
         struct wined3d_buffer *src_buffer, unsigned int src_offset, unsigned int size) DECLSPEC_HIDDEN;
 HRESULT wined3d_buffer_upload_data(struct wined3d_buffer *buffer,
         const struct wined3d_box *box, const void *data) DECLSPEC_HIDDEN;
+BOOL wined3d_buffer_map_streaming(struct wined3d_buffer *buffer, struct wined3d_map_desc *map_desc,
+        const struct wined3d_box *box, DWORD flags) DECLSPEC_HIDDEN;
+BOOL wined3d_buffer_unmap_streaming(struct wined3d_buffer *buffer) DECLSPEC_HIDDEN;
+void wined3d_buffer_upload_streaming(struct wined3d_buffer *buffer, struct wined3d_context *context,
+        unsigned int offset) DECLSPEC_HIDDEN;
 
 struct wined3d_rendertarget_view
 {
@@ -1137,15 +1137,19 @@ typedef struct _KUSER_SHARED_DATA {
     BOOLEAN SafeBootMode;
     ULONG TraceLogging;
     ULONGLONG TestRetInstruction;
+    LONGLONG QpcFrequency;
     ULONG SystemCall;
-    ULONG SystemCallReturn;
-    ULONGLONG SystemCallPad[3];
+    ULONG SystemCallPad0;
+    ULONGLONG SystemCallPad[2];
     union {
         volatile KSYSTEM_TIME TickCount;
         volatile ULONG64 TickCountQuad;
     } DUMMYUNIONNAME;
     ULONG Cookie;
     ULONG Wow64SharedInformation[MAX_WOW64_SHARED_ENTRIES];
+    ULONG Reserved4[15];
+    ULONGLONG InterruptTimeBias;
+    ULONGLONG QpcBias;
 } KSHARED_USER_DATA, *PKSHARED_USER_DATA;
 
 typedef enum _MEMORY_CACHING_TYPE {
@@ -53,11 +53,14 @@ struct request_max_size
 #define FIRST_USER_HANDLE 0x0020
 #define LAST_USER_HANDLE  0xffef
 
+#define REGISTRY_SEQ_SLOTS 4096
+
 
 typedef struct
 {
     unsigned int last_input_time;
     unsigned int foreground_wnd_epoch;
+    unsigned int registry_seq[REGISTRY_SEQ_SLOTS];
 } shmglobal_t;
 
 
@@ -67,9 +70,51 @@ typedef struct
     user_handle_t   input_focus;
     user_handle_t   input_capture;
     user_handle_t   input_active;
+    int             input_seq;
+    int             input_valid;
+    unsigned int    wake_bits;
+    unsigned int    changed_bits;
+    int             keystate_lock;
+    int             cursor_x;
+    int             cursor_y;
+    unsigned int    cursor_change;
+    unsigned char   keystate[256];
+    unsigned char   shadow_keystate[256];
+    unsigned char   desktop_keystate[256];
 } shmlocal_t;
 
 
+typedef struct
+{
+    int          waiters;
+    unsigned int tid;
+    unsigned int count;
+    unsigned int max;
+    int          abandoned;
+    int          __pad[3];
+} esync_shm_t;
+
+#define ESYNC_SHM_SLOTS 65536
+
+
+typedef struct
+{
+    int                     state;
+    int                     __pad[15];
+    struct request_max_size header;
+} request_shm_t;
+
+#define REQUEST_SHM_IDLE      0
+#define REQUEST_SHM_PENDING   1
+#define REQUEST_SHM_WAITING   2
+#define REQUEST_SHM_DONE      3
+#define REQUEST_SHM_DEAD      4
+
+#define REQUEST_SHM_SIZE      0x10000
+#define REQUEST_SHM_DATA_SIZE (REQUEST_SHM_SIZE - sizeof(request_shm_t))
+#define REQUEST_SHM_CALL      0x7fffffff
+
+
 typedef union
 {
     int code;
@@ -1142,6 +1187,20 @@ struct close_handle_reply
 };
 
 
+struct close_handles_request
+{
+    struct request_header __header;
+    /* VARARG(handles,uints); */
+    char __pad_12[4];
+};
+struct close_handles_reply
+{
+    struct reply_header __header;
+    data_size_t  closed;
+    char __pad_12[4];
+};
+
+
 struct socket_cleanup_request
 {
     struct request_header __header;
@@ -1591,6 +1650,18 @@ struct get_shared_memory_reply
 
 
 
+struct get_request_shm_request
+{
+    struct request_header __header;
+    char __pad_12[4];
+};
+struct get_request_shm_reply
+{
+    struct reply_header __header;
+};
+
+
+
 struct flush_request
 {
     struct request_header __header;
@@ -2661,6 +2732,8 @@ struct get_key_value_reply
     struct reply_header __header;
     int          type;
     data_size_t  total;
+    unsigned int seq_slot;
+    unsigned int seq;
     /* VARARG(data,bytes); */
 };
 
@@ -2832,6 +2905,19 @@ struct get_timer_info_reply
 };
 
 
+struct get_tsc_frequency_request
+{
+    struct request_header __header;
+    char __pad_12[4];
+};
+struct get_tsc_frequency_reply
+{
+    struct reply_header __header;
+    unsigned int frequency;
+    char __pad_12[4];
+};
+
+
 
 struct get_thread_context_request
 {
@@ -5380,7 +5466,7 @@ struct set_completion_info_request
     obj_handle_t  handle;
     apc_param_t   ckey;
     obj_handle_t  chandle;
-    char __pad_28[4];
+    int           replace;
 };
 struct set_completion_info_reply
 {
@@ -5748,6 +5834,76 @@ struct resume_process_reply
 };
 
 
+
+struct get_esync_fd_request
+{
+    struct request_header __header;
+    obj_handle_t handle;
+};
+struct get_esync_fd_reply
+{
+    struct reply_header __header;
+    int          type;
+    unsigned int shm_idx;
+    unsigned int access;
+    char __pad_20[4];
+};
+enum esync_type
+{
+    ESYNC_NONE,
+    ESYNC_AUTO_EVENT,
+    ESYNC_MANUAL_EVENT,
+    ESYNC_SEMAPHORE,
+    ESYNC_MUTEX
+};
+
+
+
+struct esync_wake_request
+{
+    struct request_header __header;
+    obj_handle_t handle;
+};
+struct esync_wake_reply
+{
+    struct reply_header __header;
+};
+
+
+#define REQUEST_STATS_BUCKETS 16
+struct request_stats
+{
+    unsigned int     req;
+    unsigned int     count;
+    unsigned int     max_time;
+    unsigned int     shm_count;
+    unsigned __int64 total_time;
+    unsigned __int64 bytes_in;
+    unsigned __int64 bytes_out;
+    unsigned int     histogram[REQUEST_STATS_BUCKETS];
+};
+
+
+struct get_request_stats_request
+{
+    struct request_header __header;
+    unsigned int     flags;
+};
+struct get_request_stats_reply
+{
+    struct reply_header __header;
+    int              enabled;
+    char __pad_12[4];
+    timeout_t        elapsed;
+    unsigned int     count;
+    /* VARARG(stats,request_stats); */
+    char __pad_28[4];
+};
+#define REQUEST_STATS_ENABLE   0x01
+#define REQUEST_STATS_DISABLE  0x02
+#define REQUEST_STATS_RESET    0x04
+
+
 enum request
 {
     REQ_new_process,
@@ -5773,6 +5929,7 @@ enum request
     REQ_queue_apc,
     REQ_get_apc_result,
     REQ_close_handle,
+    REQ_close_handles,
     REQ_socket_cleanup,
     REQ_set_handle_info,
     REQ_dup_handle,
@@ -5800,6 +5957,7 @@ enum request
     REQ_get_handle_fd,
     REQ_get_directory_cache_entry,
     REQ_get_shared_memory,
+    REQ_get_request_shm,
     REQ_flush,
     REQ_lock_file,
     REQ_unlock_file,
@@ -5870,6 +6028,7 @@ enum request
     REQ_set_timer,
     REQ_cancel_timer,
     REQ_get_timer_info,
+    REQ_get_tsc_frequency,
     REQ_get_thread_context,
     REQ_set_thread_context,
     REQ_get_selector_entry,
@@ -6046,6 +6205,9 @@ enum request
     REQ_get_system_info,
     REQ_suspend_process,
     REQ_resume_process,
+    REQ_get_esync_fd,
+    REQ_esync_wake,
+    REQ_get_request_stats,
     REQ_NB_REQUESTS
 };
 
@@ -6076,6 +6238,7 @@ union generic_request
     struct queue_apc_request queue_apc_request;
     struct get_apc_result_request get_apc_result_request;
     struct close_handle_request close_handle_request;
+    struct close_handles_request close_handles_request;
     struct socket_cleanup_request socket_cleanup_request;
     struct set_handle_info_request set_handle_info_request;
     struct dup_handle_request dup_handle_request;
@@ -6103,6 +6266,7 @@ union generic_request
     struct get_handle_fd_request get_handle_fd_request;
     struct get_directory_cache_entry_request get_directory_cache_entry_request;
     struct get_shared_memory_request get_shared_memory_request;
+    struct get_request_shm_request get_request_shm_request;
     struct flush_request flush_request;
     struct lock_file_request lock_file_request;
     struct unlock_file_request unlock_file_request;
@@ -6173,6 +6337,7 @@ union generic_request
     struct set_timer_request set_timer_request;
     struct cancel_timer_request cancel_timer_request;
     struct get_timer_info_request get_timer_info_request;
+    struct get_tsc_frequency_request get_tsc_frequency_request;
     struct get_thread_context_request get_thread_context_request;
     struct set_thread_context_request set_thread_context_request;
     struct get_selector_entry_request get_selector_entry_request;
@@ -6349,6 +6514,9 @@ union generic_request
     struct get_system_info_request get_system_info_request;
     struct suspend_process_request suspend_process_request;
     struct resume_process_request resume_process_request;
+    struct get_esync_fd_request get_esync_fd_request;
+    struct esync_wake_request esync_wake_request;
+    struct get_request_stats_request get_request_stats_request;
 };
 union generic_reply
 {
@@ -6377,6 +6545,7 @@ union generic_reply
     struct queue_apc_reply queue_apc_reply;
     struct get_apc_result_reply get_apc_result_reply;
     struct close_handle_reply close_handle_reply;
+    struct close_handles_reply close_handles_reply;
     struct socket_cleanup_reply socket_cleanup_reply;
     struct set_handle_info_reply set_handle_info_reply;
     struct dup_handle_reply dup_handle_reply;
@@ -6404,6 +6573,7 @@ union generic_reply
     struct get_handle_fd_reply get_handle_fd_reply;
     struct get_directory_cache_entry_reply get_directory_cache_entry_reply;
     struct get_shared_memory_reply get_shared_memory_reply;
+    struct get_request_shm_reply get_request_shm_reply;
     struct flush_reply flush_reply;
     struct lock_file_reply lock_file_reply;
     struct unlock_file_reply unlock_file_reply;
@@ -6474,6 +6644,7 @@ union generic_reply
     struct set_timer_reply set_timer_reply;
     struct cancel_timer_reply cancel_timer_reply;
     struct get_timer_info_reply get_timer_info_reply;
+    struct get_tsc_frequency_reply get_tsc_frequency_reply;
     struct get_thread_context_reply get_thread_context_reply;
     struct set_thread_context_reply set_thread_context_reply;
     struct get_selector_entry_reply get_selector_entry_reply;
@@ -6650,8 +6821,11 @@ union generic_reply
     struct get_system_info_reply get_system_info_reply;
     struct suspend_process_reply suspend_process_reply;
     struct resume_process_reply resume_process_reply;
+    struct get_esync_fd_reply get_esync_fd_reply;
+    struct esync_wake_reply esync_wake_reply;
+    struct get_request_stats_reply get_request_stats_reply;
 };
 
-#define SERVER_PROTOCOL_VERSION 533
+#define SERVER_PROTOCOL_VERSION 542
 
 #endif /* __WINE_WINE_SERVER_PROTOCOL_H */
@@ -0,0 +1,524 @@
+/*
+ * Display the wineserver request statistics
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+#include "config.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ntstatus.h"
+#define WIN32_NO_STATUS
+#include "windef.h"
+#include "winbase.h"
+#include "winternl.h"
+#include "wine/server.h"
+
+static const char progname[] = "wineserverstat";
+
+/* ### make_requests begin ### */
+
+static const char * const req_names[REQ_NB_REQUESTS] =
+{
+    "new_process",
+    "get_new_process_info",
+    "new_thread",
+    "get_startup_info",
+    "init_process_done",
+    "init_thread",
+    "terminate_process",
+    "terminate_thread",
+    "get_process_info",
+    "get_process_vm_counters",
+    "set_process_info",
+    "get_thread_info",
+    "get_thread_times",
+    "set_thread_info",
+    "get_dll_info",
+    "suspend_thread",
+    "resume_thread",
+    "load_dll",
+    "init_system_dir",
+    "unload_dll",
+    "queue_apc",
+    "get_apc_result",
+    "close_handle",
+    "close_handles",
+    "socket_cleanup",
+    "set_handle_info",
+    "dup_handle",
+    "open_process",
+    "open_thread",
+    "select",
+    "create_event",
+    "event_op",
+    "query_event",
+    "open_event",
+    "create_keyed_event",
+    "open_keyed_event",
+    "create_mutex",
+    "release_mutex",
+    "open_mutex",
+    "query_mutex",
+    "create_semaphore",
+    "release_semaphore",
+    "query_semaphore",
+    "open_semaphore",
+    "create_file",
+    "open_file_object",
+    "alloc_file_handle",
+    "get_handle_unix_name",
+    "get_handle_fd",
+    "get_directory_cache_entry",
+    "get_shared_memory",
+    "get_request_shm",
+    "flush",
+    "lock_file",
+    "unlock_file",
+    "create_socket",
+    "accept_socket",
+    "accept_into_socket",
+    "reuse_socket",
+    "set_socket_event",
+    "get_socket_event",
+    "get_socket_info",
+    "enable_socket_event",
+    "set_socket_deferred",
+    "alloc_console",
+    "free_console",
+    "get_console_renderer_events",
+    "open_console",
+    "get_console_wait_event",
+    "get_console_mode",
+    "set_console_mode",
+    "set_console_input_info",
+    "get_console_input_info",
+    "append_console_input_history",
+    "get_console_input_history",
+    "create_console_output",
+    "set_console_output_info",
+    "get_console_output_info",
+    "write_console_input",
+    "read_console_input",
+    "write_console_output",
+    "fill_console_output",
+    "read_console_output",
+    "move_console_output",
+    "send_console_signal",
+    "read_directory_changes",
+    "read_change",
+    "create_mapping",
+    "open_mapping",
+    "get_mapping_info",
+    "get_mapping_committed_range",
+    "add_mapping_committed_range",
+    "create_snapshot",
+    "next_process",
+    "next_thread",
+    "wait_debug_event",
+    "queue_exception_event",
+    "get_exception_status",
+    "continue_debug_event",
+    "debug_process",
+    "debug_break",
+    "set_debugger_kill_on_exit",
+    "read_process_memory",
+    "write_process_memory",
+    "create_key",
+    "open_key",
+    "delete_key",
+    "flush_key",
+    "enum_key",
+    "set_key_value",
+    "get_key_value",
+    "enum_key_value",
+    "delete_key_value",
+    "load_registry",
+    "unload_registry",
+    "save_registry",
+    "set_registry_notification",
+    "create_timer",
+    "open_timer",
+    "set_timer",
+    "cancel_timer",
+    "get_timer_info",
+    "get_tsc_frequency",
+    "get_thread_context",
+    "set_thread_context",
+    "get_selector_entry",
+    "add_atom",
+    "delete_atom",
+    "find_atom",
+    "get_atom_information",
+    "set_atom_information",
+    "empty_atom_table",
+    "init_atom_table",
+    "get_msg_queue",
+    "set_queue_fd",
+    "set_queue_mask",
+    "get_queue_status",
+    "get_process_idle_event",
+    "send_message",
+    "post_quit_message",
+    "send_hardware_message",
+    "get_message",
+    "reply_message",
+    "accept_hardware_message",
+    "get_message_reply",
+    "set_win_timer",
+    "kill_win_timer",
+    "is_window_hung",
+    "get_serial_info",
+    "set_serial_info",
+    "register_async",
+    "cancel_async",
+    "get_async_result",
+    "read",
+    "write",
+    "ioctl",
+    "set_irp_result",
+    "create_named_pipe",
+    "get_named_pipe_info",
+    "set_named_pipe_info",
+    "create_window",
+    "destroy_window",
+    "get_desktop_window",
+    "set_window_owner",
+    "get_window_info",
+    "set_window_info",
+    "set_parent",
+    "get_window_parents",
+    "get_window_children",
+    "get_window_children_from_point",
+    "get_window_tree",
+    "set_window_pos",
+    "get_window_rectangles",
+    "get_window_text",
+    "set_window_text",
+    "get_windows_offset",
+    "get_visible_region",
+    "get_surface_region",
+    "get_window_region",
+    "set_window_region",
+    "set_layer_region",
+    "get_update_region",
+    "update_window_zorder",
+    "redraw_window",
+    "set_window_property",
+    "remove_window_property",
+    "get_window_property",
+    "get_window_properties",
+    "create_winstation",
+    "open_winstation",
+    "close_winstation",
+    "get_process_winstation",
+    "set_process_winstation",
+    "enum_winstation",
+    "create_desktop",
+    "open_desktop",
+    "open_input_desktop",
+    "close_desktop",
+    "get_thread_desktop",
+    "set_thread_desktop",
+    "enum_desktop",
+    "set_user_object_info",
+    "register_hotkey",
+    "unregister_hotkey",
+    "attach_thread_input",
+    "get_thread_input",
+    "get_last_input_time",
+    "get_key_state",
+    "set_key_state",
+    "set_foreground_window",
+    "set_focus_window",
+    "set_active_window",
+    "set_capture_window",
+    "set_caret_window",
+    "set_caret_info",
+    "set_hook",
+    "remove_hook",
+    "start_hook_chain",
+    "finish_hook_chain",
+    "get_hook_info",
+    "create_class",
+    "destroy_class",
+    "set_class_info",
+    "open_clipboard",
+    "close_clipboard",
+    "empty_clipboard",
+    "set_clipboard_data",
+    "get_clipboard_data",
+    "get_clipboard_formats",
+    "enum_clipboard_formats",
+    "release_clipboard",
+    "get_clipboard_info",
+    "set_clipboard_viewer",
+    "add_clipboard_listener",
+    "remove_clipboard_listener",
+    "open_token",
+    "set_global_windows",
+    "adjust_token_privileges",
+    "get_token_privileges",
+    "check_token_privileges",
+    "duplicate_token",
+    "access_check",
+    "get_token_sid",
+    "get_token_groups",
+    "get_token_default_dacl",
+    "set_token_default_dacl",
+    "set_security_object",
+    "get_security_object",
+    "get_system_handles",
+    "create_mailslot",
+    "set_mailslot_info",
+    "create_directory",
+    "open_directory",
+    "get_directory_entry",
+    "create_symlink",
+    "open_symlink",
+    "query_symlink",
+    "get_object_info",
+    "get_object_type",
+    "get_object_type_by_index",
+    "unlink_object",
+    "get_token_impersonation_level",
+    "allocate_locally_unique_id",
+    "create_device_manager",
+    "create_device",
+    "delete_device",
+    "get_next_device_request",
+    "make_process_system",
+    "get_token_statistics",
+    "create_completion",
+    "open_completion",
+    "add_completion",
+    "remove_completion",
+    "query_completion",
+    "set_completion_info",
+    "add_fd_completion",
+    "set_fd_compl_info",
+    "get_fd_compl_info",
+    "set_fd_disp_info",
+    "set_fd_name_info",
+    "set_fd_eof_info",
+    "get_window_layered_info",
+    "set_window_layered_info",
+    "alloc_user_handle",
+    "free_user_handle",
+    "set_cursor",
+    "update_rawinput_devices",
+    "get_suspend_context",
+    "set_suspend_context",
+    "create_job",
+    "open_job",
+    "assign_job",
+    "process_in_job",
+    "set_job_limits",
+    "set_job_completion_port",
+    "terminate_job",
+    "get_system_info",
+    "suspend_process",
+    "resume_process",
+    "get_esync_fd",
+    "esync_wake",
+    "get_request_stats",
+};
+
+/* ### make_requests end ### */
+
+enum sort_key
+{
+    SORT_TIME,
+    SORT_COUNT,
+    SORT_MAX,
+    SORT_IN,
+    SORT_OUT
+};
+
+static const char * const sort_names[] = { "time", "count", "max", "in", "out" };
+
+static enum sort_key sort_key = SORT_TIME;
+
+static void usage( int status )
+{
+    printf( "Usage: %s [OPTION]...\n"
+            "Display the per-request statistics of the wineserver.\n"
+            "\n"
+            "  -e, --enable       start collecting statistics\n"
+            "  -d, --disable      stop collecting statistics\n"
+            "  -r, --reset        clear the statistics after displaying them\n"
+            "  -s, --sort=KEY     sort by time (default), count, max, in or out\n"
+            "  -H, --histogram    display the histogram of handler times\n"
+            "  -h, --help         display this help and exit\n"
+            "\n"
+            "Collecting the statistics adds a small overhead to each request, so they\n"
+            "are disabled until %s --enable is run.\n", progname, progname );
+    exit( status );
+}
+
+static int compare_stats( const void *p1, const void *p2 )
+{
+    const struct request_stats *s1 = p1, *s2 = p2;
+    unsigned __int64 v1, v2;
+
+    switch (sort_key)
+    {
+    case SORT_COUNT: v1 = s1->count;     v2 = s2->count;     break;
+    case SORT_MAX:   v1 = s1->max_time;  v2 = s2->max_time;  break;
+    case SORT_IN:    v1 = s1->bytes_in;  v2 = s2->bytes_in;  break;
+    case SORT_OUT:   v1 = s1->bytes_out; v2 = s2->bytes_out; break;
+    default:         v1 = s1->total_time; v2 = s2->total_time; break;
+    }
+    if (v1 != v2) return v1 > v2 ? -1 : 1;
+    return s1->req - s2->req;
+}
+
+static const char *get_req_name( unsigned int req )
+{
+    static char buffer[32];
+
+    if (req < REQ_NB_REQUESTS) return req_names[req];
+    snprintf( buffer, sizeof(buffer), "request %u", req );
+    return buffer;
+}
+
+static void print_histogram( const struct request_stats *stats )
+{
+    unsigned int i;
+
+    printf( "   " );
+    for (i = 0; i < REQUEST_STATS_BUCKETS; i++)
+    {
+        if (!stats->histogram[i]) continue;
+        if (i == REQUEST_STATS_BUCKETS - 1)
+            printf( " >=%uus:%u", 1u << (i - 1), stats->histogram[i] );
+        else
+            printf( " <%uus:%u", 1u << i, stats->histogram[i] );
+    }
+    printf( "\n" );
+}
+
+static void print_stats( struct request_stats *stats, unsigned int count, timeout_t elapsed, BOOL histogram )
+{
+    unsigned __int64 total_time = 0, total_count = 0;
+    double seconds = elapsed / 10000000.0;
+    unsigned int i;
+
+    for (i = 0; i < count; i++)
+    {
+        total_time += stats[i].total_time;
+        total_count += stats[i].count;
+    }
+    if (seconds <= 0.0) seconds = 1.0;
+
+    qsort( stats, count, sizeof(*stats), compare_stats );
+
+    printf( "%u requests in %.3f s (%.0f/s), %.3f ms in handlers (%.2f%% busy)\n\n",
+            (unsigned int)total_count, seconds, total_count / seconds, total_time / 1000000.0,
+            total_time / 10000000.0 / seconds );
+    printf( "%-32s %10s %9s %10s %8s %8s %10s %10s %6s %6s\n", "request", "calls", "calls/s",
+            "total ms", "avg us", "max us", "KB in", "KB out", "time%", "shm%" );
+
+    for (i = 0; i < count; i++)
+    {
+        printf( "%-32s %10u %9.0f %10.3f %8.2f %8.1f %10.1f %10.1f %6.2f %6.2f\n",
+                get_req_name( stats[i].req ), stats[i].count, stats[i].count / seconds,
+                stats[i].total_time / 1000000.0, stats[i].total_time / 1000.0 / stats[i].count,
+                stats[i].max_time / 1000.0, stats[i].bytes_in / 1024.0, stats[i].bytes_out / 1024.0,
+                total_time ? stats[i].total_time * 100.0 / total_time : 0.0,
+                stats[i].shm_count * 100.0 / stats[i].count );
+        if (histogram) print_histogram( &stats[i] );
+    }
+}
+
+int main( int argc, char *argv[] )
+{
+    struct request_stats *stats;
+    unsigned int i, j, flags = 0, count = 0;
+    BOOL histogram = FALSE;
+    timeout_t elapsed = 0;
+    int enabled = 0;
+    NTSTATUS status;
+
+    for (i = 1; i < argc; i++)
+    {
+        const char *sort = NULL;
+
+        if (!strcmp( argv[i], "-e" ) || !strcmp( argv[i], "--enable" )) flags |= REQUEST_STATS_ENABLE;
+        else if (!strcmp( argv[i], "-d" ) || !strcmp( argv[i], "--disable" )) flags |= REQUEST_STATS_DISABLE;
+        else if (!strcmp( argv[i], "-r" ) || !strcmp( argv[i], "--reset" )) flags |= REQUEST_STATS_RESET;
+        else if (!strcmp( argv[i], "-H" ) || !strcmp( argv[i], "--histogram" )) histogram = TRUE;
+        else if (!strcmp( argv[i], "-h" ) || !strcmp( argv[i], "--help" )) usage( 0 );
+        else if (!strcmp( argv[i], "-s" ) && i + 1 < argc) sort = argv[++i];
+        else if (!strncmp( argv[i], "--sort=", 7 )) sort = argv[i] + 7;
+        else
+        {
+            fprintf( stderr, "%s: invalid option '%s'\n", progname, argv[i] );
+            usage( 2 );
+        }
+
+        if (!sort) continue;
+        for (j = 0; j < sizeof(sort_names) / sizeof(sort_names[0]); j++)
+            if (!strcmp( sort, sort_names[j] )) break;
+        if (j == sizeof(sort_names) / sizeof(sort_names[0]))
+        {
+            fprintf( stderr, "%s: invalid sort key '%s'\n", progname, sort );
+            usage( 2 );
+        }
+        sort_key = j;
+    }
+
+    /* there is at most one entry per request type */
+    if (!(stats = HeapAlloc( GetProcessHeap(), 0, REQ_NB_REQUESTS * sizeof(*stats) )))
+    {
+        fprintf( stderr, "%s: out of memory\n", progname );
+        return 1;
+    }
+
+    SERVER_START_REQ( get_request_stats )
+    {
+        req->flags = flags;
+        wine_server_set_reply( req, stats, REQ_NB_REQUESTS * sizeof(*stats) );
+        if (!(status = wine_server_call( req )))
+        {
+            enabled = reply->enabled;
+            elapsed = reply->elapsed;
+            count   = wine_server_reply_size( reply ) / sizeof(*stats);
+        }
+    }
+    SERVER_END_REQ;
+
+    if (status)
+    {
+        fprintf( stderr, "%s: failed to get the request statistics, status %#x\n", progname, status );
+        HeapFree( GetProcessHeap(), 0, stats );
+        return 1;
+    }
+
+    if (count) print_stats( stats, count, elapsed, histogram );
+    else if (!enabled && !(flags & REQUEST_STATS_ENABLE))
+        printf( "No statistics available, run %s --enable to start collecting them.\n", progname );
+
+    if ((flags & REQUEST_STATS_ENABLE) && !enabled) printf( "Request statistics enabled.\n" );
+    if ((flags & REQUEST_STATS_DISABLE) && enabled) printf( "Request statistics disabled.\n" );
+    if (flags & REQUEST_STATS_RESET) printf( "Request statistics cleared.\n" );
+
+    HeapFree( GetProcessHeap(), 0, stats );
+    return 0;
+}
@@ -0,0 +1,289 @@
+/*
+ * eventfd-based synchronization objects
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+/*
+ * When WINEESYNC is set in the environment of the server, events, semaphores
+ * and mutexes are backed by an eventfd whose counter holds the signaled state,
+ * plus a slot in a block of shared memory for the state that doesn't fit in
+ * the counter (mutex owner, semaphore count and maximum). Clients fetch the
+ * eventfd once per handle and then signal and wait on the object without
+ * talking to the server. The server keeps using the same eventfd as the
+ * object state, so waits that still go through select (alertable waits, waits
+ * on other object types) see a consistent state; clients only need to notify
+ * the server after signaling an object when a thread is waiting on it there,
+ * which is tracked in the shared slot.
+ */
+
+#include "config.h"
+#include "wine/port.h"
+
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#ifdef HAVE_POLL_H
+#include <poll.h>
+#endif
+#ifdef HAVE_SYS_EVENTFD_H
+# include <sys/eventfd.h>
+#endif
+
+#include "ntstatus.h"
+#define WIN32_NO_STATUS
+#include "windef.h"
+#include "winternl.h"
+
+#include "handle.h"
+#include "request.h"
+#include "file.h"
+#include "esync.h"
+
+static esync_shm_t  *esync_shm;
+static int           esync_shm_fd = -1;
+static unsigned int  esync_next_idx = 1;  /* slot 0 is never used */
+static unsigned int *esync_free_idx;
+static unsigned int  esync_free_count;
+
+int do_esync(void)
+{
+#ifdef HAVE_SYS_EVENTFD_H
+    static int do_esync_cached = -1;
+
+    if (do_esync_cached == -1)
+    {
+        const char *str = getenv( "WINEESYNC" );
+        do_esync_cached = str && atoi( str );
+    }
+    return do_esync_cached;
+#else
+    return 0;
+#endif
+}
+
+/* allocate the shared state block */
+void init_esync(void)
+{
+    if (!do_esync()) return;
+
+    if (!allocate_shared_memory( &esync_shm_fd, (void **)&esync_shm,
+                                 ESYNC_SHM_SLOTS * sizeof(*esync_shm) ))
+    {
+        fprintf( stderr, "wineserver: cannot allocate esync shared memory, esync disabled\n" );
+        return;
+    }
+    esync_free_idx = mem_alloc( ESYNC_SHM_SLOTS * sizeof(*esync_free_idx) );
+}
+
+static unsigned int alloc_shm_idx(void)
+{
+    if (esync_free_count) return esync_free_idx[--esync_free_count];
+    if (esync_next_idx < ESYNC_SHM_SLOTS) return esync_next_idx++;
+    return 0;
+}
+
+/* set up the eventfd of a new object; falls back to a plain server object on failure */
+int esync_init_object( struct esync *esync, unsigned int initval, int semaphore )
+{
+    esync->fd  = -1;
+    esync->idx = 0;
+
+#ifdef HAVE_SYS_EVENTFD_H
+    if (!esync_shm || !esync_free_idx) return 0;
+    if (!(esync->idx = alloc_shm_idx())) return 0;
+
+    if ((esync->fd = eventfd( initval, EFD_CLOEXEC | EFD_NONBLOCK | (semaphore ? EFD_SEMAPHORE : 0) )) == -1)
+    {
+        esync_free_idx[esync_free_count++] = esync->idx;
+        esync->idx = 0;
+        return 0;
+    }
+    memset( &esync_shm[esync->idx], 0, sizeof(esync_shm[esync->idx]) );
+    return 1;
+#else
+    return 0;
+#endif
+}
+
+void esync_destroy_object( struct esync *esync )
+{
+    if (esync->fd == -1) return;
+    close( esync->fd );
+    esync_free_idx[esync_free_count++] = esync->idx;
+    esync->fd  = -1;
+    esync->idx = 0;
+}
+
+esync_shm_t *esync_get_shm( struct esync *esync )
+{
+    return &esync_shm[esync->idx];
+}
+
+/* check whether the counter is non-zero without consuming it */
+int esync_signaled( struct esync *esync )
+{
+    struct pollfd pfd;
+
+    pfd.fd = esync->fd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    return poll( &pfd, 1, 0 ) == 1 && (pfd.revents & POLLIN);
+}
+
+/* try to consume the counter (or one unit of it for semaphores) */
+int esync_grab( struct esync *esync )
+{
+    unsigned __int64 value;
+    return read( esync->fd, &value, sizeof(value) ) == sizeof(value);
+}
+
+void esync_post( struct esync *esync, unsigned int count )
+{
+    unsigned __int64 value = count;
+
+    if (write( esync->fd, &value, sizeof(value) ) == -1 && errno != EAGAIN)
+        fprintf( stderr, "wineserver: esync write failed: %s\n", strerror( errno ));
+}
+
+void esync_clear( struct esync *esync )
+{
+    unsigned __int64 value;
+    while (read( esync->fd, &value, sizeof(value) ) == sizeof(value));
+}
+
+/* the waiter count must be visible before the server polls the eventfd,
+ * clients read it after posting to the eventfd */
+void esync_add_waiter( struct esync *esync )
+{
+    interlocked_xchg_add( &esync_get_shm( esync )->waiters, 1 );
+}
+
+void esync_remove_waiter( struct esync *esync )
+{
+    interlocked_xchg_add( &esync_get_shm( esync )->waiters, -1 );
+}
+
+static struct esync *get_object_esync( struct object *obj, enum esync_type *type )
+{
+    struct esync *esync;
+
+    if (!(esync = get_event_esync( obj, type )) &&
+        !(esync = get_semaphore_esync( obj, type )) &&
+        !(esync = get_mutex_esync( obj, type )))
+        return NULL;
+    return esync->fd != -1 ? esync : NULL;
+}
+
+/* consume an esync object on behalf of a server-side wait that is about to be
+ * satisfied; returns 0 if a client took it since it was polled, in which case
+ * the wait must not be satisfied. grabbed is set if esync_ungrab() is needed
+ * to back out. */
+int esync_grab_for_wait( struct object *obj, struct wait_queue_entry *entry, int *grabbed )
+{
+    struct esync *esync;
+    enum esync_type type;
+
+    *grabbed = 0;
+    if (!do_esync() || !(esync = get_object_esync( obj, &type ))) return 1;
+
+    switch (type)
+    {
+    case ESYNC_MANUAL_EVENT:
+        return 1;
+    case ESYNC_SEMAPHORE:
+    {
+        esync_shm_t *shm = esync_get_shm( esync );
+        unsigned int current;
+
+        /* take the count before the eventfd like clients do, so that releases
+         * never see a unit that is already gone; if the matching post is still
+         * in flight, give the count back and let the post wake us up again */
+        do
+        {
+            if (!(current = shm->count)) return 0;
+        } while (interlocked_cmpxchg( (int *)&shm->count, current - 1, current ) != current);
+
+        if (!esync_grab( esync ))
+        {
+            interlocked_xchg_add( (int *)&shm->count, 1 );
+            return 0;
+        }
+        *grabbed = 1;
+        return 1;
+    }
+    case ESYNC_MUTEX:
+        if (esync_get_shm( esync )->tid == get_wait_queue_thread( entry )->id) return 1;
+        /* fall through */
+    default:
+        if (!esync_grab( esync )) return 0;
+        *grabbed = 1;
+        return 1;
+    }
+}
+
+/* give back an object taken by esync_grab_for_wait() */
+void esync_ungrab( struct object *obj )
+{
+    struct esync *esync;
+    enum esync_type type;
+
+    if (!(esync = get_object_esync( obj, &type ))) return;
+    if (type == ESYNC_SEMAPHORE) interlocked_xchg_add( (int *)&esync_get_shm( esync )->count, 1 );
+    esync_post( esync, 1 );
+}
+
+/* retrieve the eventfd and shared state slot of an esync object */
+DECL_HANDLER(get_esync_fd)
+{
+    struct object *obj;
+    struct esync *esync;
+    enum esync_type type;
+
+    if (!req->handle)
+    {
+        if (esync_shm_fd != -1) send_client_fd( current->process, esync_shm_fd, 0 );
+        else set_error( STATUS_NOT_IMPLEMENTED );
+        return;
+    }
+
+    if (!(obj = get_handle_obj( current->process, req->handle, 0, NULL ))) return;
+
+    if ((esync = get_object_esync( obj, &type )))
+    {
+        reply->type    = type;
+        reply->shm_idx = esync->idx;
+        reply->access  = get_handle_access( current->process, req->handle );
+        send_client_fd( current->process, esync->fd, req->handle );
+    }
+    else set_error( STATUS_NOT_IMPLEMENTED );
+
+    release_object( obj );
+}
+
+/* wake up server-side waiters after a client signaled the object */
+DECL_HANDLER(esync_wake)
+{
+    struct object *obj;
+    enum esync_type type;
+
+    if (!(obj = get_handle_obj( current->process, req->handle, 0, NULL ))) return;
+    if (get_object_esync( obj, &type )) wake_up( obj, 0 );
+    else set_error( STATUS_OBJECT_TYPE_MISMATCH );
+    release_object( obj );
+}
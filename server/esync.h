@@ -0,0 +1,49 @@
+/*
+ * eventfd-based synchronization objects
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+#ifndef __WINE_SERVER_ESYNC_H
+#define __WINE_SERVER_ESYNC_H
+
+#include "object.h"
+
+/* eventfd backing an event, semaphore or mutex; fd is -1 when not in use */
+struct esync
+{
+    int          fd;            /* eventfd holding the signaled state */
+    unsigned int idx;           /* slot in the shared state block */
+};
+
+extern int do_esync(void);
+extern void init_esync(void);
+extern int esync_init_object( struct esync *esync, unsigned int initval, int semaphore );
+extern void esync_destroy_object( struct esync *esync );
+extern esync_shm_t *esync_get_shm( struct esync *esync );
+extern int esync_signaled( struct esync *esync );
+extern int esync_grab( struct esync *esync );
+extern void esync_post( struct esync *esync, unsigned int count );
+extern void esync_clear( struct esync *esync );
+extern void esync_add_waiter( struct esync *esync );
+extern void esync_remove_waiter( struct esync *esync );
+extern int esync_grab_for_wait( struct object *obj, struct wait_queue_entry *entry, int *grabbed );
+extern void esync_ungrab( struct object *obj );
+
+extern struct esync *get_event_esync( struct object *obj, enum esync_type *type );
+extern struct esync *get_semaphore_esync( struct object *obj, enum esync_type *type );
+extern struct esync *get_mutex_esync( struct object *obj, enum esync_type *type );
+
+#endif  /* __WINE_SERVER_ESYNC_H */
@@ -35,28 +35,33 @@
 #include "thread.h"
 #include "request.h"
 #include "security.h"
+#include "esync.h"
 
 struct event
 {
     struct object  obj;             /* object header */
     int            manual_reset;    /* is it a manual reset event? */
     int            signaled;        /* event has been signaled */
+    struct esync   esync;           /* eventfd state, if esync is enabled */
 };
 
 static void event_dump( struct object *obj, int verbose );
 static struct object_type *event_get_type( struct object *obj );
+static int event_add_queue( struct object *obj, struct wait_queue_entry *entry );
+static void event_remove_queue( struct object *obj, struct wait_queue_entry *entry );
 static int event_signaled( struct object *obj, struct wait_queue_entry *entry );
 static void event_satisfied( struct object *obj, struct wait_queue_entry *entry );
 static unsigned int event_map_access( struct object *obj, unsigned int access );
 static int event_signal( struct object *obj, unsigned int access);
+static void event_destroy( struct object *obj );
 
 static const struct object_ops event_ops =
 {
     sizeof(struct event),      /* size */
     event_dump,                /* dump */
     event_get_type,            /* get_type */
-    add_queue,                 /* add_queue */
-    remove_queue,              /* remove_queue */
+    event_add_queue,           /* add_queue */
+    event_remove_queue,        /* remove_queue */
     event_signaled,            /* signaled */
     event_satisfied,           /* satisfied */
     event_signal,              /* signal */
@@ -70,7 +75,7 @@ static const struct object_ops event_ops =
     no_open_file,              /* open_file */
     no_alloc_handle,           /* alloc_handle */
     no_close_handle,           /* close_handle */
-    no_destroy                 /* destroy */
+    event_destroy              /* destroy */
 };
 
 
@@ -121,6 +126,8 @@ struct event *create_event( struct object *root, const struct unicode_str *name,
             /* initialize it if it didn't already exist */
             event->manual_reset = manual_reset;
             event->signaled     = initial_state;
+            event->esync.fd     = -1;
+            if (do_esync()) esync_init_object( &event->esync, initial_state, 0 );
         }
     }
     return event;
@@ -131,8 +138,24 @@ struct event *get_event_obj( struct process *process, obj_handle_t handle, unsig
     return (struct event *)get_handle_obj( process, handle, access, &event_ops );
 }
 
+struct esync *get_event_esync( struct object *obj, enum esync_type *type )
+{
+    struct event *event = (struct event *)obj;
+
+    if (obj->ops != &event_ops) return NULL;
+    *type = event->manual_reset ? ESYNC_MANUAL_EVENT : ESYNC_AUTO_EVENT;
+    return &event->esync;
+}
+
 void pulse_event( struct event *event )
 {
+    if (event->esync.fd != -1)
+    {
+        esync_post( &event->esync, 1 );
+        wake_up( &event->obj, 0 );
+        esync_clear( &event->esync );
+        return;
+    }
     event->signaled = 1;
     /* wake up all waiters if manual reset, a single one otherwise */
     wake_up( &event->obj, !event->manual_reset );
@@ -141,6 +164,12 @@ void pulse_event( struct event *event )
 
 void set_event( struct event *event )
 {
+    if (event->esync.fd != -1)
+    {
+        esync_post( &event->esync, 1 );
+        wake_up( &event->obj, 0 );
+        return;
+    }
     event->signaled = 1;
     /* wake up all waiters if manual reset, a single one otherwise */
     wake_up( &event->obj, !event->manual_reset );
@@ -148,6 +177,7 @@ void set_event( struct event *event )
 
 void reset_event( struct event *event )
 {
+    if (event->esync.fd != -1) esync_clear( &event->esync );
     event->signaled = 0;
 }
 
@@ -165,10 +195,27 @@ static struct object_type *event_get_type( struct object *obj )
     return get_object_type( &str );
 }
 
+static int event_add_queue( struct object *obj, struct wait_queue_entry *entry )
+{
+    struct event *event = (struct event *)obj;
+    assert( obj->ops == &event_ops );
+    if (event->esync.fd != -1) esync_add_waiter( &event->esync );
+    return add_queue( obj, entry );
+}
+
+static void event_remove_queue( struct object *obj, struct wait_queue_entry *entry )
+{
+    struct event *event = (struct event *)obj;
+    assert( obj->ops == &event_ops );
+    if (event->esync.fd != -1) esync_remove_waiter( &event->esync );
+    remove_queue( obj, entry );
+}
+
 static int event_signaled( struct object *obj, struct wait_queue_entry *entry )
 {
     struct event *event = (struct event *)obj;
     assert( obj->ops == &event_ops );
+    if (event->esync.fd != -1) return esync_signaled( &event->esync );
     return event->signaled;
 }
 
@@ -177,7 +224,9 @@ static void event_satisfied( struct object *obj, struct wait_queue_entry *entry
     struct event *event = (struct event *)obj;
     assert( obj->ops == &event_ops );
     /* Reset if it's an auto-reset event */
-    if (!event->manual_reset) event->signaled = 0;
+    if (event->manual_reset) return;
+    /* with esync the counter has already been consumed by the wait */
+    event->signaled = 0;
 }
 
 static unsigned int event_map_access( struct object *obj, unsigned int access )
@@ -203,6 +252,13 @@ static int event_signal( struct object *obj, unsigned int access )
     return 1;
 }
 
+static void event_destroy( struct object *obj )
+{
+    struct event *event = (struct event *)obj;
+    assert( obj->ops == &event_ops );
+    esync_destroy_object( &event->esync );
+}
+
 struct keyed_event *create_keyed_event( struct object *root, const struct unicode_str *name,
                                         unsigned int attr, const struct security_descriptor *sd )
 {
@@ -290,6 +346,7 @@ DECL_HANDLER(create_event)
         else
             reply->handle = alloc_handle_no_access_check( current->process, event,
                                                           req->access, objattr->attributes );
+        if (reply->handle && !name.len) set_handle_deferrable( current->process, reply->handle );
         release_object( event );
     }
 
@@ -337,7 +394,8 @@ DECL_HANDLER(query_event)
     if (!(event = get_event_obj( current->process, req->handle, EVENT_QUERY_STATE ))) return;
 
     reply->manual_reset = event->manual_reset;
-    reply->state = event->signaled;
+    if (event->esync.fd != -1) reply->state = esync_signaled( &event->esync );
+    else reply->state = event->signaled;
 
     release_object( event );
 }
@@ -2688,7 +2688,22 @@ DECL_HANDLER(set_completion_info)
 
     if (fd)
     {
-        if (!(fd->options & (FILE_SYNCHRONOUS_IO_ALERT | FILE_SYNCHRONOUS_IO_NONALERT)) && !fd->completion)
+        if (fd->options & (FILE_SYNCHRONOUS_IO_ALERT | FILE_SYNCHRONOUS_IO_NONALERT))
+            set_error( STATUS_INVALID_PARAMETER );
+        else if (req->replace)
+        {
+            struct completion *completion = NULL;
+
+            /* a null port handle removes the association */
+            if (!req->chandle ||
+                (completion = get_completion_obj( current->process, req->chandle, IO_COMPLETION_MODIFY_STATE )))
+            {
+                if (fd->completion) release_object( fd->completion );
+                fd->completion = completion;
+                fd->comp_key = completion ? req->ckey : 0;
+            }
+        }
+        else if (!fd->completion)
         {
             fd->completion = get_completion_obj( current->process, req->chandle, IO_COMPLETION_MODIFY_STATE );
             fd->comp_key = req->ckey;
@@ -470,11 +470,79 @@ static int file_get_poll_events( struct fd *fd )
     return events;
 }
 
+struct flush_work
+{
+    struct async *async;    /* async waiting for the flush to complete */
+    int           unix_fd;  /* duplicated unix fd to sync */
+    int           error;    /* errno of the fsync call */
+};
+
+/* called in a worker thread */
+static void flush_work( void *arg )
+{
+    struct flush_work *flush = arg;
+    flush->error = fsync( flush->unix_fd ) == -1 ? errno : 0;
+}
+
+/* convert the errno of a flush to a status */
+static unsigned int flush_status( int error )
+{
+    unsigned int status;
+
+    if (!error) return STATUS_SUCCESS;
+    errno = error;
+    file_set_error();
+    status = get_error();
+    clear_error();
+    return status;
+}
+
+/* called in the main loop once the worker is done */
+static void flush_done( void *arg )
+{
+    struct flush_work *flush = arg;
+
+    close( flush->unix_fd );
+    async_terminate( flush->async, flush_status( flush->error ) );
+    release_object( flush->async );
+    free( flush );
+}
+
 static obj_handle_t file_flush( struct fd *fd, struct async *async )
 {
     int unix_fd = get_unix_fd( fd );
-    if (unix_fd != -1 && fsync( unix_fd ) == -1) file_set_error();
-    return 0;
+    struct flush_work *flush;
+    obj_handle_t handle;
+
+    if (unix_fd == -1) return 0;
+
+    /* the client always waits for the flush to complete, even on overlapped handles */
+    if (!(handle = alloc_handle( current->process, async, SYNCHRONIZE, 0 ))) return 0;
+    if (!fd_queue_async( fd, async, ASYNC_TYPE_WAIT ))
+    {
+        close_handle( current->process, handle );
+        return 0;
+    }
+
+    /* fsync can take a long time, don't block the other clients while waiting for it */
+    if ((flush = mem_alloc( sizeof(*flush) )))
+    {
+        flush->async = (struct async *)grab_object( async );
+        flush->error = 0;
+        if ((flush->unix_fd = dup( unix_fd )) != -1 && queue_work( flush_work, flush_done, flush ))
+        {
+            set_error( STATUS_PENDING );
+            return handle;
+        }
+        if (flush->unix_fd != -1) close( flush->unix_fd );
+        release_object( flush->async );
+        free( flush );
+    }
+    clear_error();
+
+    async_terminate( async, flush_status( fsync( unix_fd ) == -1 ? errno : 0 ) );
+    set_error( STATUS_PENDING );
+    return handle;
 }
 
 static enum server_fd_type file_get_fd_type( struct fd *fd )
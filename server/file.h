@@ -163,6 +163,7 @@ extern struct object *create_unix_device( struct object *root, const struct unic
 extern int allocate_shared_memory( int *fd, void **memory, size_t size );
 extern void release_shared_memory( int fd, void *memory, size_t size );
 extern void init_shared_memory( void );
+extern void init_tsc( void );
 extern shmglobal_t *shmglobal;
 extern int          shmglobal_fd;
 
@@ -61,7 +61,9 @@ static struct handle_table *global_table;
 #define RESERVED_SHIFT         26
 #define RESERVED_INHERIT       (HANDLE_FLAG_INHERIT << RESERVED_SHIFT)
 #define RESERVED_CLOSE_PROTECT (HANDLE_FLAG_PROTECT_FROM_CLOSE << RESERVED_SHIFT)
-#define RESERVED_ALL           (RESERVED_INHERIT | RESERVED_CLOSE_PROTECT)
+#define RESERVED_DEFERRED      (0x04 << RESERVED_SHIFT)  /* client may defer the close */
+#define RESERVED_FLAGS         (RESERVED_INHERIT | RESERVED_CLOSE_PROTECT)
+#define RESERVED_ALL           (RESERVED_FLAGS | RESERVED_DEFERRED)
 
 #define MIN_HANDLE_ENTRIES  32
 #define MAX_HANDLE_ENTRIES  0x00ffffff
@@ -238,7 +240,8 @@ static obj_handle_t alloc_entry( struct handle_table *table, struct object *obj,
     struct handle_entry *entry = table->entries + table->free;
     int i;
 
-    for (i = table->free; i <= table->last; i++, entry++) if (!entry->ptr) goto found;
+    for (i = table->free; i <= table->last; i++, entry++)
+        if (!entry->ptr && !(entry->access & RESERVED_DEFERRED)) goto found;
     if (i >= table->count)
     {
         if (!grow_handle_table( table )) return 0;
@@ -345,7 +348,7 @@ static void shrink_handle_table( struct handle_table *table )
 
     while (table->last >= 0)
     {
-        if (entry->ptr) break;
+        if (entry->ptr || (entry->access & RESERVED_DEFERRED)) break;
         table->last--;
         entry--;
     }
@@ -377,13 +380,21 @@ struct handle_table *copy_handle_table( struct process *process, struct process
         memcpy( ptr, parent_table->entries, (table->last + 1) * sizeof(struct handle_entry) );
         for (i = 0; i <= table->last; i++, ptr++)
         {
-            if (!ptr->ptr) continue;
+            if (!ptr->ptr)
+            {
+                ptr->access = 0;
+                continue;
+            }
             if (ptr->access & RESERVED_INHERIT)
             {
                 ptr->ptr->ops->alloc_handle( ptr->ptr, process, index_to_handle(i) );
                 grab_object_for_handle( ptr->ptr );
             }
-            else ptr->ptr = NULL; /* don't inherit this entry */
+            else  /* don't inherit this entry */
+            {
+                ptr->ptr = NULL;
+                ptr->access = 0;
+            }
         }
     }
     /* attempt to shrink the table */
@@ -391,25 +402,56 @@ struct handle_table *copy_handle_table( struct process *process, struct process
     return table;
 }
 
+/* free a handle table entry, making its index available again */
+static void free_entry( struct handle_table *table, struct handle_entry *entry )
+{
+    entry->ptr = NULL;
+    entry->access = 0;
+    if (entry < table->entries + table->free) table->free = entry - table->entries;
+    if (entry == table->entries + table->last) shrink_handle_table( table );
+}
+
 /* close a handle and decrement the refcount of the associated object */
 unsigned int close_handle( struct process *process, obj_handle_t handle )
 {
-    struct handle_table *table;
+    struct handle_table *table = handle_is_global(handle) ? global_table : process->handles;
     struct handle_entry *entry;
     struct object *obj;
 
-    if (!(entry = get_handle( process, handle ))) return STATUS_INVALID_HANDLE;
+    if (!(entry = get_handle( process, handle )))
+    {
+        int index = handle_to_index( handle );
+
+        /* the owner closes a handle that was already closed by another process */
+        if (table && current && process == current->process && index >= 0 && index <= table->last &&
+            (table->entries[index].access & RESERVED_DEFERRED))
+            free_entry( table, table->entries + index );
+        return STATUS_INVALID_HANDLE;
+    }
     if (entry->access & RESERVED_CLOSE_PROTECT) return STATUS_HANDLE_NOT_CLOSABLE;
     obj = entry->ptr;
     if (!obj->ops->close_handle( obj, process, handle )) return STATUS_HANDLE_NOT_CLOSABLE;
-    entry->ptr = NULL;
-    table = handle_is_global(handle) ? global_table : process->handles;
-    if (entry < table->entries + table->free) table->free = entry - table->entries;
-    if (entry == table->entries + table->last) shrink_handle_table( table );
+    if ((entry->access & RESERVED_DEFERRED) && (!current || process != current->process))
+    {
+        /* the owner may still have queued a close of this value, so keep
+         * it reserved until the owner closes it too */
+        entry->ptr = NULL;
+        entry->access = RESERVED_DEFERRED;
+    }
+    else free_entry( table, entry );
     release_object_from_handle( obj );
     return STATUS_SUCCESS;
 }
 
+/* allow the client to defer the close of a handle, the value is then
+ * kept reserved when it is closed by another process */
+void set_handle_deferrable( struct process *process, obj_handle_t handle )
+{
+    struct handle_entry *entry;
+
+    if ((entry = get_handle( process, handle ))) entry->access |= RESERVED_DEFERRED;
+}
+
 /* retrieve the object corresponding to one of the magic pseudo-handles */
 static inline struct object *get_magic_handle( obj_handle_t handle )
 {
@@ -535,10 +577,10 @@ static int set_handle_flags( struct process *process, obj_handle_t handle, int m
         return -1;
     }
     old_access = entry->access;
-    mask  = (mask << RESERVED_SHIFT) & RESERVED_ALL;
+    mask  = (mask << RESERVED_SHIFT) & RESERVED_FLAGS;
     flags = (flags << RESERVED_SHIFT) & mask;
     entry->access = (entry->access & ~mask) | flags;
-    return (old_access & RESERVED_ALL) >> RESERVED_SHIFT;
+    return (old_access & RESERVED_FLAGS) >> RESERVED_SHIFT;
 }
 
 /* duplicate a handle */
@@ -578,7 +620,7 @@ obj_handle_t duplicate_handle( struct process *src, obj_handle_t src_handle, str
                  entry && !(entry->access & RESERVED_CLOSE_PROTECT))
         {
             if (attr & OBJ_INHERIT) access |= RESERVED_INHERIT;
-            entry->access = access;
+            entry->access = access | (entry->access & RESERVED_DEFERRED);
             res = src_handle;
         }
         else
@@ -635,6 +677,16 @@ DECL_HANDLER(close_handle)
     set_error( err );
 }
 
+/* close a batch of handles */
+DECL_HANDLER(close_handles)
+{
+    const obj_handle_t *handles = get_req_data();
+    data_size_t i, count = get_req_data_size() / sizeof(*handles);
+
+    for (i = 0; i < count; i++)
+        if (close_handle( current->process, handles[i] ) == STATUS_SUCCESS) reply->closed++;
+}
+
 /* set a handle information */
 DECL_HANDLER(set_handle_info)
 {
@@ -36,6 +36,7 @@
 #include "file.h"
 #include "thread.h"
 #include "request.h"
+#include "esync.h"
 #include "wine/library.h"
 
 /* command-line options */
@@ -58,6 +59,7 @@ static void usage( FILE *fh )
     fprintf(fh, "   -p[n], --persistent[=n]  make server persistent, optionally for n seconds\n");
     fprintf(fh, "   -v,    --version         display version information and exit\n");
     fprintf(fh, "   -w,    --wait            wait until the current wineserver terminates\n");
+    fprintf(fh, "   -W n,  --workers=n       use up to n threads for blocking operations, 0 to disable\n");
     fprintf(fh, "\n");
 }
 
@@ -74,12 +76,13 @@ static void parse_args( int argc, char *argv[] )
         {"persistent",  2, NULL, 'p'},
         {"version",     0, NULL, 'v'},
         {"wait",        0, NULL, 'w'},
+        {"workers",     1, NULL, 'W'},
         { NULL,         0, NULL, 0}
     };
 
     server_argv0 = argv[0];
 
-    while ((optc = getopt_long( argc, argv, "d::fhk::p::vw", long_options, NULL )) != -1)
+    while ((optc = getopt_long( argc, argv, "d::fhk::p::vwW:", long_options, NULL )) != -1)
     {
         switch(optc)
         {
@@ -114,6 +117,9 @@ static void parse_args( int argc, char *argv[] )
             case 'w':
                 wait_for_lock();
                 exit(0);
+            case 'W':
+                worker_threads = atoi( optarg );
+                break;
             default:
                 usage(stderr);
                 exit(1);
@@ -148,6 +154,9 @@ int main( int argc, char *argv[] )
     init_directories();
     init_registry();
     init_shared_memory();
+    init_tsc();
+    init_esync();
+    init_workers();
     init_types();
     main_loop();
     return 0;
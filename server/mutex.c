@@ -35,6 +35,7 @@
 #include "thread.h"
 #include "request.h"
 #include "security.h"
+#include "esync.h"
 
 struct mutex
 {
@@ -42,11 +43,17 @@ struct mutex
     struct thread *owner;           /* mutex owner */
     unsigned int   count;           /* recursion count */
     int            abandoned;       /* has it been abandoned? */
-    struct list    entry;           /* entry in owner thread mutex list */
+    struct list    entry;           /* entry in owner thread mutex list, or in esync_mutexes */
+    struct esync   esync;           /* eventfd state, if esync is enabled */
 };
 
+/* esync mutexes are owned by thread id through the shared state, they are not in any thread list */
+static struct list esync_mutexes = LIST_INIT( esync_mutexes );
+
 static void mutex_dump( struct object *obj, int verbose );
 static struct object_type *mutex_get_type( struct object *obj );
+static int mutex_add_queue( struct object *obj, struct wait_queue_entry *entry );
+static void mutex_remove_queue( struct object *obj, struct wait_queue_entry *entry );
 static int mutex_signaled( struct object *obj, struct wait_queue_entry *entry );
 static void mutex_satisfied( struct object *obj, struct wait_queue_entry *entry );
 static unsigned int mutex_map_access( struct object *obj, unsigned int access );
@@ -58,8 +65,8 @@ static const struct object_ops mutex_ops =
     sizeof(struct mutex),      /* size */
     mutex_dump,                /* dump */
     mutex_get_type,            /* get_type */
-    add_queue,                 /* add_queue */
-    remove_queue,              /* remove_queue */
+    mutex_add_queue,           /* add_queue */
+    mutex_remove_queue,        /* remove_queue */
     mutex_signaled,            /* signaled */
     mutex_satisfied,           /* satisfied */
     mutex_signal,              /* signal */
@@ -77,6 +84,33 @@ static const struct object_ops mutex_ops =
 };
 
 
+/* grab an esync mutex for a given thread, the eventfd has already been consumed by the wait */
+static void do_esync_grab( struct mutex *mutex, struct thread *thread, struct wait_queue_entry *entry )
+{
+    esync_shm_t *shm = esync_get_shm( &mutex->esync );
+
+    if (shm->tid == thread->id)
+    {
+        shm->count++;
+        return;
+    }
+    shm->tid = thread->id;
+    shm->count = 1;
+    if (shm->abandoned && entry) make_wait_abandoned( entry );
+    shm->abandoned = 0;
+}
+
+/* release an esync mutex once the recursion count is 0 */
+static void do_esync_release( struct mutex *mutex )
+{
+    esync_shm_t *shm = esync_get_shm( &mutex->esync );
+
+    shm->tid = 0;
+    shm->count = 0;
+    esync_post( &mutex->esync, 1 );
+    wake_up( &mutex->obj, 0 );
+}
+
 /* grab a mutex for a given thread */
 static void do_grab( struct mutex *mutex, struct thread *thread )
 {
@@ -113,7 +147,18 @@ static struct mutex *create_mutex( struct object *root, const struct unicode_str
             mutex->count = 0;
             mutex->owner = NULL;
             mutex->abandoned = 0;
-            if (owned) do_grab( mutex, current );
+            mutex->esync.fd = -1;
+            if (do_esync() && esync_init_object( &mutex->esync, !owned, 0 ))
+            {
+                esync_shm_t *shm = esync_get_shm( &mutex->esync );
+                list_add_tail( &esync_mutexes, &mutex->entry );
+                if (owned)
+                {
+                    shm->tid = current->id;
+                    shm->count = 1;
+                }
+            }
+            else if (owned) do_grab( mutex, current );
         }
     }
     return mutex;
@@ -121,8 +166,17 @@ static struct mutex *create_mutex( struct object *root, const struct unicode_str
 
 void abandon_mutexes( struct thread *thread )
 {
+    struct mutex *mutex, *next;
     struct list *ptr;
 
+    LIST_FOR_EACH_ENTRY_SAFE( mutex, next, &esync_mutexes, struct mutex, entry )
+    {
+        esync_shm_t *shm = esync_get_shm( &mutex->esync );
+        if (shm->tid != thread->id) continue;
+        shm->abandoned = 1;
+        do_esync_release( mutex );
+    }
+
     while ((ptr = list_head( &thread->mutex_list )) != NULL)
     {
         struct mutex *mutex = LIST_ENTRY( ptr, struct mutex, entry );
@@ -146,10 +200,29 @@ static struct object_type *mutex_get_type( struct object *obj )
     return get_object_type( &str );
 }
 
+static int mutex_add_queue( struct object *obj, struct wait_queue_entry *entry )
+{
+    struct mutex *mutex = (struct mutex *)obj;
+    assert( obj->ops == &mutex_ops );
+    if (mutex->esync.fd != -1) esync_add_waiter( &mutex->esync );
+    return add_queue( obj, entry );
+}
+
+static void mutex_remove_queue( struct object *obj, struct wait_queue_entry *entry )
+{
+    struct mutex *mutex = (struct mutex *)obj;
+    assert( obj->ops == &mutex_ops );
+    if (mutex->esync.fd != -1) esync_remove_waiter( &mutex->esync );
+    remove_queue( obj, entry );
+}
+
 static int mutex_signaled( struct object *obj, struct wait_queue_entry *entry )
 {
     struct mutex *mutex = (struct mutex *)obj;
     assert( obj->ops == &mutex_ops );
+    if (mutex->esync.fd != -1)
+        return (esync_get_shm( &mutex->esync )->tid == get_wait_queue_thread( entry )->id ||
+                esync_signaled( &mutex->esync ));
     return (!mutex->count || (mutex->owner == get_wait_queue_thread( entry )));
 }
 
@@ -158,6 +231,12 @@ static void mutex_satisfied( struct object *obj, struct wait_queue_entry *entry
     struct mutex *mutex = (struct mutex *)obj;
     assert( obj->ops == &mutex_ops );
 
+    if (mutex->esync.fd != -1)
+    {
+        do_esync_grab( mutex, get_wait_queue_thread( entry ), entry );
+        return;
+    }
+
     do_grab( mutex, get_wait_queue_thread( entry ));
     if (mutex->abandoned) make_wait_abandoned( entry );
     mutex->abandoned = 0;
@@ -182,6 +261,17 @@ static int mutex_signal( struct object *obj, unsigned int access )
         set_error( STATUS_ACCESS_DENIED );
         return 0;
     }
+    if (mutex->esync.fd != -1)
+    {
+        esync_shm_t *shm = esync_get_shm( &mutex->esync );
+        if (shm->tid != current->id)
+        {
+            set_error( STATUS_MUTANT_NOT_OWNED );
+            return 0;
+        }
+        if (!--shm->count) do_esync_release( mutex );
+        return 1;
+    }
     if (!mutex->count || (mutex->owner != current))
     {
         set_error( STATUS_MUTANT_NOT_OWNED );
@@ -196,11 +286,24 @@ static void mutex_destroy( struct object *obj )
     struct mutex *mutex = (struct mutex *)obj;
     assert( obj->ops == &mutex_ops );
 
+    if (mutex->esync.fd != -1)
+    {
+        list_remove( &mutex->entry );
+        esync_destroy_object( &mutex->esync );
+        return;
+    }
     if (!mutex->count) return;
     mutex->count = 0;
     do_release( mutex );
 }
 
+struct esync *get_mutex_esync( struct object *obj, enum esync_type *type )
+{
+    if (obj->ops != &mutex_ops) return NULL;
+    *type = ESYNC_MUTEX;
+    return &((struct mutex *)obj)->esync;
+}
+
 /* create a mutex */
 DECL_HANDLER(create_mutex)
 {
@@ -242,7 +345,17 @@ DECL_HANDLER(release_mutex)
     if ((mutex = (struct mutex *)get_handle_obj( current->process, req->handle,
                                                  0, &mutex_ops )))
     {
-        if (!mutex->count || (mutex->owner != current)) set_error( STATUS_MUTANT_NOT_OWNED );
+        if (mutex->esync.fd != -1)
+        {
+            esync_shm_t *shm = esync_get_shm( &mutex->esync );
+            if (shm->tid != current->id) set_error( STATUS_MUTANT_NOT_OWNED );
+            else
+            {
+                reply->prev_count = shm->count;
+                if (!--shm->count) do_esync_release( mutex );
+            }
+        }
+        else if (!mutex->count || (mutex->owner != current)) set_error( STATUS_MUTANT_NOT_OWNED );
         else
         {
             reply->prev_count = mutex->count;
@@ -260,9 +373,19 @@ DECL_HANDLER(query_mutex)
     if ((mutex = (struct mutex *)get_handle_obj( current->process, req->handle,
                                                  MUTANT_QUERY_STATE, &mutex_ops )))
     {
-        reply->count = mutex->count;
-        reply->owned = (mutex->owner == current);
-        reply->abandoned = mutex->abandoned;
+        if (mutex->esync.fd != -1)
+        {
+            esync_shm_t *shm = esync_get_shm( &mutex->esync );
+            reply->count = shm->count;
+            reply->owned = (shm->tid == current->id);
+            reply->abandoned = shm->abandoned;
+        }
+        else
+        {
+            reply->count = mutex->count;
+            reply->owned = (mutex->owner == current);
+            reply->abandoned = mutex->abandoned;
+        }
 
         release_object( mutex );
     }
@@ -226,6 +226,11 @@ extern void stop_watchdog(void);
 extern int watchdog_triggered(void);
 extern void init_signals(void);
 
+/* worker thread functions */
+
+extern void init_workers(void);
+extern int queue_work( void (*work)( void *arg ), void (*done)( void *arg ), void *arg );
+
 /* atom functions */
 
 extern atom_t add_global_atom( struct winstation *winstation, const struct unicode_str *str );
@@ -278,6 +283,7 @@ extern struct object *create_obj_symlink( struct object *root, const struct unic
 extern int debug_level;
 extern int foreground;
 extern timeout_t master_socket_timeout;
+extern int worker_threads;
 extern const char *server_argv0;
 
   /* server start time used for GetTickCount() */
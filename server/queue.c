@@ -101,6 +101,7 @@ struct thread_input
 {
     struct object          obj;           /* object header */
     struct desktop        *desktop;       /* desktop that this thread input belongs to */
+    struct list            entry;         /* entry in the desktop list of inputs */
     struct list            queues;        /* list of all queues this input belongs to */
     user_handle_t          focus;         /* focus window */
     user_handle_t          capture;       /* capture window */
@@ -267,6 +268,7 @@ static struct thread_input *create_thread_input( struct thread *thread )
         input->lock_count   = 0;
         list_init( &input->queues );
         list_init( &input->msg_list );
+        list_init( &input->entry );
         set_caret_window( input, 0 );
         memset( input->keystate, 0, sizeof(input->keystate) );
         memset( input->shadow_keystate, 0, sizeof(input->shadow_keystate) );
@@ -276,13 +278,27 @@ static struct thread_input *create_thread_input( struct thread *thread )
             release_object( input );
             return NULL;
         }
+        list_add_tail( &input->desktop->inputs, &input->entry );
     }
     return input;
 }
 
+/* start updating the input state in the shared memory; readers retry while the sequence is odd */
+static inline void begin_shm_input_update( shmlocal_t *shm )
+{
+    interlocked_xchg_add( &shm->input_seq, 1 );
+}
+
+/* finish updating the input state in the shared memory */
+static inline void end_shm_input_update( shmlocal_t *shm )
+{
+    interlocked_xchg_add( &shm->input_seq, 1 );
+}
+
 /* synchronize the input state with the shared memory */
 static void update_shm_thread_input( struct thread_input *input )
 {
+    struct desktop *desktop = input->desktop;
     struct msg_queue *queue;
 
     /* the loop doesn't matter, usually it should only have one or a few entries */
@@ -295,10 +311,84 @@ static void update_shm_thread_input( struct thread_input *input )
             shm->input_active  = input->active;
             shm->input_focus   = input->focus;
             shm->input_capture = input->capture;
+
+            begin_shm_input_update( shm );
+            shm->input_valid   = 1;
+            shm->keystate_lock = input->lock_count;
+            shm->cursor_x      = desktop->cursor.x;
+            shm->cursor_y      = desktop->cursor.y;
+            shm->cursor_change = desktop->cursor.last_change;
+            memcpy( shm->keystate, input->keystate, sizeof(shm->keystate) );
+            memcpy( shm->shadow_keystate, input->shadow_keystate, sizeof(shm->shadow_keystate) );
+            memcpy( shm->desktop_keystate, desktop->keystate, sizeof(shm->desktop_keystate) );
+            end_shm_input_update( shm );
+        }
+    }
+}
+
+/* synchronize the queue state with the shared memory */
+static inline void update_shm_queue_bits( struct msg_queue *queue )
+{
+    shmlocal_t *shm;
+    if (!queue->thread) return;
+    if ((shm = queue->thread->shm))
+    {
+        shm->queue_bits = queue->wake_bits;
+
+        begin_shm_input_update( shm );
+        shm->wake_bits    = queue->wake_bits;
+        shm->changed_bits = queue->changed_bits;
+        end_shm_input_update( shm );
+    }
+}
+
+/* synchronize the desktop key state and cursor with the shared memory of all its threads */
+static void update_shm_desktop_input( struct desktop *desktop )
+{
+    struct thread_input *input;
+    struct msg_queue *queue;
+    int cursor_changed, keystate_changed;
+
+    cursor_changed = desktop->shm_cursor_x != desktop->cursor.x ||
+                     desktop->shm_cursor_y != desktop->cursor.y ||
+                     desktop->shm_cursor_change != desktop->cursor.last_change;
+    keystate_changed = memcmp( desktop->shm_keystate, desktop->keystate, sizeof(desktop->keystate) );
+    if (!cursor_changed && !keystate_changed) return;
+
+    desktop->shm_cursor_x      = desktop->cursor.x;
+    desktop->shm_cursor_y      = desktop->cursor.y;
+    desktop->shm_cursor_change = desktop->cursor.last_change;
+    if (keystate_changed) memcpy( desktop->shm_keystate, desktop->keystate, sizeof(desktop->keystate) );
+
+    LIST_FOR_EACH_ENTRY( input, &desktop->inputs, struct thread_input, entry )
+    {
+        LIST_FOR_EACH_ENTRY( queue, &input->queues, struct msg_queue, input_entry )
+        {
+            shmlocal_t *shm;
+            if (!queue->thread || !(shm = queue->thread->shm)) continue;
+
+            begin_shm_input_update( shm );
+            shm->cursor_x      = desktop->cursor.x;
+            shm->cursor_y      = desktop->cursor.y;
+            shm->cursor_change = desktop->cursor.last_change;
+            if (keystate_changed)
+                memcpy( shm->desktop_keystate, desktop->keystate, sizeof(shm->desktop_keystate) );
+            end_shm_input_update( shm );
         }
     }
 }
 
+/* mark the input state in the shared memory as invalid once the thread loses its queue */
+static void invalidate_shm_thread_input( struct thread *thread )
+{
+    shmlocal_t *shm;
+
+    if (!(shm = thread->shm)) return;
+    begin_shm_input_update( shm );
+    shm->input_valid = 0;
+    end_shm_input_update( shm );
+}
+
 /* create a message queue object */
 static struct msg_queue *create_msg_queue( struct thread *thread, struct thread_input *input )
 {
@@ -340,12 +430,10 @@ static struct msg_queue *create_msg_queue( struct thread *thread, struct thread_
         for (i = 0; i < NB_MSG_KINDS; i++) list_init( &queue->msg_list[i] );
 
         thread->queue = queue;
+        update_shm_queue_bits( queue );
+        update_shm_thread_input( input );
     }
-    if (new_input)
-    {
-        update_shm_thread_input( new_input );
-        release_object( new_input );
-    }
+    if (new_input) release_object( new_input );
     return queue;
 }
 
@@ -354,6 +442,7 @@ void free_msg_queue( struct thread *thread )
 {
     remove_thread_hooks( thread );
     if (!thread->queue) return;
+    invalidate_shm_thread_input( thread );
     thread->queue->thread = NULL;
     release_object( thread->queue );
     thread->queue = NULL;
@@ -374,6 +463,7 @@ static int assign_thread_input( struct thread *thread, struct thread_input *new_
         if (queue->keystate_locked) queue->input->lock_count--;
         queue->input->cursor_count -= queue->cursor_count;
         list_remove( &queue->input_entry );
+        update_shm_thread_input( queue->input );
         release_object( queue->input );
         queue->keystate_locked = 0;
     }
@@ -481,15 +571,6 @@ static inline int is_signaled( struct msg_queue *queue )
     return ((queue->wake_bits & queue->wake_mask) || (queue->changed_bits & queue->changed_mask));
 }
 
-/* synchronize the queue state with the shared memory */
-static inline void update_shm_queue_bits( struct msg_queue *queue )
-{
-    shmlocal_t *shm;
-    if (!queue->thread) return;
-    if ((shm = queue->thread->shm))
-        shm->queue_bits = queue->wake_bits;
-}
-
 /* set some queue bits */
 static inline void set_queue_bits( struct msg_queue *queue, unsigned int bits )
 {
@@ -1060,6 +1141,7 @@ static void msg_queue_destroy( struct object *obj )
     if (queue->keystate_locked) queue->input->lock_count--;
     queue->input->cursor_count -= queue->cursor_count;
     list_remove( &queue->input_entry );
+    update_shm_thread_input( queue->input );
     release_object( queue->input );
     if (queue->hooks) release_object( queue->hooks );
     if (queue->fd) release_object( queue->fd );
@@ -1088,6 +1170,7 @@ static void thread_input_destroy( struct object *obj )
 
     assert( list_empty(&input->queues) );
     empty_msg_list( &input->msg_list );
+    list_remove( &input->entry );
     if (input->desktop)
     {
         if (input->desktop->foreground_input == input) set_foreground_input( input->desktop, NULL );
@@ -1175,6 +1258,7 @@ int attach_thread_input( struct thread *thread_from, struct thread *thread_to )
     {
         memset( input->keystate, 0, sizeof(input->keystate) );
         memset( input->shadow_keystate, 0, sizeof(input->shadow_keystate) );
+        update_shm_thread_input( input );
     }
     release_object( input );
     return ret;
@@ -1437,6 +1521,7 @@ static void update_input_key_state( struct thread_input *input, const struct mes
 {
     synchronize_input_key_state( input );
     update_key_state( input->desktop, input->keystate, msg );
+    update_shm_thread_input( input );
 }
 
 /* release the hardware message currently being processed by the given thread */
@@ -1596,7 +1681,11 @@ static void queue_hardware_message( struct desktop *desktop, struct message *msg
 
     if (is_keyboard_msg( msg ))
     {
-        if (queue_hotkey_message( desktop, msg )) return;
+        if (queue_hotkey_message( desktop, msg ))
+        {
+            update_shm_desktop_input( desktop );
+            return;
+        }
         if (desktop->keystate[VK_MENU] & 0x80) msg->lparam |= KF_ALTDOWN << 16;
         if (msg->wparam == VK_SHIFT || msg->wparam == VK_LSHIFT || msg->wparam == VK_RSHIFT)
             msg->lparam &= ~(KF_EXTENDED << 16);
@@ -1625,6 +1714,7 @@ static void queue_hardware_message( struct desktop *desktop, struct message *msg
     }
     msg->x = desktop->cursor.x;
     msg->y = desktop->cursor.y;
+    update_shm_desktop_input( desktop );
 
     if (msg->win && (thread = get_window_thread( msg->win )))
     {
@@ -1656,6 +1746,7 @@ static void queue_hardware_message( struct desktop *desktop, struct message *msg
             synchronize_input_key_state( input );
             input->lock_count++;
             thread->queue->keystate_locked = 1;
+            update_shm_thread_input( input );
         }
 
         list_add_tail( &input->msg_list, &msg->entry );
@@ -2406,6 +2497,7 @@ DECL_HANDLER(get_queue_status)
         reply->wake_bits    = queue->wake_bits;
         reply->changed_bits = queue->changed_bits;
         queue->changed_bits &= ~req->clear_bits;
+        update_shm_queue_bits( queue );
     }
     else reply->wake_bits = reply->changed_bits = 0;
 }
@@ -2531,6 +2623,7 @@ DECL_HANDLER(send_hardware_message)
         set_error( STATUS_INVALID_PARAMETER );
     }
     if (thread) release_object( thread );
+    update_shm_desktop_input( desktop );
 
     reply->new_x = desktop->cursor.x;
     reply->new_y = desktop->cursor.y;
@@ -2571,6 +2664,7 @@ DECL_HANDLER(get_message)
     {
         queue->input->lock_count--;
         queue->keystate_locked = 0;
+        update_shm_thread_input( queue->input );
     }
 
     /* first check for sent messages */
@@ -2589,6 +2683,7 @@ DECL_HANDLER(get_message)
     }
     if (filter & QS_INPUT) queue->changed_bits &= ~QS_INPUT;
     if (filter & QS_PAINT) queue->changed_bits &= ~QS_PAINT;
+    update_shm_queue_bits( queue );
 
     /* then check for posted messages */
     if ((filter & QS_POSTMESSAGE) &&
@@ -3038,7 +3133,11 @@ DECL_HANDLER(get_key_state)
         if (req->key >= 0)
         {
             reply->state = desktop->keystate[req->key & 0xff];
-            desktop->keystate[req->key & 0xff] &= ~0x40;
+            if (desktop->keystate[req->key & 0xff] & 0x40)
+            {
+                desktop->keystate[req->key & 0xff] &= ~0x40;
+                update_shm_desktop_input( desktop );
+            }
         }
         set_reply_data( desktop->keystate, size );
         release_object( desktop );
@@ -3053,6 +3152,7 @@ DECL_HANDLER(get_key_state)
             {
                 /* synchronize with desktop keystate, but _only_ if req->key is given */
                 synchronize_input_key_state( thread->queue->input );
+                update_shm_thread_input( thread->queue->input );
                 reply->state = thread->queue->input->keystate[req->key & 0xff];
             }
             set_reply_data( thread->queue->input->keystate, size );
@@ -3085,15 +3185,21 @@ DECL_HANDLER(set_key_state)
     {
         if (!(desktop = get_thread_desktop( current, 0 ))) return;
         memcpy( desktop->keystate, get_req_data(), size );
+        update_shm_desktop_input( desktop );
         release_object( desktop );
     }
     else
     {
         if (!(thread = get_thread_from_id( req->tid ))) return;
-        if (thread->queue) memcpy( thread->queue->input->keystate, get_req_data(), size );
+        if (thread->queue)
+        {
+            memcpy( thread->queue->input->keystate, get_req_data(), size );
+            update_shm_thread_input( thread->queue->input );
+        }
         if (req->async && (desktop = get_thread_desktop( thread, 0 )))
         {
             memcpy( desktop->keystate, get_req_data(), size );
+            update_shm_desktop_input( desktop );
             release_object( desktop );
         }
         release_object( thread );
@@ -35,6 +35,9 @@
 #include <string.h>
 #include <stdlib.h>
 #include <sys/stat.h>
+#ifdef HAVE_SYS_MMAN_H
+# include <sys/mman.h>
+#endif
 #include <unistd.h>
 
 #include "ntstatus.h"
@@ -75,13 +78,19 @@ struct key
     WCHAR            *class;       /* key class */
     unsigned short    namelen;     /* length of key name */
     unsigned short    classlen;    /* length of class name */
+    unsigned int      hash;        /* hash of the case-folded key name */
+    unsigned int      seq_slot;    /* index of the change counter in the global shared memory */
     struct key       *parent;      /* parent key */
     int               last_subkey; /* last in use subkey */
     int               nb_subkeys;  /* count of allocated subkeys */
     struct key      **subkeys;     /* subkeys array */
+    struct key      **subkey_hash; /* hash table of subkeys (only for keys with many subkeys) */
+    unsigned int      subkey_hash_size; /* size of the subkey hash table */
     int               last_value;  /* last in use value */
     int               nb_values;   /* count of allocated values in array */
     struct key_value *values;      /* values array */
+    int              *value_hash;  /* hash table of value indices + 1 (only for keys with many values) */
+    unsigned int      value_hash_size; /* size of the value hash table */
     unsigned int      flags;       /* flags */
     timeout_t         modif;       /* last modification time */
     struct list       notify_list; /* list of notifications */
@@ -100,6 +109,7 @@ struct key_value
 {
     WCHAR            *name;    /* value name */
     unsigned short    namelen; /* length of value name */
+    unsigned int      hash;    /* hash of the case-folded value name */
     unsigned int      type;    /* value type */
     data_size_t       len;     /* value data length in bytes */
     void             *data;    /* pointer to value data */
@@ -107,12 +117,14 @@ struct key_value
 
 #define MIN_SUBKEYS  8   /* min. number of allocated subkeys per key */
 #define MIN_VALUES   8   /* min. number of allocated values per key */
+#define MIN_HASHED   32  /* min. number of subkeys or values to build a hash table */
 
 #define MAX_NAME_LEN  256    /* max. length of a key name */
 #define MAX_VALUE_LEN 16383  /* max. length of a value name */
 
 /* the root of the registry tree */
 static struct key *root_key;
+static unsigned int next_seq_slot;  /* next change counter to assign to a key */
 
 static const timeout_t ticks_1601_to_1970 = (timeout_t)86400 * (369 * 365 + 89) * TICKS_PER_SEC;
 static const timeout_t save_period = 30 * -TICKS_PER_SEC;  /* delay between periodic saves */
@@ -132,6 +144,12 @@ struct save_branch_info
 {
     struct key  *key;
     const char  *path;
+    char        *hive_path;     /* path of the binary hive */
+    char        *journal_path;  /* path of the change journal */
+    timeout_t    generation;    /* generation of the binary hive, 0 if there is none */
+    file_pos_t   hive_size;     /* size of the binary hive */
+    file_pos_t   journal_size;  /* size of the valid part of the journal, 0 if there is none */
+    int          text_stale;    /* the text file is older than the hive and journal */
 };
 
 #define MAX_SAVE_BRANCH_INFO 3
@@ -413,12 +431,21 @@ static struct security_descriptor *key_get_sd( struct object *obj )
     return key_default_sd;
 }
 
+/* bump the change counter of a key, so that clients discard their cached values */
+static void invalidate_key( struct key *key )
+{
+    if (shmglobal) shmglobal->registry_seq[key->seq_slot]++;
+}
+
 /* close the notification associated with a handle */
 static int key_close_handle( struct object *obj, struct process *process, obj_handle_t handle )
 {
     struct key * key = (struct key *) obj;
     struct notify *notify = find_notify( key, process, handle );
     if (notify) do_notification( key, notify, 1 );
+    /* the owner caches values by handle, and doesn't know that this handle value
+     * may now be reused for another key */
+    if (!current || process != current->process) invalidate_key( key );
     return 1;  /* ok to close */
 }
 
@@ -437,12 +464,14 @@ static void key_destroy( struct object *obj )
         free( key->values[i].data );
     }
     free( key->values );
+    free( key->value_hash );
     for (i = 0; i <= key->last_subkey; i++)
     {
         key->subkeys[i]->parent = NULL;
         release_object( key->subkeys[i] );
     }
     free( key->subkeys );
+    free( key->subkey_hash );
     /* unconditionally notify everything waiting on this key */
     while ((ptr = list_head( &key->notify_list )))
     {
@@ -492,6 +521,15 @@ static struct unicode_str *get_path_token( const struct unicode_str *path, struc
     return token;
 }
 
+/* compute the hash of a name, ignoring case */
+static unsigned int hash_name( const WCHAR *name, data_size_t len )
+{
+    unsigned int i, hash = 2166136261u;
+
+    for (i = 0; i < len / sizeof(WCHAR); i++) hash = (hash ^ tolowerW( name[i] )) * 16777619;
+    return hash;
+}
+
 /* allocate a key object */
 static struct key *alloc_key( const struct unicode_str *name, timeout_t modif )
 {
@@ -502,13 +540,19 @@ static struct key *alloc_key( const struct unicode_str *name, timeout_t modif )
         key->class       = NULL;
         key->namelen     = name->len;
         key->classlen    = 0;
+        key->hash        = hash_name( name->str, name->len );
+        key->seq_slot    = next_seq_slot++ % REGISTRY_SEQ_SLOTS;
         key->flags       = 0;
         key->last_subkey = -1;
         key->nb_subkeys  = 0;
         key->subkeys     = NULL;
+        key->subkey_hash = NULL;
+        key->subkey_hash_size = 0;
         key->nb_values   = 0;
         key->last_value  = -1;
         key->values      = NULL;
+        key->value_hash  = NULL;
+        key->value_hash_size = 0;
         key->modif       = modif;
         key->parent      = NULL;
         list_init( &key->notify_list );
@@ -563,6 +607,7 @@ static void touch_key( struct key *key, unsigned int change )
 
     key->modif = current_time;
     make_dirty( key );
+    invalidate_key( key );
 
     /* do notifications */
     check_notify( key, change, 1 );
@@ -570,6 +615,62 @@ static void touch_key( struct key *key, unsigned int change )
         check_notify( k, change & ~REG_NOTIFY_CHANGE_LAST_SET, 0 );
 }
 
+/* add a subkey to the hash table of its parent */
+static void subkey_hash_insert( struct key *parent, struct key *key )
+{
+    unsigned int mask = parent->subkey_hash_size - 1, i = key->hash & mask;
+
+    while (parent->subkey_hash[i]) i = (i + 1) & mask;
+    parent->subkey_hash[i] = key;
+}
+
+/* remove a subkey from the hash table of its parent */
+static void subkey_hash_remove( struct key *parent, struct key *key )
+{
+    unsigned int mask = parent->subkey_hash_size - 1, i = key->hash & mask, j, home;
+
+    while (parent->subkey_hash[i] != key) i = (i + 1) & mask;
+    /* move back the following entries of the cluster that would no longer be found */
+    for (j = (i + 1) & mask; parent->subkey_hash[j]; j = (j + 1) & mask)
+    {
+        home = parent->subkey_hash[j]->hash & mask;
+        if (((j - home) & mask) < ((j - i) & mask)) continue;
+        parent->subkey_hash[i] = parent->subkey_hash[j];
+        i = j;
+    }
+    parent->subkey_hash[i] = NULL;
+}
+
+/* update the subkey hash table after adding a subkey, building or growing it if needed */
+static void update_subkey_hash( struct key *parent, struct key *key )
+{
+    struct key **table;
+    unsigned int size = parent->subkey_hash_size;
+    int i, count = parent->last_subkey + 1;
+
+    if (count < MIN_HASHED) return;
+    if (parent->subkey_hash && count * 2 <= size)
+    {
+        subkey_hash_insert( parent, key );
+        return;
+    }
+    /* keep the load factor below 1/2 */
+    if (!size) size = MIN_HASHED;
+    while (count * 2 > size) size *= 2;
+    /* the hash table is only an optimization, failing to allocate it is not an error */
+    if (!(table = calloc( size, sizeof(*table) )))
+    {
+        free( parent->subkey_hash );
+        parent->subkey_hash = NULL;
+        parent->subkey_hash_size = 0;
+        return;
+    }
+    free( parent->subkey_hash );
+    parent->subkey_hash = table;
+    parent->subkey_hash_size = size;
+    for (i = 0; i < count; i++) subkey_hash_insert( parent, parent->subkeys[i] );
+}
+
 /* try to grow the array of subkeys; return 1 if OK, 0 on error */
 static int grow_subkeys( struct key *key )
 {
@@ -600,7 +701,6 @@ static struct key *alloc_subkey( struct key *parent, const struct unicode_str *n
                                  int index, timeout_t modif )
 {
     struct key *key;
-    int i;
 
     if (name->len > MAX_NAME_LEN * sizeof(WCHAR))
     {
@@ -615,9 +715,11 @@ static struct key *alloc_subkey( struct key *parent, const struct unicode_str *n
     if ((key = alloc_key( name, modif )) != NULL)
     {
         key->parent = parent;
-        for (i = ++parent->last_subkey; i > index; i--)
-            parent->subkeys[i] = parent->subkeys[i-1];
+        memmove( parent->subkeys + index + 1, parent->subkeys + index,
+                 (parent->last_subkey - index + 1) * sizeof(*parent->subkeys) );
+        parent->last_subkey++;
         parent->subkeys[index] = key;
+        update_subkey_hash( parent, key );
         if (is_wow6432node( key->name, key->namelen ) && !is_wow6432node( parent->name, parent->namelen ))
             parent->flags |= KEY_WOW64;
     }
@@ -628,15 +730,18 @@ static struct key *alloc_subkey( struct key *parent, const struct unicode_str *n
 static void free_subkey( struct key *parent, int index )
 {
     struct key *key;
-    int i, nb_subkeys;
+    int nb_subkeys;
 
     assert( index >= 0 );
     assert( index <= parent->last_subkey );
 
     key = parent->subkeys[index];
-    for (i = index; i < parent->last_subkey; i++) parent->subkeys[i] = parent->subkeys[i + 1];
+    if (parent->subkey_hash) subkey_hash_remove( parent, key );
+    memmove( parent->subkeys + index, parent->subkeys + index + 1,
+             (parent->last_subkey - index) * sizeof(*parent->subkeys) );
     parent->last_subkey--;
     key->flags |= KEY_DELETED;
+    invalidate_key( key );
     key->parent = NULL;
     if (is_wow6432node( key->name, key->namelen )) parent->flags &= ~KEY_WOW64;
     release_object( key );
@@ -654,8 +759,8 @@ static void free_subkey( struct key *parent, int index )
     }
 }
 
-/* find the named child of a given key and return its index */
-static struct key *find_subkey( const struct key *key, const struct unicode_str *name, int *index )
+/* find the named child of a given key in the sorted array and return its index */
+static struct key *find_sorted_subkey( const struct key *key, const struct unicode_str *name, int *index )
 {
     int i, min, max, res;
     data_size_t len;
@@ -680,6 +785,25 @@ static struct key *find_subkey( const struct key *key, const struct unicode_str
     return NULL;
 }
 
+/* find the named child of a given key */
+/* the index is only returned if the key doesn't exist, as the position where to insert it */
+static struct key *find_subkey( const struct key *key, const struct unicode_str *name, int *index )
+{
+    if (key->subkey_hash)
+    {
+        unsigned int mask = key->subkey_hash_size - 1, hash = hash_name( name->str, name->len ), i;
+        struct key *subkey;
+
+        for (i = hash & mask; (subkey = key->subkey_hash[i]); i = (i + 1) & mask)
+        {
+            if (subkey->hash == hash && subkey->namelen == name->len &&
+                !memicmpW( subkey->name, name->str, name->len / sizeof(WCHAR) ))
+                return subkey;
+        }
+    }
+    return find_sorted_subkey( key, name, index );
+}
+
 /* return the wow64 variant of the key, or the key itself if none */
 static struct key *find_wow64_subkey( struct key *key, const struct unicode_str *name )
 {
@@ -1005,7 +1129,8 @@ static void enum_key( const struct key *key, int index, int info_class,
 static int delete_key( struct key *key, int recurse )
 {
     int index;
-    struct key *parent = key->parent;
+    struct key *parent = key->parent, *found;
+    struct unicode_str name;
 
     /* must find parent and index */
     if (key == root_key)
@@ -1019,9 +1144,10 @@ static int delete_key( struct key *key, int recurse )
         if (0 > delete_key(key->subkeys[key->last_subkey], 1))
             return -1;
 
-    for (index = 0; index <= parent->last_subkey; index++)
-        if (parent->subkeys[index] == key) break;
-    assert( index <= parent->last_subkey );
+    name.str = key->name;
+    name.len = key->namelen;
+    found = find_sorted_subkey( parent, &name, &index );
+    assert( found == key );
 
     /* we can only delete a key that has no subkeys */
     if (key->last_subkey >= 0)
@@ -1061,12 +1187,95 @@ static int grow_values( struct key *key )
     return 1;
 }
 
+/* add a value index to the value hash table of a key */
+static void value_hash_insert( struct key *key, int index )
+{
+    unsigned int mask = key->value_hash_size - 1, i = key->values[index].hash & mask;
+
+    while (key->value_hash[i]) i = (i + 1) & mask;
+    key->value_hash[i] = index + 1;
+}
+
+/* remove a value index from the value hash table of a key */
+static void value_hash_remove( struct key *key, int index )
+{
+    unsigned int mask = key->value_hash_size - 1, i = key->values[index].hash & mask, j, home;
+
+    while (key->value_hash[i] != index + 1) i = (i + 1) & mask;
+    /* move back the following entries of the cluster that would no longer be found */
+    for (j = (i + 1) & mask; key->value_hash[j]; j = (j + 1) & mask)
+    {
+        home = key->values[key->value_hash[j] - 1].hash & mask;
+        if (((j - home) & mask) < ((j - i) & mask)) continue;
+        key->value_hash[i] = key->value_hash[j];
+        i = j;
+    }
+    key->value_hash[i] = 0;
+}
+
+/* shift the value indices in the hash table after inserting or removing a value */
+static void value_hash_shift( struct key *key, int index, int delta )
+{
+    unsigned int i;
+
+    for (i = 0; i < key->value_hash_size; i++)
+        if (key->value_hash[i] > index) key->value_hash[i] += delta;
+}
+
+/* update the value hash table after inserting a value, building or growing it if needed */
+static void update_value_hash( struct key *key, int index )
+{
+    int *table;
+    unsigned int size = key->value_hash_size;
+    int i, count = key->last_value + 1;
+
+    if (count < MIN_HASHED) return;
+    if (key->value_hash && count * 2 <= size)
+    {
+        if (index < key->last_value) value_hash_shift( key, index, 1 );
+        value_hash_insert( key, index );
+        return;
+    }
+    /* keep the load factor below 1/2 */
+    if (!size) size = MIN_HASHED;
+    while (count * 2 > size) size *= 2;
+    /* the hash table is only an optimization, failing to allocate it is not an error */
+    if (!(table = calloc( size, sizeof(*table) )))
+    {
+        free( key->value_hash );
+        key->value_hash = NULL;
+        key->value_hash_size = 0;
+        return;
+    }
+    free( key->value_hash );
+    key->value_hash = table;
+    key->value_hash_size = size;
+    for (i = 0; i < count; i++) value_hash_insert( key, i );
+}
+
 /* find the named value of a given key and return its index in the array */
 static struct key_value *find_value( const struct key *key, const struct unicode_str *name, int *index )
 {
     int i, min, max, res;
     data_size_t len;
 
+    if (key->value_hash)
+    {
+        unsigned int mask = key->value_hash_size - 1, hash = hash_name( name->str, name->len ), pos;
+        struct key_value *value;
+
+        for (pos = hash & mask; (i = key->value_hash[pos]); pos = (pos + 1) & mask)
+        {
+            value = &key->values[i - 1];
+            if (value->hash == hash && value->namelen == name->len &&
+                !memicmpW( value->name, name->str, name->len / sizeof(WCHAR) ))
+            {
+                *index = i - 1;
+                return value;
+            }
+        }
+    }
+
     min = 0;
     max = key->last_value;
     while (min <= max)
@@ -1092,7 +1301,6 @@ static struct key_value *insert_value( struct key *key, const struct unicode_str
 {
     struct key_value *value;
     WCHAR *new_name = NULL;
-    int i;
 
     if (name->len > MAX_VALUE_LEN * sizeof(WCHAR))
     {
@@ -1104,12 +1312,17 @@ static struct key_value *insert_value( struct key *key, const struct unicode_str
         if (!grow_values( key )) return NULL;
     }
     if (name->len && !(new_name = memdup( name->str, name->len ))) return NULL;
-    for (i = ++key->last_value; i > index; i--) key->values[i] = key->values[i - 1];
+    memmove( key->values + index + 1, key->values + index,
+             (key->last_value - index + 1) * sizeof(*key->values) );
+    key->last_value++;
     value = &key->values[index];
     value->name    = new_name;
     value->namelen = name->len;
+    value->hash    = hash_name( name->str, name->len );
     value->len     = 0;
     value->data    = NULL;
+    update_value_hash( key, index );
+    invalidate_key( key );
     return value;
 }
 
@@ -1236,7 +1449,7 @@ static void enum_value( struct key *key, int i, int info_class, struct enum_key_
 static void delete_value( struct key *key, const struct unicode_str *name )
 {
     struct key_value *value;
-    int i, index, nb_values;
+    int index, nb_values;
 
     if (!(value = find_value( key, name, &index )))
     {
@@ -1246,7 +1459,13 @@ static void delete_value( struct key *key, const struct unicode_str *name )
     if (debug_level > 1) dump_operation( key, value, "Delete" );
     free( value->name );
     free( value->data );
-    for (i = index; i < key->last_value; i++) key->values[i] = key->values[i + 1];
+    if (key->value_hash)
+    {
+        value_hash_remove( key, index );
+        value_hash_shift( key, index + 1, -1 );
+    }
+    memmove( key->values + index, key->values + index + 1,
+             (key->last_value - index) * sizeof(*key->values) );
     key->last_value--;
     touch_key( key, REG_NOTIFY_CHANGE_LAST_SET );
 
@@ -1603,6 +1822,7 @@ static int load_value( struct key *key, const char *buffer, struct file_load_inf
     value->data = newptr;
     value->len  = len;
     value->type = type;
+    invalidate_key( key );
     return 1;
 
  error:
@@ -1734,28 +1954,728 @@ static void load_registry( struct key *key, obj_handle_t handle )
     }
 }
 
+/*
+ * Binary hive format
+ *
+ * The text files remain the interchange format, but in order to avoid parsing
+ * them at startup and rewriting them completely on every periodic save, the
+ * registry branches can also be stored as a native binary hive, along with an
+ * append-only journal of the keys modified since the hive was written. Both
+ * files are only used as long as the text file hasn't been modified since the
+ * hive was created. The text file is rewritten on shutdown.
+ *
+ * Every write to the hive or journal is synced to disk before the keys are
+ * marked clean, so that after a crash the hive and the replayed journal
+ * contain all the changes of the last successful save.
+ */
+
+#define HIVE_MAGIC        "WINEHIVE"
+#define JOURNAL_MAGIC     "WINEJRNL"
+#define HIVE_VERSION      1
+#define HIVE_TEXT_CURRENT 0x0001  /* hive contents match the text file */
+#define MIN_JOURNAL_COMPACT (1024 * 1024)  /* min. journal size before writing a new hive */
+
+struct hive_header
+{
+    char          magic[8];     /* HIVE_MAGIC */
+    unsigned int  version;      /* HIVE_VERSION, also used to check the byte order */
+    unsigned int  prefix_type;  /* prefix type of the registry */
+    unsigned int  flags;        /* HIVE_* flags */
+    unsigned int  padding;
+    timeout_t     generation;   /* unique generation of the hive, referenced by the journal */
+    timeout_t     text_mtime;   /* modification time of the text file the hive was created with */
+    file_pos_t    text_size;    /* size of the text file */
+    file_pos_t    text_ino;     /* inode of the text file */
+};
+
+struct journal_header
+{
+    char          magic[8];     /* JOURNAL_MAGIC */
+    unsigned int  version;      /* HIVE_VERSION */
+    unsigned int  padding;
+    timeout_t     generation;   /* generation of the hive the journal applies to */
+};
+
+/* a journal record, followed by the key path relative to the branch and the key data */
+struct journal_record
+{
+    data_size_t   size;         /* size of the record data */
+    unsigned int  checksum;     /* checksum of the record data */
+    data_size_t   pathlen;      /* length of the key path */
+};
+
+/* a key, followed by its name, class, values and subkeys */
+/* in the hive the subkeys are stored recursively, in the journal only their names are stored */
+struct hive_key
+{
+    unsigned short namelen;     /* length of key name */
+    unsigned short classlen;    /* length of class name */
+    unsigned int   flags;       /* key flags (only KEY_SYMLINK) */
+    timeout_t      modif;       /* last modification time */
+    unsigned int   nb_values;   /* number of values */
+    unsigned int   nb_subkeys;  /* number of subkeys */
+};
+
+/* a value, followed by its name and data */
+struct hive_value
+{
+    unsigned short namelen;     /* length of value name */
+    unsigned short padding;
+    unsigned int   type;        /* value type */
+    data_size_t    len;         /* value data length in bytes */
+};
+
+/* a hive or journal being written, either to a file or to a memory buffer */
+struct hive_writer
+{
+    FILE         *file;         /* output file, NULL to write to the buffer */
+    char         *buffer;       /* output buffer */
+    size_t        len;          /* length of data in the buffer */
+    size_t        size;         /* size of the buffer */
+    int           error;        /* an error occurred */
+};
+
+/* a hive or journal being read */
+struct hive_reader
+{
+    const char   *ptr;          /* current position */
+    const char   *end;          /* end of data */
+};
+
+/* check if the registry branches should be saved to a binary hive */
+static int use_binary_hive(void)
+{
+    static int use_hive_cached = -1;
+
+    if (use_hive_cached == -1)
+    {
+        const char *str = getenv( "WINEREGHIVE" );
+        use_hive_cached = str && atoi( str );
+    }
+    return use_hive_cached;
+}
+
+/* compare two key or value names, using the ordering of the subkeys and values arrays */
+static int compare_names( const WCHAR *str1, data_size_t len1, const WCHAR *str2, data_size_t len2 )
+{
+    int res = memicmpW( str1, str2, min( len1, len2 ) / sizeof(WCHAR) );
+    if (!res) res = len1 - len2;
+    return res;
+}
+
+/* compute the checksum of a journal record */
+static unsigned int hive_checksum( const void *data, size_t len )
+{
+    const unsigned char *ptr = data;
+    unsigned int sum = 0;
+
+    while (len--) sum = (sum << 5) + (sum >> 27) + *ptr++;
+    return sum;
+}
+
+/* flush a hive or journal file to disk */
+static void hive_sync( struct hive_writer *writer )
+{
+    if (writer->error) return;
+    if (fflush( writer->file ) || fsync( fileno( writer->file ) ) == -1) writer->error = 1;
+}
+
+/* write some data to a hive or journal */
+static void hive_put( struct hive_writer *writer, const void *data, size_t len )
+{
+    if (writer->error || !len) return;
+    if (writer->file)
+    {
+        if (fwrite( data, len, 1, writer->file ) != 1) writer->error = 1;
+        return;
+    }
+    if (writer->len + len > writer->size)
+    {
+        size_t size = max( writer->size * 2, writer->len + len );
+        char *buffer;
+
+        if (!(buffer = realloc( writer->buffer, size )))
+        {
+            writer->error = 1;
+            return;
+        }
+        writer->buffer = buffer;
+        writer->size = size;
+    }
+    memcpy( writer->buffer + writer->len, data, len );
+    writer->len += len;
+}
+
+/* write the padding that follows variable length data, to keep the alignment */
+static void hive_put_padding( struct hive_writer *writer, size_t len )
+{
+    static const char padding[3];
+
+    hive_put( writer, padding, (4 - len % 4) % 4 );
+}
+
+/* write variable length data to a hive or journal */
+static void hive_put_data( struct hive_writer *writer, const void *data, size_t len )
+{
+    hive_put( writer, data, len );
+    hive_put_padding( writer, len );
+}
+
+/* read some data from a hive or journal */
+static const void *hive_get( struct hive_reader *reader, size_t len )
+{
+    const char *ptr = reader->ptr;
+
+    if ((size_t)(reader->end - ptr) < len) return NULL;
+    reader->ptr += len;
+    return ptr;
+}
+
+/* read variable length data from a hive or journal */
+static const void *hive_get_data( struct hive_reader *reader, size_t len )
+{
+    const char *ptr = reader->ptr;
+
+    if (!hive_get( reader, len )) return NULL;
+    if (!hive_get( reader, (4 - len % 4) % 4 )) return NULL;
+    return ptr;
+}
+
+/* write a key to a hive or journal; in the journal, only the subkey names are written */
+static void save_hive_key( struct hive_writer *writer, const struct key *key, int journal )
+{
+    struct hive_key hdr;
+    struct hive_value val;
+    unsigned short len;
+    int i;
+
+    hdr.namelen    = key->namelen;
+    hdr.classlen   = key->classlen;
+    hdr.flags      = key->flags & KEY_SYMLINK;
+    hdr.modif      = key->modif;
+    hdr.nb_values  = key->last_value + 1;
+    hdr.nb_subkeys = 0;
+    for (i = 0; i <= key->last_subkey; i++)
+        if (!(key->subkeys[i]->flags & KEY_VOLATILE)) hdr.nb_subkeys++;
+
+    hive_put( writer, &hdr, sizeof(hdr) );
+    hive_put_data( writer, key->name, key->namelen );
+    hive_put_data( writer, key->class, key->classlen );
+    for (i = 0; i <= key->last_value; i++)
+    {
+        val.namelen = key->values[i].namelen;
+        val.padding = 0;
+        val.type    = key->values[i].type;
+        val.len     = key->values[i].len;
+        hive_put( writer, &val, sizeof(val) );
+        hive_put_data( writer, key->values[i].name, val.namelen );
+        hive_put_data( writer, key->values[i].data, val.len );
+    }
+    for (i = 0; i <= key->last_subkey; i++)
+    {
+        const struct key *subkey = key->subkeys[i];
+
+        if (subkey->flags & KEY_VOLATILE) continue;
+        if (journal)
+        {
+            len = subkey->namelen;
+            hive_put( writer, &len, sizeof(len) );
+            hive_put_data( writer, subkey->name, len );
+        }
+        else save_hive_key( writer, subkey, 0 );
+    }
+}
+
+/* write the path of a key relative to the branch base */
+static void save_hive_path( struct hive_writer *writer, const struct key *key, const struct key *base )
+{
+    static const WCHAR backslash = '\\';
+
+    if (key == base) return;
+    if (key->parent != base)
+    {
+        save_hive_path( writer, key->parent, base );
+        hive_put( writer, &backslash, sizeof(backslash) );
+    }
+    hive_put( writer, key->name, key->namelen );
+}
+
+/* map a hive or journal file in memory */
+static const char *map_hive_file( const char *path, size_t *size )
+{
+    struct stat st;
+    char *ptr = NULL;
+    int fd;
+
+    if ((fd = open( path, O_RDONLY )) == -1) return NULL;
+    if (fstat( fd, &st ) != -1 && S_ISREG( st.st_mode ) && st.st_size > 0)
+    {
+        *size = st.st_size;
+#ifdef HAVE_SYS_MMAN_H
+        if ((ptr = mmap( NULL, *size, PROT_READ, MAP_PRIVATE, fd, 0 )) == MAP_FAILED) ptr = NULL;
+#else
+        if ((ptr = malloc( *size )) && read( fd, ptr, *size ) != (ssize_t)*size)
+        {
+            free( ptr );
+            ptr = NULL;
+        }
+#endif
+    }
+    close( fd );
+    return ptr;
+}
+
+/* unmap a file mapped with map_hive_file */
+static void unmap_hive_file( const char *ptr, size_t size )
+{
+#ifdef HAVE_SYS_MMAN_H
+    munmap( (void *)ptr, size );
+#else
+    free( (void *)ptr );
+#endif
+}
+
+/* free all the values of a key */
+static void free_values( struct key *key )
+{
+    int i;
+
+    for (i = 0; i <= key->last_value; i++)
+    {
+        free( key->values[i].name );
+        free( key->values[i].data );
+    }
+    key->last_value = -1;
+    free( key->value_hash );
+    key->value_hash = NULL;
+    key->value_hash_size = 0;
+    invalidate_key( key );
+}
+
+/* read a key header and name from a hive or journal */
+static int load_hive_key_header( struct hive_reader *reader, struct hive_key *hdr, struct unicode_str *name )
+{
+    const void *ptr;
+
+    if (!(ptr = hive_get( reader, sizeof(*hdr) ))) return 0;
+    memcpy( hdr, ptr, sizeof(*hdr) );
+    if ((hdr->namelen | hdr->classlen) % sizeof(WCHAR)) return 0;
+    if (!(name->str = hive_get_data( reader, hdr->namelen ))) return 0;
+    name->len = hdr->namelen;
+    return 1;
+}
+
+/* load the class, flags and values of a key from a hive or journal */
+static int load_hive_key_data( struct key *key, const struct hive_key *hdr, struct hive_reader *reader )
+{
+    const struct hive_value *ptr;
+    struct hive_value val;
+    struct key_value *value;
+    struct unicode_str name;
+    const void *data;
+    unsigned int i;
+    int index;
+
+    if (!(data = hive_get_data( reader, hdr->classlen ))) return 0;
+    free( key->class );
+    key->class = NULL;
+    key->classlen = 0;
+    if (hdr->classlen)
+    {
+        if (!(key->class = memdup( data, hdr->classlen ))) return 0;
+        key->classlen = hdr->classlen;
+    }
+    key->flags = (key->flags & ~KEY_SYMLINK) | (hdr->flags & KEY_SYMLINK);
+    key->modif = hdr->modif;
+
+    for (i = 0; i < hdr->nb_values; i++)
+    {
+        if (!(ptr = hive_get( reader, sizeof(val) ))) return 0;
+        memcpy( &val, ptr, sizeof(val) );
+        if (val.namelen % sizeof(WCHAR)) return 0;
+        if (!(name.str = hive_get_data( reader, val.namelen ))) return 0;
+        name.len = val.namelen;
+        if (!(data = hive_get_data( reader, val.len ))) return 0;
+        /* values are stored sorted, so they are always appended */
+        if (find_value( key, &name, &index ) || index != key->last_value + 1) return 0;
+        if (!(value = insert_value( key, &name, index ))) return 0;
+        value->type = val.type;
+        if (val.len && !(value->data = memdup( data, val.len ))) return 0;
+        value->len = val.len;
+    }
+    return 1;
+}
+
+/* load a key and its subkeys from a hive */
+static int load_hive_key( struct key *key, const struct hive_key *hdr, struct hive_reader *reader )
+{
+    struct hive_key subhdr;
+    struct unicode_str name;
+    struct key *subkey;
+    unsigned int i;
+    int index;
+
+    if (!load_hive_key_data( key, hdr, reader )) return 0;
+    for (i = 0; i < hdr->nb_subkeys; i++)
+    {
+        if (!load_hive_key_header( reader, &subhdr, &name )) return 0;
+        /* subkeys are stored sorted, so they are always appended */
+        if (find_sorted_subkey( key, &name, &index ) || index != key->last_subkey + 1) return 0;
+        if (!(subkey = alloc_subkey( key, &name, index, subhdr.modif ))) return 0;
+        if (!load_hive_key( subkey, &subhdr, reader )) return 0;
+    }
+    return 1;
+}
+
+/* replay a journal record on a branch of the registry */
+static int load_journal_record( struct key *base, struct hive_reader *reader, data_size_t pathlen )
+{
+    struct unicode_str path, token, name, *names;
+    struct hive_key hdr;
+    struct key *key = base, *subkey;
+    const unsigned short *ptr;
+    unsigned int i;
+    int index, ret = 0;
+
+    if (pathlen % sizeof(WCHAR) || !(path.str = hive_get_data( reader, pathlen ))) return 0;
+    path.len = pathlen;
+
+    /* find the key, creating it if needed */
+    token.str = NULL;
+    if (!get_path_token( &path, &token )) return 0;
+    while (token.len)
+    {
+        if (!(subkey = find_subkey( key, &token, &index )) &&
+            !(subkey = alloc_subkey( key, &token, index, current_time ))) return 0;
+        key = subkey;
+        get_path_token( &path, &token );
+    }
+
+    if (!load_hive_key_header( reader, &hdr, &name )) return 0;
+    free_values( key );
+    if (!load_hive_key_data( key, &hdr, reader )) return 0;
+
+    /* the record contains the full list of subkeys, remove the ones that have been deleted */
+    if (!(names = mem_alloc( max( hdr.nb_subkeys, 1 ) * sizeof(*names) ))) return 0;
+    for (i = 0; i < hdr.nb_subkeys; i++)
+    {
+        if (!(ptr = hive_get( reader, sizeof(*ptr) ))) goto done;
+        names[i].len = *ptr;
+        if (names[i].len % sizeof(WCHAR) || !(names[i].str = hive_get_data( reader, names[i].len ))) goto done;
+        if (i && compare_names( names[i - 1].str, names[i - 1].len, names[i].str, names[i].len ) >= 0)
+            goto done;
+    }
+    for (index = key->last_subkey; index >= 0; index--)
+    {
+        int min = 0, max = hdr.nb_subkeys - 1, res = -1;
+
+        subkey = key->subkeys[index];
+        while (min <= max)
+        {
+            i = (min + max) / 2;
+            if (!(res = compare_names( names[i].str, names[i].len, subkey->name, subkey->namelen ))) break;
+            if (res > 0) max = i - 1;
+            else min = i + 1;
+        }
+        if (res && !(subkey->flags & KEY_VOLATILE)) free_subkey( key, index );
+    }
+    for (i = 0; i < hdr.nb_subkeys; i++)
+    {
+        if (find_subkey( key, &names[i], &index )) continue;
+        if (!alloc_subkey( key, &names[i], index, hdr.modif )) goto done;
+    }
+    ret = 1;
+
+done:
+    free( names );
+    return ret;
+}
+
+/* replay the journal of a registry branch; return the number of records */
+static int load_journal( struct save_branch_info *info )
+{
+    struct journal_header header;
+    struct journal_record record;
+    struct hive_reader reader, data;
+    const char *base;
+    const void *ptr;
+    size_t size;
+    int count = 0;
+
+    info->journal_size = 0;
+    if (!(base = map_hive_file( info->journal_path, &size ))) return 0;
+    reader.ptr = base;
+    reader.end = base + size;
+    if (!(ptr = hive_get( &reader, sizeof(header) ))) goto done;
+    memcpy( &header, ptr, sizeof(header) );
+    if (memcmp( header.magic, JOURNAL_MAGIC, sizeof(header.magic) ) ||
+        header.version != HIVE_VERSION || header.generation != info->generation) goto done;
+
+    /* stop at the first incomplete or corrupted record, the next save will truncate the file */
+    for (;;)
+    {
+        info->journal_size = reader.ptr - base;
+        if (!(ptr = hive_get( &reader, sizeof(record) ))) break;
+        memcpy( &record, ptr, sizeof(record) );
+        if (!(data.ptr = hive_get( &reader, record.size ))) break;
+        if (hive_checksum( data.ptr, record.size ) != record.checksum) break;
+        data.end = data.ptr + record.size;
+        if (!load_journal_record( info->key, &data, record.pathlen ))
+        {
+            fprintf( stderr, "%s: invalid journal record\n", info->journal_path );
+            break;
+        }
+        count++;
+    }
+
+done:
+    unmap_hive_file( base, size );
+    return count;
+}
+
+/* load a registry branch from its binary hive and journal */
+static int load_hive( struct save_branch_info *info )
+{
+    struct hive_header header;
+    struct hive_reader reader;
+    struct hive_key hdr;
+    struct unicode_str name;
+    struct key *key = info->key;
+    struct stat st;
+    const char *base;
+    const void *ptr;
+    size_t size;
+    int ret = 0;
+
+    if (!info->hive_path || !info->journal_path) return 0;
+    if (!(base = map_hive_file( info->hive_path, &size ))) return 0;
+    reader.ptr = base;
+    reader.end = base + size;
+    if (!(ptr = hive_get( &reader, sizeof(header) ))) goto done;
+    memcpy( &header, ptr, sizeof(header) );
+    if (memcmp( header.magic, HIVE_MAGIC, sizeof(header.magic) ) || header.version != HIVE_VERSION)
+        goto done;
+    if (prefix_type != PREFIX_UNKNOWN && header.prefix_type != PREFIX_UNKNOWN &&
+        header.prefix_type != prefix_type) goto done;
+
+    /* ignore the hive if the text file has been modified since it was created */
+    memset( &st, 0, sizeof(st) );
+    stat( info->path, &st );
+    if (header.text_mtime != st.st_mtime || header.text_size != st.st_size ||
+        header.text_ino != st.st_ino) goto done;
+
+    if (!load_hive_key_header( &reader, &hdr, &name ) || !load_hive_key( key, &hdr, &reader ) ||
+        reader.ptr != reader.end)
+    {
+        fprintf( stderr, "%s is not a valid registry hive, using %s\n", info->hive_path, info->path );
+        while (key->last_subkey >= 0) free_subkey( key, key->last_subkey );
+        free_values( key );
+        free( key->class );
+        key->class = NULL;
+        key->classlen = 0;
+        goto done;
+    }
+
+    if (header.prefix_type != PREFIX_UNKNOWN) prefix_type = header.prefix_type;
+    info->generation = header.generation;
+    info->hive_size  = size;
+    info->text_stale = !(header.flags & HIVE_TEXT_CURRENT);
+    if (load_journal( info )) info->text_stale = 1;
+    ret = 1;
+
+done:
+    unmap_hive_file( base, size );
+    return ret;
+}
+
+/* write a new binary hive for a registry branch, and reset its journal */
+static int save_hive( struct save_branch_info *info, int text_current )
+{
+    struct hive_header header;
+    struct journal_header journal;
+    struct hive_writer writer;
+    struct stat st;
+    char *tmp;
+    int ret = 0;
+
+    if (!info->hive_path || !info->journal_path) return 0;
+    if (!(tmp = malloc( strlen( info->hive_path ) + sizeof(".tmp") ))) return 0;
+    sprintf( tmp, "%s.tmp", info->hive_path );
+
+    memset( &header, 0, sizeof(header) );
+    memcpy( header.magic, HIVE_MAGIC, sizeof(header.magic) );
+    header.version     = HIVE_VERSION;
+    header.prefix_type = prefix_type;
+    header.flags       = text_current ? HIVE_TEXT_CURRENT : 0;
+    header.generation  = max( current_time, info->generation + 1 );
+    if (!stat( info->path, &st ))
+    {
+        header.text_mtime = st.st_mtime;
+        header.text_size  = st.st_size;
+        header.text_ino   = st.st_ino;
+    }
+
+    memset( &writer, 0, sizeof(writer) );
+    if (!(writer.file = fopen( tmp, "w" ))) goto done;
+    if (debug_level > 1)
+    {
+        fprintf( stderr, "%s: ", info->hive_path );
+        dump_operation( info->key, NULL, "saving" );
+    }
+    hive_put( &writer, &header, sizeof(header) );
+    save_hive_key( &writer, info->key, 0 );
+    info->hive_size = ftell( writer.file );
+    hive_sync( &writer );
+    ret = !fclose( writer.file ) && !writer.error && !rename( tmp, info->hive_path );
+    if (!ret)
+    {
+        unlink( tmp );
+        goto done;
+    }
+    info->generation = header.generation;
+    info->text_stale |= !text_current;
+    make_clean( info->key );
+
+    /* the old journal is ignored as soon as the new hive exists */
+    memset( &journal, 0, sizeof(journal) );
+    memcpy( journal.magic, JOURNAL_MAGIC, sizeof(journal.magic) );
+    journal.version    = HIVE_VERSION;
+    journal.generation = header.generation;
+    info->journal_size = 0;
+    sprintf( tmp, "%s.tmp", info->journal_path );
+    if ((writer.file = fopen( tmp, "w" )))
+    {
+        hive_put( &writer, &journal, sizeof(journal) );
+        hive_sync( &writer );
+        if (!fclose( writer.file ) && !writer.error && !rename( tmp, info->journal_path ))
+            info->journal_size = sizeof(journal);
+        else
+            unlink( tmp );
+    }
+
+done:
+    free( tmp );
+    return ret;
+}
+
+/* write the modified keys of a branch to its journal */
+static void save_journal_keys( struct hive_writer *writer, const struct key *key, const struct key *base, int fd )
+{
+    struct journal_record record;
+    int i;
+
+    if (key->flags & KEY_VOLATILE) return;
+    if (!(key->flags & KEY_DIRTY)) return;
+
+    memset( &record, 0, sizeof(record) );
+    writer->len = 0;
+    hive_put( writer, &record, sizeof(record) );
+    save_hive_path( writer, key, base );
+    record.pathlen = writer->len - sizeof(record);
+    hive_put_padding( writer, record.pathlen );
+    save_hive_key( writer, key, 1 );
+    if (writer->error) return;
+    record.size = writer->len - sizeof(record);
+    record.checksum = hive_checksum( writer->buffer + sizeof(record), record.size );
+    memcpy( writer->buffer, &record, sizeof(record) );
+    if (write( fd, writer->buffer, writer->len ) != (ssize_t)writer->len)
+    {
+        writer->error = 1;
+        return;
+    }
+    for (i = 0; i <= key->last_subkey; i++) save_journal_keys( writer, key->subkeys[i], base, fd );
+}
+
+/* save the modified keys of a registry branch to its journal */
+static int save_journal( struct save_branch_info *info )
+{
+    struct hive_writer writer;
+    struct stat st;
+    off_t size;
+    int fd;
+
+    if (!(info->key->flags & KEY_DIRTY))
+    {
+        if (debug_level > 1) dump_operation( info->key, NULL, "Not saving clean" );
+        return 1;
+    }
+
+    /* write a new hive if there is none yet or if the journal has become too large */
+    if (!info->journal_size || info->journal_size > max( info->hive_size, MIN_JOURNAL_COMPACT ))
+        return save_hive( info, 0 );
+    if ((fd = open( info->journal_path, O_WRONLY )) == -1) return save_hive( info, 0 );
+
+    /* discard anything that follows the last valid record */
+    if (fstat( fd, &st ) == -1 || (st.st_size != info->journal_size && ftruncate( fd, info->journal_size ) == -1) ||
+        lseek( fd, info->journal_size, SEEK_SET ) == -1)
+    {
+        close( fd );
+        return save_hive( info, 0 );
+    }
+
+    if (debug_level > 1)
+    {
+        fprintf( stderr, "%s: ", info->journal_path );
+        dump_operation( info->key, NULL, "saving" );
+    }
+    memset( &writer, 0, sizeof(writer) );
+    save_journal_keys( &writer, info->key, info->key, fd );
+    free( writer.buffer );
+    if (!writer.error && fsync( fd ) == -1) writer.error = 1;
+    size = lseek( fd, 0, SEEK_CUR );
+    if (close( fd ) || writer.error || size == -1) return save_hive( info, 0 );
+
+    info->journal_size = size;
+    info->text_stale = 1;
+    make_clean( info->key );
+    return 1;
+}
+
+/* remove the binary hive and journal of a branch, once the text file is up to date */
+static void remove_hive( struct save_branch_info *info )
+{
+    if (!info->generation) return;
+    unlink( info->hive_path );
+    unlink( info->journal_path );
+    info->generation   = 0;
+    info->journal_size = 0;
+}
+
 /* load one of the initial registry files */
 static int load_init_registry_from_file( const char *filename, struct key *key )
 {
-    FILE *f;
+    struct save_branch_info info;
+    FILE *f = NULL;
+    int ret;
 
-    if ((f = fopen( filename, "r" )))
+    memset( &info, 0, sizeof(info) );
+    info.key  = key;
+    info.path = filename;
+    if ((info.hive_path = malloc( strlen( filename ) + sizeof(".hive") )))
+        sprintf( info.hive_path, "%s.hive", filename );
+    if ((info.journal_path = malloc( strlen( filename ) + sizeof(".journal") )))
+        sprintf( info.journal_path, "%s.journal", filename );
+
+    if (!(ret = load_hive( &info )) && (f = fopen( filename, "r" )))
     {
         load_keys( key, filename, f, 0 );
         fclose( f );
         if (get_error() == STATUS_NOT_REGISTRY_FILE)
         {
             fprintf( stderr, "%s is not a valid registry file\n", filename );
+            free( info.hive_path );
+            free( info.journal_path );
             return 1;
         }
+        ret = 1;
     }
 
     assert( save_branch_count < MAX_SAVE_BRANCH_INFO );
 
-    save_branch_info[save_branch_count].path = filename;
+    save_branch_info[save_branch_count] = info;
     save_branch_info[save_branch_count++].key = (struct key *)grab_object( key );
     make_object_static( &key->obj );
-    return (f != NULL);
+    return ret;
 }
 
 static WCHAR *format_user_registry_path( const SID *sid, struct unicode_str *path )
@@ -1937,14 +2857,16 @@ static void save_registry( struct key *key, obj_handle_t handle )
 }
 
 /* save a registry branch to a file */
-static int save_branch( struct key *key, const char *path )
+static int save_branch( struct save_branch_info *info )
 {
+    struct key *key = info->key;
+    const char *path = info->path;
     struct stat st;
     char *p, *tmp = NULL;
     int fd, count = 0, ret = 0;
     FILE *f;
 
-    if (!(key->flags & KEY_DIRTY))
+    if (!(key->flags & KEY_DIRTY) && !info->text_stale)
     {
         if (debug_level > 1) dump_operation( key, NULL, "Not saving clean" );
         return 1;
@@ -2006,7 +2928,11 @@ static int save_branch( struct key *key, const char *path )
 
 done:
     free( tmp );
-    if (ret) make_clean( key );
+    if (ret)
+    {
+        make_clean( key );
+        info->text_stale = 0;
+    }
     return ret;
 }
 
@@ -2018,7 +2944,10 @@ static void periodic_save( void *arg )
     if (fchdir( config_dir_fd ) == -1) return;
     save_timeout_user = NULL;
     for (i = 0; i < save_branch_count; i++)
-        save_branch( save_branch_info[i].key, save_branch_info[i].path );
+    {
+        if (use_binary_hive()) save_journal( &save_branch_info[i] );
+        else if (save_branch( &save_branch_info[i] )) remove_hive( &save_branch_info[i] );
+    }
     if (fchdir( server_dir_fd ) == -1) fatal_error( "chdir to server dir: %s\n", strerror( errno ));
     set_periodic_save_timer();
 }
@@ -2038,12 +2967,17 @@ void flush_registry(void)
     if (fchdir( config_dir_fd ) == -1) return;
     for (i = 0; i < save_branch_count; i++)
     {
-        if (!save_branch( save_branch_info[i].key, save_branch_info[i].path ))
+        struct save_branch_info *info = &save_branch_info[i];
+        int modified = (info->key->flags & KEY_DIRTY) || info->text_stale;
+
+        if (!save_branch( info ))
         {
             fprintf( stderr, "wineserver: could not save registry branch to %s",
-                     save_branch_info[i].path );
+                     info->path );
             perror( " " );
         }
+        else if (!use_binary_hive()) remove_hive( info );
+        else if (modified || !info->generation) save_hive( info, 1 );
     }
     if (fchdir( server_dir_fd ) == -1) fatal_error( "chdir to server dir: %s\n", strerror( errno ));
 }
@@ -2184,6 +3118,8 @@ DECL_HANDLER(get_key_value)
     if ((key = get_hkey_obj( req->hkey, KEY_QUERY_VALUE )))
     {
         get_value( key, &name, &reply->type, &reply->total );
+        reply->seq_slot = key->seq_slot;
+        if (shmglobal) reply->seq = shmglobal->registry_seq[key->seq_slot];
         release_object( key );
     }
 }
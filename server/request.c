@@ -44,6 +44,9 @@
 #ifdef HAVE_SYS_UIO_H
 #include <sys/uio.h>
 #endif
+#ifdef HAVE_SYS_SYSCALL_H
+#include <sys/syscall.h>
+#endif
 #ifdef HAVE_SYS_UN_H
 #include <sys/un.h>
 #endif
@@ -133,6 +136,11 @@ int config_dir_fd = -1;    /* file descriptor for the config dir */
 static struct master_socket *master_socket;  /* the master socket object */
 static struct timeout_user *master_timeout;
 
+static struct request_stats request_stats[REQ_NB_REQUESTS];  /* per-request statistics */
+static int request_stats_enabled;         /* are the statistics being collected? */
+static timeout_t request_stats_start;     /* time when the collection was last started */
+static timeout_t request_stats_elapsed;   /* collection time before it was last started */
+
 /* complain about a protocol error and terminate the client connection */
 void fatal_protocol_error( struct thread *thread, const char *err, ... )
 {
@@ -245,11 +253,47 @@ void write_reply( struct thread *thread )
         fatal_protocol_error( thread, "reply write: %s\n", strerror( errno ));
 }
 
+/* update the state of a shared request block, waking up the client if it's sleeping on it */
+static void set_shm_request_state( request_shm_t *shm, int state )
+{
+    if (interlocked_xchg( &shm->state, state ) == REQUEST_SHM_WAITING)
+    {
+#if defined(__linux__) && defined(__NR_futex)
+        syscall( __NR_futex, &shm->state, 1 /* FUTEX_WAKE */, 1, NULL, 0, 0 );
+#endif
+    }
+}
+
+/* make sure a client waiting on the shared request block doesn't wait forever */
+void abort_shm_request( struct thread *thread )
+{
+    if (thread->request_shm) set_shm_request_state( thread->request_shm, REQUEST_SHM_DEAD );
+}
+
+/* send a reply to the current thread through the shared request block */
+static void send_shm_reply( union generic_reply *reply )
+{
+    request_shm_t *shm = current->request_shm;
+
+    current->req_in_shm = 0;
+    memcpy( &shm->header, reply, sizeof(*reply) );
+    if (current->reply_size) memcpy( shm + 1, current->reply_data, current->reply_size );
+    free( current->reply_data );
+    current->reply_data = NULL;
+    set_shm_request_state( shm, REQUEST_SHM_DONE );
+}
+
 /* send a reply to the current thread */
 static void send_reply( union generic_reply *reply )
 {
     int ret;
 
+    if (current->req_in_shm)
+    {
+        send_shm_reply( reply );
+        return;
+    }
+
     if (!current->reply_size)
     {
         if ((ret = write( get_unix_fd( current->reply_fd ),
@@ -287,6 +331,47 @@ static void send_reply( union generic_reply *reply )
         fatal_protocol_error( current, "reply write: %s\n", strerror( errno ));
 }
 
+/* get a monotonic time in ns for the request statistics */
+static unsigned __int64 get_request_time(void)
+{
+#ifdef __APPLE__
+    static mach_timebase_info_data_t timebase;
+
+    if (!timebase.denom) mach_timebase_info( &timebase );
+    return mach_absolute_time() * timebase.numer / timebase.denom;
+#elif defined(HAVE_CLOCK_GETTIME)
+    struct timespec ts;
+#ifdef CLOCK_MONOTONIC_RAW
+    if (!clock_gettime( CLOCK_MONOTONIC_RAW, &ts ))
+        return ts.tv_sec * (unsigned __int64)1000000000 + ts.tv_nsec;
+#endif
+    if (!clock_gettime( CLOCK_MONOTONIC, &ts ))
+        return ts.tv_sec * (unsigned __int64)1000000000 + ts.tv_nsec;
+#endif
+    return (current_time - server_start_time) * 100;
+}
+
+/* account for a request in the statistics */
+static void update_request_stats( struct thread *thread, enum request req, unsigned __int64 time )
+{
+    struct request_stats *stats = &request_stats[req];
+    unsigned __int64 us = time / 1000;
+    unsigned int bucket = 0;
+
+    stats->count++;
+    if (thread->req_in_shm) stats->shm_count++;
+    stats->total_time += time;
+    if (time > stats->max_time) stats->max_time = min( time, 0xffffffff );
+    stats->bytes_in += thread->req.request_header.request_size;
+    stats->bytes_out += thread->reply_size;
+    while (us && bucket < REQUEST_STATS_BUCKETS - 1)
+    {
+        us >>= 1;
+        bucket++;
+    }
+    stats->histogram[bucket]++;
+}
+
 /* call a request handler */
 static void call_req_handler( struct thread *thread )
 {
@@ -300,7 +385,13 @@ static void call_req_handler( struct thread *thread )
 
     if (debug_level) trace_request();
 
-    if (req < REQ_NB_REQUESTS)
+    if (req < REQ_NB_REQUESTS && request_stats_enabled)
+    {
+        unsigned __int64 start = get_request_time();
+        req_handlers[req]( &current->req, &reply );
+        update_request_stats( thread, req, get_request_time() - start );
+    }
+    else if (req < REQ_NB_REQUESTS)
         req_handlers[req]( &current->req, &reply );
     else
         set_error( STATUS_NOT_IMPLEMENTED );
@@ -323,6 +414,44 @@ static void call_req_handler( struct thread *thread )
     current = NULL;
 }
 
+/* read a request from the shared request block of a thread */
+static void read_shm_request( struct thread *thread )
+{
+    request_shm_t *shm = thread->request_shm;
+
+    /* the client may already be sleeping on the state */
+    if (!shm || (shm->state != REQUEST_SHM_PENDING && shm->state != REQUEST_SHM_WAITING))
+    {
+        fatal_protocol_error( thread, "no request in shared memory\n" );
+        return;
+    }
+    memcpy( &thread->req, &shm->header, sizeof(thread->req) );
+    if (thread->req.request_header.request_size > REQUEST_SHM_DATA_SIZE ||
+        thread->req.request_header.reply_size > REQUEST_SHM_DATA_SIZE)
+    {
+        fatal_protocol_error( thread, "request %d too large for shared memory\n",
+                              thread->req.request_header.req );
+        return;
+    }
+    if (thread->req.request_header.request_size)
+    {
+        /* copy the data so that the client can't change it under us */
+        if (!(thread->req_data = malloc( thread->req.request_header.request_size )))
+        {
+            fatal_protocol_error( thread, "no memory for %u bytes request %d\n",
+                                  thread->req.request_header.request_size,
+                                  thread->req.request_header.req );
+            return;
+        }
+        memcpy( thread->req_data, shm + 1, thread->req.request_header.request_size );
+    }
+    thread->req_in_shm = 1;
+    call_req_handler( thread );
+    thread->req_in_shm = 0;
+    free( thread->req_data );
+    thread->req_data = NULL;
+}
+
 /* read a request from a thread */
 void read_request( struct thread *thread )
 {
@@ -332,6 +461,12 @@ void read_request( struct thread *thread )
     {
         if ((ret = read( get_unix_fd( thread->request_fd ), &thread->req,
                          sizeof(thread->req) )) != sizeof(thread->req)) goto error;
+        if (thread->req.request_header.req == REQUEST_SHM_CALL)
+        {
+            /* the request is waiting in shared memory */
+            read_shm_request( thread );
+            return;
+        }
         if (!(thread->req_toread = thread->req.request_header.request_size))
         {
             /* no data, handle request at once */
@@ -372,6 +507,54 @@ error:
         fatal_protocol_error( thread, "read: %s\n", strerror( errno ));
 }
 
+/* retrieve and control the per-request statistics */
+DECL_HANDLER(get_request_stats)
+{
+    struct request_stats *stats;
+    unsigned int i, count = 0;
+
+    for (i = 0; i < REQ_NB_REQUESTS; i++) if (request_stats[i].count) count++;
+
+    reply->enabled = request_stats_enabled;
+    reply->elapsed = request_stats_elapsed;
+    if (request_stats_enabled) reply->elapsed += current_time - request_stats_start;
+    reply->count   = count;
+
+    if (count * sizeof(*stats) > get_reply_max_size())
+    {
+        set_error( STATUS_BUFFER_TOO_SMALL );
+        return;
+    }
+    if (count)
+    {
+        if (!(stats = set_reply_data_size( count * sizeof(*stats) ))) return;
+        for (i = 0; i < REQ_NB_REQUESTS; i++)
+        {
+            if (!request_stats[i].count) continue;
+            *stats = request_stats[i];
+            stats->req = i;
+            stats++;
+        }
+    }
+
+    if (req->flags & REQUEST_STATS_RESET)
+    {
+        memset( request_stats, 0, sizeof(request_stats) );
+        request_stats_elapsed = 0;
+        request_stats_start = current_time;
+    }
+    if ((req->flags & REQUEST_STATS_ENABLE) && !request_stats_enabled)
+    {
+        request_stats_enabled = 1;
+        request_stats_start = current_time;
+    }
+    if ((req->flags & REQUEST_STATS_DISABLE) && request_stats_enabled)
+    {
+        request_stats_enabled = 0;
+        request_stats_elapsed += current_time - request_stats_start;
+    }
+}
+
 /* receive a file descriptor on the process socket */
 int receive_fd( struct process *process )
 {
@@ -54,6 +54,7 @@ extern int receive_fd( struct process *process );
 extern int send_client_fd( struct process *process, int fd, obj_handle_t handle );
 extern void read_request( struct thread *thread );
 extern void write_reply( struct thread *thread );
+extern void abort_shm_request( struct thread *thread );
 extern unsigned int get_tick_count(void);
 extern void open_master_socket(void);
 extern void close_master_socket( timeout_t timeout );
@@ -135,6 +136,7 @@ DECL_HANDLER(unload_dll);
 DECL_HANDLER(queue_apc);
 DECL_HANDLER(get_apc_result);
 DECL_HANDLER(close_handle);
+DECL_HANDLER(close_handles);
 DECL_HANDLER(socket_cleanup);
 DECL_HANDLER(set_handle_info);
 DECL_HANDLER(dup_handle);
@@ -162,6 +164,7 @@ DECL_HANDLER(get_handle_unix_name);
 DECL_HANDLER(get_handle_fd);
 DECL_HANDLER(get_directory_cache_entry);
 DECL_HANDLER(get_shared_memory);
+DECL_HANDLER(get_request_shm);
 DECL_HANDLER(flush);
 DECL_HANDLER(lock_file);
 DECL_HANDLER(unlock_file);
@@ -232,6 +235,7 @@ DECL_HANDLER(open_timer);
 DECL_HANDLER(set_timer);
 DECL_HANDLER(cancel_timer);
 DECL_HANDLER(get_timer_info);
+DECL_HANDLER(get_tsc_frequency);
 DECL_HANDLER(get_thread_context);
 DECL_HANDLER(set_thread_context);
 DECL_HANDLER(get_selector_entry);
@@ -408,6 +412,9 @@ DECL_HANDLER(terminate_job);
 DECL_HANDLER(get_system_info);
 DECL_HANDLER(suspend_process);
 DECL_HANDLER(resume_process);
+DECL_HANDLER(get_esync_fd);
+DECL_HANDLER(esync_wake);
+DECL_HANDLER(get_request_stats);
 
 #ifdef WANT_REQUEST_HANDLERS
 
@@ -437,6 +444,7 @@ static const req_handler req_handlers[REQ_NB_REQUESTS] =
     (req_handler)req_queue_apc,
     (req_handler)req_get_apc_result,
     (req_handler)req_close_handle,
+    (req_handler)req_close_handles,
     (req_handler)req_socket_cleanup,
     (req_handler)req_set_handle_info,
     (req_handler)req_dup_handle,
@@ -464,6 +472,7 @@ static const req_handler req_handlers[REQ_NB_REQUESTS] =
     (req_handler)req_get_handle_fd,
     (req_handler)req_get_directory_cache_entry,
     (req_handler)req_get_shared_memory,
+    (req_handler)req_get_request_shm,
     (req_handler)req_flush,
     (req_handler)req_lock_file,
     (req_handler)req_unlock_file,
@@ -534,6 +543,7 @@ static const req_handler req_handlers[REQ_NB_REQUESTS] =
     (req_handler)req_set_timer,
     (req_handler)req_cancel_timer,
     (req_handler)req_get_timer_info,
+    (req_handler)req_get_tsc_frequency,
     (req_handler)req_get_thread_context,
     (req_handler)req_set_thread_context,
     (req_handler)req_get_selector_entry,
@@ -710,6 +720,9 @@ static const req_handler req_handlers[REQ_NB_REQUESTS] =
     (req_handler)req_get_system_info,
     (req_handler)req_suspend_process,
     (req_handler)req_resume_process,
+    (req_handler)req_get_esync_fd,
+    (req_handler)req_esync_wake,
+    (req_handler)req_get_request_stats,
 };
 
 C_ASSERT( sizeof(affinity_t) == 8 );
@@ -901,6 +914,9 @@ C_ASSERT( FIELD_OFFSET(struct get_apc_result_reply, result) == 8 );
 C_ASSERT( sizeof(struct get_apc_result_reply) == 48 );
 C_ASSERT( FIELD_OFFSET(struct close_handle_request, handle) == 12 );
 C_ASSERT( sizeof(struct close_handle_request) == 16 );
+C_ASSERT( sizeof(struct close_handles_request) == 16 );
+C_ASSERT( FIELD_OFFSET(struct close_handles_reply, closed) == 8 );
+C_ASSERT( sizeof(struct close_handles_reply) == 16 );
 C_ASSERT( sizeof(struct socket_cleanup_request) == 16 );
 C_ASSERT( FIELD_OFFSET(struct set_handle_info_request, handle) == 12 );
 C_ASSERT( FIELD_OFFSET(struct set_handle_info_request, flags) == 16 );
@@ -1052,6 +1068,7 @@ C_ASSERT( FIELD_OFFSET(struct get_directory_cache_entry_reply, entry) == 8 );
 C_ASSERT( sizeof(struct get_directory_cache_entry_reply) == 16 );
 C_ASSERT( FIELD_OFFSET(struct get_shared_memory_request, tid) == 12 );
 C_ASSERT( sizeof(struct get_shared_memory_request) == 16 );
+C_ASSERT( sizeof(struct get_request_shm_request) == 16 );
 C_ASSERT( FIELD_OFFSET(struct flush_request, async) == 16 );
 C_ASSERT( sizeof(struct flush_request) == 56 );
 C_ASSERT( FIELD_OFFSET(struct flush_reply, event) == 8 );
@@ -1414,7 +1431,9 @@ C_ASSERT( FIELD_OFFSET(struct get_key_value_request, hkey) == 12 );
 C_ASSERT( sizeof(struct get_key_value_request) == 16 );
 C_ASSERT( FIELD_OFFSET(struct get_key_value_reply, type) == 8 );
 C_ASSERT( FIELD_OFFSET(struct get_key_value_reply, total) == 12 );
-C_ASSERT( sizeof(struct get_key_value_reply) == 16 );
+C_ASSERT( FIELD_OFFSET(struct get_key_value_reply, seq_slot) == 16 );
+C_ASSERT( FIELD_OFFSET(struct get_key_value_reply, seq) == 20 );
+C_ASSERT( sizeof(struct get_key_value_reply) == 24 );
 C_ASSERT( FIELD_OFFSET(struct enum_key_value_request, hkey) == 12 );
 C_ASSERT( FIELD_OFFSET(struct enum_key_value_request, index) == 16 );
 C_ASSERT( FIELD_OFFSET(struct enum_key_value_request, info_class) == 20 );
@@ -1465,6 +1484,9 @@ C_ASSERT( sizeof(struct get_timer_info_request) == 16 );
 C_ASSERT( FIELD_OFFSET(struct get_timer_info_reply, when) == 8 );
 C_ASSERT( FIELD_OFFSET(struct get_timer_info_reply, signaled) == 16 );
 C_ASSERT( sizeof(struct get_timer_info_reply) == 24 );
+C_ASSERT( sizeof(struct get_tsc_frequency_request) == 16 );
+C_ASSERT( FIELD_OFFSET(struct get_tsc_frequency_reply, frequency) == 8 );
+C_ASSERT( sizeof(struct get_tsc_frequency_reply) == 16 );
 C_ASSERT( FIELD_OFFSET(struct get_thread_context_request, handle) == 12 );
 C_ASSERT( FIELD_OFFSET(struct get_thread_context_request, flags) == 16 );
 C_ASSERT( FIELD_OFFSET(struct get_thread_context_request, suspend) == 20 );
@@ -2331,6 +2353,7 @@ C_ASSERT( sizeof(struct query_completion_reply) == 16 );
 C_ASSERT( FIELD_OFFSET(struct set_completion_info_request, handle) == 12 );
 C_ASSERT( FIELD_OFFSET(struct set_completion_info_request, ckey) == 16 );
 C_ASSERT( FIELD_OFFSET(struct set_completion_info_request, chandle) == 24 );
+C_ASSERT( FIELD_OFFSET(struct set_completion_info_request, replace) == 28 );
 C_ASSERT( sizeof(struct set_completion_info_request) == 32 );
 C_ASSERT( FIELD_OFFSET(struct add_fd_completion_request, handle) == 12 );
 C_ASSERT( FIELD_OFFSET(struct add_fd_completion_request, cvalue) == 16 );
@@ -2426,6 +2449,20 @@ C_ASSERT( FIELD_OFFSET(struct suspend_process_request, handle) == 12 );
 C_ASSERT( sizeof(struct suspend_process_request) == 16 );
 C_ASSERT( FIELD_OFFSET(struct resume_process_request, handle) == 12 );
 C_ASSERT( sizeof(struct resume_process_request) == 16 );
+C_ASSERT( FIELD_OFFSET(struct get_esync_fd_request, handle) == 12 );
+C_ASSERT( sizeof(struct get_esync_fd_request) == 16 );
+C_ASSERT( FIELD_OFFSET(struct get_esync_fd_reply, type) == 8 );
+C_ASSERT( FIELD_OFFSET(struct get_esync_fd_reply, shm_idx) == 12 );
+C_ASSERT( FIELD_OFFSET(struct get_esync_fd_reply, access) == 16 );
+C_ASSERT( sizeof(struct get_esync_fd_reply) == 24 );
+C_ASSERT( FIELD_OFFSET(struct esync_wake_request, handle) == 12 );
+C_ASSERT( sizeof(struct esync_wake_request) == 16 );
+C_ASSERT( FIELD_OFFSET(struct get_request_stats_request, flags) == 12 );
+C_ASSERT( sizeof(struct get_request_stats_request) == 16 );
+C_ASSERT( FIELD_OFFSET(struct get_request_stats_reply, enabled) == 8 );
+C_ASSERT( FIELD_OFFSET(struct get_request_stats_reply, elapsed) == 16 );
+C_ASSERT( FIELD_OFFSET(struct get_request_stats_reply, count) == 24 );
+C_ASSERT( sizeof(struct get_request_stats_reply) == 32 );
 
 #endif  /* WANT_REQUEST_HANDLERS */
 
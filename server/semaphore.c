@@ -35,28 +35,33 @@
 #include "thread.h"
 #include "request.h"
 #include "security.h"
+#include "esync.h"
 
 struct semaphore
 {
     struct object  obj;    /* object header */
     unsigned int   count;  /* current count */
     unsigned int   max;    /* maximum possible count */
+    struct esync   esync;  /* eventfd state, if esync is enabled */
 };
 
 static void semaphore_dump( struct object *obj, int verbose );
 static struct object_type *semaphore_get_type( struct object *obj );
+static int semaphore_add_queue( struct object *obj, struct wait_queue_entry *entry );
+static void semaphore_remove_queue( struct object *obj, struct wait_queue_entry *entry );
 static int semaphore_signaled( struct object *obj, struct wait_queue_entry *entry );
 static void semaphore_satisfied( struct object *obj, struct wait_queue_entry *entry );
 static unsigned int semaphore_map_access( struct object *obj, unsigned int access );
 static int semaphore_signal( struct object *obj, unsigned int access );
+static void semaphore_destroy( struct object *obj );
 
 static const struct object_ops semaphore_ops =
 {
     sizeof(struct semaphore),      /* size */
     semaphore_dump,                /* dump */
     semaphore_get_type,            /* get_type */
-    add_queue,                     /* add_queue */
-    remove_queue,                  /* remove_queue */
+    semaphore_add_queue,           /* add_queue */
+    semaphore_remove_queue,        /* remove_queue */
     semaphore_signaled,            /* signaled */
     semaphore_satisfied,           /* satisfied */
     semaphore_signal,              /* signal */
@@ -70,7 +75,7 @@ static const struct object_ops semaphore_ops =
     no_open_file,                  /* open_file */
     no_alloc_handle,               /* alloc_handle */
     no_close_handle,               /* close_handle */
-    no_destroy                     /* destroy */
+    semaphore_destroy              /* destroy */
 };
 
 
@@ -92,14 +97,47 @@ static struct semaphore *create_semaphore( struct object *root, const struct uni
             /* initialize it if it didn't already exist */
             sem->count = initial;
             sem->max   = max;
+            sem->esync.fd = -1;
+            if (do_esync() && esync_init_object( &sem->esync, initial, 1 ))
+            {
+                esync_shm_t *shm = esync_get_shm( &sem->esync );
+                shm->count = initial;
+                shm->max   = max;
+            }
         }
     }
     return sem;
 }
 
+static int release_esync_semaphore( struct semaphore *sem, unsigned int count,
+                                    unsigned int *prev )
+{
+    esync_shm_t *shm = esync_get_shm( &sem->esync );
+    unsigned int current, new;
+
+    /* the count is shared with clients, which may update it concurrently */
+    do
+    {
+        current = shm->count;
+        new = current + count;
+        if (new < current || new > shm->max)
+        {
+            if (prev) *prev = current;
+            set_error( STATUS_SEMAPHORE_LIMIT_EXCEEDED );
+            return 0;
+        }
+    } while (interlocked_cmpxchg( (int *)&shm->count, new, current ) != current);
+
+    if (prev) *prev = current;
+    esync_post( &sem->esync, count );
+    wake_up( &sem->obj, 0 );
+    return 1;
+}
+
 static int release_semaphore( struct semaphore *sem, unsigned int count,
                               unsigned int *prev )
 {
+    if (sem->esync.fd != -1) return release_esync_semaphore( sem, count, prev );
     if (prev) *prev = sem->count;
     if (sem->count + count < sem->count || sem->count + count > sem->max)
     {
@@ -132,10 +170,27 @@ static struct object_type *semaphore_get_type( struct object *obj )
     return get_object_type( &str );
 }
 
+static int semaphore_add_queue( struct object *obj, struct wait_queue_entry *entry )
+{
+    struct semaphore *sem = (struct semaphore *)obj;
+    assert( obj->ops == &semaphore_ops );
+    if (sem->esync.fd != -1) esync_add_waiter( &sem->esync );
+    return add_queue( obj, entry );
+}
+
+static void semaphore_remove_queue( struct object *obj, struct wait_queue_entry *entry )
+{
+    struct semaphore *sem = (struct semaphore *)obj;
+    assert( obj->ops == &semaphore_ops );
+    if (sem->esync.fd != -1) esync_remove_waiter( &sem->esync );
+    remove_queue( obj, entry );
+}
+
 static int semaphore_signaled( struct object *obj, struct wait_queue_entry *entry )
 {
     struct semaphore *sem = (struct semaphore *)obj;
     assert( obj->ops == &semaphore_ops );
+    if (sem->esync.fd != -1) return esync_signaled( &sem->esync );
     return (sem->count > 0);
 }
 
@@ -143,6 +198,8 @@ static void semaphore_satisfied( struct object *obj, struct wait_queue_entry *en
 {
     struct semaphore *sem = (struct semaphore *)obj;
     assert( obj->ops == &semaphore_ops );
+    /* with esync, the count and the eventfd unit have already been taken by the wait */
+    if (sem->esync.fd != -1) return;
     assert( sem->count );
     sem->count--;
 }
@@ -169,6 +226,20 @@ static int semaphore_signal( struct object *obj, unsigned int access )
     return release_semaphore( sem, 1, NULL );
 }
 
+static void semaphore_destroy( struct object *obj )
+{
+    struct semaphore *sem = (struct semaphore *)obj;
+    assert( obj->ops == &semaphore_ops );
+    esync_destroy_object( &sem->esync );
+}
+
+struct esync *get_semaphore_esync( struct object *obj, enum esync_type *type )
+{
+    if (obj->ops != &semaphore_ops) return NULL;
+    *type = ESYNC_SEMAPHORE;
+    return &((struct semaphore *)obj)->esync;
+}
+
 /* create a semaphore */
 DECL_HANDLER(create_semaphore)
 {
@@ -187,6 +258,7 @@ DECL_HANDLER(create_semaphore)
         else
             reply->handle = alloc_handle_no_access_check( current->process, sem,
                                                           req->access, objattr->attributes );
+        if (reply->handle && !name.len) set_handle_deferrable( current->process, reply->handle );
         release_object( sem );
     }
 
@@ -223,7 +295,8 @@ DECL_HANDLER(query_semaphore)
     if ((sem = (struct semaphore *)get_handle_obj( current->process, req->handle,
                                                    SEMAPHORE_QUERY_STATE, &semaphore_ops )))
     {
-        reply->current = sem->count;
+        if (sem->esync.fd != -1) reply->current = esync_get_shm( &sem->esync )->count;
+        else reply->current = sem->count;
         reply->max = sem->max;
         release_object( sem );
     }
@@ -51,6 +51,7 @@
 #include "request.h"
 #include "user.h"
 #include "security.h"
+#include "esync.h"
 
 
 #ifdef __i386__
@@ -204,6 +205,8 @@ static inline void init_thread_structure( struct thread *thread )
     thread->exit_poll       = NULL;
     thread->shm_fd          = -1;
     thread->shm             = NULL;
+    thread->request_shm     = NULL;
+    thread->req_in_shm      = 0;
 
     thread->creation_time = current_time;
     thread->exit_time     = 0;
@@ -306,6 +309,12 @@ static void cleanup_thread( struct thread *thread )
         }
     }
     release_shared_memory( thread->shm_fd, thread->shm, sizeof(*thread->shm) );
+    if (thread->request_shm)
+    {
+        /* wake up the client if it is still waiting for a reply */
+        abort_shm_request( thread );
+        release_shared_memory( -1, thread->request_shm, REQUEST_SHM_SIZE );
+    }
 
     thread->req_data = NULL;
     thread->reply_data = NULL;
@@ -317,7 +326,8 @@ static void cleanup_thread( struct thread *thread )
     thread->desktop = 0;
     thread->shm_fd = -1;
     thread->shm = NULL;
-
+    thread->request_shm = NULL;
+    thread->req_in_shm = 0;
 }
 
 /* destroy a thread when its refcount is 0 */
@@ -674,7 +684,7 @@ static int wait_on_handles( const select_op_t *select_op, unsigned int count, co
 /* check if the thread waiting condition is satisfied */
 static int check_wait( struct thread *thread )
 {
-    int i;
+    int i, grabbed[MAXIMUM_WAIT_OBJECTS];
     struct thread_wait *wait = thread->wait;
     struct wait_queue_entry *entry;
 
@@ -694,6 +704,15 @@ static int check_wait( struct thread *thread )
         for (i = 0, entry = wait->queues; i < wait->count; i++, entry++)
             not_ok |= !entry->obj->ops->signaled( entry->obj, entry );
         if (not_ok) goto other_checks;
+        /* esync objects can be taken by clients at any time, so they have to
+         * be consumed atomically, and all given back if one of them is gone */
+        for (i = 0, entry = wait->queues; i < wait->count; i++, entry++)
+        {
+            if (esync_grab_for_wait( entry->obj, entry, &grabbed[i] )) continue;
+            while (i--)
+                if (grabbed[i]) esync_ungrab( wait->queues[i].obj );
+            goto other_checks;
+        }
         /* Wait satisfied: tell it to all objects */
         for (i = 0, entry = wait->queues; i < wait->count; i++, entry++)
             entry->obj->ops->satisfied( entry->obj, entry );
@@ -704,6 +723,7 @@ static int check_wait( struct thread *thread )
         for (i = 0, entry = wait->queues; i < wait->count; i++, entry++)
         {
             if (!entry->obj->ops->signaled( entry->obj, entry )) continue;
+            if (!esync_grab_for_wait( entry->obj, entry, &grabbed[0] )) continue;
             /* Wait satisfied: tell it to the object */
             entry->obj->ops->satisfied( entry->obj, entry );
             if (wait->abandoned) i += STATUS_ABANDONED_WAIT_0;
@@ -765,7 +785,7 @@ int wake_thread_queue_entry( struct wait_queue_entry *entry )
 {
     struct thread_wait *wait = entry->wait;
     struct thread *thread = wait->thread;
-    int signaled;
+    int signaled, grabbed;
     client_ptr_t cookie;
 
     if (thread->wait != wait) return 0;  /* not the current wait */
@@ -773,6 +793,8 @@ int wake_thread_queue_entry( struct wait_queue_entry *entry )
 
     assert( wait->select != SELECT_WAIT_ALL );
 
+    if (!esync_grab_for_wait( entry->obj, entry, &grabbed )) return 0;
+
     signaled = entry - wait->queues;
     entry->obj->ops->satisfied( entry->obj, entry );
     if (wait->abandoned) signaled += STATUS_ABANDONED_WAIT_0;
@@ -1380,6 +1402,25 @@ DECL_HANDLER(init_thread)
     if (wait_fd != -1) close( wait_fd );
 }
 
+/* get the shared memory block used to send requests */
+DECL_HANDLER(get_request_shm)
+{
+    int fd;
+
+    if (current->request_shm)  /* already mapped in the client */
+    {
+        set_error( STATUS_INVALID_PARAMETER );
+        return;
+    }
+    if (!allocate_shared_memory( &fd, (void **)&current->request_shm, REQUEST_SHM_SIZE ))
+    {
+        set_error( STATUS_NOT_SUPPORTED );
+        return;
+    }
+    send_client_fd( current->process, fd, 0 );
+    close( fd );
+}
+
 /* terminate a thread */
 DECL_HANDLER(terminate_thread)
 {
@@ -91,6 +91,8 @@ struct thread
     struct timeout_user   *exit_poll;     /* poll if the thread/process has exited already */
     int                    shm_fd;        /* file descriptor for thread local shared memory */
     shmlocal_t            *shm;           /* thread local shared memory pointer */
+    request_shm_t         *request_shm;   /* shared memory block used to send requests */
+    int                    req_in_shm;    /* current request was read from request_shm */
 };
 
 struct thread_snapshot
@@ -25,6 +25,8 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
 #include <sys/types.h>
 #include <stdarg.h>
 
@@ -294,3 +296,126 @@ DECL_HANDLER(get_timer_info)
         release_object( timer );
     }
 }
+
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+
+/* The time stamp counter frequency is determined once by the server, so that
+ * the performance counters of all processes use the same frequency and can
+ * be compared. It is taken from cpuid if the CPU reports it, otherwise the
+ * TSC is calibrated against the raw monotonic clock since server startup. */
+
+#define TSC_CALIBRATION_TIME 50000  /* minimum calibration interval in microseconds */
+
+static unsigned long long tsc_start;       /* TSC at server startup */
+static unsigned long long tsc_start_time;  /* raw monotonic time at server startup in ns */
+static unsigned int tsc_frequency;         /* frequency in kHz, 0 if the TSC is unusable */
+static int tsc_calibrated;                 /* frequency has been determined */
+
+static inline unsigned long long rdtsc(void)
+{
+    unsigned int low, high;
+    __asm__ __volatile__( "rdtsc" : "=a" (low), "=d" (high) );
+    return ((unsigned long long)high << 32) | low;
+}
+
+static inline void do_cpuid( unsigned int ax, unsigned int *p )
+{
+#ifdef __i386__
+    __asm__( "pushl %%ebx\n\t"
+             "cpuid\n\t"
+             "movl %%ebx, %%esi\n\t"
+             "popl %%ebx"
+             : "=a" (p[0]), "=S" (p[1]), "=c" (p[2]), "=d" (p[3])
+             : "0" (ax), "2" (0) );
+#else
+    __asm__( "push %%rbx\n\t"
+             "cpuid\n\t"
+             "movq %%rbx, %%rsi\n\t"
+             "pop %%rbx"
+             : "=a" (p[0]), "=S" (p[1]), "=c" (p[2]), "=d" (p[3])
+             : "0" (ax), "2" (0) );
+#endif
+}
+
+static unsigned long long raw_monotonic_time(void)
+{
+    struct timespec ts;
+
+#ifdef CLOCK_MONOTONIC_RAW
+    if (!clock_gettime( CLOCK_MONOTONIC_RAW, &ts ))
+        return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* sample the TSC and the raw monotonic clock as close together as possible */
+static unsigned long long sample_tsc( unsigned long long *tsc )
+{
+    unsigned long long before, after, time, ret = 0, best = ~0ULL;
+    int i;
+
+    for (i = 0; i < 5; i++)
+    {
+        before = rdtsc();
+        time = raw_monotonic_time();
+        after = rdtsc();
+        if (after - before >= best) continue;
+        best = after - before;
+        *tsc = before + best / 2;
+        ret = time;
+    }
+    return ret;
+}
+
+/* frequency in kHz reported by cpuid leaf 0x15, 0 if not available */
+static unsigned int cpuid_tsc_frequency(void)
+{
+    unsigned int regs[4];
+
+    do_cpuid( 0, regs );
+    if (regs[0] < 0x15) return 0;
+    do_cpuid( 0x15, regs );
+    /* eax/ebx is the ratio of TSC to crystal clock, ecx the crystal clock in Hz */
+    if (!regs[0] || !regs[1] || !regs[2]) return 0;
+    return (unsigned long long)regs[2] * regs[1] / regs[0] / 1000;
+}
+
+/* take the starting sample for the TSC calibration */
+void init_tsc(void)
+{
+    tsc_start_time = sample_tsc( &tsc_start );
+}
+
+/* get the time stamp counter frequency */
+DECL_HANDLER(get_tsc_frequency)
+{
+    unsigned long long tsc = 0, time, elapsed;
+    double freq;
+
+    if (!tsc_calibrated && !(tsc_frequency = cpuid_tsc_frequency()))
+    {
+        /* only the first request after startup may have to wait */
+        elapsed = (raw_monotonic_time() - tsc_start_time) / 1000;
+        if (elapsed < TSC_CALIBRATION_TIME) usleep( TSC_CALIBRATION_TIME - elapsed );
+
+        time = sample_tsc( &tsc );
+        freq = (double)(tsc - tsc_start) * 1000000 / (time - tsc_start_time);
+        if (tsc > tsc_start && freq >= 100e3 && freq <= 20e6) tsc_frequency = freq + 0.5;
+        else if (debug_level) fprintf( stderr, "wineserver: unreliable TSC frequency %f kHz\n", freq );
+    }
+    tsc_calibrated = 1;
+    reply->frequency = tsc_frequency;
+}
+
+#else
+
+void init_tsc(void)
+{
+}
+
+DECL_HANDLER(get_tsc_frequency)
+{
+}
+
+#endif
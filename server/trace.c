@@ -1206,6 +1206,27 @@ static void dump_varargs_handle_infos( const char *prefix, data_size_t size )
     fputc( '}', stderr );
 }
 
+static void dump_varargs_request_stats( const char *prefix, data_size_t size )
+{
+    const struct request_stats *stats;
+
+    fprintf( stderr, "%s{", prefix );
+    while (size >= sizeof(*stats))
+    {
+        stats = cur_data;
+        fprintf( stderr, "{req=%u,count=%u,max_time=%u,shm_count=%u", stats->req, stats->count,
+                 stats->max_time, stats->shm_count );
+        dump_uint64( ",total_time=", &stats->total_time );
+        dump_uint64( ",bytes_in=", &stats->bytes_in );
+        dump_uint64( ",bytes_out=", &stats->bytes_out );
+        fputc( '}', stderr );
+        size -= sizeof(*stats);
+        remove_data( sizeof(*stats) );
+        if (size) fputc( ',', stderr );
+    }
+    fputc( '}', stderr );
+}
+
 typedef void (*dump_func)( const void *req );
 
 /* Everything below this line is generated automatically by tools/make_requests */
@@ -1496,6 +1517,16 @@ static void dump_close_handle_request( const struct close_handle_request *req )
     fprintf( stderr, " handle=%04x", req->handle );
 }
 
+static void dump_close_handles_request( const struct close_handles_request *req )
+{
+    dump_varargs_uints( " handles=", cur_size );
+}
+
+static void dump_close_handles_reply( const struct close_handles_reply *req )
+{
+    fprintf( stderr, " closed=%u", req->closed );
+}
+
 static void dump_socket_cleanup_request( const struct socket_cleanup_request *req )
 {
 }
@@ -1815,6 +1846,10 @@ static void dump_get_shared_memory_request( const struct get_shared_memory_reque
     fprintf( stderr, " tid=%04x", req->tid );
 }
 
+static void dump_get_request_shm_request( const struct get_request_shm_request *req )
+{
+}
+
 static void dump_flush_request( const struct flush_request *req )
 {
     dump_async_data( " async=", &req->async );
@@ -2495,6 +2530,8 @@ static void dump_get_key_value_reply( const struct get_key_value_reply *req )
 {
     fprintf( stderr, " type=%d", req->type );
     fprintf( stderr, ", total=%u", req->total );
+    fprintf( stderr, ", seq_slot=%08x", req->seq_slot );
+    fprintf( stderr, ", seq=%08x", req->seq );
     dump_varargs_bytes( ", data=", cur_size );
 }
 
@@ -2605,6 +2642,15 @@ static void dump_get_timer_info_reply( const struct get_timer_info_reply *req )
     fprintf( stderr, ", signaled=%d", req->signaled );
 }
 
+static void dump_get_tsc_frequency_request( const struct get_tsc_frequency_request *req )
+{
+}
+
+static void dump_get_tsc_frequency_reply( const struct get_tsc_frequency_reply *req )
+{
+    fprintf( stderr, " frequency=%08x", req->frequency );
+}
+
 static void dump_get_thread_context_request( const struct get_thread_context_request *req )
 {
     fprintf( stderr, " handle=%04x", req->handle );
@@ -4355,6 +4401,7 @@ static void dump_set_completion_info_request( const struct set_completion_info_r
     fprintf( stderr, " handle=%04x", req->handle );
     dump_uint64( ", ckey=", &req->ckey );
     fprintf( stderr, ", chandle=%04x", req->chandle );
+    fprintf( stderr, ", replace=%d", req->replace );
 }
 
 static void dump_add_fd_completion_request( const struct add_fd_completion_request *req )
@@ -4553,6 +4600,36 @@ static void dump_resume_process_request( const struct resume_process_request *re
     fprintf( stderr, " handle=%04x", req->handle );
 }
 
+static void dump_get_esync_fd_request( const struct get_esync_fd_request *req )
+{
+    fprintf( stderr, " handle=%04x", req->handle );
+}
+
+static void dump_get_esync_fd_reply( const struct get_esync_fd_reply *req )
+{
+    fprintf( stderr, " type=%d", req->type );
+    fprintf( stderr, ", shm_idx=%08x", req->shm_idx );
+    fprintf( stderr, ", access=%08x", req->access );
+}
+
+static void dump_esync_wake_request( const struct esync_wake_request *req )
+{
+    fprintf( stderr, " handle=%04x", req->handle );
+}
+
+static void dump_get_request_stats_request( const struct get_request_stats_request *req )
+{
+    fprintf( stderr, " flags=%08x", req->flags );
+}
+
+static void dump_get_request_stats_reply( const struct get_request_stats_reply *req )
+{
+    fprintf( stderr, " enabled=%d", req->enabled );
+    dump_timeout( ", elapsed=", &req->elapsed );
+    fprintf( stderr, ", count=%08x", req->count );
+    dump_varargs_request_stats( ", stats=", cur_size );
+}
+
 static const dump_func req_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_new_process_request,
     (dump_func)dump_get_new_process_info_request,
@@ -4577,6 +4654,7 @@ static const dump_func req_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_queue_apc_request,
     (dump_func)dump_get_apc_result_request,
     (dump_func)dump_close_handle_request,
+    (dump_func)dump_close_handles_request,
     (dump_func)dump_socket_cleanup_request,
     (dump_func)dump_set_handle_info_request,
     (dump_func)dump_dup_handle_request,
@@ -4604,6 +4682,7 @@ static const dump_func req_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_get_handle_fd_request,
     (dump_func)dump_get_directory_cache_entry_request,
     (dump_func)dump_get_shared_memory_request,
+    (dump_func)dump_get_request_shm_request,
     (dump_func)dump_flush_request,
     (dump_func)dump_lock_file_request,
     (dump_func)dump_unlock_file_request,
@@ -4674,6 +4753,7 @@ static const dump_func req_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_set_timer_request,
     (dump_func)dump_cancel_timer_request,
     (dump_func)dump_get_timer_info_request,
+    (dump_func)dump_get_tsc_frequency_request,
     (dump_func)dump_get_thread_context_request,
     (dump_func)dump_set_thread_context_request,
     (dump_func)dump_get_selector_entry_request,
@@ -4850,6 +4930,9 @@ static const dump_func req_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_get_system_info_request,
     (dump_func)dump_suspend_process_request,
     (dump_func)dump_resume_process_request,
+    (dump_func)dump_get_esync_fd_request,
+    (dump_func)dump_esync_wake_request,
+    (dump_func)dump_get_request_stats_request,
 };
 
 static const dump_func reply_dumpers[REQ_NB_REQUESTS] = {
@@ -4876,6 +4959,7 @@ static const dump_func reply_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_queue_apc_reply,
     (dump_func)dump_get_apc_result_reply,
     NULL,
+    (dump_func)dump_close_handles_reply,
     NULL,
     (dump_func)dump_set_handle_info_reply,
     (dump_func)dump_dup_handle_reply,
@@ -4903,6 +4987,7 @@ static const dump_func reply_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_get_handle_fd_reply,
     (dump_func)dump_get_directory_cache_entry_reply,
     NULL,
+    NULL,
     (dump_func)dump_flush_reply,
     (dump_func)dump_lock_file_reply,
     NULL,
@@ -4973,6 +5058,7 @@ static const dump_func reply_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_set_timer_reply,
     (dump_func)dump_cancel_timer_reply,
     (dump_func)dump_get_timer_info_reply,
+    (dump_func)dump_get_tsc_frequency_reply,
     (dump_func)dump_get_thread_context_reply,
     (dump_func)dump_set_thread_context_reply,
     (dump_func)dump_get_selector_entry_reply,
@@ -5149,6 +5235,9 @@ static const dump_func reply_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_get_system_info_reply,
     NULL,
     NULL,
+    (dump_func)dump_get_esync_fd_reply,
+    NULL,
+    (dump_func)dump_get_request_stats_reply,
 };
 
 static const char * const req_names[REQ_NB_REQUESTS] = {
@@ -5175,6 +5264,7 @@ static const char * const req_names[REQ_NB_REQUESTS] = {
     "queue_apc",
     "get_apc_result",
     "close_handle",
+    "close_handles",
     "socket_cleanup",
     "set_handle_info",
     "dup_handle",
@@ -5202,6 +5292,7 @@ static const char * const req_names[REQ_NB_REQUESTS] = {
     "get_handle_fd",
     "get_directory_cache_entry",
     "get_shared_memory",
+    "get_request_shm",
     "flush",
     "lock_file",
     "unlock_file",
@@ -5272,6 +5363,7 @@ static const char * const req_names[REQ_NB_REQUESTS] = {
     "set_timer",
     "cancel_timer",
     "get_timer_info",
+    "get_tsc_frequency",
     "get_thread_context",
     "set_thread_context",
     "get_selector_entry",
@@ -5448,6 +5540,9 @@ static const char * const req_names[REQ_NB_REQUESTS] = {
     "get_system_info",
     "suspend_process",
     "resume_process",
+    "get_esync_fd",
+    "esync_wake",
+    "get_request_stats",
 };
 
 static const struct
@@ -77,6 +77,11 @@ struct desktop
     unsigned int         users;            /* processes and threads using this desktop */
     struct global_cursor cursor;           /* global cursor information */
     unsigned char        keystate[256];    /* asynchronous key state */
+    struct list          inputs;           /* thread inputs using this desktop */
+    int                  shm_cursor_x;     /* cursor position last published in the shared memory */
+    int                  shm_cursor_y;
+    unsigned int         shm_cursor_change; /* cursor change time last published */
+    unsigned char        shm_keystate[256]; /* key state last published in the shared memory */
 };
 
 /* user handles functions */
@@ -254,6 +254,10 @@ static struct desktop *create_desktop( const struct unicode_str *name, unsigned
             memset( desktop->keystate, 0, sizeof(desktop->keystate) );
             list_add_tail( &winstation->desktops, &desktop->entry );
             list_init( &desktop->hotkeys );
+            list_init( &desktop->inputs );
+            desktop->shm_cursor_x = desktop->shm_cursor_y = 0;
+            desktop->shm_cursor_change = 0;
+            memset( desktop->shm_keystate, 0, sizeof(desktop->shm_keystate) );
         }
         else clear_error();
     }
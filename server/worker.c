@@ -0,0 +1,290 @@
+/*
+ * Server worker threads
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+/*
+ * The server state is only ever touched from the main loop thread. Requests
+ * that need to make a blocking system call (fsync and the like) hand it to
+ * a pool of worker threads instead, so that the other clients don't stall
+ * behind it. The work function runs in a worker thread and must not touch
+ * any server object; the completion function is then called from the main
+ * loop, where it can finish the request, usually by waking up an async.
+ *
+ * Running the server with --workers=0 (or building it without pthread
+ * support) disables the workers, in which case queue_work fails and callers
+ * do the work synchronously as before.
+ */
+
+#include "config.h"
+#include "wine/port.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef HAVE_POLL_H
+#include <poll.h>
+#endif
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
+#include <unistd.h>
+
+#include "ntstatus.h"
+#define WIN32_NO_STATUS
+#include "winternl.h"
+
+#include "file.h"
+#include "object.h"
+#include "request.h"
+
+int worker_threads = 4;  /* maximum number of worker threads, 0 to disable */
+
+#ifdef HAVE_PTHREAD_H
+
+struct work_item
+{
+    struct list   entry;               /* entry in pending or done list */
+    void        (*work)( void *arg );  /* function called in a worker thread */
+    void        (*done)( void *arg );  /* function called in the main loop */
+    void         *arg;                 /* argument for both */
+};
+
+struct workers
+{
+    struct object    obj;         /* object header */
+    struct fd       *fd;          /* file descriptor for the notification pipe */
+    int              pipe_write;  /* unix fd for the pipe write side */
+};
+
+static void workers_dump( struct object *obj, int verbose );
+static void workers_destroy( struct object *obj );
+
+static const struct object_ops workers_ops =
+{
+    sizeof(struct workers),   /* size */
+    workers_dump,             /* dump */
+    no_get_type,              /* get_type */
+    no_add_queue,             /* add_queue */
+    NULL,                     /* remove_queue */
+    NULL,                     /* signaled */
+    NULL,                     /* satisfied */
+    no_signal,                /* signal */
+    no_get_fd,                /* get_fd */
+    no_map_access,            /* map_access */
+    default_get_sd,           /* get_sd */
+    default_set_sd,           /* set_sd */
+    no_lookup_name,           /* lookup_name */
+    no_link_name,             /* link_name */
+    NULL,                     /* unlink_name */
+    no_open_file,             /* open_file */
+    no_alloc_handle,          /* alloc_handle */
+    no_close_handle,          /* close_handle */
+    workers_destroy           /* destroy */
+};
+
+static void workers_poll_event( struct fd *fd, int event );
+
+static const struct fd_ops workers_fd_ops =
+{
+    NULL,                     /* get_poll_events */
+    workers_poll_event,       /* poll_event */
+    NULL,                     /* flush */
+    NULL,                     /* get_fd_type */
+    NULL,                     /* ioctl */
+    NULL,                     /* queue_async */
+    NULL                      /* reselect_async */
+};
+
+static struct workers *workers;
+static pthread_mutex_t work_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t work_cond = PTHREAD_COND_INITIALIZER;
+static struct list pending_work = LIST_INIT( pending_work );  /* protected by work_mutex */
+static struct list done_work = LIST_INIT( done_work );        /* protected by work_mutex */
+static unsigned int thread_count;   /* number of running workers */
+static unsigned int idle_count;     /* number of workers waiting for work */
+static int notify_pending;          /* notification byte written and not read yet */
+
+static void workers_dump( struct object *obj, int verbose )
+{
+    struct workers *workers = (struct workers *)obj;
+    fprintf( stderr, "Worker threads fd=%p count=%u\n", workers->fd, thread_count );
+}
+
+static void workers_destroy( struct object *obj )
+{
+    struct workers *workers = (struct workers *)obj;
+    if (workers->fd) release_object( workers->fd );
+    close( workers->pipe_write );
+}
+
+/* worker thread main function */
+static void *worker_thread( void *arg )
+{
+    struct work_item *item;
+    struct list *ptr;
+    char dummy = 0;
+
+    pthread_mutex_lock( &work_mutex );
+    for (;;)
+    {
+        while (!(ptr = list_head( &pending_work )))
+        {
+            idle_count++;
+            pthread_cond_wait( &work_cond, &work_mutex );
+            idle_count--;
+        }
+        item = LIST_ENTRY( ptr, struct work_item, entry );
+        list_remove( &item->entry );
+        pthread_mutex_unlock( &work_mutex );
+
+        item->work( item->arg );
+
+        pthread_mutex_lock( &work_mutex );
+        list_add_tail( &done_work, &item->entry );
+        if (!notify_pending)
+        {
+            notify_pending = 1;
+            write( workers->pipe_write, &dummy, 1 );
+        }
+    }
+    return NULL;
+}
+
+/* run the completion functions of the finished work items */
+static void workers_poll_event( struct fd *fd, int event )
+{
+    struct list list = LIST_INIT( list ), *ptr;
+    char dummy;
+
+    if (event & (POLLERR | POLLHUP))
+    {
+        /* this is not supposed to happen */
+        fatal_error( "error on worker notification pipe\n" );
+    }
+
+    pthread_mutex_lock( &work_mutex );
+    read( get_unix_fd( fd ), &dummy, 1 );
+    notify_pending = 0;
+    list_move_tail( &list, &done_work );
+    pthread_mutex_unlock( &work_mutex );
+
+    while ((ptr = list_head( &list )))
+    {
+        struct work_item *item = LIST_ENTRY( ptr, struct work_item, entry );
+        list_remove( &item->entry );
+        item->done( item->arg );
+        free( item );
+    }
+}
+
+/* create the worker notification pipe */
+void init_workers(void)
+{
+    int fd[2];
+
+    if (worker_threads <= 0) return;
+
+    if (pipe( fd ) == -1) goto failed;
+    fcntl( fd[0], F_SETFD, FD_CLOEXEC );
+    fcntl( fd[1], F_SETFD, FD_CLOEXEC );
+    if (!(workers = alloc_object( &workers_ops )))
+    {
+        close( fd[0] );
+        close( fd[1] );
+        goto failed;
+    }
+    workers->pipe_write = fd[1];
+    if (!(workers->fd = create_anonymous_fd( &workers_fd_ops, fd[0], &workers->obj, 0 )))
+    {
+        release_object( workers );
+        workers = NULL;
+        goto failed;
+    }
+    set_fd_events( workers->fd, POLLIN );
+    make_object_static( &workers->obj );
+    return;
+
+failed:
+    fprintf( stderr, "wineserver: cannot create worker threads, running single-threaded\n" );
+    worker_threads = 0;
+}
+
+/* start a new worker thread; must be called with work_mutex held */
+static int start_worker(void)
+{
+    pthread_attr_t attr;
+    pthread_t thread;
+    sigset_t sigset, old_sigset;
+    int ret;
+
+    /* signals are handled by the main thread only */
+    sigfillset( &sigset );
+    pthread_sigmask( SIG_SETMASK, &sigset, &old_sigset );
+    pthread_attr_init( &attr );
+    pthread_attr_setdetachstate( &attr, PTHREAD_CREATE_DETACHED );
+    pthread_attr_setstacksize( &attr, 256 * 1024 );
+    ret = pthread_create( &thread, &attr, worker_thread, NULL );
+    pthread_attr_destroy( &attr );
+    pthread_sigmask( SIG_SETMASK, &old_sigset, NULL );
+
+    if (ret) return 0;
+    thread_count++;
+    return 1;
+}
+
+/* queue a function to be run by a worker thread, and its completion in the main loop */
+int queue_work( void (*work)( void *arg ), void (*done)( void *arg ), void *arg )
+{
+    struct work_item *item;
+
+    if (!workers) return 0;
+    if (!(item = malloc( sizeof(*item) ))) return 0;
+
+    item->work = work;
+    item->done = done;
+    item->arg  = arg;
+
+    pthread_mutex_lock( &work_mutex );
+    if (!idle_count && thread_count < worker_threads && !start_worker() && !thread_count)
+    {
+        pthread_mutex_unlock( &work_mutex );
+        free( item );
+        return 0;
+    }
+    list_add_tail( &pending_work, &item->entry );
+    pthread_cond_signal( &work_cond );
+    pthread_mutex_unlock( &work_mutex );
+    return 1;
+}
+
+#else  /* HAVE_PTHREAD_H */
+
+void init_workers(void)
+{
+    worker_threads = 0;
+}
+
+int queue_work( void (*work)( void *arg ), void (*done)( void *arg ), void *arg )
+{
+    return 0;
+}
+
+#endif  /* HAVE_PTHREAD_H */